@@ -0,0 +1,274 @@
+#include "bench.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory_resource>
+#include <sstream>
+#include "pe_lib/pe_bliss.h"
+#include "handler/handler.hpp"
+
+using namespace pe_bliss;
+
+static std::size_t count_resource_entries(const resource_directory& dir)
+{
+	std::size_t count = 0;
+	for (const resource_directory_entry& entry : dir.get_entry_list()) {
+		if (entry.includes_data())
+			++count;
+		else
+			count += count_resource_entries(entry.get_resource_directory());
+	}
+	return count;
+}
+
+// compares the entropy map of data with entropy of every window counted separately,
+// windows start every step bytes while they are inside of data and stop at the first one reaching its end
+static void check_entropy_map(const char* data, std::size_t length, std::size_t window_size, std::size_t step)
+{
+	entropy_map expected;
+	for (std::size_t start = 0; start < length; start += step) {
+		std::size_t end = (std::min)(start + window_size, length);
+		expected.push_back(entropy_calculator::calculate_entropy(data + start, end - start));
+		if (end == length)
+			break;
+	}
+
+	if (entropy_calculator::calculate_entropy_map(data, length, window_size, step) != expected) {
+		char text[128];
+		snprintf(text, sizeof(text), "Entropy map of %zu bytes with window %zu and step %zu is wrong\n", length, window_size, step);
+		print_error(text);
+	}
+}
+
+namespace {
+	// forwards to upstream and counts the allocations
+	class c_counting_resource : public std::pmr::memory_resource {
+	public:
+		explicit c_counting_resource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+			: m_upstream(upstream) {}
+
+		std::size_t allocations() const { return m_allocations; }
+		std::size_t bytes() const { return m_bytes; }
+
+	private:
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			m_allocations++;
+			m_bytes += bytes;
+			return m_upstream->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+		{
+			m_upstream->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+		std::pmr::memory_resource* m_upstream;
+		std::size_t m_allocations = 0;
+		std::size_t m_bytes = 0;
+	};
+}
+
+c_bench::c_bench(std::string image, std::uint32_t iterations)
+	: m_image(std::move(image)), m_iterations(iterations ? iterations : 1) {}
+
+template<typename Fn>
+double c_bench::measure(Fn&& fn)
+{
+	// one warm-up run, then the average over all iterations
+	fn();
+
+	auto start = std::chrono::steady_clock::now();
+	for (std::uint32_t i = 0; i < m_iterations; i++)
+		fn();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / m_iterations;
+}
+
+void c_bench::report(const char* name, double seconds, std::size_t bytes, std::size_t entries)
+{
+	double mb_per_sec = seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0;
+	double entries_per_sec = seconds > 0 ? entries / seconds : 0;
+
+	printf("%-18s %10.3f ms %10.2f MB/s %14.0f entries/s %10zu entries\n",
+		name, seconds * 1000.0, mb_per_sec, entries_per_sec, entries);
+}
+
+template<typename Fn>
+void c_bench::report_allocations(const char* name, Fn&& fn)
+{
+	// every node on the heap, as with the default resource
+	c_counting_resource heap;
+	fn(&heap);
+
+	// the same nodes from one arena, only its buffers reach the heap
+	c_counting_resource upstream;
+	{
+		std::pmr::monotonic_buffer_resource arena(&upstream);
+		fn(&arena);
+	}
+
+	printf("%-18s %10zu allocs %10.2f MB %10zu allocs with arena %10.2f MB\n",
+		name, heap.allocations(), heap.bytes() / (1024.0 * 1024.0),
+		upstream.allocations(), upstream.bytes() / (1024.0 * 1024.0));
+}
+
+void c_bench::run()
+{
+	printf("image size %zu bytes, %u iterations\n", m_image.size(), m_iterations);
+
+	std::istringstream stream(m_image);
+	pe_base pe(pe_factory::create_pe(stream));
+
+	double t = measure([this]() {
+		std::istringstream in(m_image);
+		pe_base image(pe_factory::create_pe(in));
+	});
+	report("load", t, m_image.size(), pe.get_image_sections().size());
+
+	// the default pool above reuses section blocks of the previous load, a pool caching nothing allocates them every time
+	section_buffer_pool no_reuse(0);
+	t = measure([this, &no_reuse]() {
+		std::istringstream in(m_image);
+		pe_base image(pe_factory::create_pe(in, false, &no_reuse));
+	});
+	report("load (no reuse)", t, m_image.size(), pe.get_image_sections().size());
+
+	section_buffer_pool pool;
+	measure([this, &pool]() {
+		std::istringstream in(m_image);
+		pe_base image(pe_factory::create_pe(in, false, &pool));
+	});
+	printf("%-18s %10zu allocs %10zu reused\n", "section buffers", pool.get_allocations(), pool.get_reused());
+
+	// a copy cut inside of headers is rejected early, so the cost of the error path is not hidden by section reads,
+	// once by exception and once through pe_error
+	std::string truncated = m_image.substr(0, 0x200);
+	t = measure([&truncated]() {
+		std::istringstream in(truncated);
+		try {
+			pe_base image(pe_factory::create_pe(in));
+		}
+		catch (const pe_exception&) {
+		}
+	});
+	report("reject (throw)", t, truncated.size(), 0);
+
+	t = measure([&truncated]() {
+		std::istringstream in(truncated);
+		pe_error error;
+		return pe_factory::try_create_pe(in, error) != nullptr;
+	});
+	report("reject (pe_error)", t, truncated.size(), 0);
+
+	if (pe.has_imports()) {
+		std::size_t entries = 0;
+		for (const import_library& lib : get_imported_functions(pe))
+			entries += lib.get_imported_functions().size();
+
+		t = measure([&pe]() { get_imported_functions(pe); });
+		report("imports", t, pe.get_directory_size(pe_win::image_directory_entry_import), entries);
+
+		t = measure([&pe]() { get_import_table(pe); });
+		report("imports (table)", t, pe.get_directory_size(pe_win::image_directory_entry_import), entries);
+
+		t = measure([&pe]() {
+			std::pmr::monotonic_buffer_resource arena;
+			get_imported_functions(pe, &arena);
+		});
+		report("imports (arena)", t, pe.get_directory_size(pe_win::image_directory_entry_import), entries);
+		report_allocations("imports", [&pe](std::pmr::memory_resource* resource) { get_imported_functions(pe, resource); });
+	}
+
+	if (pe.has_exports()) {
+		std::size_t entries = get_exported_functions(pe).size();
+		t = measure([&pe]() { get_exported_functions(pe); });
+		report("exports", t, pe.get_directory_size(pe_win::image_directory_entry_export), entries);
+
+		t = measure([&pe]() {
+			std::pmr::monotonic_buffer_resource arena;
+			get_exported_functions(pe, &arena);
+		});
+		report("exports (arena)", t, pe.get_directory_size(pe_win::image_directory_entry_export), entries);
+		report_allocations("exports", [&pe](std::pmr::memory_resource* resource) { get_exported_functions(pe, resource); });
+	}
+
+	if (pe.has_reloc()) {
+		std::size_t entries = 0;
+		for (const relocation_table& table : get_relocations(pe))
+			entries += table.get_relocations().size();
+
+		t = measure([&pe]() { get_relocations(pe); });
+		report("relocations", t, pe.get_directory_size(pe_win::image_directory_entry_basereloc), entries);
+
+		t = measure([&pe]() {
+			std::pmr::monotonic_buffer_resource arena;
+			get_relocations(pe, false, &arena);
+		});
+		report("relocations (arena)", t, pe.get_directory_size(pe_win::image_directory_entry_basereloc), entries);
+		report_allocations("relocations", [&pe](std::pmr::memory_resource* resource) { get_relocations(pe, false, resource); });
+	}
+
+	if (pe.has_resources()) {
+		std::size_t entries = count_resource_entries(get_resources(pe));
+		t = measure([&pe]() { get_resources(pe); });
+		report("resources", t, pe.get_directory_size(pe_win::image_directory_entry_resource), entries);
+	}
+
+	if (pe.has_tls()) {
+		std::size_t entries = get_tls_info(pe).get_tls_callbacks().size();
+		t = measure([&pe]() { get_tls_info(pe); });
+		report("tls", t, pe.get_directory_size(pe_win::image_directory_entry_tls), entries);
+	}
+
+	if (pe.has_exception_directory()) {
+		std::size_t entries = get_exception_directory_data(pe).size();
+		t = measure([&pe]() { get_exception_directory_data(pe); });
+		report("exceptions", t, pe.get_directory_size(pe_win::image_directory_entry_exception), entries);
+
+		t = measure([&pe]() { exception_directory_view view(pe); });
+		report("exceptions (view)", t, pe.get_directory_size(pe_win::image_directory_entry_exception), entries);
+
+		// one RVA -> function lookup per entry, in the middle of each function
+		exception_directory_view view(pe);
+		t = measure([&view]() {
+			std::size_t found = 0;
+			for (std::size_t i = 0; i < view.size(); i++)
+				found += view.find_function(view[i].BeginAddress + (view[i].EndAddress - view[i].BeginAddress) / 2) != 0;
+			return found;
+		});
+		report("exception lookup", t, view.size() * sizeof(pe_win::image_runtime_function_entry), view.size());
+	}
+
+	// windows overlapping, adjacent and with gaps between them (step larger than window), the last one shorter
+	std::size_t check_size = (std::min<std::size_t>)(m_image.size(), 0x2345);
+	const std::size_t windows[][2] = { { 4, 12 }, { 0x100, 0x40 }, { 0x400, 0x400 }, { 0x400, 0x1001 }, { 0x10000, 0x100 } };
+	for (const auto& [window_size, step] : windows) {
+		check_entropy_map(m_image.data(), (std::min<std::size_t>)(check_size, 10), window_size, step);
+		check_entropy_map(m_image.data(), check_size, window_size, step);
+	}
+
+	std::size_t section_bytes = 0;
+	for (const section& s : pe.get_image_sections())
+		section_bytes += s.get_raw_view().size();
+
+	t = measure([&pe]() { return entropy_calculator::calculate_entropy(pe); });
+	report("entropy", t, section_bytes, pe.get_image_sections().size());
+
+	t = measure([this]() {
+		std::istringstream in(m_image);
+		return entropy_calculator::calculate_entropy(in);
+	});
+	report("entropy (stream)", t, m_image.size(), 1);
+
+	// 4 kb windows every 1 kb, each byte is counted in and out of four windows
+	std::size_t entries = entropy_calculator::calculate_entropy_map(m_image.data(), m_image.size(), 0x1000, 0x400).size();
+	t = measure([this]() { return entropy_calculator::calculate_entropy_map(m_image.data(), m_image.size(), 0x1000, 0x400); });
+	report("entropy map", t, m_image.size(), entries);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Times pe_lib parsers over one in-memory image and reports
+// MB/s and entries/s per directory type, and how many allocations
+// list parsers make with and without a monotonic arena, and how many section
+// buffers a section_buffer_pool reuses between loads, then entropy of section data,
+// of the image stream and its entropy map (after checking the map against separately counted windows)
+class c_bench
+{
+public:
+	c_bench(std::string image, std::uint32_t iterations);
+
+	void run();
+
+private:
+	template<typename Fn>
+	double measure(Fn&& fn);
+
+	void report(const char* name, double seconds, std::size_t bytes, std::size_t entries);
+
+	// fn(std::pmr::memory_resource*) parses into the given resource
+	template<typename Fn>
+	void report_allocations(const char* name, Fn&& fn);
+
+	std::string m_image;
+	std::uint32_t m_iterations;
+};
@@ -0,0 +1,196 @@
+#include "emit_bench.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include "core/emitter.hpp"
+#include "handler/handler.hpp"
+
+using namespace asmjit;
+
+namespace {
+	enum op_t {
+		op_push, op_pop, op_neg,
+		op_add_rr, op_sub_rr, op_imul_rr, op_mov_rr, op_xor_rr,
+		op_add_ri, op_sub_ri, op_imul_ri, op_and_ri, op_shr_ri,
+		op_cpuid, op_nop,
+		ops_count
+	};
+
+	// jumps of the junk generators, the rest of kinds are conditions
+	enum jump_t { jump_jmp, jump_call, jump_jecxz, jump_jcc };
+	const x86::CondCode jump_conds[] = { x86::CondCode::kZ, x86::CondCode::kNZ, x86::CondCode::kB, x86::CondCode::kBE,
+		x86::CondCode::kL, x86::CondCode::kLE, x86::CondCode::kG };
+	const std::uint32_t jump_kinds = jump_jcc + sizeof(jump_conds) / sizeof(jump_conds[0]);
+
+	// registers returned by c_core::get_rand_reg
+	const std::uint32_t junk_regs[] = { x86::Gp::kIdAx, x86::Gp::kIdBx, x86::Gp::kIdCx, x86::Gp::kIdDx, x86::Gp::kIdSi, x86::Gp::kIdDi };
+
+	// x86::Assembler and c_emitter have the same interface for these shapes
+	template<typename Emitter, typename Inst>
+	void emit_all(Emitter& e, const std::vector<Inst>& instructions)
+	{
+		for (const Inst& inst : instructions) {
+			x86::Gp dst = x86::gpq(inst.dst);
+			x86::Gp src = x86::gpq(inst.src);
+
+			switch (inst.op) {
+			case op_push: e.push(dst); break;
+			case op_pop: e.pop(dst); break;
+			case op_neg: e.neg(dst); break;
+			case op_add_rr: e.add(dst, src); break;
+			case op_sub_rr: e.sub(dst, src); break;
+			case op_imul_rr: e.imul(dst, src); break;
+			case op_mov_rr: e.mov(dst, src); break;
+			case op_xor_rr: e.xor_(dst, src); break;
+			case op_add_ri: e.add(dst, inst.imm); break;
+			case op_sub_ri: e.sub(dst, inst.imm); break;
+			case op_imul_ri: e.imul(dst, inst.imm); break;
+			case op_and_ri: e.and_(dst, inst.imm); break;
+			case op_shr_ri: e.shr(dst, inst.imm); break;
+			case op_cpuid: e.cpuid(); break;
+			case op_nop: e.nop(); break;
+			default: break;
+			}
+		}
+	}
+}
+
+c_emit_bench::c_emit_bench(std::uint32_t instructions, std::uint32_t iterations, std::uint32_t seed)
+	: m_iterations(iterations ? iterations : 1)
+{
+	std::mt19937 rng(seed);
+	m_instructions.resize(instructions);
+	for (inst_t& inst : m_instructions) {
+		inst.op = static_cast<std::uint8_t>(rng() % ops_count);
+		inst.dst = static_cast<std::uint8_t>(junk_regs[rng() % 6]);
+		inst.src = static_cast<std::uint8_t>(junk_regs[rng() % 6]);
+		inst.imm = inst.op == op_shr_ri ? rng() % 64 : rng() % 100;
+	}
+}
+
+template<typename Fn>
+double c_emit_bench::measure(Fn&& fn)
+{
+	// one warm-up run, then the average over all iterations
+	fn();
+
+	auto start = std::chrono::steady_clock::now();
+	for (std::uint32_t i = 0; i < m_iterations; i++)
+		fn();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / m_iterations;
+}
+
+void c_emit_bench::run()
+{
+	printf("%zu instructions, %u iterations\n", m_instructions.size(), m_iterations);
+
+	std::string code_data[2];
+
+	auto emit = [this, &code_data](bool templates) {
+		CodeHolder code;
+		if (code.init(Environment(Arch::kX64)) != kErrorOk)
+			print_error("Failed initialization\n");
+
+		// buffer growth is the same for both ways, it's excluded from the measurement
+		if (code.reserve_buffer(&code.text_section()->_buffer, m_instructions.size() * 16) != kErrorOk)
+			print_error("Failed allocation of code buffer\n");
+
+		x86::Assembler assembler(&code);
+		if (templates) {
+			c_emitter emitter(&assembler);
+			emit_all(emitter, m_instructions);
+		}
+		else {
+			emit_all(assembler, m_instructions);
+		}
+
+		code_data[templates].assign(reinterpret_cast<const char*>(code.text_section()->data()), assembler.offset());
+	};
+
+	double t_assembler = measure([&emit]() { emit(false); });
+	double t_templates = measure([&emit]() { emit(true); });
+
+	if (code_data[0] != code_data[1])
+		print_error("Templates produced different code\n");
+
+	const char* names[2] = { "assembler", "templates" };
+	double times[2] = { t_assembler, t_templates };
+	for (int i = 0; i < 2; i++) {
+		double inst_per_sec = times[i] > 0 ? m_instructions.size() / times[i] : 0;
+		printf("%-18s %10.3f ms %14.0f inst/s %10zu bytes\n", names[i], times[i] * 1000.0, inst_per_sec, code_data[i].size());
+	}
+
+	printf("speedup %.2fx\n", t_templates > 0 ? t_assembler / t_templates : 0);
+
+	run_labels();
+}
+
+void c_emit_bench::run_labels()
+{
+	// every instruction of the mix becomes a block: forward jump, push, target
+	printf("\n%zu forward jump blocks\n", m_instructions.size());
+
+	std::string code_data[2];
+	std::size_t labels[2] = {};
+	std::size_t label_size[2] = {};
+
+	auto emit = [this, &code_data, &labels, &label_size](bool local) {
+		CodeHolder code;
+		if (code.init(Environment(Arch::kX64)) != kErrorOk)
+			print_error("Failed initialization\n");
+
+		if (code.reserve_buffer(&code.text_section()->_buffer, m_instructions.size() * 16) != kErrorOk)
+			print_error("Failed allocation of code buffer\n");
+
+		x86::Assembler assembler(&code);
+		for (const inst_t& inst : m_instructions) {
+			x86::Gp reg = x86::gpq(inst.dst);
+
+			if (local) {
+				c_local_label label(&assembler);
+				switch (inst.op % jump_kinds) {
+				case jump_jmp: label.jmp(); break;
+				case jump_call: label.call(); break;
+				case jump_jecxz: label.jecxz(); break;
+				default: label.j(jump_conds[inst.op % jump_kinds - jump_jcc]); break;
+				}
+				assembler.push(reg);
+				label.bind();
+			}
+			else {
+				Label label = assembler.new_label();
+				switch (inst.op % jump_kinds) {
+				case jump_jmp: assembler.jmp(label); break;
+				case jump_call: assembler.call(label); break;
+				case jump_jecxz: assembler.jecxz(label); break;
+				default: assembler.j(jump_conds[inst.op % jump_kinds - jump_jcc], label); break;
+				}
+				assembler.push(reg);
+				assembler.bind(label);
+			}
+		}
+
+		code_data[local].assign(reinterpret_cast<const char*>(code.text_section()->data()), assembler.offset());
+		labels[local] = code.label_count();
+		label_size[local] = code.label_count() * sizeof(LabelEntry);
+	};
+
+	double t_labels = measure([&emit]() { emit(false); });
+	double t_local = measure([&emit]() { emit(true); });
+
+	if (code_data[0] != code_data[1])
+		print_error("Local labels produced different code\n");
+
+	const char* names[2] = { "labels", "local labels" };
+	double times[2] = { t_labels, t_local };
+	for (int i = 0; i < 2; i++) {
+		double blocks_per_sec = times[i] > 0 ? m_instructions.size() / times[i] : 0;
+		printf("%-18s %10.3f ms %14.0f blocks/s %10zu labels %10zu KB label entries\n", names[i], times[i] * 1000.0, blocks_per_sec,
+			labels[i], label_size[i] / 1024);
+	}
+
+	printf("speedup %.2fx\n", t_local > 0 ? t_labels / t_local : 0);
+}
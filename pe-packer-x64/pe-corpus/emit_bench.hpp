@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Times emission of the junk instruction mix through x86::Assembler
+// and through pre-encoded templates of c_emitter, checks both give the same code.
+// Forward jump blocks are compared the same way between CodeHolder labels and c_local_label,
+// with the memory the code holder keeps for labels and fixups
+class c_emit_bench
+{
+public:
+	c_emit_bench(std::uint32_t instructions, std::uint32_t iterations, std::uint32_t seed);
+
+	void run();
+
+private:
+	struct inst_t {
+		std::uint8_t op;
+		std::uint8_t dst;
+		std::uint8_t src;
+		std::int64_t imm;
+	};
+
+	template<typename Fn>
+	double measure(Fn&& fn);
+
+	void run_labels();
+
+	std::vector<inst_t> m_instructions;
+	std::uint32_t m_iterations;
+};
@@ -0,0 +1,250 @@
+#include "generator.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+
+using namespace pe_bliss;
+
+c_generator::c_generator(const options& opt)
+	: m_options(opt), m_rng(opt.seed)
+{
+	m_peImage = std::make_unique<pe_base>(pe_properties_64(), 0x1000, false, pe_win::image_subsystem_windows_cui);
+}
+
+void c_generator::generate(std::ostream& out)
+{
+	add_code_sections();
+
+	if (m_options.exports)
+		add_exports();
+
+	if (m_options.import_libraries && m_options.imports_per_library)
+		add_imports();
+
+	if (m_options.tls_callbacks)
+		add_tls();
+
+	if (m_options.resource_types && m_options.resource_names && m_options.resource_languages)
+		add_resources();
+
+	// relocations go last, so the loader-visible layout above stays untouched
+	if (m_options.relocations)
+		add_relocations();
+
+	rebuild_pe(*m_peImage, out);
+
+	std::string overlay = random_bytes(m_options.overlay_size);
+	out.write(overlay.data(), overlay.size());
+}
+
+void c_generator::add_code_sections()
+{
+	// every byte of .text is a ret, so any exported or callback RVA is harmless
+	section code;
+	code.set_name(".text");
+	code.readable(true).executable(true);
+	code.get_raw_buffer().assign(0x10000, '\xC3');
+
+	section& code_sec = m_peImage->add_section(code);
+	m_code_rva = code_sec.get_virtual_address();
+	m_code_size = static_cast<std::uint32_t>(code_sec.get_raw_view().size());
+	m_peImage->set_ep(m_code_rva);
+
+	// .data holds one qword per relocation
+	section data;
+	data.set_name(".data");
+	data.readable(true).writeable(true);
+	data.get_raw_buffer().assign(std::max<std::size_t>(m_options.relocations, 1) * sizeof(std::uint64_t), '\0');
+
+	section& data_sec = m_peImage->add_section(data);
+	m_data_rva = data_sec.get_virtual_address();
+
+	std::uint64_t image_base = m_peImage->get_image_base_64();
+	section_buffer& raw = data_sec.get_raw_buffer();
+	for (std::size_t i = 0; i + sizeof(std::uint64_t) <= raw.size(); i += sizeof(std::uint64_t)) {
+		std::uint64_t va = image_base + m_code_rva + (i % m_code_size);
+		memcpy(&raw[i], &va, sizeof(va));
+	}
+
+	for (std::uint32_t i = 0; i < m_options.sections; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), ".fill%u", i);
+
+		section filler;
+		filler.set_name(name);
+		filler.readable(true);
+		filler.set_raw_data(random_bytes(m_options.section_size));
+		m_peImage->add_section(filler);
+	}
+}
+
+void c_generator::add_relocations()
+{
+	relocation_table_list tables;
+	for (std::uint32_t i = 0; i < m_options.relocations; i++) {
+		std::uint32_t rva = m_data_rva + i * static_cast<std::uint32_t>(sizeof(std::uint64_t));
+		std::uint32_t page = rva & ~0xFFFu;
+
+		if (tables.empty() || tables.back().get_rva() != page)
+			tables.push_back(relocation_table(page));
+
+		tables.back().add_relocation(relocation_entry(static_cast<std::uint16_t>(rva & 0xFFF), pe_win::image_rel_based_dir64));
+	}
+
+	rebuild_relocations(*m_peImage, tables, add_empty_section(".reloc"));
+}
+
+void c_generator::add_exports()
+{
+	std::uint32_t count = std::min<std::uint32_t>(m_options.exports, 0xFFFF);
+
+	exported_functions_list exports;
+	exports.reserve(count);
+	for (std::uint32_t i = 0; i < count; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "corpus_export_%05u", i);
+
+		exported_function func;
+		func.set_ordinal(static_cast<std::uint16_t>(i + 1));
+		func.set_rva(m_code_rva + (i * 16) % m_code_size);
+		func.set_name(name);
+		exports.push_back(func);
+	}
+
+	export_info info;
+	info.set_name("corpus.dll");
+	info.set_ordinal_base(1);
+
+	rebuild_exports(*m_peImage, info, exports, add_empty_section(".edata"));
+}
+
+void c_generator::add_imports()
+{
+	imported_functions_list imports;
+	for (std::uint32_t i = 0; i < m_options.import_libraries; i++) {
+		char name[64];
+		snprintf(name, sizeof(name), "corpus%03u.dll", i);
+
+		import_library lib;
+		lib.set_name(name);
+		for (std::uint32_t j = 0; j < m_options.imports_per_library; j++) {
+			// IAT needs a non-zero placeholder, the loader rewrites it from the lookup table anyway
+			imported_function func;
+			func.set_iat_va(m_peImage->get_image_base_64() + m_code_rva);
+			if (j % 8 == 7) {
+				func.set_ordinal(static_cast<std::uint16_t>(j + 1));
+			}
+			else {
+				snprintf(name, sizeof(name), "CorpusImport%03u_%u", i, j);
+				func.set_name(name);
+				func.set_hint(static_cast<std::uint16_t>(j));
+			}
+			lib.add_import(func);
+		}
+		imports.push_back(lib);
+	}
+
+	rebuild_imports(*m_peImage, imports, add_empty_section(".idata"), import_rebuilder_settings(true, false));
+}
+
+void c_generator::add_tls()
+{
+	const std::uint32_t ptr_size = sizeof(std::uint64_t);
+	const std::uint32_t template_size = 0x40;
+
+	// layout: index, callbacks (null terminated), raw data template, directory
+	std::uint32_t callbacks_offset = 2 * ptr_size;
+	std::uint32_t template_offset = callbacks_offset + (m_options.tls_callbacks + 1) * ptr_size;
+	std::uint32_t directory_offset = template_offset + template_size;
+
+	section& tls_sec = add_empty_section(".tls", directory_offset + sizeof(pe_win::image_tls_directory64));
+
+	std::uint32_t base = tls_sec.get_virtual_address();
+
+	tls_info info;
+	info.set_index_rva(base);
+	info.set_callbacks_rva(base + callbacks_offset);
+	info.set_raw_data_start_rva(base + template_offset);
+	info.set_raw_data(random_bytes(template_size));
+	info.recalc_raw_data_end_rva();
+
+	for (std::uint32_t i = 0; i < m_options.tls_callbacks; i++)
+		info.add_tls_callback(m_code_rva + (i * 16) % m_code_size);
+
+	rebuild_tls(*m_peImage, info, tls_sec, directory_offset);
+}
+
+void c_generator::add_resources()
+{
+	resource_directory root;
+	for (std::uint32_t t = 0; t < m_options.resource_types; t++) {
+		resource_directory names;
+		for (std::uint32_t n = 0; n < m_options.resource_names; n++) {
+			resource_directory languages;
+			for (std::uint32_t l = 0; l < m_options.resource_languages; l++) {
+				resource_directory_entry lang_entry;
+				lang_entry.set_id(0x409 + l);
+				if (m_options.resource_depth)
+					lang_entry.add_resource_directory(make_resource_level(m_options.resource_depth));
+				else
+					lang_entry.add_data_entry(resource_data_entry(random_bytes(m_options.resource_size), 0));
+
+				languages.add_resource_directory_entry(lang_entry);
+			}
+
+			resource_directory_entry name_entry;
+			if (n % 2) {
+				wchar_t name[32];
+				swprintf(name, sizeof(name) / sizeof(name[0]), L"CORPUS_%u", n);
+				name_entry.set_name(name);
+			}
+			else {
+				name_entry.set_id(n + 1);
+			}
+			name_entry.add_resource_directory(languages);
+			names.add_resource_directory_entry(name_entry);
+		}
+
+		// custom types, so resource viewers don't try to decode the random payloads
+		resource_directory_entry type_entry;
+		type_entry.set_id(0x100 + t);
+		type_entry.add_resource_directory(names);
+		root.add_resource_directory_entry(type_entry);
+	}
+
+	rebuild_resources(*m_peImage, root, add_empty_section(".rsrc"));
+}
+
+resource_directory c_generator::make_resource_level(std::uint32_t depth)
+{
+	resource_directory_entry entry;
+	entry.set_id(depth);
+	if (depth > 1)
+		entry.add_resource_directory(make_resource_level(depth - 1));
+	else
+		entry.add_data_entry(resource_data_entry(random_bytes(m_options.resource_size), 0));
+
+	resource_directory dir;
+	dir.add_resource_directory_entry(entry);
+	return dir;
+}
+
+section& c_generator::add_empty_section(const char* name, std::size_t size)
+{
+	section s;
+	s.set_name(name);
+	s.readable(true);
+	s.get_raw_buffer().resize(size);
+	return m_peImage->add_section(s);
+}
+
+std::string c_generator::random_bytes(std::size_t size)
+{
+	std::string data(size, '\0');
+	std::uniform_int_distribution<int> dist(0, 0xFF);
+	for (char& c : data)
+		c = static_cast<char>(dist(m_rng));
+
+	return data;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <string>
+#include "pe_lib/pe_bliss.h"
+
+// Builds synthetic PE64 images with controllable directory sizes,
+// used as reproducible inputs for benchmarks and stress tests
+class c_generator
+{
+public:
+	struct options {
+		std::uint32_t sections = 4;              // filler sections besides .text/.data
+		std::uint32_t section_size = 0x10000;
+		std::uint32_t relocations = 100000;
+		std::uint32_t exports = 50000;
+		std::uint32_t import_libraries = 32;
+		std::uint32_t imports_per_library = 128;
+		std::uint32_t resource_types = 8;
+		std::uint32_t resource_names = 64;       // per type
+		std::uint32_t resource_languages = 4;    // per name
+		std::uint32_t resource_depth = 0;        // extra nested directories under each language
+		std::uint32_t resource_size = 0x100;
+		std::uint32_t tls_callbacks = 16;
+		std::uint32_t overlay_size = 0x100000;
+		std::uint32_t seed = 1;
+	};
+
+	explicit c_generator(const options& opt);
+
+	// Builds the image and writes it (with overlay) to out
+	void generate(std::ostream& out);
+
+	pe_bliss::pe_base* get_peImage() {
+		return m_peImage.get();
+	}
+
+private:
+	void add_code_sections();
+	void add_relocations();
+	void add_exports();
+	void add_imports();
+	void add_resources();
+	void add_tls();
+
+	pe_bliss::section& add_empty_section(const char* name, std::size_t size = 1);
+	pe_bliss::resource_directory make_resource_level(std::uint32_t depth);
+	std::string random_bytes(std::size_t size);
+
+	options m_options;
+	std::mt19937 m_rng;
+	std::unique_ptr<pe_bliss::pe_base> m_peImage;
+
+	std::uint32_t m_code_rva = 0;
+	std::uint32_t m_code_size = 0;
+	std::uint32_t m_data_rva = 0;
+};
@@ -0,0 +1,118 @@
+#include "kernel_bench.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "core/kernels.hpp"
+#include "core/transform.hpp"
+#include "handler/handler.hpp"
+
+c_kernel_bench::c_kernel_bench(std::string image, std::uint32_t iterations)
+	: m_image(std::move(image)), m_iterations(iterations ? iterations : 1) {}
+
+template<typename Fn>
+double c_kernel_bench::measure(Fn&& fn)
+{
+	// one warm-up run, then the average over all iterations
+	fn();
+
+	auto start = std::chrono::steady_clock::now();
+	for (std::uint32_t i = 0; i < m_iterations; i++)
+		fn();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / m_iterations;
+}
+
+void c_kernel_bench::report(const char* name, double t_scalar, double t_jit)
+{
+	double mb = m_image.size() / (1024.0 * 1024.0);
+	printf("%-10s scalar %10.2f MB/s   jit %10.2f MB/s   speedup %.2fx\n", name,
+		t_scalar > 0 ? mb / t_scalar : 0, t_jit > 0 ? mb / t_jit : 0, t_jit > 0 ? t_scalar / t_jit : 0);
+}
+
+void c_kernel_bench::run()
+{
+	const c_kernels& kernels = c_kernels::get();
+	printf("image size %zu bytes, %u iterations, jit vector width %u bytes\n", m_image.size(), m_iterations, kernels.vec_size());
+
+	// an even number of runs leaves the data unchanged
+	std::string data[2] = { m_image, m_image };
+	double t_scalar = measure([&data]() { c_kernels::xor_bytes_scalar(&data[0][0], data[0].size(), 0x5A); });
+	double t_jit = measure([&data, &kernels]() { kernels.xor_bytes(&data[1][0], data[1].size(), 0x5A); });
+	if (data[0] != data[1])
+		print_error("XOR kernel produced different data\n");
+	report("xor", t_scalar, t_jit);
+
+	std::uint32_t counts[2][256] = {};
+	t_scalar = measure([this, &counts]() { c_kernels::count_bytes_scalar(m_image.data(), m_image.size(), counts[0]); });
+	t_jit = measure([this, &counts, &kernels]() { kernels.count_bytes(m_image.data(), m_image.size(), counts[1]); });
+	if (std::memcmp(counts[0], counts[1], sizeof(counts[0])) != 0)
+		print_error("Histogram kernel produced different counts\n");
+	report("histogram", t_scalar, t_jit);
+
+	std::uint32_t checksum[2] = {};
+	t_scalar = measure([this, &checksum]() { checksum[0] = c_kernels::pe_checksum_scalar(m_image.data(), m_image.size()); });
+	t_jit = measure([this, &checksum, &kernels]() { checksum[1] = kernels.pe_checksum(m_image.data(), m_image.size()); });
+	if (checksum[0] != checksum[1])
+		print_error("Checksum kernel produced different checksum\n");
+	report("checksum", t_scalar, t_jit);
+
+	printf("checksum 0x%08x, entropy %.4f bits/byte\n", checksum[1], kernels.entropy(m_image.data(), m_image.size()));
+
+	run_transform();
+}
+
+void c_kernel_bench::run_transform()
+{
+	const c_kernels& kernels = c_kernels::get();
+
+	// XOR, checksum, histogram and copy of the image: a pass over memory for each of them,
+	// then fused by c_section_transform on one thread and on all of them
+	struct pass_t {
+		std::string data;
+		std::string out;
+		std::uint64_t sum = 0;
+		std::uint32_t counts[256] = {};
+	};
+	pass_t passes[3];
+	for (pass_t& pass : passes) {
+		pass.data = m_image;
+		pass.out.resize(m_image.size());
+	}
+
+	double t_separate = measure([&passes, &kernels]() {
+		pass_t& pass = passes[0];
+		kernels.xor_bytes(&pass.data[0], pass.data.size(), 0x5A);
+		pass.sum += kernels.sum_dwords(reinterpret_cast<const std::uint8_t*>(pass.data.data()), pass.data.size());
+		kernels.count_bytes(pass.data.data(), pass.data.size(), pass.counts);
+		std::memcpy(&pass.out[0], pass.data.data(), pass.data.size());
+	});
+
+	c_section_transform::stats_t stats[2];
+	double t_fused[2];
+	std::uint32_t jobs[2] = { 1, 0 };
+	for (std::uint32_t i = 0; i < 2; i++) {
+		t_fused[i] = measure([&passes, &stats, &jobs, i]() {
+			pass_t& pass = passes[i + 1];
+			c_section_transform transform;
+			std::size_t buffer = transform.add_buffer(&pass.data[0], pass.data.size());
+			transform.add_xor(buffer, 0, pass.data.size(), 0x5A);
+			transform.add_checksum(buffer, &pass.sum);
+			transform.add_histogram(buffer, pass.counts);
+			transform.add_copy(buffer, &pass.out[0]);
+			stats[i] = transform.run(jobs[i]);
+		});
+	}
+
+	for (std::uint32_t i = 1; i < 3; i++) {
+		if (passes[i].data != passes[0].data || passes[i].out != passes[0].out || passes[i].sum != passes[0].sum ||
+			std::memcmp(passes[i].counts, passes[0].counts, sizeof(passes[0].counts)) != 0)
+			print_error("Fused section transform produced different results\n");
+	}
+
+	double mb = m_image.size() / (1024.0 * 1024.0);
+	printf("%-10s separate %8.2f MB/s   fused %8.2f MB/s   speedup %.2fx\n", "transform",
+		t_separate > 0 ? mb / t_separate : 0, t_fused[0] > 0 ? mb / t_fused[0] : 0, t_fused[0] > 0 ? t_separate / t_fused[0] : 0);
+	printf("%-10s %zu chunks on %u threads %8.2f MB/s   speedup %.2fx   memory bandwidth %.2f MB/s\n", "",
+		stats[1].chunks, stats[1].threads, t_fused[1] > 0 ? mb / t_fused[1] : 0, t_fused[1] > 0 ? t_separate / t_fused[1] : 0, stats[1].bandwidth());
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Times the JIT kernels of the packer (section XOR, byte histogram, PE checksum)
+// against their compiled scalar versions on one in-memory image, checks both give the same results,
+// then compares separate passes of XOR, checksum, histogram and copy with the fused c_section_transform pass
+class c_kernel_bench
+{
+public:
+	c_kernel_bench(std::string image, std::uint32_t iterations);
+
+	void run();
+
+private:
+	template<typename Fn>
+	double measure(Fn&& fn);
+
+	void report(const char* name, double t_scalar, double t_jit);
+	void run_transform();
+
+	std::string m_image;
+	std::uint32_t m_iterations;
+};
@@ -0,0 +1,72 @@
+#include "pack_bench.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "core/pack.hpp"
+
+c_pack_bench::c_pack_bench(std::vector<std::uint8_t> image, const c_core::options& opt, std::uint32_t packs, std::uint32_t threads)
+	: m_image(std::move(image)), m_options(opt), m_packs(packs ? packs : 1), m_threads(threads ? threads : 1)
+{
+	// packs run in parallel with each other, not their stubs
+	m_options.stub_jobs = 1;
+	m_options.verbose = false;
+	if (!m_options.seed)
+		m_options.seed = 1;
+}
+
+double c_pack_bench::measure(std::uint32_t threads, std::uint32_t& mismatches)
+{
+	std::atomic<std::uint32_t> next_pack(0);
+	std::atomic<std::uint32_t> different(0);
+
+	auto worker = [&]() {
+		while (next_pack++ < m_packs) {
+			if (pe_packer::pack(m_image, m_options) != m_reference)
+				different++;
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for (std::uint32_t i = 1; i < threads; i++)
+		workers.emplace_back(worker);
+
+	worker();
+	for (std::thread& t : workers)
+		t.join();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	mismatches = different;
+	return elapsed.count();
+}
+
+void c_pack_bench::run()
+{
+	// the warm-up pack is the reference output
+	m_reference = pe_packer::pack(m_image, m_options);
+
+	printf("image size %zu bytes, packed size %zu bytes, %u mutations, %u packs\n",
+		m_image.size(), m_reference.size(), m_options.mutations, m_packs);
+
+	std::vector<std::uint32_t> thread_counts = { 1 };
+	if (m_threads > 1)
+		thread_counts.push_back(m_threads);
+
+	double single = 0;
+	for (std::uint32_t threads : thread_counts) {
+		std::uint32_t mismatches = 0;
+		double seconds = measure(threads, mismatches);
+		if (mismatches)
+			print_error("Concurrent packs produced different images\n");
+
+		double packs_per_sec = seconds > 0 ? m_packs / seconds : 0;
+		double mb_per_sec = seconds > 0 ? m_image.size() * static_cast<double>(m_packs) / seconds / (1024.0 * 1024.0) : 0;
+		if (threads == 1)
+			single = packs_per_sec;
+
+		printf("%2u threads %10.3f s %10.2f packs/s %10.2f MB/s %8.2fx\n",
+			threads, seconds, packs_per_sec, mb_per_sec, single > 0 ? packs_per_sec / single : 0);
+	}
+}
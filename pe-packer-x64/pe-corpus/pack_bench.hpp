@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "core/core.hpp"
+
+// Times in-memory packing through pe_packer::pack with one and with several threads
+// and reports packs/s, every pack has the same seed so all outputs must be equal
+class c_pack_bench
+{
+public:
+	c_pack_bench(std::vector<std::uint8_t> image, const c_core::options& opt, std::uint32_t packs, std::uint32_t threads);
+
+	void run();
+
+private:
+	// returns seconds of all packs, mismatches counts outputs that differ from the reference
+	double measure(std::uint32_t threads, std::uint32_t& mismatches);
+
+	std::vector<std::uint8_t> m_image;
+	std::vector<std::uint8_t> m_reference;
+	c_core::options m_options;
+	std::uint32_t m_packs;
+	std::uint32_t m_threads;
+};
@@ -0,0 +1,190 @@
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "generator.hpp"
+#include "bench.hpp"
+#include "emit_bench.hpp"
+#include "kernel_bench.hpp"
+#include "pack_bench.hpp"
+#include "stub_bench.hpp"
+#include "handler/handler.hpp"
+#include "utils/arguments.hpp"
+
+static void usage()
+{
+	printf(
+		"usage: pe-corpus gen <output.exe> [options]\n"
+		"       pe-corpus bench [input.exe] [-iterations N] [options]\n"
+		"       pe-corpus emit [-instructions N] [-iterations N] [-seed N]\n"
+		"       pe-corpus kernels [input.exe] [-iterations N] [options]\n"
+		"       pe-corpus pack [input.exe] [-mutations N] [-packs N] [-threads N] [packer options]\n"
+		"       pe-corpus stub [input.exe] [-mutations N] [-runs N] [packer options]\n"
+		"without input, bench, kernels, pack and stub generate the image in memory\n"
+		"emit compares stub instruction templates with x86::Assembler\n"
+		"kernels compares JIT kernels (XOR, histogram, checksum) with scalar code, and their separate passes with one fused pass\n"
+		"pack measures in-memory packs/s, mutations are counted like the packer argument\n"
+		"stub runs the entry stub of the packed image on x86-64 hosts and reports its cycles\n\n"
+		"options:\n"
+		"  -sections N      filler sections (default 4)\n"
+		"  -section-size N  filler section size (default 0x10000)\n"
+		"  -relocs N        relocations (default 100000)\n"
+		"  -exports N       exports, at most 65535 (default 50000)\n"
+		"  -libs N          imported libraries (default 32)\n"
+		"  -imports N       imports per library (default 128)\n"
+		"  -res-types N     resource types (default 8)\n"
+		"  -res-names N     resource names per type (default 64)\n"
+		"  -res-langs N     resource languages per name (default 4)\n"
+		"  -res-depth N     extra nested resource directories (default 0)\n"
+		"  -tls N           TLS callbacks (default 16)\n"
+		"  -overlay N       overlay size (default 0x100000)\n"
+		"  -seed N          random seed (default 1)\n");
+}
+
+static void read_option(const char* flag, std::uint32_t& value)
+{
+	const char* str = arguments::get(flag);
+	if (str)
+		value = static_cast<std::uint32_t>(std::strtoul(str, nullptr, 0));
+}
+
+static c_generator::options read_generator_options()
+{
+	c_generator::options opt;
+	read_option("-sections", opt.sections);
+	read_option("-section-size", opt.section_size);
+	read_option("-relocs", opt.relocations);
+	read_option("-exports", opt.exports);
+	read_option("-libs", opt.import_libraries);
+	read_option("-imports", opt.imports_per_library);
+	read_option("-res-types", opt.resource_types);
+	read_option("-res-names", opt.resource_names);
+	read_option("-res-langs", opt.resource_languages);
+	read_option("-res-depth", opt.resource_depth);
+	read_option("-tls", opt.tls_callbacks);
+	read_option("-overlay", opt.overlay_size);
+	read_option("-seed", opt.seed);
+	return opt;
+}
+
+static std::string generate_image()
+{
+	std::ostringstream out;
+	c_generator generator(read_generator_options());
+	generator.generate(out);
+	return out.str();
+}
+
+// input file of the mode if it is given, generated image otherwise
+static std::string read_input(int argc, char** argv)
+{
+	if (argc < 3 || argv[2][0] == '-')
+		return generate_image();
+
+	std::ifstream in(argv[2], std::ios::in | std::ios::binary);
+	if (!in)
+		print_error("Cannot open input file\n");
+
+	std::ostringstream ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+int main(int argc, char** argv)
+{
+	arguments::init(argc, argv);
+
+	if (argc < 2) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	std::string mode = argv[1];
+
+	try
+	{
+		if (mode == "gen" && argc >= 3 && argv[2][0] != '-') {
+			std::string image = generate_image();
+
+			std::ofstream out(argv[2], std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!out)
+				print_error("Cannot open output file\n");
+
+			out.write(image.data(), image.size());
+			print_info("Generated %s (%zu bytes)\n", argv[2], image.size());
+		}
+		else if (mode == "bench") {
+			std::string image = read_input(argc, argv);
+
+			std::uint32_t iterations = 3;
+			read_option("-iterations", iterations);
+
+			c_bench bench(std::move(image), iterations);
+			bench.run();
+		}
+		else if (mode == "emit") {
+			std::uint32_t instructions = 1000000;
+			std::uint32_t iterations = 3;
+			std::uint32_t seed = 1;
+			read_option("-instructions", instructions);
+			read_option("-iterations", iterations);
+			read_option("-seed", seed);
+
+			c_emit_bench bench(instructions, iterations, seed);
+			bench.run();
+		}
+		else if (mode == "kernels") {
+			std::string image = read_input(argc, argv);
+
+			std::uint32_t iterations = 10;
+			read_option("-iterations", iterations);
+
+			c_kernel_bench bench(std::move(image), iterations);
+			bench.run();
+		}
+		else if (mode == "pack") {
+			std::string image = read_input(argc, argv);
+
+			std::uint32_t mutations = 10;
+			std::uint32_t packs = 16;
+			std::uint32_t threads = std::thread::hardware_concurrency();
+			read_option("-mutations", mutations);
+			read_option("-packs", packs);
+			read_option("-threads", threads);
+
+			c_pack_bench bench(std::vector<std::uint8_t>(image.begin(), image.end()),
+				c_core::options::from_arguments(mutations * 10), packs, threads);
+			bench.run();
+		}
+		else if (mode == "stub") {
+			std::string image = read_input(argc, argv);
+
+			std::uint32_t mutations = 10;
+			std::uint32_t runs = 100;
+			read_option("-mutations", mutations);
+			read_option("-runs", runs);
+
+			c_stub_bench bench(std::move(image), c_core::options::from_arguments(mutations * 10), runs);
+			bench.run();
+		}
+		else {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		std::stringstream ss;
+		ss << "[ " << COLOR_RED << "error" << COLOR_RESET << " ] " << ex.what() << "\n";
+		std::cerr << ss.str();
+
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
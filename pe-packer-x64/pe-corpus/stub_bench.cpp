@@ -0,0 +1,331 @@
+#include "stub_bench.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include "core/analyzer.hpp"
+#include "core/pack.hpp"
+#include "handler/handler.hpp"
+#include "pe_lib/pe_bliss.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace asmjit;
+
+namespace {
+	// jmp qword ptr [rip], followed by the absolute address
+	const std::uint8_t jmp_abs[] = { 0xFF, 0x25, 0x00, 0x00, 0x00, 0x00 };
+	const std::size_t landing_size = sizeof(jmp_abs) + sizeof(std::uint64_t);
+
+	// bytes mapped after the packed image, the stub of the second pack can be a bit longer than of the first one
+	const std::size_t region_slack = 0x10000;
+
+	// retired user mode instructions of the calling thread, counts nothing if perf events are not available
+	class c_inst_counter {
+	public:
+#ifdef __linux__
+		c_inst_counter()
+		{
+			perf_event_attr attr{};
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		}
+
+		~c_inst_counter()
+		{
+			if (m_fd >= 0)
+				close(m_fd);
+		}
+
+		bool available() const { return m_fd >= 0; }
+
+		void start()
+		{
+			if (m_fd >= 0) {
+				ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+
+		std::uint64_t stop()
+		{
+			std::uint64_t count = 0;
+			if (m_fd >= 0) {
+				ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+				if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+					count = 0;
+			}
+			return count;
+		}
+
+	private:
+		int m_fd = -1;
+#else
+		bool available() const { return false; }
+		void start() {}
+		std::uint64_t stop() { return 0; }
+#endif
+	};
+
+	std::uint64_t median(std::vector<std::uint64_t> values)
+	{
+		if (values.empty())
+			return 0;
+
+		std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+		return values[values.size() / 2];
+	}
+}
+
+c_stub_bench::c_stub_bench(std::string image, const c_core::options& opt, std::uint32_t runs)
+	: m_image(std::move(image)), m_options(opt), m_runs(runs ? runs : 1)
+{
+	m_options.verbose = false;
+	// both packs must generate the same stub
+	if (!m_options.seed)
+		m_options.seed = 1;
+}
+
+c_stub_bench::~c_stub_bench()
+{
+	if (m_region)
+		(void)VirtMem::release(m_region, m_region_size);
+}
+
+std::vector<std::uint8_t> c_stub_bench::map_image(const std::string& image, std::uint32_t& entry_point)
+{
+	std::istringstream in(image);
+	pe_bliss::pe_base pe(pe_bliss::pe_factory::create_pe(in));
+
+	std::vector<std::uint8_t> mapped(pe.get_size_of_image());
+	for (const pe_bliss::section& sec : pe.get_image_sections()) {
+		std::string_view data = sec.get_raw_view();
+		std::size_t rva = sec.get_virtual_address();
+		if (rva >= mapped.size())
+			continue;
+
+		std::size_t size = (std::min)(data.size(), mapped.size() - rva);
+		if (sec.get_virtual_size())
+			size = (std::min)(size, static_cast<std::size_t>(sec.get_virtual_size()));
+		std::memcpy(&mapped[rva], data.data(), size);
+	}
+
+	entry_point = pe.get_ep();
+	return mapped;
+}
+
+std::vector<c_stub_bench::range_t> c_stub_bench::diff_ranges(const std::uint8_t* a, const std::uint8_t* b, std::size_t size)
+{
+	std::vector<range_t> ranges;
+	for (std::size_t i = 0; i < size;) {
+		if (a[i] == b[i]) {
+			i++;
+			continue;
+		}
+
+		std::size_t start = i;
+		while (i < size && a[i] != b[i])
+			i++;
+		ranges.push_back({ start, i - start });
+	}
+	return ranges;
+}
+
+void c_stub_bench::compile_enter()
+{
+	CodeHolder code;
+	if (code.init(m_runtime.environment(), m_runtime.cpu_features()) != kErrorOk)
+		print_error("Failed initialization of stub harness\n");
+
+	x86::Assembler a(&code);
+
+	FuncDetail func;
+	func.init(FuncSignature::build<std::uint64_t, const void*, void*>(), code.environment());
+
+	// the stub may change any general purpose register
+	FuncFrame frame;
+	frame.init(func);
+	frame.set_all_dirty(RegGroup::kGp);
+
+	x86::Gp entry = x86::r10;
+	x86::Gp stack_top = x86::r11;
+	x86::Gp state = x86::r9;
+
+	FuncArgsAssignment args(&func);
+	args.assign_all(entry, stack_top);
+	args.update_func_frame(frame);
+	frame.finalize();
+
+	a.emit_prolog(frame);
+	a.emit_args_assignment(frame, args);
+
+	a.mov(state, reinterpret_cast<std::uint64_t>(&m_state));
+	a.mov(x86::qword_ptr(state, offsetof(state_t, saved_rsp)), x86::rsp);
+
+	a.lfence();
+	a.rdtsc();
+	a.shl(x86::rdx, 32);
+	a.or_(x86::rax, x86::rdx);
+	a.mov(x86::qword_ptr(state, offsetof(state_t, start)), x86::rax);
+	a.lfence();
+
+	a.mov(x86::rsp, stack_top);
+	a.jmp(entry);
+
+	// the OEP jump of the stub lands here with any stack
+	Label exit = a.new_label();
+	a.bind(exit);
+	a.lfence();
+	a.rdtsc();
+	a.shl(x86::rdx, 32);
+	a.or_(x86::rax, x86::rdx);
+	a.mov(state, reinterpret_cast<std::uint64_t>(&m_state));
+	a.sub(x86::rax, x86::qword_ptr(state, offsetof(state_t, start)));
+	a.mov(x86::rsp, x86::qword_ptr(state, offsetof(state_t, saved_rsp)));
+	a.emit_epilog(frame);
+
+	if (m_runtime.add(&m_enter, &code) != kErrorOk)
+		print_error("Failed compilation of stub harness\n");
+
+	m_exit = reinterpret_cast<const std::uint8_t*>(m_enter) + code.label_offset(exit);
+}
+
+std::uint64_t c_stub_bench::run_stub(const void* entry)
+{
+	std::uint64_t* stack_top = m_stack.data() + m_stack.size() - 2;
+	return m_enter(entry, stack_top);
+}
+
+void c_stub_bench::run()
+{
+	if (m_runtime.environment().arch() != Arch::kX64)
+		print_error("Stub harness needs an x86-64 host\n");
+
+	compile_enter();
+
+	// the first pack gives the size of the region, the second one generates the same stub for its address
+	std::vector<std::uint8_t> packed = pe_packer::pack(reinterpret_cast<const std::uint8_t*>(m_image.data()), m_image.size(), m_options);
+	std::uint32_t packed_ep = 0;
+	m_region_size = map_image(std::string(packed.begin(), packed.end()), packed_ep).size() + region_slack;
+
+	void* region = nullptr;
+	if (VirtMem::alloc(&region, m_region_size, VirtMem::MemoryFlags::kAccessRWX) != kErrorOk)
+		print_error("Cannot allocate executable memory for the image\n");
+	m_region = static_cast<std::uint8_t*>(region);
+
+	m_options.stub_image_base = reinterpret_cast<std::uint64_t>(m_region);
+	packed = pe_packer::pack(reinterpret_cast<const std::uint8_t*>(m_image.data()), m_image.size(), m_options);
+
+	std::uint32_t oep = 0;
+	std::vector<std::uint8_t> original = map_image(m_image, oep);
+	std::vector<std::uint8_t> mapped = map_image(std::string(packed.begin(), packed.end()), packed_ep);
+	if (mapped.size() > m_region_size || original.size() > mapped.size())
+		print_error("Packed image doesn't fit the region\n");
+
+	// .ptext is the last section, the entry stub starts in it
+	std::istringstream packed_in(std::string(packed.begin(), packed.end()));
+	pe_bliss::pe_base packed_pe(pe_bliss::pe_factory::create_pe(packed_in));
+	const pe_bliss::section& stub_section = packed_pe.get_image_sections().back();
+	std::size_t stub_rva = stub_section.get_virtual_address();
+	std::size_t stub_size = stub_section.get_virtual_size();
+	stub_stats_t stats = analyze_stub(&mapped[stub_rva], stub_size, packed_ep - stub_rva);
+
+	std::vector<range_t> encrypted = diff_ranges(original.data(), mapped.data(), original.size());
+	std::size_t encrypted_bytes = 0;
+	for (const range_t& range : encrypted) {
+		encrypted_bytes += range.size;
+		if (range.offset < oep + landing_size && oep < range.offset + range.size)
+			print_error("Entry point is inside of an encrypted range, the OEP jump can't be redirected\n");
+	}
+
+	std::memcpy(m_region, mapped.data(), mapped.size());
+	std::uint64_t exit_address = reinterpret_cast<std::uint64_t>(m_exit);
+	std::memcpy(m_region + oep, jmp_abs, sizeof(jmp_abs));
+	std::memcpy(m_region + oep + sizeof(jmp_abs), &exit_address, sizeof(exit_address));
+
+	// a return address for every byte of the stub at most
+	m_stack.resize(stub_size + 0x2000);
+
+	printf("stub %zu bytes, %llu instructions, %u mutations, %u runs, %zu encrypted ranges (%zu bytes)\n",
+		stub_size, static_cast<unsigned long long>(stats.instructions), m_options.mutations, m_runs, encrypted.size(), encrypted_bytes);
+	printf("static estimate: path %llu-%llu instructions, %llu-%llu cycles\n",
+		static_cast<unsigned long long>(stats.path_min), static_cast<unsigned long long>(stats.path_max),
+		static_cast<unsigned long long>(stats.cycles_min), static_cast<unsigned long long>(stats.cycles_max));
+
+	c_inst_counter counter;
+
+	// harness overhead is measured by jumping right to the exit
+	std::vector<std::uint64_t> overhead_cycles, overhead_insts;
+	for (std::uint32_t i = 0; i < 16; i++) {
+		counter.start();
+		overhead_cycles.push_back(run_stub(m_exit));
+		overhead_insts.push_back(counter.stop());
+	}
+	std::uint64_t base_cycles = *std::min_element(overhead_cycles.begin(), overhead_cycles.end());
+	std::uint64_t base_insts = *std::min_element(overhead_insts.begin(), overhead_insts.end());
+
+	const void* entry = m_region + packed_ep;
+	std::vector<std::uint64_t> cycles, insts;
+	std::uint64_t first_cycles = 0;
+	std::vector<range_t> mismatches;
+
+	// the first run is cold, every run decrypts the image packed state again
+	for (std::uint32_t i = 0; i <= m_runs; i++) {
+		for (const range_t& range : encrypted)
+			std::memcpy(m_region + range.offset, &mapped[range.offset], range.size);
+
+		counter.start();
+		std::uint64_t run_cycles = run_stub(entry);
+		std::uint64_t run_insts = counter.stop();
+
+		run_cycles = run_cycles > base_cycles ? run_cycles - base_cycles : 0;
+		run_insts = run_insts > base_insts ? run_insts - base_insts : 0;
+
+		if (i == 0) {
+			first_cycles = run_cycles;
+		}
+		else {
+			cycles.push_back(run_cycles);
+			insts.push_back(run_insts);
+		}
+
+		// all bytes of the input image must be restored, the redirected OEP is compared as the original
+		std::uint8_t landing[landing_size];
+		std::memcpy(landing, m_region + oep, landing_size);
+		std::memcpy(m_region + oep, &original[oep], landing_size);
+		if (mismatches.empty())
+			mismatches = diff_ranges(original.data(), m_region, original.size());
+		std::memcpy(m_region + oep, landing, landing_size);
+	}
+
+	printf("cycles: first run %llu, min %llu, median %llu\n",
+		static_cast<unsigned long long>(first_cycles),
+		static_cast<unsigned long long>(*std::min_element(cycles.begin(), cycles.end())),
+		static_cast<unsigned long long>(median(cycles)));
+
+	if (counter.available())
+		printf("retired instructions: min %llu, median %llu\n",
+			static_cast<unsigned long long>(*std::min_element(insts.begin(), insts.end())),
+			static_cast<unsigned long long>(median(insts)));
+	else
+		printf("retired instructions: perf counters are not available\n");
+
+	if (!mismatches.empty()) {
+		for (const range_t& range : mismatches)
+			print_warning("%zu bytes at RVA 0x%zx differ from the input image\n", range.size, range.offset);
+		print_error("Decrypted image differs from the input image\n");
+	}
+
+	printf("decrypted image matches the input image\n");
+}
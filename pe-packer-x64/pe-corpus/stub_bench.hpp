@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "core/core.hpp"
+
+// Runs the .ptext entry stub of a packed image inside of the process on x86-64 hosts, Linux included,
+// and reports its cycles (and retired instructions where perf counters are available)
+// The image is packed with options::stub_image_base pointing to an RWX buffer its sections are mapped to,
+// the OEP jump lands on a JIT compiled exit and the decrypted buffer is compared with the input image
+class c_stub_bench
+{
+public:
+	c_stub_bench(std::string image, const c_core::options& opt, std::uint32_t runs);
+	~c_stub_bench();
+
+	void run();
+
+private:
+	// bytes changed by packing, the stub restores them
+	struct range_t {
+		std::size_t offset;
+		std::size_t size;
+	};
+
+	// read and written by the JIT compiled enter and exit
+	struct state_t {
+		std::uint64_t saved_rsp;
+		std::uint64_t start;
+	};
+
+	using enter_fn = std::uint64_t (*)(const void* entry, void* stack_top);
+
+	// sections of image copied to their RVAs
+	static std::vector<std::uint8_t> map_image(const std::string& image, std::uint32_t& entry_point);
+	static std::vector<range_t> diff_ranges(const std::uint8_t* a, const std::uint8_t* b, std::size_t size);
+
+	void compile_enter();
+	// cycles from the jump to entry until the exit is reached
+	std::uint64_t run_stub(const void* entry);
+
+	std::string m_image;
+	c_core::options m_options;
+	std::uint32_t m_runs;
+
+	asmjit::JitRuntime m_runtime;
+	enter_fn m_enter = nullptr;
+	const void* m_exit = nullptr;
+	state_t m_state{};
+
+	std::uint8_t* m_region = nullptr;
+	std::size_t m_region_size = 0;
+	// the stub pushes return addresses of its calls and never pops them
+	std::vector<std::uint64_t> m_stack;
+};
@@ -58,3 +58,7 @@
 #include "asmjit/asmjit/support/arenatree.cpp"
 #include "asmjit/asmjit/support/arenavector.cpp"
 #include "asmjit/asmjit/support/support.cpp"
+
+// UniCompiler, used by the JIT kernels of the packer
+#include "asmjit/asmjit/ujit/unicompiler_x86.cpp"
+#include "asmjit/asmjit/ujit/vecconsttable.cpp"
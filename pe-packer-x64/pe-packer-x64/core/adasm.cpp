@@ -1,19 +1,23 @@
 #include "adasm.hpp"
 #include "utils/utils.hpp"
+#include "emitter.hpp"
 
 using namespace asmjit;
 
 c_adasm::c_adasm(c_core& g_core) : m_core(g_core) {}
 
 void c_adasm::jmp_label_skip() {
-	Label skip_cc = m_core.get_assembler()->new_label();
-	m_core.get_assembler()->jz(skip_cc);
-	m_core.get_assembler()->jnz(skip_cc);
+	c_cost_meter& cost = m_core.get_cost();
+	if (!cost.fits({ x86::Inst::kIdJz, x86::Inst::kIdJnz }))
+		return;
+
+	c_local_label skip_cc(m_core.get_assembler(), &cost);
+	skip_cc.j(x86::CondCode::kZ);
+	skip_cc.j(x86::CondCode::kNZ);
 	m_core.get_assembler()->db(0xE9);
 	if (m_core.obf_fake_instr) {
-		for (int i = 0; i < random_value(0x1, 0x100); ++i) {
-			m_core.get_assembler()->db(random_value(0x10, 0xFF));
-		}
+		c_emitter emit(m_core.get_assembler());
+		emit.random_bytes((std::min)(static_cast<std::size_t>(random_value(0x1, 0x100)), m_core.fake_bytes_left()), 0x10, 0xFF, random_engine()());
 	}
-	m_core.get_assembler()->bind(skip_cc);
+	skip_cc.bind();
 }
@@ -0,0 +1,445 @@
+#include "analyzer.hpp"
+#include <algorithm>
+#include <vector>
+#include "asmjit/asmjit.h"
+#include "handler/handler.hpp"
+#include "cost.hpp"
+
+using namespace asmjit;
+
+namespace {
+	// maximum length of x86 instruction
+	const std::size_t max_inst_size = 15;
+
+	enum flow_t : std::uint8_t {
+		flow_next,      // continues with the next instruction
+		flow_jump,      // continues at target
+		flow_jcc,       // next instruction or target
+		flow_exit       // leaves the stub: ret, indirect jump or jump out of the stub
+	};
+
+	// condition of jecxz, it has no opposite condition
+	const std::uint8_t cc_rcx = 0x10;
+
+	struct inst_t {
+		std::size_t offset = 0;
+		std::int64_t target = 0;    // branch target, can be out of the stub
+		InstId id = x86::Inst::kIdNone;
+		std::uint8_t size = 0;
+		std::uint8_t cc = 0;
+		flow_t flow = flow_next;
+	};
+
+	// instructions selected by reg field of modrm
+	enum group_t { group_none, group_alu, group_shift, group_unary, group_inc_dec, group_ff, group_pop, group_mov };
+
+	const InstId alu_ops[8] = {
+		x86::Inst::kIdAdd, x86::Inst::kIdOr, x86::Inst::kIdAdc, x86::Inst::kIdSbb,
+		x86::Inst::kIdAnd, x86::Inst::kIdSub, x86::Inst::kIdXor, x86::Inst::kIdCmp
+	};
+
+	const InstId shift_ops[8] = {
+		x86::Inst::kIdRol, x86::Inst::kIdRor, x86::Inst::kIdRcl, x86::Inst::kIdRcr,
+		x86::Inst::kIdShl, x86::Inst::kIdShr, x86::Inst::kIdShl, x86::Inst::kIdSar
+	};
+
+	const InstId unary_ops[8] = {
+		x86::Inst::kIdTest, x86::Inst::kIdTest, x86::Inst::kIdNot, x86::Inst::kIdNeg,
+		x86::Inst::kIdMul, x86::Inst::kIdImul, x86::Inst::kIdDiv, x86::Inst::kIdIdiv
+	};
+
+	bool is_prefix(std::uint8_t byte)
+	{
+		switch (byte) {
+		case 0x26: case 0x2E: case 0x36: case 0x3E: case 0x64: case 0x65:
+		case 0x66: case 0x67: case 0xF0: case 0xF2: case 0xF3:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// decodes the general purpose subset of x86-64 the stub is made of, false for anything else
+	bool decode(const std::uint8_t* code, std::size_t size, std::size_t offset, inst_t& inst)
+	{
+		const std::uint8_t* start = code + offset;
+		const std::uint8_t* end = code + (std::min)(size, offset + max_inst_size);
+		const std::uint8_t* p = start;
+
+		bool op16 = false;
+		while (p < end && is_prefix(*p)) {
+			if (*p == 0x66)
+				op16 = true;
+			p++;
+		}
+
+		bool rex_w = false;
+		if (p < end && (*p & 0xF0) == 0x40) {
+			rex_w = (*p & 0x08) != 0;
+			p++;
+		}
+
+		if (p >= end)
+			return false;
+
+		const std::uint32_t imm_z = op16 ? 2 : 4;
+
+		bool modrm = false;
+		group_t group = group_none;
+		std::uint32_t imm_size = 0;
+		std::uint32_t rel_size = 0;
+		inst.flow = flow_next;
+
+		std::uint8_t op = *p++;
+		if (op == 0x0F) {
+			if (p >= end)
+				return false;
+
+			op = *p++;
+			if (op >= 0x80 && op <= 0x8F) {
+				inst.id = x86::Inst::kIdJz;
+				inst.flow = flow_jcc;
+				inst.cc = op & 0x0F;
+				rel_size = 4;
+			}
+			else {
+				switch (op) {
+				case 0xA2: inst.id = x86::Inst::kIdCpuid; break;
+				case 0x31: inst.id = x86::Inst::kIdRdtsc; break;
+				case 0x0B: inst.id = x86::Inst::kIdUd2; inst.flow = flow_exit; break;
+				case 0x1F: inst.id = x86::Inst::kIdNop; modrm = true; break;
+				case 0xAF: inst.id = x86::Inst::kIdImul; modrm = true; break;
+				case 0xB6: case 0xB7: inst.id = x86::Inst::kIdMovzx; modrm = true; break;
+				case 0xBE: case 0xBF: inst.id = x86::Inst::kIdMovsx; modrm = true; break;
+				default:
+					return false;
+				}
+			}
+		}
+		else if (op < 0x40 && (op & 0x07) < 6) {
+			inst.id = alu_ops[op >> 3];
+			if ((op & 0x07) < 4)
+				modrm = true;
+			else
+				imm_size = (op & 0x07) == 4 ? 1 : imm_z;
+		}
+		else if (op >= 0x50 && op <= 0x57) {
+			inst.id = x86::Inst::kIdPush;
+		}
+		else if (op >= 0x58 && op <= 0x5F) {
+			inst.id = x86::Inst::kIdPop;
+		}
+		else if (op >= 0x70 && op <= 0x7F) {
+			inst.id = x86::Inst::kIdJz;
+			inst.flow = flow_jcc;
+			inst.cc = op & 0x0F;
+			rel_size = 1;
+		}
+		else if (op >= 0x91 && op <= 0x97) {
+			inst.id = x86::Inst::kIdXchg;
+		}
+		else if (op >= 0xB0 && op <= 0xB7) {
+			inst.id = x86::Inst::kIdMov;
+			imm_size = 1;
+		}
+		else if (op >= 0xB8 && op <= 0xBF) {
+			inst.id = x86::Inst::kIdMov;
+			imm_size = rex_w ? 8 : imm_z;
+		}
+		else {
+			switch (op) {
+			case 0x63: inst.id = x86::Inst::kIdMovsxd; modrm = true; break;
+			case 0x68: inst.id = x86::Inst::kIdPush; imm_size = 4; break;
+			case 0x6A: inst.id = x86::Inst::kIdPush; imm_size = 1; break;
+			case 0x69: inst.id = x86::Inst::kIdImul; modrm = true; imm_size = imm_z; break;
+			case 0x6B: inst.id = x86::Inst::kIdImul; modrm = true; imm_size = 1; break;
+			case 0x80: case 0x83: group = group_alu; modrm = true; imm_size = 1; break;
+			case 0x81: group = group_alu; modrm = true; imm_size = imm_z; break;
+			case 0x84: case 0x85: inst.id = x86::Inst::kIdTest; modrm = true; break;
+			case 0x86: case 0x87: inst.id = x86::Inst::kIdXchg; modrm = true; break;
+			case 0x88: case 0x89: case 0x8A: case 0x8B: inst.id = x86::Inst::kIdMov; modrm = true; break;
+			case 0x8D: inst.id = x86::Inst::kIdLea; modrm = true; break;
+			case 0x8F: group = group_pop; modrm = true; break;
+			case 0x90: inst.id = x86::Inst::kIdNop; break;
+			case 0xA8: inst.id = x86::Inst::kIdTest; imm_size = 1; break;
+			case 0xA9: inst.id = x86::Inst::kIdTest; imm_size = imm_z; break;
+			case 0xC0: case 0xC1: group = group_shift; modrm = true; imm_size = 1; break;
+			case 0xD0: case 0xD1: case 0xD2: case 0xD3: group = group_shift; modrm = true; break;
+			case 0xC2: inst.id = x86::Inst::kIdRet; inst.flow = flow_exit; imm_size = 2; break;
+			case 0xC3: inst.id = x86::Inst::kIdRet; inst.flow = flow_exit; break;
+			case 0xC6: group = group_mov; modrm = true; imm_size = 1; break;
+			case 0xC7: group = group_mov; modrm = true; imm_size = imm_z; break;
+			case 0xCC: inst.id = x86::Inst::kIdInt3; inst.flow = flow_exit; break;
+			case 0xE3: inst.id = x86::Inst::kIdJecxz; inst.flow = flow_jcc; inst.cc = cc_rcx; rel_size = 1; break;
+			case 0xE8: inst.id = x86::Inst::kIdCall; inst.flow = flow_jump; rel_size = 4; break;
+			case 0xE9: inst.id = x86::Inst::kIdJmp; inst.flow = flow_jump; rel_size = 4; break;
+			case 0xEB: inst.id = x86::Inst::kIdJmp; inst.flow = flow_jump; rel_size = 1; break;
+			case 0xF6: group = group_unary; modrm = true; break;
+			case 0xF7: group = group_unary; modrm = true; break;
+			case 0xFE: group = group_inc_dec; modrm = true; break;
+			case 0xFF: group = group_ff; modrm = true; break;
+			default:
+				return false;
+			}
+		}
+
+		std::uint8_t reg = 0;
+		if (modrm) {
+			if (p >= end)
+				return false;
+
+			std::uint8_t mod = *p >> 6;
+			std::uint8_t rm = *p & 0x07;
+			reg = (*p >> 3) & 0x07;
+			p++;
+
+			std::uint32_t disp_size = 0;
+			if (mod != 3) {
+				if (rm == 4) {
+					if (p >= end)
+						return false;
+					// SIB without base register
+					if (mod == 0 && (*p & 0x07) == 5)
+						disp_size = 4;
+					p++;
+				}
+
+				if (mod == 0 && rm == 5)
+					disp_size = 4;
+				else if (mod == 1)
+					disp_size = 1;
+				else if (mod == 2)
+					disp_size = 4;
+			}
+			p += disp_size;
+		}
+
+		switch (group) {
+		case group_alu:
+			inst.id = alu_ops[reg];
+			break;
+		case group_shift:
+			inst.id = shift_ops[reg];
+			break;
+		case group_unary:
+			inst.id = unary_ops[reg];
+			if (reg < 2)
+				imm_size = op == 0xF6 ? 1 : imm_z;
+			break;
+		case group_inc_dec:
+			if (reg > 1)
+				return false;
+			inst.id = reg == 0 ? x86::Inst::kIdInc : x86::Inst::kIdDec;
+			break;
+		case group_ff:
+			switch (reg) {
+			case 0: inst.id = x86::Inst::kIdInc; break;
+			case 1: inst.id = x86::Inst::kIdDec; break;
+			// indirect call returns to the next instruction
+			case 2: inst.id = inst_id_call_indirect; break;
+			case 4: inst.id = inst_id_jmp_indirect; inst.flow = flow_exit; break;
+			case 6: inst.id = x86::Inst::kIdPush; break;
+			default:
+				return false;
+			}
+			break;
+		case group_pop:
+			if (reg != 0)
+				return false;
+			inst.id = x86::Inst::kIdPop;
+			break;
+		case group_mov:
+			if (reg != 0)
+				return false;
+			inst.id = x86::Inst::kIdMov;
+			break;
+		default:
+			break;
+		}
+
+		p += imm_size;
+
+		std::int64_t rel = 0;
+		if (rel_size == 1 && p < end) {
+			rel = static_cast<std::int8_t>(*p);
+		}
+		else if (rel_size == 4 && p + 4 <= end) {
+			rel = static_cast<std::int32_t>(p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<std::uint32_t>(p[3]) << 24));
+		}
+		p += rel_size;
+
+		if (p > end)
+			return false;
+
+		inst.offset = offset;
+		inst.size = static_cast<std::uint8_t>(p - start);
+		inst.target = static_cast<std::int64_t>(offset + inst.size) + rel;
+		return true;
+	}
+
+	// executed instructions and cycles from an instruction to the exit of the stub
+	struct path_t {
+		std::uint64_t insts_min = 0;
+		std::uint64_t insts_max = 0;
+		std::uint64_t cycles_min = 0;
+		std::uint64_t cycles_max = 0;
+		// false if every path from the instruction goes back to a loop
+		bool valid = true;
+	};
+
+	void merge_path(path_t& path, bool& first, const path_t& next)
+	{
+		if (!next.valid)
+			return;
+
+		if (first) {
+			path = next;
+			first = false;
+			return;
+		}
+
+		path.insts_min = (std::min)(path.insts_min, next.insts_min);
+		path.insts_max = (std::max)(path.insts_max, next.insts_max);
+		path.cycles_min = (std::min)(path.cycles_min, next.cycles_min);
+		path.cycles_max = (std::max)(path.cycles_max, next.cycles_max);
+	}
+}
+
+stub_stats_t analyze_stub(const std::uint8_t* code, std::size_t size, std::size_t entry)
+{
+	stub_stats_t stats;
+	stats.size = size;
+
+	if (entry >= size)
+		return stats;
+
+	auto in_stub = [size](std::int64_t offset) { return offset >= 0 && static_cast<std::uint64_t>(offset) < size; };
+
+	std::vector<inst_t> insts;
+	std::vector<bool> visited(size);
+	std::vector<std::size_t> pending = { entry };
+
+	auto follow = [&](const inst_t& inst) {
+		if (inst.flow == flow_next || inst.flow == flow_jcc)
+			pending.push_back(inst.offset + inst.size);
+		if ((inst.flow == flow_jump || inst.flow == flow_jcc) && in_stub(inst.target))
+			pending.push_back(static_cast<std::size_t>(inst.target));
+	};
+
+	while (!pending.empty()) {
+		std::size_t offset = pending.back();
+		pending.pop_back();
+
+		if (offset >= size || visited[offset])
+			continue;
+		visited[offset] = true;
+
+		inst_t inst;
+		if (!decode(code, size, offset, inst)) {
+			stats.undecoded++;
+			continue;
+		}
+
+		// jumps out of the stub never come back
+		if (inst.flow == flow_jump && !in_stub(inst.target))
+			inst.flow = inst.id == x86::Inst::kIdCall ? flow_next : flow_exit;
+
+		// jcc followed by the opposite jcc to the same target is an unconditional jump (anti-disassembly),
+		// bytes after the pair are never executed
+		std::size_t next_offset = offset + inst.size;
+		inst_t next;
+		if (inst.flow == flow_jcc && inst.cc != cc_rcx && next_offset < size && !visited[next_offset] &&
+			decode(code, size, next_offset, next) && next.flow == flow_jcc && next.cc == (inst.cc ^ 1) && next.target == inst.target) {
+			visited[next_offset] = true;
+			next.flow = flow_jump;
+			insts.push_back(next);
+			follow(next);
+		}
+
+		insts.push_back(inst);
+		follow(inst);
+	}
+
+	std::sort(insts.begin(), insts.end(), [](const inst_t& a, const inst_t& b) { return a.offset < b.offset; });
+
+	// all successors of an instruction are after it except the loops, so a single backward pass is enough
+	std::vector<path_t> paths(insts.size());
+	auto path_at = [&](std::int64_t offset) {
+		// leaving the stub or a place that wasn't decoded ends the path
+		path_t end;
+		if (!in_stub(offset))
+			return end;
+
+		auto it = std::lower_bound(insts.begin(), insts.end(), static_cast<std::size_t>(offset),
+			[](const inst_t& inst, std::size_t value) { return inst.offset < value; });
+		if (it == insts.end() || it->offset != static_cast<std::size_t>(offset))
+			return end;
+
+		return paths[it - insts.begin()];
+	};
+
+	for (std::size_t i = insts.size(); i-- > 0;) {
+		const inst_t& inst = insts[i];
+		const inst_cost_t& cost = get_inst_cost(inst.id);
+
+		stats.instructions++;
+		if (cost.cost_class != cost_class_t::regular)
+			stats.serializing++;
+		if (cost.cost_class == cost_class_t::vm_exit)
+			stats.vm_exits++;
+
+		path_t path;
+		bool first = true;
+
+		if (inst.flow == flow_exit)
+			merge_path(path, first, path_t());
+
+		if (inst.flow == flow_next || inst.flow == flow_jcc)
+			merge_path(path, first, path_at(static_cast<std::int64_t>(inst.offset + inst.size)));
+
+		if (inst.flow == flow_jump || inst.flow == flow_jcc) {
+			if (in_stub(inst.target) && static_cast<std::size_t>(inst.target) <= inst.offset)
+				stats.loops++;
+			else
+				merge_path(path, first, path_at(inst.target));
+		}
+
+		if (first) {
+			paths[i].valid = false;
+			continue;
+		}
+
+		path.insts_min++;
+		path.insts_max++;
+		path.cycles_min += cost.min_cycles;
+		path.cycles_max += cost.max_cycles;
+		paths[i] = path;
+	}
+
+	path_t path = path_at(static_cast<std::int64_t>(entry));
+	if (path.valid) {
+		stats.path_min = path.insts_min;
+		stats.path_max = path.insts_max;
+		stats.cycles_min = path.cycles_min;
+		stats.cycles_max = path.cycles_max;
+	}
+
+	return stats;
+}
+
+void print_stub_stats(const stub_stats_t& stats)
+{
+	print_info("Stub: %llu bytes, %llu instructions, %llu serializing (%llu VM exits)\n",
+		static_cast<unsigned long long>(stats.size), static_cast<unsigned long long>(stats.instructions),
+		static_cast<unsigned long long>(stats.serializing), static_cast<unsigned long long>(stats.vm_exits));
+
+	print_info("Stub path: %llu-%llu instructions, %llu-%llu cycles\n",
+		static_cast<unsigned long long>(stats.path_min), static_cast<unsigned long long>(stats.path_max),
+		static_cast<unsigned long long>(stats.cycles_min), static_cast<unsigned long long>(stats.cycles_max));
+
+	if (stats.loops)
+		print_info("Stub path doesn't include iterations of %llu loops\n", static_cast<unsigned long long>(stats.loops));
+
+	if (stats.undecoded)
+		print_warning("Stub analysis stopped at %llu unknown instructions, the path is incomplete\n", static_cast<unsigned long long>(stats.undecoded));
+}
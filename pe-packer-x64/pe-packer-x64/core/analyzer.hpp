@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Static analysis of the generated stub, instructions are decoded from the entry by following the control flow,
+// so bytes hidden behind jumps (anti-disassembly and fake instructions) are never decoded
+// Paths go forward only: backward jumps of the decryption loops are not followed, loop iterations are not counted
+// Calls of the stub never return, they are followed as jumps
+struct stub_stats_t {
+	std::uint64_t size = 0;              // bytes of the whole stub section
+	std::uint64_t instructions = 0;      // reachable instructions
+	std::uint64_t path_min = 0;          // instructions executed from the entry to the jump to OEP
+	std::uint64_t path_max = 0;
+	std::uint64_t cycles_min = 0;        // cycles of the cost model on the cheapest and the most expensive path
+	std::uint64_t cycles_max = 0;
+	std::uint64_t serializing = 0;       // reachable serializing instructions, VM exits included
+	std::uint64_t vm_exits = 0;
+	std::uint64_t loops = 0;             // backward jumps
+	std::uint64_t undecoded = 0;         // places where decoding stopped, paths through them are incomplete
+};
+
+stub_stats_t analyze_stub(const std::uint8_t* code, std::size_t size, std::size_t entry);
+
+void print_stub_stats(const stub_stats_t& stats);
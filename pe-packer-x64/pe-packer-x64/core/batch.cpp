@@ -0,0 +1,292 @@
+#include "batch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "core.hpp"
+
+namespace fs = std::filesystem;
+
+static std::uint32_t get_workers_count() {
+	const char* jobs = arguments::get("-jobs");
+	if (jobs && atoi(jobs) > 0)
+		return static_cast<std::uint32_t>(atoi(jobs));
+
+	std::uint32_t hw = std::thread::hardware_concurrency();
+	return hw ? hw : 1;
+}
+
+static std::uint64_t get_queue_limit() {
+	const char* queue_mb = arguments::get("-queue-mb");
+	std::uint64_t mb = queue_mb && atoi(queue_mb) > 0 ? static_cast<std::uint64_t>(atoi(queue_mb)) : 256;
+	return mb * 1024 * 1024;
+}
+
+static std::string json_string(const std::string& value) {
+	std::string out = "\"";
+	for (char c : value) {
+		switch (c) {
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+				out += escaped;
+			}
+			else {
+				out += c;
+			}
+		}
+	}
+	return out + "\"";
+}
+
+c_batch::c_batch(std::string input_dir, std::string output_dir, std::uint32_t mutations_counter)
+	: m_options(c_core::options::from_arguments(mutations_counter)),
+	m_workers(get_workers_count()),
+	m_read_queue(m_workers * 2),
+	m_write_queue(m_workers * 2),
+	m_budget(get_queue_limit())
+{
+	// files are already packed in parallel
+	m_options.stub_jobs = 1;
+	m_options.section_pool = &m_section_pool;
+
+	m_report_file = arguments::get_after("-report");
+	if (!m_report_file.empty())
+		m_options.stub_stats = true;
+	else if (arguments::has("-report"))
+		print_warning("Argument -report must be followed by report file\n");
+
+	std::error_code ec;
+	if (!fs::is_directory(input_dir, ec))
+		print_error("Batch input must be a directory\n");
+
+	fs::create_directories(output_dir, ec);
+	if (!fs::is_directory(output_dir, ec))
+		print_error("Cannot create batch output directory\n");
+
+	for (const fs::directory_entry& entry : fs::directory_iterator(input_dir)) {
+		if (!entry.is_regular_file())
+			continue;
+
+		std::string ext = entry.path().extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+		if (ext != ".exe" && ext != ".dll")
+			continue;
+
+		job_t job;
+		job.input = entry.path().string();
+		job.output = (fs::path(output_dir) / entry.path().filename()).string();
+		m_jobs.push_back(std::move(job));
+	}
+
+	std::sort(m_jobs.begin(), m_jobs.end(), [](const job_t& a, const job_t& b) { return a.input < b.input; });
+}
+
+void c_batch::run()
+{
+	print_info("Batch: %u files, %u workers\n", static_cast<std::uint32_t>(m_jobs.size()), m_workers);
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::thread reader_thread(&c_batch::reader, this);
+	std::thread writer_thread(&c_batch::writer, this);
+
+	std::vector<std::thread> workers;
+	for (std::uint32_t i = 0; i < m_workers; i++)
+		workers.emplace_back(&c_batch::worker, this);
+
+	reader_thread.join();
+	for (std::thread& t : workers)
+		t.join();
+
+	m_write_queue.close();
+	writer_thread.join();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	double seconds = elapsed.count() > 0 ? elapsed.count() : 1e-9;
+
+	print_info("Batch: %u packed, %u failed in %.2f s (%.2f files/s, %.2f MB/s in, %.2f MB/s out)\n",
+		m_packed.load(), m_failed.load(), elapsed.count(),
+		m_packed.load() / seconds,
+		m_bytes_in.load() / seconds / (1024.0 * 1024.0),
+		m_bytes_out.load() / seconds / (1024.0 * 1024.0));
+	print_info("Batch: %zu section buffers allocated, %zu of them reused pooled blocks\n",
+		m_section_pool.get_allocations(), m_section_pool.get_reused());
+
+	if (!m_report_file.empty())
+		write_report(elapsed.count());
+}
+
+void c_batch::reader()
+{
+	for (job_t& job : m_jobs) {
+		std::error_code ec;
+		std::uint64_t size = fs::file_size(job.input, ec);
+		if (ec) {
+			print_warning("Cannot read %s\n", job.input.c_str());
+			add_report(job, "cannot read input");
+			m_failed++;
+			continue;
+		}
+
+		// backpressure: wait until workers and writer free enough memory
+		m_budget.acquire(size);
+
+		std::ifstream file(job.input, std::ios::in | std::ios::binary);
+		job.data.resize(static_cast<std::size_t>(size));
+		if (!file || !file.read(&job.data[0], job.data.size())) {
+			print_warning("Cannot read %s\n", job.input.c_str());
+			add_report(job, "cannot read input");
+			m_budget.release(size);
+			m_failed++;
+			continue;
+		}
+
+		if (!m_read_queue.push(std::move(job)))
+			break;
+	}
+
+	m_read_queue.close();
+}
+
+void c_batch::worker()
+{
+	job_t job;
+	while (m_read_queue.pop(job)) {
+		std::uint64_t input_size = job.data.size();
+		job.input_size = input_size;
+
+		try {
+			std::ostringstream out;
+			{
+				c_core packer(job.data, m_options);
+				packer.process(out);
+				job.stats = packer.get_stub_stats();
+			}
+
+			m_bytes_in += input_size;
+			job.data = out.str();
+		}
+		catch (const std::exception& ex) {
+			print_warning("Failed to pack %s: %s\n", job.input.c_str(), ex.what());
+			add_report(job, ex.what());
+			m_budget.release(input_size);
+			m_failed++;
+			continue;
+		}
+
+		m_budget.add(job.data.size());
+		m_budget.release(input_size);
+
+		std::uint64_t output_size = job.data.size();
+		if (!m_write_queue.push(std::move(job)))
+			m_budget.release(output_size);
+	}
+}
+
+void c_batch::writer()
+{
+	job_t job;
+	while (m_write_queue.pop(job)) {
+		std::ofstream file(job.output, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write(job.data.data(), job.data.size());
+		file.close();
+
+		if (file) {
+			m_bytes_out += job.data.size();
+			m_packed++;
+			print_info("File successfully packed and saved in %s\n", job.output.c_str());
+			add_report(job, std::string());
+		}
+		else {
+			print_warning("Cannot write %s\n", job.output.c_str());
+			add_report(job, "cannot write output");
+			m_failed++;
+		}
+
+		m_budget.release(job.data.size());
+	}
+}
+
+void c_batch::add_report(const job_t& job, std::string error)
+{
+	if (m_report_file.empty())
+		return;
+
+	report_entry_t entry;
+	entry.input = job.input;
+	entry.output = job.output;
+	entry.error = std::move(error);
+	entry.input_size = job.input_size;
+	if (entry.error.empty()) {
+		entry.output_size = job.data.size();
+		entry.stats = job.stats;
+	}
+
+	std::lock_guard<std::mutex> lock(m_report_mutex);
+	m_report.push_back(std::move(entry));
+}
+
+void c_batch::write_report(double seconds)
+{
+	// files finish in any order, the report is sorted like the jobs
+	std::sort(m_report.begin(), m_report.end(), [](const report_entry_t& a, const report_entry_t& b) { return a.input < b.input; });
+
+	std::ostringstream out;
+	out << "{\n";
+	out << "  \"mutations\": " << m_options.mutations << ",\n";
+	out << "  \"packed\": " << m_packed.load() << ",\n";
+	out << "  \"failed\": " << m_failed.load() << ",\n";
+	out << "  \"seconds\": " << seconds << ",\n";
+	out << "  \"files\": [";
+
+	for (std::size_t i = 0; i < m_report.size(); i++) {
+		const report_entry_t& entry = m_report[i];
+
+		out << (i ? ",\n" : "\n") << "    { \"input\": " << json_string(entry.input) << ", \"output\": " << json_string(entry.output);
+		if (!entry.error.empty()) {
+			out << ", \"status\": \"failed\", \"error\": " << json_string(entry.error) << " }";
+			continue;
+		}
+
+		out << ", \"status\": \"packed\", \"input_size\": " << entry.input_size << ", \"output_size\": " << entry.output_size;
+		if (entry.stats) {
+			const stub_stats_t& stats = *entry.stats;
+			out << ",\n      \"stub\": { \"size\": " << stats.size
+				<< ", \"instructions\": " << stats.instructions
+				<< ", \"path_min\": " << stats.path_min
+				<< ", \"path_max\": " << stats.path_max
+				<< ", \"cycles_min\": " << stats.cycles_min
+				<< ", \"cycles_max\": " << stats.cycles_max
+				<< ", \"serializing\": " << stats.serializing
+				<< ", \"vm_exits\": " << stats.vm_exits
+				<< ", \"loops\": " << stats.loops
+				<< ", \"undecoded\": " << stats.undecoded << " }";
+		}
+		out << " }";
+	}
+
+	out << (m_report.empty() ? "]\n" : "\n  ]\n") << "}\n";
+
+	std::ofstream file(m_report_file, std::ios::out | std::ios::binary | std::ios::trunc);
+	std::string data = out.str();
+	file.write(data.data(), data.size());
+	file.close();
+
+	if (file)
+		print_info("Batch report saved in %s\n", m_report_file.c_str());
+	else
+		print_warning("Cannot write report %s\n", m_report_file.c_str());
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "core.hpp"
+#include "utils/pipeline.hpp"
+
+// Packs every .exe/.dll of a directory with a three-stage pipeline:
+// reader thread prefetches inputs, worker threads run c_core, writer thread saves results
+// Queues are bounded and the total size of buffered inputs and outputs is capped by -queue-mb
+// -report file writes the result and the stub analysis of every file as JSON
+class c_batch
+{
+public:
+	c_batch(std::string input_dir, std::string output_dir, std::uint32_t mutations_counter);
+
+	void run();
+
+private:
+	struct job_t {
+		std::string input;
+		std::string output;
+		std::string data;
+		std::uint64_t input_size = 0;
+		std::optional<stub_stats_t> stats;
+	};
+
+	struct report_entry_t {
+		std::string input;
+		std::string output;
+		std::string error;
+		std::uint64_t input_size = 0;
+		std::uint64_t output_size = 0;
+		std::optional<stub_stats_t> stats;
+	};
+
+	void reader();
+	void worker();
+	void writer();
+
+	void add_report(const job_t& job, std::string error);
+	void write_report(double seconds);
+
+	std::vector<job_t> m_jobs;
+	// parsed once for all files
+	c_core::options m_options;
+	std::uint32_t m_workers;
+	// section data of all files, blocks of packed files are reused by the next ones
+	pe_bliss::section_buffer_pool m_section_pool;
+
+	c_bounded_queue<job_t> m_read_queue;
+	c_bounded_queue<job_t> m_write_queue;
+	c_byte_budget m_budget;
+
+	std::string m_report_file;
+	std::mutex m_report_mutex;
+	std::vector<report_entry_t> m_report;
+
+	std::atomic<std::uint32_t> m_packed{ 0 };
+	std::atomic<std::uint32_t> m_failed{ 0 };
+	std::atomic<std::uint64_t> m_bytes_in{ 0 };
+	std::atomic<std::uint64_t> m_bytes_out{ 0 };
+};
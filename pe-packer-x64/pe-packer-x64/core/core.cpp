@@ -2,35 +2,163 @@
 #include "utils/utils.hpp"
 #include "mba.hpp"
 #include "adasm.hpp"
+#include "emitter.hpp"
+#include <limits>
 
 using namespace asmjit;
 
-c_core::c_core(std::string input_file, std::string output_file, std::uint32_t mutations_counter)
+// mutations generated by one stub chunk
+static const std::uint32_t mutations_per_chunk = 32;
+
+// upper bounds of the fixed code after the junk, reserved in the size budget
+static const std::uint64_t decrypt_loop_size = 48;
+static const std::uint64_t oep_jump_size = 40;
+static const std::uint64_t skip_jump_size = 16;
+
+// share of budget for part of whole, a zero share would mean unlimited
+static std::uint64_t budget_share(std::uint64_t budget, std::uint64_t part, std::uint64_t whole)
+{
+	std::uint64_t share = budget / whole * part + budget % whole * part / whole;
+	return (std::max)(share, std::uint64_t(1));
+}
+
+c_core::options c_core::options::from_arguments(std::uint32_t mutations_counter)
 {
-	m_input = input_file;
-	m_output = output_file;
-	m_mutations = mutations_counter;
+	options opt;
+	opt.mutations = mutations_counter;
+	opt.remove_aslr = arguments::has("-noaslr");
+	opt.call_oep = arguments::has("-oep_call");
+	opt.anti_disasm = arguments::has("-adasm");
+	opt.mba = arguments::has("-mba");
+	opt.xor_sections = arguments::has("-senc");
+	opt.fake_instr = arguments::has("-finstr");
+
+	if (arguments::has("-fpack")) {
+		std::string addr_start = arguments::get_after("-fpack", 0);
+		std::string addr_end = arguments::get_after("-fpack", 1);
+
+		if (!addr_start.empty() && !addr_end.empty())
+			opt.packed_functions.push_back({ std::stoull(addr_start, nullptr, 16), std::stoull(addr_end, nullptr, 16) });
+		else
+			print_warning("Argument -fpack must be followed by two addresses [START_ADDR] [END_ADDR]\n");
+	}
+
+	opt.cache_dir = arguments::get_after("-cache");
+	if (opt.cache_dir.empty() && arguments::has("-cache"))
+		print_warning("Argument -cache must be followed by cache directory\n");
+
+	const char* seed = arguments::get("-seed");
+	if (seed)
+		opt.seed = static_cast<std::uint32_t>(std::strtoul(seed, nullptr, 0));
+
+	const char* stub_jobs = arguments::get("-stub-jobs");
+	if (stub_jobs && atoi(stub_jobs) > 0)
+		opt.stub_jobs = static_cast<std::uint32_t>(atoi(stub_jobs));
+
+	const char* max_stub_cycles = arguments::get("-max-stub-cycles");
+	if (max_stub_cycles)
+		opt.max_stub_cycles = std::strtoull(max_stub_cycles, nullptr, 0);
+
+	const char* max_stub_bytes = arguments::get("-max-stub-bytes");
+	if (max_stub_bytes)
+		opt.max_stub_bytes = std::strtoull(max_stub_bytes, nullptr, 0);
+
+	const char* max_output_growth = arguments::get("-max-output-growth");
+	if (max_output_growth)
+		opt.max_output_growth = std::strtoull(max_output_growth, nullptr, 0);
+
+	opt.stub_stats = arguments::has("-stats");
 
-	std::ifstream pe_file(m_input, std::ios::in | std::ios::binary);
+	return opt;
+}
+
+c_core::c_core(std::string input_file, std::string output_file, std::uint32_t mutations_counter)
+	: m_input(input_file), m_output(output_file)
+{
+	std::ifstream pe_file(input_file, std::ios::in | std::ios::binary);
 	if (!pe_file) {
 		print_error("Binary is not PE file\n");
 	}
 
-	m_peImage = std::make_unique<pe_bliss::pe_base>(pe_bliss::pe_factory::create_pe(pe_file));
+	std::string image((std::istreambuf_iterator<char>(pe_file)), std::istreambuf_iterator<char>());
+	init(image, options::from_arguments(mutations_counter));
+}
+
+c_core::c_core(std::string input_file, std::string output_file, std::uint32_t mutations_counter, const std::string& image)
+	: m_input(input_file), m_output(output_file)
+{
+	init(image, options::from_arguments(mutations_counter));
+}
+
+c_core::c_core(const std::string& image, const options& opt)
+{
+	init(image, opt);
+}
+
+void c_core::init(const std::string& image, const options& opt)
+{
+	m_mutations = opt.mutations;
+
+	m_seed = opt.seed ? *opt.seed : std::random_device{}();
+	seed_random(m_seed);
+	print_info("Seed 0x%08x\n", m_seed);
+
+	m_stub_jobs = opt.stub_jobs ? opt.stub_jobs : (std::max)(std::thread::hardware_concurrency(), 1u);
+
+	m_max_stub_cycles = opt.max_stub_cycles;
+	m_analyze_stub = opt.stub_stats;
+	m_section_pool = opt.section_pool;
+	if (m_max_stub_cycles)
+		print_info("Stub junk is limited to %llu cycles\n", static_cast<unsigned long long>(m_max_stub_cycles));
+
+	if (!opt.cache_dir.empty()) {
+		bool from_cache = false;
+
+		m_peImage = std::make_unique<pe_bliss::pe_base>(pe_bliss::pe_image_cache(opt.cache_dir).load(image, &from_cache, m_section_pool));
+		if (from_cache)
+			print_info("Parsed image loaded from cache\n");
+	}
+	else {
+		std::istringstream pe_file(image);
+		pe_bliss::pe_error error;
+		m_peImage = pe_bliss::pe_factory::try_create_pe(pe_file, error, false, m_section_pool);
+		if (!m_peImage) {
+			print_error(std::string("Failed to parse image: ") + error.get_text() + "\n");
+		}
+	}
+
 	if (m_peImage->get_pe_type() != pe_bliss::pe_type_64) {
 		print_error("Binary is not x64 architecture\n");
 	}
 
+	m_stub_image_base = opt.stub_image_base ? *opt.stub_image_base : m_peImage->get_image_base_64();
+
+	m_max_stub_bytes = opt.max_stub_bytes;
+	m_max_output_growth = opt.max_output_growth;
+	if (m_max_output_growth) {
+		// raw data of .ptext is padded to FileAlignment, so the stub may take the growth rounded down to it
+		std::uint64_t file_alignment = m_peImage->get_file_alignment();
+		std::uint64_t growth_bytes = m_max_output_growth / file_alignment * file_alignment;
+		if (!growth_bytes) {
+			print_error("Output growth limit is smaller than FileAlignment\n");
+		}
+
+		if (!m_max_stub_bytes || growth_bytes < m_max_stub_bytes)
+			m_max_stub_bytes = growth_bytes;
+	}
+
+	if (m_max_stub_bytes)
+		print_info("Stub is limited to %llu bytes\n", static_cast<unsigned long long>(m_max_stub_bytes));
+
 	bool clr_dir = m_peImage->directory_exists(14);
 	if (clr_dir) {
 		print_error("CLR directory found, .NET binary is not supported yet\n");
 	}
 
-	JitRuntime jitRt;
 	Environment targetEnv(Arch::kX64);
 
 	m_codeHolder = std::make_unique<CodeHolder>();
-	Error init_asmjit = m_codeHolder->init(targetEnv, jitRt.cpu_features());
+	Error init_asmjit = m_codeHolder->init(targetEnv, CpuInfo::host().features());
 
 	if (init_asmjit != kErrorOk) {
 		print_error("Failed initialization\n");
@@ -42,9 +170,9 @@ c_core::c_core(std::string input_file, std::string output_file, std::uint32_t mu
 
 	auto dll_char = m_peImage->get_dll_characteristics();
 
-	if (arguments::has("-noaslr")) {
-		if (dll_char & IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE) {
-			dll_char &= ~IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE;
+	if (opt.remove_aslr) {
+		if (dll_char & pe_bliss::pe_win::image_dllcharacteristics_dynamic_base) {
+			dll_char &= ~pe_bliss::pe_win::image_dllcharacteristics_dynamic_base;
 
 			m_peImage->set_dll_characteristics(dll_char);
 			print_info("ASLR flag has been removed\n");
@@ -52,8 +180,8 @@ c_core::c_core(std::string input_file, std::string output_file, std::uint32_t mu
 			print_warning("ASLR flag not find yet\n");
 	}
 
-	if (arguments::has("-oep_call")) {
-		if (dll_char & IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE) {
+	if (opt.call_oep) {
+		if (dll_char & pe_bliss::pe_win::image_dllcharacteristics_dynamic_base) {
 			print_info("OEP call obfuscation cannot be enabled because PE file has a ASLR flag\n");
 		}
 		else {
@@ -62,45 +190,37 @@ c_core::c_core(std::string input_file, std::string output_file, std::uint32_t mu
 		}
 	}
 
-	if (arguments::has("-adasm")) {
+	if (opt.anti_disasm) {
 		print_info("Anti-disassembly obfuscation is enabled\n");
 		obf_anti_disasm = true;
 	}
 
-	if (arguments::has("-mba")) {
+	if (opt.mba) {
 		print_info("Mixed Boolean Arithmetic obfuscation is enabled\n");
 		obf_mba = true;
 	}
 
-	if (arguments::has("-senc")) {
+	if (opt.xor_sections) {
 		print_info("Sections encryption is enabled\n");
 		obf_xor_sections = true;
 	}
 
-	if (arguments::has("-finstr")) {
+	if (opt.fake_instr) {
 		print_info("Fake instructions is enabled\n");
 		obf_fake_instr = true;
 	}
 
-	if (arguments::has("-fpack")) {
-		std::string addr_start = arguments::get_after("-fpack", 0);
-		std::string addr_end = arguments::get_after("-fpack", 1);
+	for (const auto& [func_start, func_end] : opt.packed_functions) {
 		std::uint8_t key = random_value(0x10, 0xFF);
 
-		if (!addr_start.empty() && !addr_end.empty()) {
+		print_info("Packing functions from %llx to %llx enabled\n", static_cast<unsigned long long>(func_start), static_cast<unsigned long long>(func_end));
 
-			print_info("Packing functions from %s to %s enabled\n", addr_start.c_str(), addr_end.c_str());
+		obf_func_pack = true;
 
-			obf_func_pack = true;
+		xor_target.func_start = func_start;
+		xor_target.func_end = func_end;
 
-			xor_target.func_start = std::stoull(addr_start, nullptr, 16);
-			xor_target.func_end = std::stoull(addr_end, nullptr, 16);
-
-			obf_xor_targets.push_back({ xor_target.func_start, xor_target.func_end, key });
-		}
-		else {
-			print_warning("Argument -fpack must be followed by two addresses [START_ADDR] [END_ADDR]\n");
-		}
+		obf_xor_targets.push_back({ xor_target.func_start, xor_target.func_end, key });
 	}
 
 	m_assembler = std::make_unique<x86::Assembler>(m_codeHolder.get());
@@ -116,14 +236,14 @@ void c_core::xor_function_range(xor_target_t xor_target)
 
 
 	for (auto& sec : m_peImage->get_image_sections()) {
+		// const access keeps sections that are only inspected unmodified for the incremental rebuild
 		std::uintptr_t sec_base = m_peImage->get_image_base_64() + sec.get_virtual_address();
-		std::uintptr_t sec_end = sec_base + sec.get_raw_data().size();
+		std::uintptr_t sec_end = sec_base + sec.get_raw_view().size();
 
 		if (xor_target.func_start >= sec_base && xor_target.func_end <= sec_end) {
 			std::size_t offset = xor_target.func_start - sec_base;
-			std::string& data = sec.get_raw_data();
-			for (std::size_t i = 0; i < func_size; ++i)
-				data[offset + i] ^= key;
+			pe_bliss::section_buffer& data = sec.get_raw_buffer();
+			m_transform.add_xor(m_transform.add_buffer(data.data(), data.size()), offset, func_size, key);
 
 			break;
 		}
@@ -132,14 +252,15 @@ void c_core::xor_function_range(xor_target_t xor_target)
 
 void c_core::insert_runtime_xor_stub(xor_target_t xor_target)
 {
-	if (!obf_func_pack)
+	// the same ranges as xor_function_range skips
+	if (!obf_func_pack || xor_target.func_start >= xor_target.func_end)
 		return;
 
 	x86::Gp reg_base = x86::rcx;
 	x86::Gp reg_counter = x86::rbx;
 	x86::Gp reg_key = x86::al;
 
-	m_assembler->mov(reg_base, xor_target.func_start);     
+	m_assembler->mov(reg_base, xor_target.func_start - m_peImage->get_image_base_64() + m_stub_image_base);
 	m_assembler->mov(reg_counter, xor_target.func_end - xor_target.func_start);
 	m_assembler->mov(reg_key, xor_target.xor_key);
 
@@ -164,14 +285,14 @@ void c_core::xor_sections(std::string sec_to_xor)
 		return;
 	}
 
-	std::string* reloc_data = nullptr;
+	pe_bliss::section_buffer* reloc_data = nullptr;
 
 	pe_bliss::section* reloc_secptr = nullptr;
 
 	for (auto& sec : m_peImage->get_image_sections()) {
 		if (sec.get_name() == sec_to_xor) {
 			reloc_secptr = &sec;
-			reloc_data = &sec.get_raw_data();
+			reloc_data = &sec.get_raw_buffer();
 			break;
 		}
 	}
@@ -179,15 +300,13 @@ void c_core::xor_sections(std::string sec_to_xor)
 	std::uint8_t reloc_xor_key = static_cast<std::uint8_t>(random_value(1, 255));
 
 	if (reloc_data && !reloc_data->empty()) {
-		for (char& byte : *reloc_data) {
-			byte ^= reloc_xor_key;
-		}
+		m_transform.add_xor(m_transform.add_buffer(reloc_data->data(), reloc_data->size()), 0, reloc_data->size(), reloc_xor_key);
 		print_info("Section %s has been encrypted with key 0x%02x\n", sec_to_xor.c_str(), reloc_xor_key);
 	}
 
 	if (reloc_secptr) {
-		uint64_t reloc_va = reloc_secptr->get_virtual_address() + m_peImage->get_image_base_64();
-		uint64_t reloc_size = static_cast<uint64_t>(reloc_secptr->get_raw_data().size());
+		uint64_t reloc_va = reloc_secptr->get_virtual_address() + m_stub_image_base;
+		uint64_t reloc_size = static_cast<uint64_t>(reloc_secptr->get_raw_view().size());
 
 		x86::Gp reg_base = x86::rcx;
 		x86::Gp reg_counter = x86::rbx;
@@ -214,33 +333,42 @@ void c_core::xor_sections(std::string sec_to_xor)
 }
 
 void c_core::process()
+{
+	build_image();
+
+	// sections that were not modified are copied from the input file instead of being written again
+	pe_bliss::rebuild_pe_incremental(*m_peImage, m_input, m_output);
+
+	print_info("File successfully packed and saved in %s", m_output.c_str());
+}
+
+void c_core::process(std::ostream& out)
+{
+	build_image();
+	pe_bliss::rebuild_pe(*m_peImage, out);
+}
+
+void c_core::build_image()
 {
 	uint64_t ep_addr = m_assembler->offset();
 	uint64_t idx_oep = random_value(0x1000, 0xFFFFFFFF);
 	uint64_t image_base = m_peImage->get_image_base_64();
 
-	pe_bliss::section new_section;
-	const char* section_name = ".ptext";
-
 	m_assembler->push(x86::rbp);
 	m_assembler->mov(x86::rbp, x86::rsp);
-	
-	new_section.set_name(section_name);
-	new_section.readable(true).writeable(false).executable(true);
-	size_t codeSize = m_codeHolder->section_by_id(0)->buffer_size();
-	if (codeSize == 0) {
-		print_error("Empty code section");
-	}
-
-	new_section.get_raw_data().resize(codeSize);
 
-	pe_bliss::section& pe_section = m_peImage->add_section(new_section);
-	m_codeHolder->_base_address = pe_section.get_virtual_address();
-	std::uint64_t oep = obf_call_oep ? m_peImage->get_ep() + m_peImage->get_image_base_64() : m_peImage->get_ep();
+	// the stub is generated for the address of the section first, the section is added once its final size is known
+	std::uint32_t section_rva = m_peImage->get_next_section_rva();
+	m_codeHolder->_base_address = section_rva;
+	std::uint64_t oep = obf_call_oep ? m_peImage->get_ep() + m_stub_image_base : m_peImage->get_ep();
 	std::uint64_t oepvl_xor_key = random_value(128, 1024);
 	Label new_label = m_assembler->new_label();
 
 	c_adasm adasm_obj(*this);
+	c_emitter emit(m_assembler.get());
+
+	// decryption loops of packed functions and .reloc, the jump to OEP and anti-disassembly jumps around it
+	m_stub_reserve = decrypt_loop_size * (obf_xor_targets.size() + 1) + oep_jump_size + 3 * skip_jump_size;
 
 	obfuscation_process();
 
@@ -265,7 +393,7 @@ void c_core::process()
 		adasm_obj.jmp_label_skip();
 
 	if (obf_call_oep) {
-		switch (rand() % 2) {
+		switch (random_int() % 2) {
 		case 0:
 
 			oep -= idx_oep;
@@ -280,9 +408,7 @@ void c_core::process()
 				adasm_obj.jmp_label_skip();
 
 			if (obf_fake_instr) {
-				for (int i = 0; i < random_value(0x1, 0x400); ++i) {
-					m_assembler->db(random_value(0x10, 0xFF));
-				}
+				emit.random_bytes((std::min)(static_cast<std::size_t>(random_value(0x1, 0x400)), fake_bytes_left()), 0x10, 0xFF, random_engine()());
 			}
 			break;
 		case 1:
@@ -303,9 +429,7 @@ void c_core::process()
 			m_assembler->jmp(x86::rax);
 
 			if (obf_fake_instr) {
-				for (int i = 0; i < random_value(0x1, 0x400); ++i) {
-					m_assembler->db(random_value(0x10, 0xFF));
-				}
+				emit.random_bytes((std::min)(static_cast<std::size_t>(random_value(0x1, 0x400)), fake_bytes_left()), 0x10, 0xFF, random_engine()());
 			}
 
 			if (obf_anti_disasm)
@@ -321,9 +445,7 @@ void c_core::process()
 		m_assembler->jmp(oep);
 
 		if (obf_fake_instr) {
-			for (int i = 0; i < random_value(0x1, 0x400); ++i) {
-				m_assembler->db(random_value(0x10, 0xFF));
-			}
+			emit.random_bytes((std::min)(static_cast<std::size_t>(random_value(0x1, 0x400)), fake_bytes_left()), 0x10, 0xFF, random_engine()());
 		}
 	}
 
@@ -336,34 +458,80 @@ void c_core::process()
 		xor_sections(section_to_xor[i]);
 	}
 
-	print_info("Address of entry point 0x%llx\n", (unsigned long long)pe_section.get_virtual_address() + image_base + ep_addr); 
-	print_info("New section characteristics 0x%x\n", pe_section.get_characteristics());
+	// all section data changes are registered, they are applied before add_section can move the data
+	if (!m_transform.empty()) {
+		c_section_transform::stats_t stats = m_transform.run(m_stub_jobs);
+		print_info("Section data transformed in one pass: %zu sections, %zu chunks on %u threads, %.2f MB/s\n",
+			stats.buffers, stats.chunks, stats.threads, stats.bandwidth());
+	}
 
-	Section* section = m_codeHolder->section_by_id(0);
-	pe_section.set_raw_data(
-		std::string(reinterpret_cast<const char*>(section->data()), m_assembler->offset())
-	);
+	if (m_codeHolder->relocate_to_base(section_rva) != kErrorOk) {
+		print_error("Failed relocation of stub\n");
+	}
 
-	pe_section.get_raw_data().resize(section->buffer_size());
-	pe_section.set_virtual_size(static_cast<uint32_t>(m_assembler->offset()));
+	size_t code_size = m_codeHolder->code_size();
+	if (code_size == 0) {
+		print_error("Empty code section");
+	}
 
-	m_peImage->set_ep(static_cast<uint32_t>(pe_section.get_virtual_address() + ep_addr));
-	pe_bliss::import_rebuilder_settings settings(true, false);
+	pe_bliss::section new_section(m_section_pool);
+	new_section.set_name(".ptext");
+	new_section.readable(true).writeable(false).executable(true);
 
-	std::ofstream patch_file(m_output, std::ios::out | std::ios::binary | std::ios::trunc);
-	pe_bliss::rebuild_pe(*m_peImage, patch_file);
-	patch_file.close();
+	// raw data has the exact code size, add_section pads it only to FileAlignment,
+	// the buffer isn't zero-filled first, copy_flattened_data pads the code of the single section itself
+	pe_bliss::section_buffer& code = new_section.get_raw_buffer();
+	code.resize_uninitialized(code_size);
+	if (m_codeHolder->copy_flattened_data(code.data(), code.size(), CopySectionFlags::kPadSectionBuffer | CopySectionFlags::kPadTargetBuffer) != kErrorOk) {
+		print_error("Failed relocation of stub\n");
+	}
 
-	print_info("File successfully packed and saved in %s", m_output.c_str());
+	if (m_max_stub_bytes) {
+		print_info("Stub size %zu of %llu bytes, %u mutations dropped\n", code_size,
+			static_cast<unsigned long long>(m_max_stub_bytes), m_dropped_mutations);
+		if (code_size > m_max_stub_bytes)
+			print_warning("Stub exceeds the size budget by %llu bytes\n", static_cast<unsigned long long>(code_size - m_max_stub_bytes));
+	}
+
+	if (m_max_output_growth) {
+		std::uint64_t file_alignment = m_peImage->get_file_alignment();
+		std::uint64_t growth = (code_size + file_alignment - 1) / file_alignment * file_alignment;
+		print_info("Output grows by %llu of %llu bytes\n", static_cast<unsigned long long>(growth),
+			static_cast<unsigned long long>(m_max_output_growth));
+	}
+
+	if (m_analyze_stub) {
+		m_stub_stats = analyze_stub(reinterpret_cast<const std::uint8_t*>(code.data()), code.size(), static_cast<std::size_t>(ep_addr));
+		print_stub_stats(*m_stub_stats);
+	}
+
+	pe_bliss::section& pe_section = m_peImage->add_section(std::move(new_section));
+	if (pe_section.get_virtual_address() != section_rva) {
+		print_error("Unexpected address of new section\n");
+	}
+
+	// add_section has already counted the aligned size in SizeOfImage, header keeps the exact one
+	pe_section.set_virtual_size(static_cast<uint32_t>(code_size));
+
+	print_info("Address of entry point 0x%llx\n", (unsigned long long)pe_section.get_virtual_address() + image_base + ep_addr); 
+	print_info("New section characteristics 0x%x\n", pe_section.get_characteristics());
 
-	return;
+	m_peImage->set_ep(static_cast<uint32_t>(pe_section.get_virtual_address() + ep_addr));
+	pe_bliss::import_rebuilder_settings settings(true, false);
 }
 
 void c_core::simple_jump_obfuscation()
 {
-	int jmp_labes = (rand() % 10);
+	c_cost_meter& cost = get_cost();
+	c_emitter emit(get_assembler(), &cost);
+
+	int jmp_labes = (random_int() % 10);
 	for (int i = 0; i < jmp_labes; i++)
 	{
+		// all condition variants cost the same as jz
+		if (!cost.fits({ x86::Inst::kIdXor, x86::Inst::kIdMov, x86::Inst::kIdMov, x86::Inst::kIdAdd, x86::Inst::kIdCmp, x86::Inst::kIdJz }))
+			break;
+
 		int first_value = random_value(0x10, 0x100);
 		int second_value = random_value(0x10, 0x100);
 		int third_value = 0;
@@ -377,52 +545,59 @@ void c_core::simple_jump_obfuscation()
 			third_value = first_value - second_value;
 		}
 
-		Label label = m_assembler->new_label();
+		c_local_label label(get_assembler(), &cost);
 		auto rand_reg = get_rand_reg();
-		m_assembler->xor_(rand_reg, random_value(0x10, 0x100));
-		m_assembler->mov(x86::rax, first_value);
-		m_assembler->mov(x86::rbx, second_value);
-		m_assembler->add(x86::rax, third_value);
+		emit.xor_(rand_reg, random_value(0x10, 0x100));
+		emit.mov(x86::rax, first_value);
+		emit.mov(x86::rbx, second_value);
+		emit.add(x86::rax, third_value);
 		
-		m_assembler->cmp(x86::rax, x86::rbx);
-		switch (rand() % 4)
+		emit.cmp(x86::rax, x86::rbx);
+		switch (random_int() % 4)
 		{
 		case 0:
-			m_assembler->jz(label);
+			label.j(x86::CondCode::kZ);
 			break;
 		case 1:
-			m_assembler->jnz(label);
+			label.j(x86::CondCode::kNZ);
 			break;
 		case 2:
-			m_assembler->jecxz(label);
+			label.jecxz();
 			break;
 		case 3:
-			m_assembler->jg(label);
+			label.j(x86::CondCode::kG);
 			break;
 		}
-		int junk_bytes = rand() % 100;
+		int junk_bytes = random_int() % 100;
 		for (int j = 0; j < junk_bytes; j++)
 			generate_junk_code();
-		m_assembler->bind(label);
+		label.bind();
 		generate_junk_code();
 	}
 }
 
 void c_core::call_obfuscation()
 {
-	int call_deep = (rand() % 10) + 1;
+	c_cost_meter& cost = get_cost();
+
+	int call_deep = (random_int() % 10) + 1;
 	for (int i = 0; i < call_deep; i++)
 	{
-		Label call_label = m_assembler->new_label();
+		if (!cost.fits({ x86::Inst::kIdCall }))
+			break;
+
+		c_local_label call_label(get_assembler(), &cost);
 		generate_junk_code();
-		m_assembler->call(call_label);
+		call_label.call();
 		generate_junk_code();
-		m_assembler->bind(call_label);
+		call_label.bind();
 	}
 }
 
 void c_core::generate_junk_code()
 {
+	// push_pop_junk and big_conditions_junk are disabled here, so in a real pack the c_emitter templates
+	// are used mostly by c_mba (-mba) and the few compares of simple_jump_obfuscation
 	int junk_type = 2;
 	switch (junk_type)
 	{
@@ -439,93 +614,109 @@ void c_core::generate_junk_code()
 
 void c_core::push_pop_junk()
 {
-	int push_pop_count = (rand() % 10) * m_mutations;
+	c_cost_meter& cost = get_cost();
+	c_emitter emit(get_assembler(), &cost);
+
+	int push_pop_count = (random_int() % 10) * m_mutations;
 	for (int i = 0; i < push_pop_count; i++)
 	{
 		Operand src;
 
-		if (rand() % 2) {
+		if (random_int() % 2) {
 			src = get_rand_reg();
 		}
 		else {
-			src = Imm(rand() % 100);
+			src = Imm(random_int() % 100);
 		}
 
-		m_assembler->push(get_rand_reg());
-		switch (rand() % 3)
+		// imul is the most expensive variant of the operation
+		if (!cost.fits({ x86::Inst::kIdPush, x86::Inst::kIdImul, x86::Inst::kIdPop }))
+			break;
+
+		emit.push(get_rand_reg());
+		switch (random_int() % 3)
 		{
 		case 0:
 			if (src.is_reg()) {
-				m_assembler->add(get_rand_reg(), src.as<x86::Gp>());
+				emit.add(get_rand_reg(), src.as<x86::Gp>());
 			}
 			else if (src.is_imm()) {
-				m_assembler->add(get_rand_reg(), src.as<Imm>());
+				emit.add(get_rand_reg(), src.as<Imm>().value());
 			}
 			break;
 		case 1:
 			if (src.is_reg()) {
-				m_assembler->imul(get_rand_reg(), src.as<x86::Gp>());
+				emit.imul(get_rand_reg(), src.as<x86::Gp>());
 			}
 			else if (src.is_imm()) {
-				m_assembler->imul(get_rand_reg(), src.as<Imm>());
+				emit.imul(get_rand_reg(), src.as<Imm>().value());
 			}
 			break;
 		case 2:
 			if (src.is_reg()) {
-				m_assembler->sub(get_rand_reg(), src.as<x86::Gp>());
+				emit.sub(get_rand_reg(), src.as<x86::Gp>());
 			}
 			else if (src.is_imm()) {
-				m_assembler->sub(get_rand_reg(), src.as<Imm>());
+				emit.sub(get_rand_reg(), src.as<Imm>().value());
 			}
 			break;
 		default:
-			m_assembler->nop();
+			emit.nop();
 		}
-		m_assembler->pop(get_rand_reg());
+		emit.pop(get_rand_reg());
 
-		int junk_subnodes_count = rand() % 100;
+		int junk_subnodes_count = random_int() % 100;
 		for (int n = 0; n < junk_subnodes_count; n++)
 		{
-			int rn = rand() % 3;
+			int rn = random_int() % 3;
 			switch (rn)
 			{
 
 			case 0:
-				m_assembler->imul(get_rand_reg(), rand() % 100);
-				m_assembler->imul(get_rand_reg(), rand() % 100);
-				m_assembler->add(get_rand_reg(), rand() % 100);
-				m_assembler->cpuid();
-				m_assembler->nop();
-				m_assembler->cpuid();
-				m_assembler->push(get_rand_reg());
-				m_assembler->pop(get_rand_reg());
+				if (!cost.fits({ x86::Inst::kIdImul, x86::Inst::kIdImul, x86::Inst::kIdAdd, x86::Inst::kIdCpuid,
+					x86::Inst::kIdNop, x86::Inst::kIdCpuid, x86::Inst::kIdPush, x86::Inst::kIdPop }))
+					break;
+				emit.imul(get_rand_reg(), random_int() % 100);
+				emit.imul(get_rand_reg(), random_int() % 100);
+				emit.add(get_rand_reg(), random_int() % 100);
+				emit.cpuid();
+				emit.nop();
+				emit.cpuid();
+				emit.push(get_rand_reg());
+				emit.pop(get_rand_reg());
 				break;
 
 			case 1:
-				m_assembler->imul(get_rand_reg(), rand() % 100);
-				m_assembler->add(get_rand_reg(), rand() % 100);
-				m_assembler->push(get_rand_reg());
-				m_assembler->add(get_rand_reg(), rand() % 100);
-				m_assembler->cpuid();
-				m_assembler->nop();
-				m_assembler->nop();
-				m_assembler->pop(get_rand_reg());
+				if (!cost.fits({ x86::Inst::kIdImul, x86::Inst::kIdAdd, x86::Inst::kIdPush, x86::Inst::kIdAdd,
+					x86::Inst::kIdCpuid, x86::Inst::kIdNop, x86::Inst::kIdNop, x86::Inst::kIdPop }))
+					break;
+				emit.imul(get_rand_reg(), random_int() % 100);
+				emit.add(get_rand_reg(), random_int() % 100);
+				emit.push(get_rand_reg());
+				emit.add(get_rand_reg(), random_int() % 100);
+				emit.cpuid();
+				emit.nop();
+				emit.nop();
+				emit.pop(get_rand_reg());
 
 				break;
 
 			case 2:
-				m_assembler->sub(get_rand_reg(), rand() % 100);
-				m_assembler->add(get_rand_reg(), rand() % 100);
-				m_assembler->add(get_rand_reg(), rand() % 100);
-				m_assembler->push(get_rand_reg());
-				m_assembler->nop();
-				m_assembler->nop();
-				m_assembler->cpuid();
-				m_assembler->pop(get_rand_reg());
+				if (!cost.fits({ x86::Inst::kIdSub, x86::Inst::kIdAdd, x86::Inst::kIdAdd, x86::Inst::kIdPush,
+					x86::Inst::kIdNop, x86::Inst::kIdNop, x86::Inst::kIdCpuid, x86::Inst::kIdPop }))
+					break;
+				emit.sub(get_rand_reg(), random_int() % 100);
+				emit.add(get_rand_reg(), random_int() % 100);
+				emit.add(get_rand_reg(), random_int() % 100);
+				emit.push(get_rand_reg());
+				emit.nop();
+				emit.nop();
+				emit.cpuid();
+				emit.pop(get_rand_reg());
 				break;
 
 			default:
-				m_assembler->nop();
+				emit.nop();
 			}
 		}
 	}
@@ -533,64 +724,76 @@ void c_core::push_pop_junk()
 
 void c_core::big_conditions_junk()
 {
-	int cond_count = (rand() % 100) + 1;
+	c_cost_meter& cost = get_cost();
+	c_emitter emit(get_assembler(), &cost);
+
+	int cond_count = (random_int() % 100) + 1;
 	for (int i = 0; i < cond_count; i++)
 	{
 		auto reg1 = get_rand_reg();
 		auto reg2 = get_rand_reg();
-		int actions_count = rand() % 100;
+		int actions_count = random_int() % 100;
 		for (int j = 0; j < actions_count; j++)
 		{
-			switch (rand() % 5)
+			switch (random_int() % 5)
 			{
 			case 0:
-				m_assembler->xor_(reg1, reg2);
+				if (cost.fits({ x86::Inst::kIdXor }))
+					emit.xor_(reg1, reg2);
 				break;
 			case 1:
-				m_assembler->add(reg1, rand() % 10);
+				if (cost.fits({ x86::Inst::kIdAdd }))
+					emit.add(reg1, random_int() % 10);
 				break;
 			case 2:
-				m_assembler->imul(reg2, rand() % 100);
+				if (cost.fits({ x86::Inst::kIdImul }))
+					emit.imul(reg2, random_int() % 100);
 				break;
 			case 3:
-				m_assembler->sub(reg1, rand() % 100);
+				if (cost.fits({ x86::Inst::kIdSub }))
+					emit.sub(reg1, random_int() % 100);
 			case 4:
-				m_assembler->mov(reg1, reg2);
+				if (cost.fits({ x86::Inst::kIdMov }))
+					emit.mov(reg1, reg2);
 				break;
 			default:
 				break;
 			}
 		}
-		m_assembler->cmp(reg1, reg2);
-		Label cmp_label = m_assembler->new_label();
-		switch (rand() % 7)
+		// every jump variant costs the same as jz
+		if (!cost.fits({ x86::Inst::kIdCmp, x86::Inst::kIdJz }))
+			break;
+
+		emit.cmp(reg1, reg2);
+		c_local_label cmp_label(get_assembler(), &cost);
+		switch (random_int() % 7)
 		{
 		case 0:
-			m_assembler->jmp(cmp_label);
+			cmp_label.jmp();
 			break;
 		case 1:
-			m_assembler->jz(cmp_label);
+			cmp_label.j(x86::CondCode::kZ);
 			break;
 		case 2:
-			m_assembler->jnz(cmp_label);
+			cmp_label.j(x86::CondCode::kNZ);
 			break;
 		case 3:
-			m_assembler->jb(cmp_label);
+			cmp_label.j(x86::CondCode::kB);
 			break;
 		case 4:
-			m_assembler->jbe(cmp_label);
+			cmp_label.j(x86::CondCode::kBE);
 			break;
 		case 5:
-			m_assembler->jl(cmp_label);
+			cmp_label.j(x86::CondCode::kL);
 			break;
 		case 6:
-			m_assembler->jle(cmp_label);
+			cmp_label.j(x86::CondCode::kLE);
 			break;
 		default:
-			m_assembler->jmp(cmp_label);
+			cmp_label.jmp();
 			break;
 		}
-		m_assembler->bind(cmp_label);
+		cmp_label.bind();
 		push_pop_junk();
 
 	}
@@ -598,7 +801,7 @@ void c_core::big_conditions_junk()
 
 x86::Gp c_core::get_rand_reg()
 {
-	int reg_num = rand() % 6;
+	int reg_num = random_int() % 6;
 	switch (reg_num)
 	{
 	case 0:
@@ -619,7 +822,7 @@ x86::Gp c_core::get_rand_reg()
 }
 
 x86::Gp c_core::get_rand_lower_reg() {
-	int reg_num = rand() % 6;
+	int reg_num = random_int() % 6;
 	switch (reg_num) {
 	case 0:
 		return x86::ax;
@@ -640,17 +843,131 @@ x86::Gp c_core::get_rand_lower_reg() {
 
 void c_core::obfuscation_process()
 {
+	// chunk boundaries don't depend on the workers count, so the output is the same for any count
+	std::uint32_t chunks_count = (m_mutations + mutations_per_chunk - 1) / mutations_per_chunk;
+
+	struct chunk_t {
+		CodeHolder code;
+		c_cost_meter cost;
+		std::uint64_t max_bytes = 0;
+		std::uint32_t dropped = 0;
+		std::exception_ptr error;
+	};
+
+	// the junk gets what is left of the size budget after the entry and the fixed code
+	std::uint64_t junk_bytes = 0;
+	if (m_max_stub_bytes) {
+		std::uint64_t fixed_bytes = m_assembler->offset() + m_stub_reserve;
+		if (m_max_stub_bytes > fixed_bytes)
+			junk_bytes = m_max_stub_bytes - fixed_bytes;
+		else
+			print_warning("Stub size budget leaves no room for junk, %llu bytes are reserved for the fixed code\n",
+				static_cast<unsigned long long>(fixed_bytes));
+	}
+
+	// every chunk gets the share of the budgets proportional to its mutations
+	std::vector<chunk_t> chunks(chunks_count);
+	for (std::uint32_t i = 0; i < chunks_count; i++) {
+		std::uint64_t chunk_mutations = (std::min)(mutations_per_chunk, m_mutations - i * mutations_per_chunk);
+		if (m_max_stub_cycles)
+			chunks[i].cost = c_cost_meter(budget_share(m_max_stub_cycles, chunk_mutations, m_mutations));
+		if (m_max_stub_bytes)
+			chunks[i].max_bytes = budget_share(junk_bytes, chunk_mutations, m_mutations);
+	}
+
+	std::atomic<std::uint32_t> next_chunk(0);
+
+	auto worker = [&]() {
+		// chunks reseed the generator of the thread, the calling thread gets its state back
+		std::mt19937 engine = random_engine();
+		for (std::uint32_t i = next_chunk++; i < chunks_count; i = next_chunk++) {
+			try {
+				generate_stub_chunk(chunks[i].code, i, chunks[i].cost, chunks[i].max_bytes, chunks[i].dropped);
+			}
+			catch (...) {
+				m_chunk_assembler = nullptr;
+				m_chunk_cost = nullptr;
+				chunks[i].error = std::current_exception();
+			}
+		}
+		random_engine() = engine;
+	};
+
+	std::vector<std::thread> workers;
+	for (std::uint32_t i = 1; i < (std::min)(m_stub_jobs, chunks_count); i++)
+		workers.emplace_back(worker);
+
+	worker();
+	for (std::thread& t : workers)
+		t.join();
+
+	std::string data;
+	for (chunk_t& chunk : chunks) {
+		if (chunk.error)
+			std::rethrow_exception(chunk.error);
+
+		// labels never cross chunks, only relocations depend on the final place of chunk in .ptext
+		if (chunk.code.relocate_to_base(m_codeHolder->_base_address + m_assembler->offset()) != kErrorOk) {
+			print_error("Failed relocation of stub chunk\n");
+		}
+
+		data.resize(chunk.code.code_size());
+		if (chunk.code.copy_flattened_data(data.data(), data.size()) != kErrorOk) {
+			print_error("Failed relocation of stub chunk\n");
+		}
+
+		m_assembler->embed(data.data(), data.size());
+		m_cost.add(chunk.cost);
+		m_dropped_mutations += chunk.dropped;
+	}
+
+	if (m_max_stub_cycles)
+		print_info("Stub junk: %llu instructions, %llu-%llu cycles, %llu serializing\n",
+			static_cast<unsigned long long>(m_cost.instructions()), static_cast<unsigned long long>(m_cost.min_cycles()),
+			static_cast<unsigned long long>(m_cost.max_cycles()), static_cast<unsigned long long>(m_cost.serializing()));
+}
+
+void c_core::generate_stub_chunk(CodeHolder& code, std::uint32_t chunk_index, c_cost_meter& cost, std::uint64_t max_bytes, std::uint32_t& dropped)
+{
+	// every chunk has its own random stream derived from the seed
+	std::seed_seq chunk_seed{ m_seed, chunk_index };
+	std::uint32_t seed = 0;
+	chunk_seed.generate(&seed, &seed + 1);
+	seed_random(seed);
+
+	if (code.init(m_codeHolder->environment(), m_codeHolder->cpu_features()) != kErrorOk) {
+		print_error("Failed initialization of stub chunk\n");
+	}
+
+	x86::Assembler assembler(&code);
+
+	// every mutation is emitted into its own code holder and embedded into the chunk only if it fits,
+	// so a dropped mutation leaves nothing behind
+	CodeHolder mutation;
+	if (mutation.init(code.environment(), code.cpu_features()) != kErrorOk) {
+		print_error("Failed initialization of stub chunk\n");
+	}
+
+	x86::Assembler mutation_assembler(&mutation);
+	m_chunk_assembler = &mutation_assembler;
+	m_chunk_cost = &cost;
+
 	c_mba mba_obj(*this);
 	c_mba::options mba_opt;
 
 	c_adasm adasm_obj(*this);
-	for (uint32_t i = 0; i < m_mutations; i++)
+	std::uint32_t first = chunk_index * mutations_per_chunk;
+	std::uint32_t last = (std::min)(first + mutations_per_chunk, m_mutations);
+	for (uint32_t i = first; i < last; i++)
 	{
+		mutation.reinit();
+		c_cost_meter mutation_cost = cost;
+
 		if (obf_anti_disasm) {
 			adasm_obj.jmp_label_skip();
 		}
 
-		int junk_step = obf_mba ? rand() % 3 : rand() % 2;
+		int junk_step = obf_mba ? random_int() % 3 : random_int() % 2;
 		switch (junk_step)
 		{
 		case 0:
@@ -666,5 +983,36 @@ void c_core::obfuscation_process()
 		default:
 			break;
 		}
+
+		// labels of a mutation are bound inside of it and it has no absolute addresses, so it's copied as is
+		if (mutation.has_unresolved_fixups() || mutation.has_reloc_entries()) {
+			print_error("Failed generation of stub chunk\n");
+		}
+
+		// a mutation that doesn't fit is dropped entirely, smaller mutations after it may still fit
+		const CodeBuffer& buffer = mutation.text_section()->buffer();
+		if (max_bytes && assembler.offset() + buffer.size() > max_bytes) {
+			cost = mutation_cost;
+			dropped++;
+			continue;
+		}
+
+		assembler.embed(buffer.data(), buffer.size());
+	}
+
+	m_chunk_assembler = nullptr;
+	m_chunk_cost = nullptr;
+
+	if (code.has_unresolved_fixups() || code.flatten() != kErrorOk) {
+		print_error("Failed generation of stub chunk\n");
 	}
 }
+
+std::size_t c_core::fake_bytes_left() const
+{
+	if (!m_max_stub_bytes || m_chunk_assembler)
+		return (std::numeric_limits<std::size_t>::max)();
+
+	std::uint64_t used = m_assembler->offset() + m_stub_reserve;
+	return used < m_max_stub_bytes ? static_cast<std::size_t>(m_max_stub_bytes - used) : 0;
+}
@@ -1,27 +1,90 @@
 #pragma once
+#ifdef _WIN32
 #include <Windows.h>
 #include <Psapi.h>
 #include <TlHelp32.h>
 #include <winnt.h>
+#endif
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <cstdio>
 #include <cstdint>
 #include <string>
+#include <sstream>
+#include <iterator>
 #include <ctime>
+#include <utility>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <optional>
 #include "pe_lib/pe_bliss.h"
 #include "asmjit/asmjit.h"
 #include "handler/handler.hpp"
 #include "utils/arguments.hpp"
+#include "cost.hpp"
+#include "analyzer.hpp"
+#include "transform.hpp"
 
 class c_core
 {
 public:
+	// everything that changes the packed output, command line flags are in comments
+	struct options {
+		std::uint32_t mutations = 0;                  // mutations argument * 10
+		bool remove_aslr = false;                     // -noaslr
+		bool call_oep = false;                        // -oep_call, ignored for images with ASLR
+		bool anti_disasm = false;                     // -adasm
+		bool mba = false;                             // -mba
+		bool xor_sections = false;                    // -senc
+		bool fake_instr = false;                      // -finstr
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> packed_functions; // -fpack start end
+		std::string cache_dir;                        // -cache dir
+		std::optional<std::uint32_t> seed;            // -seed N, random if not set
+		std::uint32_t stub_jobs = 0;                  // -stub-jobs N, 0 - hardware concurrency
+		std::uint64_t max_stub_cycles = 0;            // -max-stub-cycles N, 0 - unlimited
+		std::uint64_t max_stub_bytes = 0;             // -max-stub-bytes N, size of .ptext, 0 - unlimited
+		std::uint64_t max_output_growth = 0;          // -max-output-growth N, bytes .ptext adds to the file, 0 - unlimited
+		bool stub_stats = false;                      // -stats, static analysis of the generated stub
+		// absolute addresses of the stub are based on it instead of the image base,
+		// harnesses running the stub outside of Windows map the image there
+		std::optional<std::uint64_t> stub_image_base;
+		bool verbose = true;                          // progress messages of the current thread
+		// section data of the image is allocated from it, the default pool if not set,
+		// batches share one pool so images reuse blocks of the previous ones
+		pe_bliss::section_buffer_pool* section_pool = nullptr;
+
+		// reads options from command line arguments
+		static options from_arguments(std::uint32_t mutations_counter);
+	};
+
+	// options are read from command line arguments
 	c_core(std::string input_file, std::string output_file, std::uint32_t mutations_counter);
+	// image is the already loaded content of input_file
+	c_core(std::string input_file, std::string output_file, std::uint32_t mutations_counter, const std::string& image);
+	// in-memory image, only process(std::ostream&) can be used
+	c_core(const std::string& image, const options& opt);
 
+	// inside of stub chunk generation returns assembler of the chunk generated by the current thread
 	asmjit::x86::Assembler* get_assembler() {
-		return m_assembler.get();
+		return m_chunk_assembler ? m_chunk_assembler : m_assembler.get();
+	}
+
+	// cost of the junk emitted by the current thread, generators check it before emitting
+	c_cost_meter& get_cost() {
+		return m_chunk_cost ? *m_chunk_cost : m_cost;
+	}
+
+	// bytes a fake fill of the main stub may take without exceeding the size budget,
+	// chunks drop whole mutations instead and aren't limited here
+	std::size_t fake_bytes_left() const;
+
+	// analysis of the stub after packing, empty unless options::stub_stats is set
+	const std::optional<stub_stats_t>& get_stub_stats() const {
+		return m_stub_stats;
 	}
 
 	pe_bliss::pe_base* get_peImage() {
@@ -34,7 +97,7 @@ public:
 
 	struct xor_target_t {
 		std::uintptr_t func_start;
-		std::uint32_t func_end;
+		std::uintptr_t func_end;
 		std::uint8_t xor_key;
 	};
 
@@ -47,6 +110,7 @@ public:
 	void xor_sections(std::string sec_to_xor);
 
 	void process();
+	void process(std::ostream& out);
 
 	void simple_jump_obfuscation();
 	void call_obfuscation();
@@ -70,12 +134,47 @@ public:
 	bool obf_func_pack = false;
 
 	std::uint32_t m_mutations;
+	// seed of all random values, the same seed gives the same output
+	std::uint32_t m_seed;
+	// threads generating stub chunks and transforming section data, doesn't affect the output
+	std::uint32_t m_stub_jobs;
+	// budget of the junk on the executed path in max cycles of the cost model, 0 - unlimited
+	std::uint64_t m_max_stub_cycles;
+	// budget of the whole .ptext in bytes, the smaller of options::max_stub_bytes and max_output_growth, 0 - unlimited
+	std::uint64_t m_max_stub_bytes;
+	std::uint64_t m_max_output_growth;
+	// base of the image addresses in the stub, the image base unless options::stub_image_base is set
+	std::uint64_t m_stub_image_base;
 	std::string m_input;
 	std::string m_output;
 
 private:
+	// generates the stub and applies all changes to m_peImage
+	void build_image();
+
+	// generates mutations of a single chunk into its own code holder, junk stays within the budget of cost,
+	// mutations exceeding max_bytes of the chunk are dropped and counted in dropped
+	void generate_stub_chunk(asmjit::CodeHolder& code, std::uint32_t chunk_index, c_cost_meter& cost, std::uint64_t max_bytes, std::uint32_t& dropped);
+
+	void init(const std::string& image, const options& opt);
+
 	std::unique_ptr<asmjit::x86::Assembler> m_assembler;
 	std::unique_ptr<pe_bliss::pe_base> m_peImage;
 	std::unique_ptr<asmjit::CodeHolder> m_codeHolder;
+	pe_bliss::section_buffer_pool* m_section_pool = nullptr;
+	// XOR of packed functions and sections, applied to section data in one pass once all of it is registered
+	c_section_transform m_transform;
+
+	static inline thread_local asmjit::x86::Assembler* m_chunk_assembler = nullptr;
+
+	c_cost_meter m_cost;
+	static inline thread_local c_cost_meter* m_chunk_cost = nullptr;
+
+	// upper bound of the fixed code emitted after the junk, kept free of the size budget
+	std::uint64_t m_stub_reserve = 0;
+	std::uint32_t m_dropped_mutations = 0;
+
+	bool m_analyze_stub = false;
+	std::optional<stub_stats_t> m_stub_stats;
 
 }; extern c_core* mutator;
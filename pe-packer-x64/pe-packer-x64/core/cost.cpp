@@ -0,0 +1,110 @@
+#include "cost.hpp"
+
+using namespace asmjit;
+
+const inst_cost_t& get_inst_cost(InstId inst_id)
+{
+	static const inst_cost_t alu = { 1, 1, cost_class_t::regular };
+	static const inst_cost_t nop = { 0, 1, cost_class_t::regular };
+	static const inst_cost_t mul = { 3, 4, cost_class_t::regular };
+	static const inst_cost_t stack = { 1, 3, cost_class_t::regular };
+	// a cold branch is predicted statically, the max is a full misprediction
+	static const inst_cost_t branch = { 1, 20, cost_class_t::regular };
+	static const inst_cost_t call = { 2, 20, cost_class_t::regular };
+	static const inst_cost_t indirect = { 2, 25, cost_class_t::regular };
+	// ~100-250 cycles on bare metal, a VM exit round trip costs thousands
+	static const inst_cost_t cpuid = { 100, 2000, cost_class_t::vm_exit };
+	static const inst_cost_t unknown = { 1, 5, cost_class_t::regular };
+
+	switch (inst_id) {
+	case x86::Inst::kIdMov:
+	case x86::Inst::kIdAdd:
+	case x86::Inst::kIdSub:
+	case x86::Inst::kIdAnd:
+	case x86::Inst::kIdOr:
+	case x86::Inst::kIdXor:
+	case x86::Inst::kIdNeg:
+	case x86::Inst::kIdCmp:
+	case x86::Inst::kIdTest:
+	case x86::Inst::kIdInc:
+	case x86::Inst::kIdDec:
+	case x86::Inst::kIdShr:
+	case x86::Inst::kIdShl:
+	case x86::Inst::kIdLea:
+	case x86::Inst::kIdAdc:
+	case x86::Inst::kIdSbb:
+	case x86::Inst::kIdNot:
+	case x86::Inst::kIdSar:
+	case x86::Inst::kIdRol:
+	case x86::Inst::kIdRor:
+	case x86::Inst::kIdMovzx:
+	case x86::Inst::kIdMovsx:
+	case x86::Inst::kIdMovsxd:
+		return alu;
+	case x86::Inst::kIdNop:
+		return nop;
+	case x86::Inst::kIdImul:
+		return mul;
+	case x86::Inst::kIdPush:
+	case x86::Inst::kIdPop:
+		return stack;
+	case x86::Inst::kIdJmp:
+	case x86::Inst::kIdJz:
+	case x86::Inst::kIdJnz:
+	case x86::Inst::kIdJb:
+	case x86::Inst::kIdJbe:
+	case x86::Inst::kIdJl:
+	case x86::Inst::kIdJle:
+	case x86::Inst::kIdJg:
+	case x86::Inst::kIdJecxz:
+		return branch;
+	case x86::Inst::kIdCall:
+	case x86::Inst::kIdRet:
+		return call;
+	case inst_id_call_indirect:
+	case inst_id_jmp_indirect:
+		return indirect;
+	case x86::Inst::kIdCpuid:
+		return cpuid;
+	default:
+		return unknown;
+	}
+}
+
+c_cost_meter::c_cost_meter(std::uint64_t budget) : m_budget(budget) {}
+
+bool c_cost_meter::fits(std::initializer_list<InstId> insts) const
+{
+	if (!m_budget)
+		return true;
+
+	std::uint64_t cycles = m_max_cycles;
+	for (InstId inst_id : insts)
+		cycles += get_inst_cost(inst_id).max_cycles;
+
+	return cycles <= m_budget;
+}
+
+void c_cost_meter::charge(std::initializer_list<InstId> insts)
+{
+	for (InstId inst_id : insts) {
+		const inst_cost_t& cost = get_inst_cost(inst_id);
+		m_min_cycles += cost.min_cycles;
+		m_max_cycles += cost.max_cycles;
+		m_instructions++;
+
+		if (cost.cost_class != cost_class_t::regular)
+			m_serializing++;
+		if (cost.cost_class == cost_class_t::vm_exit)
+			m_vm_exits++;
+	}
+}
+
+void c_cost_meter::add(const c_cost_meter& other)
+{
+	m_min_cycles += other.m_min_cycles;
+	m_max_cycles += other.m_max_cycles;
+	m_instructions += other.m_instructions;
+	m_serializing += other.m_serializing;
+	m_vm_exits += other.m_vm_exits;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include "asmjit/asmjit.h"
+
+// Static cost model of the stub instructions, cycles are estimated for a single cold execution
+// and don't depend on operands: min is the predicted/native case, max a mispredicted branch or a VM exit
+enum class cost_class_t : std::uint8_t {
+	regular,
+	serializing,    // drains the pipeline
+	vm_exit         // serializing and always trapped by the hypervisor on virtual machines
+};
+
+struct inst_cost_t {
+	std::uint16_t min_cycles;
+	std::uint16_t max_cycles;
+	cost_class_t cost_class;
+};
+
+// asmjit uses the same id for direct and indirect branches,
+// indirect ones (FF /2, FF /4) get ids past the last instruction of asmjit
+const asmjit::InstId inst_id_call_indirect = asmjit::x86::Inst::_kIdCount;
+const asmjit::InstId inst_id_jmp_indirect = asmjit::x86::Inst::_kIdCount + 1;
+
+const inst_cost_t& get_inst_cost(asmjit::InstId inst_id);
+
+// Accumulates the cost of instructions put on the executed path of the stub,
+// generators ask it before emitting a junk group, so the path stays under the budget;
+// c_emitter and c_local_label charge the instructions as they emit them
+class c_cost_meter
+{
+public:
+	// budget in max cycles, 0 - unlimited
+	explicit c_cost_meter(std::uint64_t budget = 0);
+
+	bool fits(std::initializer_list<asmjit::InstId> insts) const;
+	void charge(std::initializer_list<asmjit::InstId> insts);
+
+	void add(const c_cost_meter& other);
+
+	std::uint64_t budget() const { return m_budget; }
+	std::uint64_t min_cycles() const { return m_min_cycles; }
+	std::uint64_t max_cycles() const { return m_max_cycles; }
+	std::uint64_t instructions() const { return m_instructions; }
+	std::uint64_t serializing() const { return m_serializing; }
+	std::uint64_t vm_exits() const { return m_vm_exits; }
+
+private:
+	std::uint64_t m_budget;
+	std::uint64_t m_min_cycles = 0;
+	std::uint64_t m_max_cycles = 0;
+	std::uint64_t m_instructions = 0;
+	std::uint64_t m_serializing = 0;
+	std::uint64_t m_vm_exits = 0;
+};
@@ -0,0 +1,479 @@
+#include "emitter.hpp"
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "handler/handler.hpp"
+
+using namespace asmjit;
+
+namespace {
+	// maximum length of x86 instruction
+	const std::uint32_t max_inst_size = 15;
+	const std::uint32_t gp_count = 16;
+
+	enum imm_class_t { imm_one, imm_8, imm_32, imm_classes_count };
+
+	// instruction bytes and size, copied as a whole
+	struct template_t {
+		std::uint8_t bytes[max_inst_size];
+		std::uint8_t size;
+	};
+
+	static_assert(sizeof(template_t) == 16, "template must fit 16 bytes");
+
+	struct templates_t {
+		template_t reg[c_emitter::reg_ops_count][gp_count];
+		template_t reg_reg[c_emitter::bin_ops_count][gp_count][gp_count];
+		template_t reg_imm[c_emitter::bin_ops_count][gp_count][imm_classes_count];
+		template_t cpuid;
+		template_t nop;
+	};
+
+	const InstId reg_ops[c_emitter::reg_ops_count] = {
+		x86::Inst::kIdPush, x86::Inst::kIdPop, x86::Inst::kIdNeg
+	};
+
+	const InstId bin_ops[c_emitter::bin_ops_count] = {
+		x86::Inst::kIdAdd, x86::Inst::kIdSub, x86::Inst::kIdAnd, x86::Inst::kIdOr,
+		x86::Inst::kIdXor, x86::Inst::kIdMov, x86::Inst::kIdImul, x86::Inst::kIdShr, x86::Inst::kIdCmp
+	};
+
+	// immediates used to encode templates, patched by the real value later
+	const std::int64_t imm_samples[imm_classes_count] = { 1, 0x55, 0x12345678 };
+	const std::uint32_t imm_sizes[imm_classes_count] = { 0, 1, 4 };
+
+	template<typename Fn>
+	void encode_template(x86::Assembler& assembler, template_t& tmpl, Fn&& fn)
+	{
+		tmpl.size = 0;
+
+		size_t start = assembler.offset();
+		if (fn() != kErrorOk)
+			return;
+
+		size_t size = assembler.offset() - start;
+		if (size == 0 || size > max_inst_size)
+			return;
+
+		tmpl.size = static_cast<std::uint8_t>(size);
+		std::memcpy(tmpl.bytes, assembler.code()->text_section()->data() + start, size);
+	}
+
+	// the same assembler encodes every shape once, so templates match its output byte for byte
+	templates_t build_templates()
+	{
+		templates_t templates{};
+
+		CodeHolder code;
+		if (code.init(Environment(Arch::kX64)) != kErrorOk)
+			return templates;
+
+		x86::Assembler assembler(&code);
+
+		for (std::uint32_t op = 0; op < c_emitter::reg_ops_count; op++) {
+			for (std::uint32_t r = 0; r < gp_count; r++)
+				encode_template(assembler, templates.reg[op][r], [&]() { return assembler.emit(reg_ops[op], x86::gpq(r)); });
+		}
+
+		for (std::uint32_t op = 0; op < c_emitter::bin_ops_count; op++) {
+			for (std::uint32_t dst = 0; dst < gp_count; dst++) {
+				// shift count can be only in cl
+				if (op != c_emitter::op_shr) {
+					for (std::uint32_t src = 0; src < gp_count; src++)
+						encode_template(assembler, templates.reg_reg[op][dst][src], [&]() { return assembler.emit(bin_ops[op], x86::gpq(dst), x86::gpq(src)); });
+				}
+
+				// mov changes its form depending on immediate value, so it's not cached
+				if (op == c_emitter::op_mov)
+					continue;
+
+				for (std::uint32_t cls = 0; cls < imm_classes_count; cls++) {
+					// shift count is always imm8
+					if (op == c_emitter::op_shr && cls == imm_32)
+						continue;
+
+					template_t& tmpl = templates.reg_imm[op][dst][cls];
+					encode_template(assembler, tmpl, [&]() { return assembler.emit(bin_ops[op], x86::gpq(dst), Imm(imm_samples[cls])); });
+
+					// immediate must be the last field of the encoded instruction
+					std::uint32_t imm_size = imm_sizes[cls];
+					if (tmpl.size <= imm_size || std::memcmp(tmpl.bytes + tmpl.size - imm_size, &imm_samples[cls], imm_size) != 0)
+						tmpl.size = 0;
+				}
+			}
+		}
+
+		encode_template(assembler, templates.cpuid, [&]() { return assembler.emit(x86::Inst::kIdCpuid); });
+		encode_template(assembler, templates.nop, [&]() { return assembler.emit(x86::Inst::kIdNop); });
+
+		return templates;
+	}
+
+	const templates_t& get_templates()
+	{
+		static const templates_t templates = build_templates();
+		return templates;
+	}
+
+	imm_class_t get_imm_class(c_emitter::bin_op_t op, std::int64_t imm)
+	{
+		if (imm == 1)
+			return imm_one;
+
+		if (op == c_emitter::op_shr)
+			return imm >= 0 && imm <= 0xFF ? imm_8 : imm_classes_count;
+
+		if (imm >= INT8_MIN && imm <= INT8_MAX)
+			return imm_8;
+
+		if (imm >= INT32_MIN && imm <= INT32_MAX)
+			return imm_32;
+
+		return imm_classes_count;
+	}
+
+	bool is_cached_reg(const x86::Gp& reg)
+	{
+		return reg.is_gp64() && reg.id() < gp_count;
+	}
+
+	// Bytes are written right into the code buffer at the cursor of the assembler, as x86::Assembler does
+	// with an encoded instruction. Moving the cursor and the section size past them (commit_code) is the only
+	// place writing asmjit state: BaseAssembler::_buffer_ptr and CodeBuffer::_size are public members,
+	// but not documented API, so they must be checked again when asmjit is updated.
+	static_assert(ASMJIT_LIBRARY_VERSION == ASMJIT_LIBRARY_MAKE_VERSION(1, 21, 0),
+		"commit_code() writes BaseAssembler::_buffer_ptr and CodeBuffer::_size, check them for this asmjit version");
+
+	// returns place for size bytes at the cursor, null if they have to go through embed():
+	// the output is logged, the code at the cursor is overwritten or the buffer can't grow
+	std::uint8_t* reserve_code(x86::Assembler* assembler, std::size_t size)
+	{
+		Section* section = assembler->current_section();
+		if (!assembler->code() || !section || assembler->logger() || assembler->offset() < section->buffer().size())
+			return nullptr;
+
+		// code holder moves the buffer pointers of attached assembler
+		if (assembler->remaining_space() < size && assembler->code()->grow_buffer(&section->buffer(), size) != kErrorOk)
+			return nullptr;
+
+		return assembler->buffer_ptr();
+	}
+
+	// moves the cursor past size bytes written to the place returned by reserve_code()
+	void commit_code(x86::Assembler* assembler, std::size_t size)
+	{
+		assembler->_buffer_ptr += size;
+		assembler->current_section()->_buffer._size = assembler->offset();
+	}
+
+	// whole 16 bytes of the template are copied, only its size is kept
+	void stamp(x86::Assembler* assembler, const template_t& tmpl)
+	{
+		std::uint8_t* dst = reserve_code(assembler, sizeof(template_t));
+		if (!dst) {
+			assembler->embed(tmpl.bytes, tmpl.size);
+			return;
+		}
+
+		std::memcpy(dst, &tmpl, sizeof(template_t));
+		commit_code(assembler, tmpl.size);
+	}
+
+	std::uint64_t splitmix64(std::uint64_t& state)
+	{
+		std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// four independent xorshift64 lanes give 32 bytes per step, shifts and xors of lanes
+	// and scaling of bytes to [from; to] are plain loops, so the compiler vectorizes them
+	void fill_random(std::uint8_t* dst, std::size_t size, std::uint8_t from, std::uint8_t to, std::uint64_t seed)
+	{
+		const std::size_t lanes_count = 4;
+		const std::size_t block_size = lanes_count * sizeof(std::uint64_t);
+
+		std::uint64_t lanes[lanes_count];
+		for (std::size_t l = 0; l < lanes_count; l++) {
+			lanes[l] = splitmix64(seed);
+			if (!lanes[l])
+				lanes[l] = 1;
+		}
+
+		if (to < from)
+			std::swap(from, to);
+
+		std::uint32_t span = to - from + 1u;
+		for (std::size_t offset = 0; offset < size; offset += block_size) {
+			for (std::size_t l = 0; l < lanes_count; l++) {
+				lanes[l] ^= lanes[l] << 13;
+				lanes[l] ^= lanes[l] >> 7;
+				lanes[l] ^= lanes[l] << 17;
+			}
+
+			std::uint8_t block[block_size];
+			std::memcpy(block, lanes, block_size);
+
+			for (std::size_t b = 0; b < block_size; b++)
+				block[b] = static_cast<std::uint8_t>(from + ((block[b] * span) >> 8));
+
+			std::memcpy(dst + offset, block, size - offset < block_size ? size - offset : block_size);
+		}
+	}
+
+	void fill_pattern(std::uint8_t* dst, std::size_t size, const void* pattern, std::size_t pattern_size)
+	{
+		std::size_t filled = pattern_size < size ? pattern_size : size;
+		std::memcpy(dst, pattern, filled);
+
+		// the filled part is doubled until the whole run is written
+		while (filled < size) {
+			std::size_t chunk = filled < size - filled ? filled : size - filled;
+			std::memcpy(dst + filled, dst, chunk);
+			filled += chunk;
+		}
+	}
+}
+
+c_emitter::c_emitter(x86::Assembler* assembler, c_cost_meter* cost) : m_assembler(assembler), m_cost(cost) {}
+
+void c_emitter::charge(InstId inst_id)
+{
+	if (m_cost)
+		m_cost->charge({ inst_id });
+}
+
+void c_emitter::emit_reg(reg_op_t op, const x86::Gp& reg)
+{
+	charge(reg_ops[op]);
+
+	if (!is_cached_reg(reg)) {
+		m_assembler->emit(reg_ops[op], reg);
+		return;
+	}
+
+	const template_t& tmpl = get_templates().reg[op][reg.id()];
+	if (!tmpl.size) {
+		m_assembler->emit(reg_ops[op], reg);
+		return;
+	}
+
+	stamp(m_assembler, tmpl);
+}
+
+void c_emitter::emit_reg_reg(bin_op_t op, const x86::Gp& dst, const x86::Gp& src)
+{
+	charge(bin_ops[op]);
+
+	if (!is_cached_reg(dst) || !is_cached_reg(src)) {
+		m_assembler->emit(bin_ops[op], dst, src);
+		return;
+	}
+
+	const template_t& tmpl = get_templates().reg_reg[op][dst.id()][src.id()];
+	if (!tmpl.size) {
+		m_assembler->emit(bin_ops[op], dst, src);
+		return;
+	}
+
+	stamp(m_assembler, tmpl);
+}
+
+void c_emitter::emit_reg_imm(bin_op_t op, const x86::Gp& dst, std::int64_t imm)
+{
+	charge(bin_ops[op]);
+
+	imm_class_t cls = get_imm_class(op, imm);
+	if (!is_cached_reg(dst) || cls == imm_classes_count) {
+		m_assembler->emit(bin_ops[op], dst, Imm(imm));
+		return;
+	}
+
+	const template_t& tmpl = get_templates().reg_imm[op][dst.id()][cls];
+	if (!tmpl.size) {
+		m_assembler->emit(bin_ops[op], dst, Imm(imm));
+		return;
+	}
+
+	// immediate is little endian and always the last field
+	template_t patched = tmpl;
+	if (cls == imm_8) {
+		patched.bytes[tmpl.size - 1] = static_cast<std::uint8_t>(imm);
+	}
+	else if (cls == imm_32) {
+		std::int32_t imm32 = static_cast<std::int32_t>(imm);
+		std::memcpy(patched.bytes + tmpl.size - sizeof(imm32), &imm32, sizeof(imm32));
+	}
+
+	stamp(m_assembler, patched);
+}
+
+void c_emitter::push(const x86::Gp& reg) { emit_reg(op_push, reg); }
+void c_emitter::pop(const x86::Gp& reg) { emit_reg(op_pop, reg); }
+void c_emitter::neg(const x86::Gp& reg) { emit_reg(op_neg, reg); }
+
+void c_emitter::add(const x86::Gp& dst, const x86::Gp& src) { emit_reg_reg(op_add, dst, src); }
+void c_emitter::sub(const x86::Gp& dst, const x86::Gp& src) { emit_reg_reg(op_sub, dst, src); }
+void c_emitter::and_(const x86::Gp& dst, const x86::Gp& src) { emit_reg_reg(op_and, dst, src); }
+void c_emitter::or_(const x86::Gp& dst, const x86::Gp& src) { emit_reg_reg(op_or, dst, src); }
+void c_emitter::xor_(const x86::Gp& dst, const x86::Gp& src) { emit_reg_reg(op_xor, dst, src); }
+void c_emitter::mov(const x86::Gp& dst, const x86::Gp& src) { emit_reg_reg(op_mov, dst, src); }
+void c_emitter::imul(const x86::Gp& dst, const x86::Gp& src) { emit_reg_reg(op_imul, dst, src); }
+void c_emitter::cmp(const x86::Gp& dst, const x86::Gp& src) { emit_reg_reg(op_cmp, dst, src); }
+
+void c_emitter::add(const x86::Gp& dst, std::int64_t imm) { emit_reg_imm(op_add, dst, imm); }
+void c_emitter::sub(const x86::Gp& dst, std::int64_t imm) { emit_reg_imm(op_sub, dst, imm); }
+void c_emitter::and_(const x86::Gp& dst, std::int64_t imm) { emit_reg_imm(op_and, dst, imm); }
+void c_emitter::or_(const x86::Gp& dst, std::int64_t imm) { emit_reg_imm(op_or, dst, imm); }
+void c_emitter::xor_(const x86::Gp& dst, std::int64_t imm) { emit_reg_imm(op_xor, dst, imm); }
+void c_emitter::imul(const x86::Gp& dst, std::int64_t imm) { emit_reg_imm(op_imul, dst, imm); }
+void c_emitter::shr(const x86::Gp& dst, std::int64_t imm) { emit_reg_imm(op_shr, dst, imm); }
+void c_emitter::cmp(const x86::Gp& dst, std::int64_t imm) { emit_reg_imm(op_cmp, dst, imm); }
+void c_emitter::mov(const x86::Gp& dst, std::int64_t imm) { emit_reg_imm(op_mov, dst, imm); }
+
+void c_emitter::cpuid()
+{
+	charge(x86::Inst::kIdCpuid);
+
+	const template_t& tmpl = get_templates().cpuid;
+	if (tmpl.size)
+		stamp(m_assembler, tmpl);
+	else
+		m_assembler->cpuid();
+}
+
+void c_emitter::nop()
+{
+	charge(x86::Inst::kIdNop);
+
+	const template_t& tmpl = get_templates().nop;
+	if (tmpl.size)
+		stamp(m_assembler, tmpl);
+	else
+		m_assembler->nop();
+}
+
+void c_emitter::random_bytes(std::size_t size, std::uint8_t from, std::uint8_t to, std::uint64_t seed)
+{
+	if (!size)
+		return;
+
+	std::uint8_t* dst = reserve_code(m_assembler, size);
+	if (dst) {
+		fill_random(dst, size, from, to, seed);
+		commit_code(m_assembler, size);
+		return;
+	}
+
+	std::vector<std::uint8_t> data(size);
+	fill_random(data.data(), size, from, to, seed);
+	m_assembler->embed(data.data(), size);
+}
+
+void c_emitter::pattern_bytes(std::size_t size, const void* pattern, std::size_t pattern_size)
+{
+	if (!size || !pattern_size)
+		return;
+
+	std::uint8_t* dst = reserve_code(m_assembler, size);
+	if (dst) {
+		fill_pattern(dst, size, pattern, pattern_size);
+		commit_code(m_assembler, size);
+		return;
+	}
+
+	std::vector<std::uint8_t> data(size);
+	fill_pattern(data.data(), size, pattern, pattern_size);
+	m_assembler->embed(data.data(), size);
+}
+
+c_local_label::c_local_label(x86::Assembler* assembler, c_cost_meter* cost) : m_assembler(assembler), m_cost(cost) {}
+
+void c_local_label::emit_jump(InstId inst_id, const std::uint8_t* opcode, std::size_t opcode_size, std::uint8_t disp_size)
+{
+	if (m_bound) {
+		print_error("Jump to a bound local label\n");
+	}
+
+	if (m_cost)
+		m_cost->charge({ inst_id });
+
+	// the assembler encodes the same jump to an unbound label
+	if (m_count == max_jumps) {
+		if (!m_label.is_valid())
+			m_label = m_assembler->new_label();
+
+		Error err = inst_id == x86::Inst::kIdJecxz ? m_assembler->jecxz(x86::rcx, m_label) : m_assembler->emit(inst_id, m_label);
+		if (err != kErrorOk) {
+			print_error("Failed jump to a local label\n");
+		}
+		return;
+	}
+
+	template_t tmpl{};
+	std::memcpy(tmpl.bytes, opcode, opcode_size);
+	tmpl.size = static_cast<std::uint8_t>(opcode_size + disp_size);
+	stamp(m_assembler, tmpl);
+
+	m_slots[m_count++] = { m_assembler->offset() - disp_size, disp_size };
+}
+
+void c_local_label::jmp()
+{
+	static const std::uint8_t opcode[] = { 0xE9 };
+	emit_jump(x86::Inst::kIdJmp, opcode, sizeof(opcode), 4);
+}
+
+void c_local_label::call()
+{
+	static const std::uint8_t opcode[] = { 0xE8 };
+	emit_jump(x86::Inst::kIdCall, opcode, sizeof(opcode), 4);
+}
+
+void c_local_label::j(x86::CondCode cc)
+{
+	const std::uint8_t opcode[] = { 0x0F, static_cast<std::uint8_t>(0x80 | static_cast<std::uint8_t>(cc)) };
+	emit_jump(x86::Inst::jcc_from_cond(cc), opcode, sizeof(opcode), 4);
+}
+
+void c_local_label::jecxz()
+{
+	// the assembler emits jecxz without the address size prefix, in 64-bit mode it tests rcx
+	static const std::uint8_t opcode[] = { 0xE3 };
+	emit_jump(x86::Inst::kIdJecxz, opcode, sizeof(opcode), 1);
+}
+
+void c_local_label::bind()
+{
+	if (m_bound) {
+		print_error("Local label is bound twice\n");
+	}
+
+	m_bound = true;
+	if (m_label.is_valid() && m_assembler->bind(m_label) != kErrorOk) {
+		print_error("Failed binding of a local label\n");
+	}
+
+	std::size_t target = m_assembler->offset();
+	// the buffer may have moved since the jumps were written
+	std::uint8_t* data = m_assembler->buffer_data();
+
+	for (std::size_t i = 0; i < m_count; i++) {
+		const slot_t& slot = m_slots[i];
+		std::int64_t disp = static_cast<std::int64_t>(target) - static_cast<std::int64_t>(slot.offset + slot.size);
+
+		if (slot.size == 1) {
+			// a zero rel8 would turn the jump into a fall-through
+			if (disp < INT8_MIN || disp > INT8_MAX) {
+				print_error("Jump of a local label is out of rel8 range\n");
+			}
+
+			data[slot.offset] = static_cast<std::uint8_t>(disp);
+		}
+		else {
+			std::int32_t disp32 = static_cast<std::int32_t>(disp);
+			std::memcpy(data + slot.offset, &disp32, sizeof(disp32));
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "asmjit/asmjit.h"
+#include "cost.hpp"
+
+// Emits the instruction shapes repeated by the junk generators from templates
+// pre-encoded once per register and immediate width, only the immediate is patched.
+// Operands not covered by the templates are emitted through the assembler.
+// Every instruction is charged to the cost meter if there is one, budget is checked by the caller before a group.
+class c_emitter {
+public:
+	c_emitter(asmjit::x86::Assembler* assembler, c_cost_meter* cost = nullptr);
+
+	void push(const asmjit::x86::Gp& reg);
+	void pop(const asmjit::x86::Gp& reg);
+	void neg(const asmjit::x86::Gp& reg);
+
+	void add(const asmjit::x86::Gp& dst, const asmjit::x86::Gp& src);
+	void sub(const asmjit::x86::Gp& dst, const asmjit::x86::Gp& src);
+	void and_(const asmjit::x86::Gp& dst, const asmjit::x86::Gp& src);
+	void or_(const asmjit::x86::Gp& dst, const asmjit::x86::Gp& src);
+	void xor_(const asmjit::x86::Gp& dst, const asmjit::x86::Gp& src);
+	void mov(const asmjit::x86::Gp& dst, const asmjit::x86::Gp& src);
+	void imul(const asmjit::x86::Gp& dst, const asmjit::x86::Gp& src);
+	void cmp(const asmjit::x86::Gp& dst, const asmjit::x86::Gp& src);
+
+	void add(const asmjit::x86::Gp& dst, std::int64_t imm);
+	void sub(const asmjit::x86::Gp& dst, std::int64_t imm);
+	void and_(const asmjit::x86::Gp& dst, std::int64_t imm);
+	void or_(const asmjit::x86::Gp& dst, std::int64_t imm);
+	void xor_(const asmjit::x86::Gp& dst, std::int64_t imm);
+	void imul(const asmjit::x86::Gp& dst, std::int64_t imm);
+	void shr(const asmjit::x86::Gp& dst, std::int64_t imm);
+	void cmp(const asmjit::x86::Gp& dst, std::int64_t imm);
+	void mov(const asmjit::x86::Gp& dst, std::int64_t imm);
+
+	void cpuid();
+	void nop();
+
+	// bulk data is written right into the code buffer, space for all bytes is reserved once;
+	// it isn't executed, so it isn't charged
+	// random bytes in range [from; to], the same seed gives the same bytes
+	void random_bytes(std::size_t size, std::uint8_t from, std::uint8_t to, std::uint64_t seed);
+	// pattern repeated to size bytes
+	void pattern_bytes(std::size_t size, const void* pattern, std::size_t pattern_size);
+
+	enum reg_op_t { op_push, op_pop, op_neg, reg_ops_count };
+	enum bin_op_t { op_add, op_sub, op_and, op_or, op_xor, op_mov, op_imul, op_shr, op_cmp, bin_ops_count };
+
+private:
+	void charge(asmjit::InstId inst_id);
+	void emit_reg(reg_op_t op, const asmjit::x86::Gp& reg);
+	void emit_reg_reg(bin_op_t op, const asmjit::x86::Gp& dst, const asmjit::x86::Gp& src);
+	void emit_reg_imm(bin_op_t op, const asmjit::x86::Gp& dst, std::int64_t imm);
+
+	asmjit::x86::Assembler* m_assembler;
+	c_cost_meter* m_cost;
+};
+
+// Target of forward jumps bound shortly after them, for junk blocks that would otherwise create
+// a LabelEntry in the CodeHolder and a Fixup per jump that live until the end of the pack.
+// Jumps are written with a zero displacement and patched by bind(), so the label takes only its slots.
+// Encodings are the ones x86::Assembler uses for jumps to unbound labels: rel32, rel8 for jecxz.
+// Jumps are charged to the cost meter if there is one, as c_emitter does.
+// Misuse and a jecxz farther than rel8 from bind() are reported by print_error.
+class c_local_label {
+public:
+	c_local_label(asmjit::x86::Assembler* assembler, c_cost_meter* cost = nullptr);
+
+	void jmp();
+	void call();
+	void j(asmjit::x86::CondCode cc);
+	void jecxz();
+
+	// patches all jumps to the current offset, the label can't be used after it
+	void bind();
+
+	// jumps patched by the label itself, the following ones go through an asmjit label
+	static const std::size_t max_jumps = 4;
+
+private:
+	void emit_jump(asmjit::InstId inst_id, const std::uint8_t* opcode, std::size_t opcode_size, std::uint8_t disp_size);
+
+	struct slot_t {
+		std::size_t offset;         // offset of the displacement
+		std::uint8_t size;
+	};
+
+	asmjit::x86::Assembler* m_assembler;
+	c_cost_meter* m_cost;
+	slot_t m_slots[max_jumps];
+	std::size_t m_count = 0;
+	// created on the first jump that has no slot left
+	asmjit::Label m_label;
+	bool m_bound = false;
+};
@@ -0,0 +1,323 @@
+#include "kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "asmjit/ujit.h"
+
+using namespace asmjit;
+
+namespace {
+	// compiles one function through UniCompiler, returns null if anything failed
+	template<typename Fn, typename Build>
+	Fn compile_kernel(JitRuntime& runtime, const CpuFeatures& features, std::uint32_t& vec_size, Build&& build)
+	{
+		CodeHolder code;
+		if (code.init(runtime.environment(), features) != kErrorOk)
+			return nullptr;
+
+		ujit::BackendCompiler cc(&code);
+		ujit::UniCompiler uc(&cc, features, CpuHints::kNone);
+		uc.init_vec_width(uc.max_vec_width_from_cpu_features());
+		vec_size = 16u << static_cast<std::uint32_t>(uc.vec_width());
+
+		build(uc, cc);
+
+		Fn fn = nullptr;
+		if (uc.end_func() != kErrorOk || cc.finalize() != kErrorOk || runtime.add(&fn, &code) != kErrorOk)
+			return nullptr;
+
+		return fn;
+	}
+}
+
+const c_kernels& c_kernels::get()
+{
+	static const c_kernels kernels;
+	return kernels;
+}
+
+c_kernels::c_kernels()
+	: m_features(CpuInfo::host().features())
+{
+	compile_xor();
+	compile_count();
+	compile_sum();
+}
+
+void c_kernels::compile_xor()
+{
+	std::uint32_t vec_size = 0;
+	m_xor = compile_kernel<xor_fn>(m_runtime, m_features, vec_size, [&vec_size](ujit::UniCompiler& uc, ujit::BackendCompiler&) {
+		FuncNode* node = uc.add_func(FuncSignature::build<void, std::uint8_t*, std::size_t, std::uint32_t>());
+
+		ujit::Gp ptr = uc.new_gpz("ptr");
+		ujit::Gp blocks = uc.new_gpz("blocks");
+		ujit::Gp key = uc.new_gp32("key");
+		node->set_arg(0, ptr);
+		node->set_arg(1, blocks);
+		node->set_arg(2, key);
+
+		ujit::Vec vkey = uc.new_vec("vkey");
+		ujit::Vec v[vec_unroll];
+		for (ujit::Vec& reg : v)
+			reg = uc.new_vec("v");
+
+		uc.v_broadcast_u8(vkey, key);
+
+		Label loop = uc.new_label();
+		Label done = uc.new_label();
+		uc.j(done, ujit::cmp_eq(blocks, Imm(0)));
+
+		uc.bind(loop);
+		for (std::uint32_t i = 0; i < vec_unroll; i++)
+			uc.v_loaduvec(v[i], ujit::mem_ptr(ptr, static_cast<std::int32_t>(i * vec_size)));
+		for (std::uint32_t i = 0; i < vec_unroll; i++)
+			uc.v_xor_i32(v[i], v[i], vkey);
+		for (std::uint32_t i = 0; i < vec_unroll; i++)
+			uc.v_storeuvec(ujit::mem_ptr(ptr, static_cast<std::int32_t>(i * vec_size)), v[i]);
+
+		uc.add(ptr, ptr, Imm(vec_unroll * vec_size));
+		uc.j(loop, ujit::sub_nz(blocks, Imm(1)));
+		uc.bind(done);
+	});
+
+	m_vec_size = m_xor ? vec_size : 0;
+}
+
+void c_kernels::compile_sum()
+{
+	std::uint32_t vec_size = 0;
+	m_sum = compile_kernel<sum_fn>(m_runtime, m_features, vec_size, [&vec_size](ujit::UniCompiler& uc, ujit::BackendCompiler&) {
+		FuncNode* node = uc.add_func(FuncSignature::build<void, const std::uint8_t*, std::size_t, std::uint64_t*>());
+
+		ujit::Gp ptr = uc.new_gpz("ptr");
+		ujit::Gp blocks = uc.new_gpz("blocks");
+		ujit::Gp lanes = uc.new_gpz("lanes");
+		node->set_arg(0, ptr);
+		node->set_arg(1, blocks);
+		node->set_arg(2, lanes);
+
+		// dwords are zero extended to qword lanes, so the sum never overflows
+		ujit::Vec acc[vec_unroll];
+		ujit::Vec v[vec_unroll];
+		ujit::Vec wide = uc.new_vec("wide");
+		for (std::uint32_t i = 0; i < vec_unroll; i++) {
+			acc[i] = uc.new_vec("acc");
+			v[i] = uc.new_vec("v");
+			uc.v_zero_i(acc[i]);
+		}
+
+		Label loop = uc.new_label();
+		Label done = uc.new_label();
+		uc.j(done, ujit::cmp_eq(blocks, Imm(0)));
+
+		uc.bind(loop);
+		for (std::uint32_t i = 0; i < vec_unroll; i++)
+			uc.v_loaduvec(v[i], ujit::mem_ptr(ptr, static_cast<std::int32_t>(i * vec_size)));
+		for (std::uint32_t i = 0; i < vec_unroll; i++) {
+			uc.v_cvt_u32_lo_to_u64(wide, v[i]);
+			uc.v_add_u64(acc[i], acc[i], wide);
+			uc.v_cvt_u32_hi_to_u64(wide, v[i]);
+			uc.v_add_u64(acc[(i + 1) % vec_unroll], acc[(i + 1) % vec_unroll], wide);
+		}
+
+		uc.add(ptr, ptr, Imm(vec_unroll * vec_size));
+		uc.j(loop, ujit::sub_nz(blocks, Imm(1)));
+		uc.bind(done);
+
+		for (std::uint32_t i = 1; i < vec_unroll; i++)
+			uc.v_add_u64(acc[0], acc[0], acc[i]);
+		uc.v_storeuvec(ujit::mem_ptr(lanes), acc[0]);
+	});
+
+	if (m_sum && vec_size != m_vec_size)
+		m_sum = nullptr;
+}
+
+void c_kernels::compile_count()
+{
+	std::uint32_t vec_size = 0;
+	m_count = compile_kernel<count_fn>(m_runtime, m_features, vec_size, [](ujit::UniCompiler& uc, ujit::BackendCompiler& cc) {
+		FuncNode* node = uc.add_func(FuncSignature::build<void, const std::uint8_t*, std::size_t, std::uint32_t*>());
+
+		ujit::Gp ptr = uc.new_gpz("ptr");
+		ujit::Gp blocks = uc.new_gpz("blocks");
+		ujit::Gp tables = uc.new_gpz("tables");
+		node->set_arg(0, ptr);
+		node->set_arg(1, blocks);
+		node->set_arg(2, tables);
+
+		// a histogram has no vector form, one qword load feeds count_block increments spread over several
+		// tables, so the increments of equal neighbouring bytes don't wait for each other
+		ujit::Gp bytes = uc.new_gp64("bytes");
+		ujit::Gp index[count_block];
+		for (ujit::Gp& reg : index)
+			reg = uc.new_gp64("index");
+
+		Label loop = uc.new_label();
+		Label done = uc.new_label();
+		uc.j(done, ujit::cmp_eq(blocks, Imm(0)));
+
+		uc.bind(loop);
+		cc.mov(bytes, x86::qword_ptr(ptr));
+		for (std::uint32_t i = 0; i < count_block; i++) {
+			cc.movzx(index[i].r32(), bytes.r8());
+			if (i + 1 != count_block)
+				cc.shr(bytes, 8);
+		}
+		for (std::uint32_t i = 0; i < count_block; i++)
+			cc.add(x86::dword_ptr(tables, index[i], 2, static_cast<std::int32_t>((i % count_tables) * 256 * sizeof(std::uint32_t))), 1);
+
+		uc.add(ptr, ptr, Imm(count_block));
+		uc.j(loop, ujit::sub_nz(blocks, Imm(1)));
+		uc.bind(done);
+	});
+}
+
+void c_kernels::xor_bytes(void* data, std::size_t size, std::uint8_t key) const
+{
+	std::uint8_t* bytes = static_cast<std::uint8_t*>(data);
+	std::size_t done = 0;
+
+	if (m_xor) {
+		std::size_t block = m_vec_size * vec_unroll;
+		m_xor(bytes, size / block, key);
+		done = size / block * block;
+	}
+
+	xor_bytes_scalar(bytes + done, size - done, key);
+}
+
+void c_kernels::xor_bytes_scalar(void* data, std::size_t size, std::uint8_t key)
+{
+	std::uint8_t* bytes = static_cast<std::uint8_t*>(data);
+	for (std::size_t i = 0; i < size; i++)
+		bytes[i] ^= key;
+}
+
+void c_kernels::count_bytes(const void* data, std::size_t size, std::uint32_t counts[256]) const
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	if (!m_count) {
+		count_bytes_scalar(bytes, size, counts);
+		return;
+	}
+
+	std::uint32_t tables[count_tables][256] = {};
+	m_count(bytes, size / count_block, tables[0]);
+
+	for (std::size_t i = size / count_block * count_block; i < size; i++)
+		tables[0][bytes[i]]++;
+
+	for (std::uint32_t b = 0; b < 256; b++)
+		for (std::uint32_t t = 0; t < count_tables; t++)
+			counts[b] += tables[t][b];
+}
+
+void c_kernels::count_bytes_scalar(const void* data, std::size_t size, std::uint32_t counts[256])
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	std::uint32_t tables[count_tables][256] = {};
+
+	std::size_t i = 0;
+	for (; i + count_tables <= size; i += count_tables)
+		for (std::uint32_t t = 0; t < count_tables; t++)
+			tables[t][bytes[i + t]]++;
+
+	for (; i < size; i++)
+		tables[0][bytes[i]]++;
+
+	for (std::uint32_t b = 0; b < 256; b++)
+		for (std::uint32_t t = 0; t < count_tables; t++)
+			counts[b] += tables[t][b];
+}
+
+double c_kernels::entropy(const void* data, std::size_t size) const
+{
+	if (!size)
+		return 0;
+
+	std::uint32_t counts[256] = {};
+	count_bytes(data, size, counts);
+
+	double entropy = 0;
+	for (std::uint32_t count : counts) {
+		if (!count)
+			continue;
+
+		double p = static_cast<double>(count) / size;
+		entropy -= p * std::log2(p);
+	}
+
+	return entropy;
+}
+
+std::uint64_t c_kernels::sum_dwords(const std::uint8_t* data, std::size_t size) const
+{
+	if (!m_sum)
+		return sum_dwords_scalar(data, size);
+
+	std::size_t block = m_vec_size * vec_unroll;
+	std::uint64_t lanes[8] = {};
+	m_sum(data, size / block, lanes);
+
+	std::uint64_t sum = 0;
+	for (std::uint32_t i = 0; i < m_vec_size / sizeof(std::uint64_t); i++)
+		sum += lanes[i];
+
+	std::size_t done = size / block * block;
+	return sum + sum_dwords_scalar(data + done, size - done);
+}
+
+std::uint64_t c_kernels::sum_dwords_scalar(const std::uint8_t* data, std::size_t size)
+{
+	std::uint64_t sum = 0;
+
+	std::size_t i = 0;
+	for (; i + sizeof(std::uint32_t) <= size; i += sizeof(std::uint32_t)) {
+		std::uint32_t dw;
+		std::memcpy(&dw, data + i, sizeof(dw));
+		sum += dw;
+	}
+
+	if (i < size) {
+		std::uint32_t dw = 0;
+		std::memcpy(&dw, data + i, size - i);
+		sum += dw;
+	}
+
+	return sum;
+}
+
+std::uint32_t c_kernels::finish_checksum(const std::uint8_t* image, std::size_t size, std::uint64_t sum)
+{
+	// the CheckSum field itself is not summed, it's at offset 64 of the optional header
+	if (size >= 0x40) {
+		std::uint32_t e_lfanew;
+		std::memcpy(&e_lfanew, image + 0x3C, sizeof(e_lfanew));
+
+		std::uint64_t checksum_pos = static_cast<std::uint64_t>(e_lfanew) + 24 + 64;
+		if (checksum_pos % sizeof(std::uint32_t) == 0 && checksum_pos < size) {
+			std::uint32_t dw = 0;
+			std::memcpy(&dw, image + checksum_pos, (std::min)(size - static_cast<std::size_t>(checksum_pos), sizeof(dw)));
+			sum -= dw;
+		}
+	}
+
+	// adding dwords with end-around carry and folding to a word is the sum modulo 0xFFFF,
+	// where a non-zero multiple of 0xFFFF gives 0xFFFF
+	std::uint32_t checksum = sum ? static_cast<std::uint32_t>((sum - 1) % 0xFFFF + 1) : 0;
+	return checksum + static_cast<std::uint32_t>(size);
+}
+
+std::uint32_t c_kernels::pe_checksum(const void* image, std::size_t size) const
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(image);
+	return finish_checksum(bytes, size, sum_dwords(bytes, size));
+}
+
+std::uint32_t c_kernels::pe_checksum_scalar(const void* image, std::size_t size)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(image);
+	return finish_checksum(bytes, size, sum_dwords_scalar(bytes, size));
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "asmjit/asmjit.h"
+
+// Byte-crunching loops of the packer compiled at runtime for the host CPU through asmjit's UniCompiler,
+// so the widest vectors the CPU has (SSE2/AVX2/AVX-512) are used whatever the packer itself was built for
+// Kernels are compiled once per process on the first use, a kernel that can't be compiled falls back to scalar code
+class c_kernels
+{
+public:
+	static const c_kernels& get();
+
+	// data[i] ^= key
+	void xor_bytes(void* data, std::size_t size, std::uint8_t key) const;
+	// adds the number of every byte value in data to counts
+	void count_bytes(const void* data, std::size_t size, std::uint32_t counts[256]) const;
+	// Shannon entropy in bits per byte, 0 for empty data
+	double entropy(const void* data, std::size_t size) const;
+	// PE checksum of the whole image file, the same value as pe_bliss::calculate_checksum
+	std::uint32_t pe_checksum(const void* image, std::size_t size) const;
+	// sum of little-endian dwords of data, the last one is padded with zeroes,
+	// sums of pieces starting at dword offsets add up to the sum of the whole data
+	std::uint64_t sum_dwords(const std::uint8_t* data, std::size_t size) const;
+
+	// compiled C++ versions, used as fallback and as the baseline of the benchmark
+	static void xor_bytes_scalar(void* data, std::size_t size, std::uint8_t key);
+	static void count_bytes_scalar(const void* data, std::size_t size, std::uint32_t counts[256]);
+	static std::uint32_t pe_checksum_scalar(const void* image, std::size_t size);
+
+	// vector width of the kernels in bytes, 0 if they are not compiled
+	std::uint32_t vec_size() const { return m_vec_size; }
+
+private:
+	using xor_fn = void (*)(std::uint8_t* data, std::size_t blocks, std::uint32_t key);
+	using count_fn = void (*)(const std::uint8_t* data, std::size_t blocks, std::uint32_t* tables);
+	using sum_fn = void (*)(const std::uint8_t* data, std::size_t blocks, std::uint64_t* lanes);
+
+	// vectors processed by one iteration of xor and sum kernels
+	static const std::uint32_t vec_unroll = 4;
+	// bytes processed by one iteration of the count kernel, spread over count_tables tables
+	static const std::uint32_t count_block = 8;
+	static const std::uint32_t count_tables = 4;
+
+	c_kernels();
+
+	void compile_xor();
+	void compile_count();
+	void compile_sum();
+
+	static std::uint64_t sum_dwords_scalar(const std::uint8_t* data, std::size_t size);
+	static std::uint32_t finish_checksum(const std::uint8_t* image, std::size_t size, std::uint64_t sum);
+
+	asmjit::JitRuntime m_runtime;
+	asmjit::CpuFeatures m_features;
+	std::uint32_t m_vec_size = 0;
+
+	xor_fn m_xor = nullptr;
+	count_fn m_count = nullptr;
+	sum_fn m_sum = nullptr;
+};
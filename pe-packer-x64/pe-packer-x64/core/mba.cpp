@@ -1,26 +1,29 @@
 #include "mba.hpp"
 #include "utils/utils.hpp"
+#include "emitter.hpp"
 
 using namespace asmjit;
 
 c_mba::c_mba(c_core& g_core) : m_core(g_core){}
 
 void c_mba::gen_math_operations() {
-	switch (rand() % 4) {
+	c_emitter emit(m_core.get_assembler(), &m_core.get_cost());
+
+	switch (random_int() % 4) {
 	case 0:
-		m_core.get_assembler()->shr(m_core.get_rand_reg(), random_value(1, 100));
+		emit.shr(m_core.get_rand_reg(), random_value(1, 100));
 		break;
 
 	case 1:
-		m_core.get_assembler()->and_(m_core.get_rand_reg(), random_value(1, 100));
+		emit.and_(m_core.get_rand_reg(), random_value(1, 100));
 		break;
 
 	case 2:
-		m_core.get_assembler()->xor_(m_core.get_rand_reg(), random_value(1, 100));
+		emit.xor_(m_core.get_rand_reg(), random_value(1, 100));
 		break;
 
 	case 3:
-		m_core.get_assembler()->add(m_core.get_rand_reg(), random_value(1, 100));
+		emit.add(m_core.get_rand_reg(), random_value(1, 100));
 		break;
 
 	default:
@@ -29,115 +32,134 @@ void c_mba::gen_math_operations() {
 }
 
 void c_mba::mba_code(c_mba::options opt) {
+	c_cost_meter& cost = m_core.get_cost();
+	c_emitter emit(m_core.get_assembler(), &cost);
 
 	int x = random_value(0, 3);
 	switch (x) {
 
 	case 0: {
-
-		Label new_label = m_core.get_assembler()->new_label();
+		// math operations are checked as xor, they all cost the same
+		if (!cost.fits({ x86::Inst::kIdXor, x86::Inst::kIdJz, x86::Inst::kIdMov, x86::Inst::kIdMov, x86::Inst::kIdOr,
+			x86::Inst::kIdPush, x86::Inst::kIdMov, x86::Inst::kIdAnd, x86::Inst::kIdPop, x86::Inst::kIdSub, x86::Inst::kIdMov,
+			x86::Inst::kIdPush, x86::Inst::kIdMov, x86::Inst::kIdXor, x86::Inst::kIdPush, x86::Inst::kIdMov, x86::Inst::kIdXor,
+			x86::Inst::kIdPop }))
+			return;
+
+		c_local_label new_label(m_core.get_assembler(), &cost);
 		gen_math_operations();
 
-		m_core.get_assembler()->je(new_label);
+		new_label.j(x86::CondCode::kE);
 
-		m_core.get_assembler()->mov(x86::rax, x86::rdi);
-		m_core.get_assembler()->mov(x86::rbx, x86::rsi);
+		emit.mov(x86::rax, x86::rdi);
+		emit.mov(x86::rbx, x86::rsi);
 
-		m_core.get_assembler()->or_(x86::rax, x86::rbx);
-		m_core.get_assembler()->push(x86::rax);
+		emit.or_(x86::rax, x86::rbx);
+		emit.push(x86::rax);
 
-		m_core.get_assembler()->mov(x86::rax, x86::rdi);
-		m_core.get_assembler()->and_(x86::rax, x86::rbx);
+		emit.mov(x86::rax, x86::rdi);
+		emit.and_(x86::rax, x86::rbx);
 
-		m_core.get_assembler()->pop(x86::rcx);
-		m_core.get_assembler()->sub(x86::rcx, x86::rax);
+		emit.pop(x86::rcx);
+		emit.sub(x86::rcx, x86::rax);
 
-		m_core.get_assembler()->mov(x86::rax, x86::rcx);
+		emit.mov(x86::rax, x86::rcx);
 
-		m_core.get_assembler()->push(x86::rax);
-		m_core.get_assembler()->mov(x86::rbx, x86::rax);
-		m_core.get_assembler()->xor_(x86::rbx, x86::rdi);
+		emit.push(x86::rax);
+		emit.mov(x86::rbx, x86::rax);
+		emit.xor_(x86::rbx, x86::rdi);
 
-		m_core.get_assembler()->bind(new_label);
+		new_label.bind();
 
-		m_core.get_assembler()->push(x86::rbp);
-		m_core.get_assembler()->mov(x86::rbp, x86::rsp);
+		emit.push(x86::rbp);
+		emit.mov(x86::rbp, x86::rsp);
 		gen_math_operations();
 
-		m_core.get_assembler()->pop(x86::rbp);
+		emit.pop(x86::rbp);
 
 		break;
 	}
 
 	case 1: {
+		if (!cost.fits({ x86::Inst::kIdXor, x86::Inst::kIdJz, x86::Inst::kIdMov, x86::Inst::kIdMov, x86::Inst::kIdAnd,
+			x86::Inst::kIdPush, x86::Inst::kIdMov, x86::Inst::kIdOr, x86::Inst::kIdPop, x86::Inst::kIdAdd, x86::Inst::kIdMov,
+			x86::Inst::kIdPush, x86::Inst::kIdMov, x86::Inst::kIdXor, x86::Inst::kIdPush, x86::Inst::kIdMov, x86::Inst::kIdXor,
+			x86::Inst::kIdPop }))
+			return;
 
-		Label new_label = m_core.get_assembler()->new_label();
+		c_local_label new_label(m_core.get_assembler(), &cost);
 
 		gen_math_operations();
 
-		m_core.get_assembler()->je(new_label);
+		new_label.j(x86::CondCode::kE);
 
-		m_core.get_assembler()->mov(x86::rax, x86::rdi);
-		m_core.get_assembler()->mov(x86::rbx, x86::rsi);
+		emit.mov(x86::rax, x86::rdi);
+		emit.mov(x86::rbx, x86::rsi);
 
-		m_core.get_assembler()->and_(x86::rax, x86::rbx);
-		m_core.get_assembler()->push(x86::rax);
+		emit.and_(x86::rax, x86::rbx);
+		emit.push(x86::rax);
 
-		m_core.get_assembler()->mov(x86::rax, x86::rdi);
-		m_core.get_assembler()->or_(x86::rax, x86::rbx);
+		emit.mov(x86::rax, x86::rdi);
+		emit.or_(x86::rax, x86::rbx);
 
-		m_core.get_assembler()->pop(x86::rcx);
-		m_core.get_assembler()->add(x86::rcx, x86::rax);
+		emit.pop(x86::rcx);
+		emit.add(x86::rcx, x86::rax);
 
-		m_core.get_assembler()->mov(x86::rax, x86::rcx);
+		emit.mov(x86::rax, x86::rcx);
 
-		m_core.get_assembler()->push(x86::rax);
-		m_core.get_assembler()->mov(x86::rbx, x86::rax);
-		m_core.get_assembler()->xor_(x86::rbx, x86::rdi);
+		emit.push(x86::rax);
+		emit.mov(x86::rbx, x86::rax);
+		emit.xor_(x86::rbx, x86::rdi);
 
-		m_core.get_assembler()->bind(new_label);
+		new_label.bind();
 
-		m_core.get_assembler()->push(x86::rbp);
-		m_core.get_assembler()->mov(x86::rbp, x86::rsp);
+		emit.push(x86::rbp);
+		emit.mov(x86::rbp, x86::rsp);
 		gen_math_operations();
 
-		m_core.get_assembler()->pop(x86::rbp);
+		emit.pop(x86::rbp);
 
 		break;
 	}
 
 	case 2: {
-		Label new_label = m_core.get_assembler()->new_label();
+		if (!cost.fits({ x86::Inst::kIdJz, x86::Inst::kIdMov, x86::Inst::kIdMov, x86::Inst::kIdXor, x86::Inst::kIdNeg,
+			x86::Inst::kIdPush, x86::Inst::kIdMov, x86::Inst::kIdNeg, x86::Inst::kIdAnd, x86::Inst::kIdPop, x86::Inst::kIdAdd,
+			x86::Inst::kIdMov, x86::Inst::kIdPush, x86::Inst::kIdMov, x86::Inst::kIdXor, x86::Inst::kIdPush, x86::Inst::kIdMov,
+			x86::Inst::kIdXor, x86::Inst::kIdPop }))
+			return;
+
+		c_local_label new_label(m_core.get_assembler(), &cost);
 
-		m_core.get_assembler()->je(new_label);
+		new_label.j(x86::CondCode::kE);
 
-		m_core.get_assembler()->mov(x86::rax, x86::rdi);
-		m_core.get_assembler()->mov(x86::rbx, x86::rsi);
+		emit.mov(x86::rax, x86::rdi);
+		emit.mov(x86::rbx, x86::rsi);
 
-		m_core.get_assembler()->xor_(x86::rax, x86::rbx);
-		m_core.get_assembler()->neg(x86::rax);
-		m_core.get_assembler()->push(x86::rax);
+		emit.xor_(x86::rax, x86::rbx);
+		emit.neg(x86::rax);
+		emit.push(x86::rax);
 
-		m_core.get_assembler()->mov(x86::rax, x86::rdi);
-		m_core.get_assembler()->neg(x86::rax);
-		m_core.get_assembler()->and_(x86::rax, x86::rbx);
+		emit.mov(x86::rax, x86::rdi);
+		emit.neg(x86::rax);
+		emit.and_(x86::rax, x86::rbx);
 
-		m_core.get_assembler()->pop(x86::rcx);
-		m_core.get_assembler()->add(x86::rcx, x86::rax);
+		emit.pop(x86::rcx);
+		emit.add(x86::rcx, x86::rax);
 
-		m_core.get_assembler()->mov(x86::rax, x86::rcx);
+		emit.mov(x86::rax, x86::rcx);
 
-		m_core.get_assembler()->push(x86::rax);
-		m_core.get_assembler()->mov(x86::rbx, x86::rax);
-		m_core.get_assembler()->xor_(x86::rbx, x86::rdi);
+		emit.push(x86::rax);
+		emit.mov(x86::rbx, x86::rax);
+		emit.xor_(x86::rbx, x86::rdi);
 
-		m_core.get_assembler()->bind(new_label);
+		new_label.bind();
 
-		m_core.get_assembler()->push(x86::rbp);
-		m_core.get_assembler()->mov(x86::rbp, x86::rsp);
+		emit.push(x86::rbp);
+		emit.mov(x86::rbp, x86::rsp);
 		gen_math_operations();
 
-		m_core.get_assembler()->pop(x86::rbp);
+		emit.pop(x86::rbp);
 
 		break;
 	}
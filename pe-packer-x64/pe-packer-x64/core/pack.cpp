@@ -0,0 +1,43 @@
+#include "pack.hpp"
+#include "utils/utils.hpp"
+
+namespace {
+	// pack() reseeds the generator and may silence messages of the calling thread, both are restored on return
+	class c_thread_state_guard {
+	public:
+		c_thread_state_guard(bool verbose)
+			: m_quiet(quiet_output()), m_engine(random_engine())
+		{
+			quiet_output() = m_quiet || !verbose;
+		}
+
+		~c_thread_state_guard()
+		{
+			quiet_output() = m_quiet;
+			random_engine() = m_engine;
+		}
+
+	private:
+		bool m_quiet;
+		std::mt19937 m_engine;
+	};
+}
+
+std::vector<std::uint8_t> pe_packer::pack(const std::uint8_t* data, std::size_t size, const c_core::options& opt)
+{
+	c_thread_state_guard guard(opt.verbose);
+
+	std::ostringstream out;
+	{
+		c_core packer(std::string(reinterpret_cast<const char*>(data), size), opt);
+		packer.process(out);
+	}
+
+	const std::string packed = out.str();
+	return std::vector<std::uint8_t>(packed.begin(), packed.end());
+}
+
+std::vector<std::uint8_t> pe_packer::pack(const std::vector<std::uint8_t>& image, const c_core::options& opt)
+{
+	return pack(image.data(), image.size(), opt);
+}
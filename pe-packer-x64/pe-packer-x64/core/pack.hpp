@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "core.hpp"
+
+// Packs an image held in memory, nothing touches the disk except the optional parse cache
+// Every call has its own c_core, so calls from different threads don't share any state
+// When many images are packed at once, options::stub_jobs = 1 avoids oversubscribing the cores
+namespace pe_packer {
+	std::vector<std::uint8_t> pack(const std::uint8_t* data, std::size_t size, const c_core::options& opt);
+	std::vector<std::uint8_t> pack(const std::vector<std::uint8_t>& image, const c_core::options& opt);
+}
@@ -0,0 +1,196 @@
+#include "transform.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include "kernels.hpp"
+
+double c_section_transform::stats_t::bandwidth() const
+{
+	return seconds > 0 ? (bytes_read + bytes_written) / (1024.0 * 1024.0) / seconds : 0;
+}
+
+c_section_transform::c_section_transform(std::size_t block_size, std::size_t chunk_size)
+{
+	// blocks start at dword offsets so the checksum of a buffer is the sum of its blocks
+	m_block_size = (std::max)(block_size / sizeof(std::uint32_t) * sizeof(std::uint32_t), sizeof(std::uint32_t));
+	m_chunk_size = (std::max)(chunk_size / m_block_size * m_block_size, m_block_size);
+}
+
+std::size_t c_section_transform::add_buffer(void* data, std::size_t size)
+{
+	std::uint8_t* bytes = static_cast<std::uint8_t*>(data);
+	for (std::size_t i = 0; i < m_buffers.size(); i++) {
+		if (m_buffers[i].data == bytes) {
+			m_buffers[i].size = size;
+			return i;
+		}
+	}
+
+	m_buffers.push_back({ bytes, size, {} });
+	return m_buffers.size() - 1;
+}
+
+void c_section_transform::add_xor(std::size_t buffer, std::size_t offset, std::size_t size, std::uint8_t key)
+{
+	std::size_t buffer_size = m_buffers[buffer].size;
+	std::size_t begin = (std::min)(offset, buffer_size);
+	std::size_t end = begin + (std::min)(size, buffer_size - begin);
+	if (begin == end)
+		return;
+
+	m_buffers[buffer].stages.push_back(m_stages.size());
+	m_stages.push_back({ stage_kind::xor_bytes, begin, end, key, nullptr });
+}
+
+void c_section_transform::add_checksum(std::size_t buffer, std::uint64_t* sum)
+{
+	m_buffers[buffer].stages.push_back(m_stages.size());
+	m_stages.push_back({ stage_kind::checksum, 0, m_buffers[buffer].size, 0, sum });
+}
+
+void c_section_transform::add_histogram(std::size_t buffer, std::uint32_t* counts)
+{
+	m_buffers[buffer].stages.push_back(m_stages.size());
+	m_stages.push_back({ stage_kind::histogram, 0, m_buffers[buffer].size, 0, counts });
+}
+
+void c_section_transform::add_copy(std::size_t buffer, void* out)
+{
+	m_buffers[buffer].stages.push_back(m_stages.size());
+	m_stages.push_back({ stage_kind::copy, 0, m_buffers[buffer].size, 0, out });
+}
+
+void c_section_transform::run_chunk(const chunk_t& chunk, std::vector<std::uint64_t>& sums, std::vector<std::uint32_t>& counts,
+	std::uint64_t& bytes_read, std::uint64_t& bytes_written) const
+{
+	const c_kernels& kernels = c_kernels::get();
+	const buffer_t& buffer = m_buffers[chunk.buffer];
+
+	for (std::size_t block = chunk.begin; block < chunk.end; block += m_block_size) {
+		std::size_t block_end = (std::min)(block + m_block_size, chunk.end);
+		// bytes changed in place are written back once, whatever number of XOR stages changed them
+		std::size_t dirty_begin = block_end;
+		std::size_t dirty_end = block;
+
+		for (std::size_t index : buffer.stages) {
+			const stage_t& stage = m_stages[index];
+			std::size_t begin = (std::max)(stage.begin, block);
+			std::size_t end = (std::min)(stage.end, block_end);
+			if (begin >= end)
+				continue;
+
+			std::uint8_t* data = buffer.data + begin;
+			std::size_t size = end - begin;
+
+			switch (stage.kind) {
+			case stage_kind::xor_bytes:
+				kernels.xor_bytes(data, size, stage.key);
+				dirty_begin = (std::min)(dirty_begin, begin);
+				dirty_end = (std::max)(dirty_end, end);
+				break;
+			case stage_kind::checksum:
+				sums[index] += kernels.sum_dwords(data, size);
+				break;
+			case stage_kind::histogram:
+				kernels.count_bytes(data, size, &counts[index * 256]);
+				break;
+			case stage_kind::copy:
+				std::memcpy(static_cast<std::uint8_t*>(stage.target) + begin, data, size);
+				bytes_written += size;
+				break;
+			}
+		}
+
+		bytes_read += block_end - block;
+		if (dirty_begin < dirty_end)
+			bytes_written += dirty_end - dirty_begin;
+	}
+}
+
+c_section_transform::stats_t c_section_transform::run(std::uint32_t jobs)
+{
+	auto start = std::chrono::steady_clock::now();
+	stats_t stats;
+
+	std::vector<chunk_t> chunks;
+	for (std::size_t i = 0; i < m_buffers.size(); i++) {
+		if (m_buffers[i].stages.empty())
+			continue;
+
+		stats.buffers++;
+		for (std::size_t begin = 0; begin < m_buffers[i].size; begin += m_chunk_size)
+			chunks.push_back({ i, begin, (std::min)(begin + m_chunk_size, m_buffers[i].size) });
+	}
+
+	if (!jobs)
+		jobs = (std::max)(std::thread::hardware_concurrency(), 1u);
+	std::uint32_t threads = static_cast<std::uint32_t>((std::max<std::size_t>)((std::min<std::size_t>)(jobs, chunks.size()), 1));
+
+	// every thread sums its own results, they are added up in thread order afterwards
+	struct result_t {
+		std::vector<std::uint64_t> sums;
+		std::vector<std::uint32_t> counts;
+		std::uint64_t bytes_read = 0;
+		std::uint64_t bytes_written = 0;
+		std::exception_ptr error;
+	};
+	std::vector<result_t> results(threads);
+
+	std::atomic<std::size_t> next_chunk{ 0 };
+	auto worker = [&](std::uint32_t thread) {
+		result_t& result = results[thread];
+		result.sums.assign(m_stages.size(), 0);
+		result.counts.assign(m_stages.size() * 256, 0);
+
+		try {
+			for (std::size_t i; (i = next_chunk++) < chunks.size(); )
+				run_chunk(chunks[i], result.sums, result.counts, result.bytes_read, result.bytes_written);
+		}
+		catch (...) {
+			result.error = std::current_exception();
+			next_chunk = chunks.size();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (std::uint32_t i = 1; i < threads; i++)
+		workers.emplace_back(worker, i);
+
+	worker(0);
+	for (std::thread& t : workers)
+		t.join();
+
+	for (result_t& result : results) {
+		if (result.error)
+			std::rethrow_exception(result.error);
+	}
+
+	for (std::size_t i = 0; i < m_stages.size(); i++) {
+		const stage_t& stage = m_stages[i];
+		for (const result_t& result : results) {
+			if (stage.kind == stage_kind::checksum)
+				*static_cast<std::uint64_t*>(stage.target) += result.sums[i];
+			else if (stage.kind == stage_kind::histogram)
+				for (std::size_t b = 0; b < 256; b++)
+					static_cast<std::uint32_t*>(stage.target)[b] += result.counts[i * 256 + b];
+		}
+	}
+
+	for (const result_t& result : results) {
+		stats.bytes_read += result.bytes_read;
+		stats.bytes_written += result.bytes_written;
+	}
+
+	stats.chunks = chunks.size();
+	stats.threads = threads;
+
+	m_buffers.clear();
+	m_stages.clear();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	stats.seconds = elapsed.count();
+	return stats;
+}
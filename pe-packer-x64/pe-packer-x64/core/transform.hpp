@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Byte transforms of section data fused into a single pass
+// Stages (XOR, checksum, histogram, copy) are registered per buffer and run() goes over every buffer once:
+// each cache block is loaded and all stages of its buffer are applied to it in the order they were registered,
+// instead of a separate pass over memory for every stage. Buffers larger than a chunk are split into chunks
+// processed by several threads, results don't depend on the number of threads
+class c_section_transform
+{
+public:
+	// bytes of a buffer processed by all its stages before moving on, fits into L2
+	static const std::size_t default_block_size = 0x10000;
+	// bytes of a buffer taken by one thread at once, a multiple of the block size
+	static const std::size_t default_chunk_size = 0x100000;
+
+	struct stats_t {
+		std::size_t buffers = 0;
+		std::size_t chunks = 0;
+		std::uint32_t threads = 0;
+		// bytes of the buffers loaded once, and bytes stored back (XOR) or to the copy targets
+		std::uint64_t bytes_read = 0;
+		std::uint64_t bytes_written = 0;
+		double seconds = 0;
+
+		// memory bandwidth of the pass in MB/s, reads and writes together
+		double bandwidth() const;
+	};
+
+	explicit c_section_transform(std::size_t block_size = default_block_size, std::size_t chunk_size = default_chunk_size);
+
+	// registers data of a section, returns the index stages are added to
+	// the same data pointer gives the same index, data must stay in place until run()
+	std::size_t add_buffer(void* data, std::size_t size);
+
+	// data[i] ^= key for size bytes from offset, the range is clamped to the buffer
+	void add_xor(std::size_t buffer, std::size_t offset, std::size_t size, std::uint8_t key);
+	// adds the sum of little-endian dwords of the buffer to sum (c_kernels::sum_dwords),
+	// buffers at dword-aligned file offsets add up to the sum of the PE checksum
+	void add_checksum(std::size_t buffer, std::uint64_t* sum);
+	// adds the number of every byte value in the buffer to counts
+	void add_histogram(std::size_t buffer, std::uint32_t* counts);
+	// copies the buffer to out, which must have room for the whole buffer
+	void add_copy(std::size_t buffer, void* out);
+
+	bool empty() const { return m_stages.empty(); }
+
+	// runs all stages on up to jobs threads (0 - hardware concurrency) and removes them with the buffers,
+	// the first exception of a thread is rethrown
+	stats_t run(std::uint32_t jobs = 0);
+
+private:
+	enum class stage_kind { xor_bytes, checksum, histogram, copy };
+
+	struct buffer_t {
+		std::uint8_t* data;
+		std::size_t size;
+		// stages of the buffer in the order they were added
+		std::vector<std::size_t> stages;
+	};
+
+	struct stage_t {
+		stage_kind kind;
+		std::size_t begin;
+		std::size_t end;
+		std::uint8_t key;
+		// result (checksum, histogram) or copy target
+		void* target;
+	};
+
+	struct chunk_t {
+		std::size_t buffer;
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	// applies stages of the chunk block by block, partial sums and counts go to the results of the thread
+	void run_chunk(const chunk_t& chunk, std::vector<std::uint64_t>& sums, std::vector<std::uint32_t>& counts,
+		std::uint64_t& bytes_read, std::uint64_t& bytes_written) const;
+
+	std::size_t m_block_size;
+	std::size_t m_chunk_size;
+	std::vector<buffer_t> m_buffers;
+	std::vector<stage_t> m_stages;
+};
@@ -1,5 +1,9 @@
 #pragma once
+#include <cstdarg>
+#include <cstdio>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 
 #define COLOR_RESET   "\033[0m"
 #define COLOR_RED     "\033[31m"
@@ -12,7 +16,16 @@
 //#define print_info(fmt, ...)         printf("[ " COLOR_CYAN   "info"    COLOR_RESET " ] " fmt, ##__VA_ARGS__)
 //#define print_custom(fmt, mdl, ...)  printf("[ " COLOR_GREEN  "%s"      COLOR_RESET " ] " mdl, fmt, ##__VA_ARGS__)
 
+// silences info and warning messages of the current thread, errors are still thrown
+inline bool& quiet_output() {
+    static thread_local bool quiet = false;
+    return quiet;
+}
+
 inline void print_custom(const char* mdl, const char* fmt, ...) {
+    if (quiet_output())
+        return;
+
     va_list args;
     va_start(args, fmt);
     printf("[ " COLOR_GREEN "%s" COLOR_RESET " ] ", mdl);
@@ -21,6 +34,9 @@ inline void print_custom(const char* mdl, const char* fmt, ...) {
 }
 
 inline void print_warning(const char* fmt, ...) {
+    if (quiet_output())
+        return;
+
     va_list args;
     va_start(args, fmt);
     printf("[ " COLOR_YELLOW "info" COLOR_RESET " ] ");
@@ -29,6 +45,9 @@ inline void print_warning(const char* fmt, ...) {
 }
 
 inline void print_info(const char* fmt, ...) {
+	if (quiet_output())
+		return;
+
 	va_list args;
 	va_start(args, fmt);
 	printf("[ " COLOR_CYAN "info" COLOR_RESET " ] ");
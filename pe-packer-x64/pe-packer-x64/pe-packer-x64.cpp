@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "core/core.hpp"
+#include "core/batch.hpp"
 #include "gui/gui_app.hpp"
 #include "utils/utils.hpp"
 
@@ -87,14 +88,16 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int)
     ensure_cli();
     enable_virtual_terminal_processing();
 
-    time_t ctime = 0;
-    time(&ctime);
-    srand(static_cast<unsigned>(ctime));
-
     uint32_t mut_count = static_cast<uint32_t>(atoi(argv[3])) * 10;
 
     try
     {
+        if (arguments::has("-batch")) {
+            c_batch batch(argv[1], argv[2], mut_count);
+            batch.run();
+            return EXIT_SUCCESS;
+        }
+
         auto packer = std::make_unique<c_core>(argv[1], argv[2], mut_count);
 
         print_info("Mutations count: %i\n", mut_count);
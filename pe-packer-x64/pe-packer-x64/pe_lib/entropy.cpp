@@ -1,16 +1,21 @@
 #include <cmath>
+#include <algorithm>
 #include "entropy.h"
 #include "utils.h"
 
 namespace pe_bliss
 {
+//Size of chunk used to read streams
+static const std::streamoff stream_chunk_size = 0x10000;
+
 //Calculates entropy for PE image section
 double entropy_calculator::calculate_entropy(const section& s)
 {
-	if(s.get_raw_data().empty()) //Don't count entropy for empty sections
+	std::string_view data = s.get_raw_view();
+	if(data.empty()) //Don't count entropy for empty sections
 		throw pe_exception("Section is empty", pe_exception::section_is_empty);
 
-	return calculate_entropy(s.get_raw_data().data(), s.get_raw_data().length());
+	return calculate_entropy(data.data(), data.length());
 }
 
 //Calculates entropy for istream (from current position of stream)
@@ -29,9 +34,17 @@ double entropy_calculator::calculate_entropy(std::istream& file)
 	if(!length) //Don't calculate entropy for empty buffers
 		throw pe_exception("Data length is zero", pe_exception::data_is_empty);
 
-	//Count bytes
-	for(std::streamoff i = 0; i != length; ++i)
-		++byte_count[static_cast<unsigned char>(file.get())];
+	//Count bytes, reading stream by chunks
+	std::vector<char> buffer(static_cast<size_t>(std::min<std::streamoff>(length, stream_chunk_size)));
+	for(std::streamoff left = length; left != 0;)
+	{
+		std::streamsize chunk = static_cast<std::streamsize>(std::min<std::streamoff>(left, stream_chunk_size));
+		if(!file.read(&buffer[0], chunk))
+			throw pe_exception("Error reading stream", pe_exception::error_reading_file);
+
+		count_bytes(&buffer[0], static_cast<size_t>(chunk), byte_count);
+		left -= chunk;
+	}
 
 	file.seekg(pos);
 
@@ -46,9 +59,7 @@ double entropy_calculator::calculate_entropy(const char* data, size_t length)
 	if(!length) //Don't calculate entropy for empty buffers
 		throw pe_exception("Data length is zero", pe_exception::data_is_empty);
 
-	//Count bytes
-	for(size_t i = 0; i != length; ++i)
-		++byte_count[static_cast<unsigned char>(data[i])];
+	count_bytes(data, length, byte_count);
 
 	return calculate_entropy(byte_count, length);
 }
@@ -63,16 +74,99 @@ double entropy_calculator::calculate_entropy(const pe_base& pe)
 	//Count bytes for each section
 	for(section_list::const_iterator it = pe.get_image_sections().begin(); it != pe.get_image_sections().end(); ++it)
 	{
-		const std::string& data = (*it).get_raw_data();
-		size_t length = data.length();
-		total_data_length += length;
-		for(size_t i = 0; i != length; ++i)
-			++byte_count[static_cast<unsigned char>(data[i])];
+		std::string_view data = (*it).get_raw_view();
+		total_data_length += data.length();
+		count_bytes(data.data(), data.length(), byte_count);
 	}
 
 	return calculate_entropy(byte_count, total_data_length);
 }
 
+//Calculates entropy map for PE image section
+const entropy_map entropy_calculator::calculate_entropy_map(const section& s, size_t window_size, size_t step)
+{
+	std::string_view data = s.get_raw_view();
+	if(data.empty()) //Don't count entropy for empty sections
+		throw pe_exception("Section is empty", pe_exception::section_is_empty);
+
+	return calculate_entropy_map(data.data(), data.length(), window_size, step);
+}
+
+//Calculates entropy map for data block
+const entropy_map entropy_calculator::calculate_entropy_map(const char* data, size_t length, size_t window_size, size_t step)
+{
+	if(!length) //Don't calculate entropy for empty buffers
+		throw pe_exception("Data length is zero", pe_exception::data_is_empty);
+
+	if(!window_size)
+		throw pe_exception("Window size is zero", pe_exception::data_is_empty);
+
+	if(!step)
+		step = window_size;
+
+	entropy_map ret;
+	ret.reserve(length <= window_size ? 1 : (length - window_size + step - 1) / step + 1);
+
+	uint32_t byte_count[256] = {0};
+	size_t window_start = 0, window_end = 0;
+	while(true)
+	{
+		if(window_start >= window_end)
+		{
+			//Window doesn't overlap previous one, count it from scratch
+			std::fill(byte_count, byte_count + 256, 0);
+			window_end = window_start;
+		}
+
+		//Add bytes which enter the window
+		size_t new_end = std::min(window_start + window_size, length);
+		count_bytes(data + window_end, new_end - window_end, byte_count);
+		window_end = new_end;
+
+		ret.push_back(calculate_entropy(byte_count, window_end - window_start));
+
+		if(window_end == length)
+			break;
+
+		//Windows start at the end of data when step is larger than window_size
+		if(step >= length - window_start)
+			break;
+
+		//Remove bytes which leave the window
+		size_t new_start = window_start + step;
+		for(size_t i = window_start; i < new_start && i < window_end; ++i)
+			--byte_count[static_cast<unsigned char>(data[i])];
+
+		window_start = new_start;
+	}
+
+	return ret;
+}
+
+//Adds count of each byte of data block to byte_count
+void entropy_calculator::count_bytes(const char* data, size_t length, uint32_t byte_count[256])
+{
+	//Several interleaved tables are used, so the increments of
+	//equal neighbouring bytes don't wait for each other
+	uint32_t counts[4][256] = {{0}};
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+
+	size_t i = 0;
+	for(; i + 4 <= length; i += 4)
+	{
+		++counts[0][bytes[i]];
+		++counts[1][bytes[i + 1]];
+		++counts[2][bytes[i + 2]];
+		++counts[3][bytes[i + 3]];
+	}
+
+	for(; i != length; ++i)
+		++counts[0][bytes[i]];
+
+	for(uint32_t b = 0; b != 256; ++b)
+		byte_count[b] += counts[0][b] + counts[1][b] + counts[2][b] + counts[3][b];
+}
+
 //Calculates entropy from bytes count
 double entropy_calculator::calculate_entropy(const uint32_t byte_count[256], std::streamoff total_length)
 {
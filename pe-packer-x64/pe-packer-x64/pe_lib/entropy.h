@@ -1,9 +1,13 @@
 #pragma once
 #include <istream>
+#include <vector>
 #include "pe_base.h"
 
 namespace pe_bliss
 {
+//Entropy values of consecutive data windows
+typedef std::vector<double> entropy_map;
+
 class entropy_calculator
 {
 public:
@@ -19,11 +23,22 @@ public:
 	//Calculates entropy for this PE file (only section data)
 	static double calculate_entropy(const pe_base& pe);
 
+	//Calculates entropy map for PE image section
+	//Each value is entropy of window_size bytes, windows start every step bytes (step == 0 means step == window_size)
+	//The last window may be shorter than window_size
+	static const entropy_map calculate_entropy_map(const section& s, size_t window_size = 0x1000, size_t step = 0);
+
+	//Calculates entropy map for data block (see above)
+	static const entropy_map calculate_entropy_map(const char* data, size_t length, size_t window_size = 0x1000, size_t step = 0);
+
 private:
 	entropy_calculator();
 	entropy_calculator(const entropy_calculator&);
 	entropy_calculator& operator=(const entropy_calculator&);
 
+	//Adds count of each byte of data block to byte_count
+	static void count_bytes(const char* data, size_t length, uint32_t byte_count[256]);
+
 	//Calculates entropy from bytes count
 	static double calculate_entropy(const uint32_t byte_count[256], std::streamoff total_length);
 };
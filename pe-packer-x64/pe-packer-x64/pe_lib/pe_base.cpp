@@ -14,24 +14,41 @@ namespace pe_bliss
 using namespace pe_win;
 
 //Constructor
-pe_base::pe_base(std::istream& file, const pe_properties& props, bool read_debug_raw_data)
+pe_base::pe_base(std::istream& file, const pe_properties& props, bool read_debug_raw_data, section_buffer_pool* section_pool)
 {
 	props_ = props.duplicate().release();
 
+	pe_error error;
+	if(!load(file, read_debug_raw_data, error, section_pool))
+		error.raise();
+}
+
+//Non-throwing constructor
+pe_base::pe_base(std::istream& file, const pe_properties& props, bool read_debug_raw_data, pe_error& error, section_buffer_pool* section_pool)
+{
+	props_ = props.duplicate().release();
+	load(file, read_debug_raw_data, error, section_pool);
+}
+
+//Reads DOS header, PE headers and section data, restores istream state
+bool pe_base::load(std::istream& file, bool read_debug_raw_data, pe_error& error, section_buffer_pool* section_pool)
+{
 	//Save istream state
 	std::ios_base::iostate state = file.exceptions();
 	std::streamoff old_offset = file.tellg();
 
+	//Raw debug data is read by read_pe() if requested
+	debug_raw_data_deferred_ = !read_debug_raw_data;
+
+	bool result;
 	try
 	{
 		file.exceptions(std::ios::goodbit);
-		//Read DOS header, PE headers and section data
-		read_dos_header(file);
-		read_pe(file, read_debug_raw_data);
+		result = try_read_dos_header(file, dos_header_, error) && read_pe(file, read_debug_raw_data, error, section_pool);
 	}
 	catch(const std::exception&)
 	{
-		//If something went wrong, restore istream state
+		//If something went wrong (allocation), restore istream state
 		file.seekg(old_offset);
 		file.exceptions(state);
 		file.clear();
@@ -43,6 +60,7 @@ pe_base::pe_base(std::istream& file, const pe_properties& props, bool read_debug
 	file.seekg(old_offset);
 	file.exceptions(state);
 	file.clear();
+	return result;
 }
 
 pe_base::pe_base(const pe_properties& props, uint32_t section_alignment, bool dll, uint16_t subsystem)
@@ -51,6 +69,7 @@ pe_base::pe_base(const pe_properties& props, uint32_t section_alignment, bool dl
 	props_->create_pe(section_alignment, subsystem);
 
 	has_overlay_ = false;
+	debug_raw_data_deferred_ = false;
 	memset(&dos_header_, 0, sizeof(dos_header_));
 
 	dos_header_.e_magic = 0x5A4D; //"MZ"
@@ -81,6 +100,7 @@ pe_base::pe_base(const pe_base& pe)
 	has_overlay_(pe.has_overlay_),
 	full_headers_data_(pe.full_headers_data_),
 	debug_data_(pe.debug_data_),
+	debug_raw_data_deferred_(pe.debug_raw_data_deferred_),
 	props_(0)
 {
 	props_ = pe.props_->duplicate().release();
@@ -94,6 +114,7 @@ pe_base& pe_base::operator=(const pe_base& pe)
 	has_overlay_ = pe.has_overlay_;
 	full_headers_data_ = pe.full_headers_data_;
 	debug_data_ = pe.debug_data_;
+	debug_raw_data_deferred_ = pe.debug_raw_data_deferred_;
 	delete props_;
 	props_ = 0;
 	props_ = pe.props_->duplicate().release();
@@ -198,12 +219,13 @@ void pe_base::realign_section(uint32_t index)
 	//Get section iterator
 	section_list::iterator it = sections_.begin() + index;
 	section& s = *it;
+	section_buffer& raw_data = s.get_raw_buffer();
 
 	//Calculate, how many null bytes we have in the end of raw section data
 	std::size_t strip = 0;
-	for(std::size_t i = (*it).get_raw_data().length(); i >= 1; --i)
+	for(std::size_t i = raw_data.length(); i >= 1; --i)
 	{
-		if(s.get_raw_data()[i - 1] == 0)
+		if(raw_data[i - 1] == 0)
 			strip++;
 		else
 			break;
@@ -212,15 +234,15 @@ void pe_base::realign_section(uint32_t index)
 	if(it == sections_.end() - 1) //If we're realigning the last section
 	{
 		//We can strip ending null bytes
-		s.set_size_of_raw_data(static_cast<uint32_t>(s.get_raw_data().length() - strip));
-		s.get_raw_data().resize(s.get_raw_data().length() - strip, 0);
+		s.set_size_of_raw_data(static_cast<uint32_t>(raw_data.length() - strip));
+		raw_data.resize(raw_data.length() - strip, 0);
 	}
 	else
 	{
 		//Else just set size of raw data
 		uint32_t raw_size_aligned = s.get_aligned_raw_size(get_file_alignment());
 		s.set_size_of_raw_data(raw_size_aligned);
-		s.get_raw_data().resize(raw_size_aligned, 0);
+		raw_data.resize(raw_size_aligned, 0);
 	}
 }
 
@@ -292,20 +314,31 @@ void pe_base::set_characteristics(uint16_t ch)
 //Returns section from RVA
 section& pe_base::section_from_rva(uint32_t rva)
 {
-	//Search for section
-	for(section_list::iterator i = sections_.begin(); i != sections_.end(); ++i)
-	{
-		section& s = *i;
-		//Return section if found
-		if(rva >= s.get_virtual_address() && rva < s.get_virtual_address() + s.get_aligned_virtual_size(get_section_alignment()))
-			return s;
-	}
+	section* s = find_section_from_rva(rva);
+	if(!s)
+		throw pe_exception("No section found by presented address", pe_exception::no_section_found);
 
-	throw pe_exception("No section found by presented address", pe_exception::no_section_found);
+	return *s;
 }
 
 //Returns section from RVA
 const section& pe_base::section_from_rva(uint32_t rva) const
+{
+	const section* s = find_section_from_rva(rva);
+	if(!s)
+		throw pe_exception("No section found by presented address", pe_exception::no_section_found);
+
+	return *s;
+}
+
+//Returns section from RVA or null
+section* pe_base::find_section_from_rva(uint32_t rva)
+{
+	return const_cast<section*>(static_cast<const pe_base&>(*this).find_section_from_rva(rva));
+}
+
+//Returns section from RVA or null
+const section* pe_base::find_section_from_rva(uint32_t rva) const
 {
 	//Search for section
 	for(section_list::const_iterator i = sections_.begin(); i != sections_.end(); ++i)
@@ -313,10 +346,10 @@ const section& pe_base::section_from_rva(uint32_t rva) const
 		const section& s = *i;
 		//Return section if found
 		if(rva >= s.get_virtual_address() && rva < s.get_virtual_address() + s.get_aligned_virtual_size(get_section_alignment()))
-			return s;
+			return &s;
 	}
 
-	throw pe_exception("No section found by presented address", pe_exception::no_section_found);
+	return 0;
 }
 
 //Returns section from directory ID
@@ -373,7 +406,7 @@ bool pe_base::expand_section(section& s, uint32_t needed_rva, uint32_t needed_si
 	if(expand == expand_section_raw && section_data_length_from_rva(s, needed_rva, section_data_raw) < needed_size)
 	{
 		//Expand section raw data
-		s.get_raw_data().resize(needed_rva - s.get_virtual_address() + needed_size);
+		s.get_raw_buffer().resize(needed_rva - s.get_virtual_address() + needed_size);
 		recalculate_section_sizes(s, false);
 		return true;
 	}
@@ -437,7 +470,7 @@ void pe_base::set_machine(uint16_t machine)
 void pe_base::prepare_section(section& s)
 {
 	//Calculate its size of raw data
-	s.set_size_of_raw_data(static_cast<uint32_t>(pe_utils::align_up(s.get_raw_data().length(), get_file_alignment())));
+	s.set_size_of_raw_data(static_cast<uint32_t>(pe_utils::align_up(s.get_raw_buffer().length(), get_file_alignment())));
 
 	//Check section virtual and raw size
 	if(!s.get_size_of_raw_data() && !s.get_virtual_size())
@@ -467,24 +500,17 @@ section& pe_base::add_section(section s)
 	prepare_section(s);
 
 	//Calculate section virtual address
+	s.set_virtual_address(get_next_section_rva(s.get_virtual_address()));
+
 	if(!sections_.empty())
 	{
-		s.set_virtual_address(pe_utils::align_up(sections_.back().get_virtual_address() + sections_.back().get_aligned_virtual_size(get_section_alignment()), get_section_alignment()));
-
 		//We should align last section raw size, if it wasn't aligned
 		section& last = sections_.back();
-		last.set_size_of_raw_data(static_cast<uint32_t>(pe_utils::align_up(last.get_raw_data().length(), get_file_alignment())));
-	}
-	else
-	{
-		s.set_virtual_address(
-			s.get_virtual_address() == 0
-			? pe_utils::align_up(get_size_of_headers(), get_section_alignment())
-			: pe_utils::align_up(s.get_virtual_address(), get_section_alignment()));
+		last.set_size_of_raw_data(static_cast<uint32_t>(pe_utils::align_up(last.get_raw_view().length(), get_file_alignment())));
 	}
 
 	//Add section to the end of section list
-	sections_.push_back(s);
+	sections_.push_back(std::move(s));
 	//Set number of sections in PE header
 	set_number_of_sections(static_cast<uint16_t>(sections_.size()));
 	//Recalculate virtual size of image
@@ -493,6 +519,17 @@ section& pe_base::add_section(section s)
 	return sections_.back();
 }
 
+//Returns virtual address, which section added by add_section will get
+uint32_t pe_base::get_next_section_rva(uint32_t section_rva) const
+{
+	if(!sections_.empty())
+		return pe_utils::align_up(sections_.back().get_virtual_address() + sections_.back().get_aligned_virtual_size(get_section_alignment()), get_section_alignment());
+
+	return section_rva == 0
+		? pe_utils::align_up(get_size_of_headers(), get_section_alignment())
+		: pe_utils::align_up(section_rva, get_section_alignment());
+}
+
 //Returns true if sectios "s" is already attached to this PE file
 bool pe_base::section_attached(const section& s) const
 {
@@ -621,10 +658,11 @@ char* pe_base::section_data_from_rva(section& s, uint32_t rva)
 	//Check if RVA is inside section "s"
 	if(rva >= s.get_virtual_address() && rva < s.get_virtual_address() + s.get_aligned_virtual_size(get_section_alignment()))
 	{
-		if(s.get_raw_data().empty())
+		char* data = s.get_raw_data_ptr();
+		if(!data)
 			throw pe_exception("Section raw data is empty and cannot be changed", pe_exception::section_is_empty);
 
-		return &s.get_raw_data()[rva - s.get_virtual_address()];
+		return data + rva - s.get_virtual_address();
 	}
 
 	throw pe_exception("RVA not found inside section", pe_exception::rva_not_exists);
@@ -635,7 +673,7 @@ const char* pe_base::section_data_from_rva(const section& s, uint32_t rva, secti
 {
 	//Check if RVA is inside section "s"
 	if(rva >= s.get_virtual_address() && rva < s.get_virtual_address() + s.get_aligned_virtual_size(get_section_alignment()))
-		return (datatype == section_data_raw ? s.get_raw_data().data() : s.get_virtual_data(get_section_alignment()).c_str()) + rva - s.get_virtual_address();
+		return (datatype == section_data_raw ? s.get_raw_view() : s.get_virtual_view(get_section_alignment())).data() + rva - s.get_virtual_address();
 
 	throw pe_exception("RVA not found inside section", pe_exception::rva_not_exists);
 }
@@ -648,7 +686,7 @@ uint32_t pe_base::section_data_length_from_rva(uint32_t rva, section_data_type d
 		return static_cast<unsigned long>(full_headers_data_.length());
 
 	const section& s = section_from_rva(rva);
-	return static_cast<unsigned long>(datatype == section_data_raw ? s.get_raw_data().length() /* instead of SizeOfRawData */ : s.get_aligned_virtual_size(get_section_alignment()));
+	return static_cast<unsigned long>(datatype == section_data_raw ? s.get_raw_view().length() /* instead of SizeOfRawData */ : s.get_aligned_virtual_size(get_section_alignment()));
 }
 
 //Returns section TOTAL RAW/VIRTUAL data length from VA inside section for PE32
@@ -665,23 +703,38 @@ uint32_t pe_base::section_data_length_from_va(uint64_t va, section_data_type dat
 
 //Returns section remaining RAW/VIRTUAL data length from RVA "rva_inside" to the end of section containing RVA "rva"
 uint32_t pe_base::section_data_length_from_rva(uint32_t rva, uint32_t rva_inside, section_data_type datatype, bool include_headers) const
+{
+	uint32_t length;
+	pe_error error;
+	if(!try_section_data_length_from_rva(rva, rva_inside, length, error, datatype, include_headers))
+		error.raise();
+
+	return length;
+}
+
+//Non-throwing version of section_data_length_from_rva
+bool pe_base::try_section_data_length_from_rva(uint32_t rva, uint32_t rva_inside, uint32_t& length, pe_error& error, section_data_type datatype, bool include_headers) const
 {
 	//if RVAs are inside of headers and we're searching them too...
 	if(include_headers && rva < full_headers_data_.length() && rva_inside < full_headers_data_.length())
-		return static_cast<unsigned long>(full_headers_data_.length() - rva_inside);
+	{
+		length = static_cast<uint32_t>(full_headers_data_.length() - rva_inside);
+		return true;
+	}
 
-	const section& s = section_from_rva(rva);
-	if(rva_inside < s.get_virtual_address())
-		throw pe_exception("RVA not found inside section", pe_exception::rva_not_exists);
+	const section* s = find_section_from_rva(rva);
+	if(!s)
+		return error.set("No section found by presented address", pe_exception::no_section_found);
 
-	//Calculate remaining length of section data from "rva" address
-	long length = static_cast<long>(datatype == section_data_raw ? s.get_raw_data().length() /* instead of SizeOfRawData */ : s.get_aligned_virtual_size(get_section_alignment()))
-		+ s.get_virtual_address() - rva_inside;
+	if(rva_inside < s->get_virtual_address())
+		return error.set("RVA not found inside section", pe_exception::rva_not_exists);
 
-	if(length < 0)
-		return 0;
+	//Calculate remaining length of section data from "rva" address
+	long remaining = static_cast<long>(datatype == section_data_raw ? s->get_raw_view().length() /* instead of SizeOfRawData */ : s->get_aligned_virtual_size(get_section_alignment()))
+		+ s->get_virtual_address() - rva_inside;
 
-	return static_cast<unsigned long>(length);
+	length = remaining < 0 ? 0 : static_cast<uint32_t>(remaining);
+	return true;
 }
 
 //Returns section remaining RAW/VIRTUAL data length from VA "va_inside" to the end of section containing VA "va" for PE32
@@ -703,7 +756,7 @@ uint32_t pe_base::section_data_length_from_rva(const section& s, uint32_t rva_in
 	if(rva_inside >= s.get_virtual_address() && rva_inside < s.get_virtual_address() + s.get_aligned_virtual_size(get_section_alignment()))
 	{
 		//Calculate remaining length of section data from "rva" address
-		int32_t length = static_cast<int32_t>(datatype == section_data_raw ? s.get_raw_data().length() /* instead of SizeOfRawData */ : s.get_aligned_virtual_size(get_section_alignment()))
+		int32_t length = static_cast<int32_t>(datatype == section_data_raw ? s.get_raw_view().length() /* instead of SizeOfRawData */ : s.get_aligned_virtual_size(get_section_alignment()))
 			+ s.get_virtual_address() - rva_inside;
 
 		if(length < 0)
@@ -736,69 +789,91 @@ char* pe_base::section_data_from_rva(uint32_t rva, bool include_headers)
 
 	section& s = section_from_rva(rva);
 
-	if(s.get_raw_data().empty())
+	char* data = s.get_raw_data_ptr();
+	if(!data)
 		throw pe_exception("Section raw data is empty and cannot be changed", pe_exception::section_is_empty);
 
-	return &s.get_raw_data()[rva - s.get_virtual_address()];
+	return data + rva - s.get_virtual_address();
 }
 
 //Returns corresponding section data pointer from RVA inside section
 const char* pe_base::section_data_from_rva(uint32_t rva, section_data_type datatype, bool include_headers) const
+{
+	pe_error error;
+	const char* data = try_section_data_from_rva(rva, error, datatype, include_headers);
+	if(!data)
+		error.raise();
+
+	return data;
+}
+
+//Non-throwing version of section_data_from_rva
+const char* pe_base::try_section_data_from_rva(uint32_t rva, pe_error& error, section_data_type datatype, bool include_headers) const
 {
 	//if RVA is inside of headers and we're searching them too...
 	if(include_headers && rva < full_headers_data_.length())
 		return &full_headers_data_[rva];
 
-	const section& s = section_from_rva(rva);
-	return (datatype == section_data_raw ? s.get_raw_data().data() : s.get_virtual_data(get_section_alignment()).c_str()) + rva - s.get_virtual_address();
+	const section* s = find_section_from_rva(rva);
+	if(!s)
+	{
+		error.set("No section found by presented address", pe_exception::no_section_found);
+		return 0;
+	}
+
+	return (datatype == section_data_raw ? s->get_raw_view() : s->get_virtual_view(get_section_alignment())).data() + rva - s->get_virtual_address();
 }
 
 //Reads DOS headers from istream
 void pe_base::read_dos_header(std::istream& file, image_dos_header& header)
+{
+	pe_error error;
+	if(!try_read_dos_header(file, header, error))
+		error.raise();
+}
+
+//Non-throwing version of read_dos_header
+bool pe_base::try_read_dos_header(std::istream& file, image_dos_header& header, pe_error& error)
 {
 	//Check istream flags
 	if(file.bad() || file.eof())
-		throw pe_exception("PE file stream is bad or closed.", pe_exception::bad_pe_file);
+		return error.set("PE file stream is bad or closed.", pe_exception::bad_pe_file);
 
 	//Read DOS header and check istream
 	file.read(reinterpret_cast<char*>(&header), sizeof(image_dos_header));
 	if(file.bad() || file.eof())
-		throw pe_exception("Unable to read IMAGE_DOS_HEADER", pe_exception::bad_dos_header);
+		return error.set("Unable to read IMAGE_DOS_HEADER", pe_exception::bad_dos_header);
 
 	//Check DOS header magic
 	if(header.e_magic != 0x5a4d) //"MZ"
-		throw pe_exception("IMAGE_DOS_HEADER signature is incorrect", pe_exception::bad_dos_header);
-}
+		return error.set("IMAGE_DOS_HEADER signature is incorrect", pe_exception::bad_dos_header);
 
-//Reads DOS headers from istream
-void pe_base::read_dos_header(std::istream& file)
-{
-	read_dos_header(file, dos_header_);
+	return true;
 }
 
 //Reads PE image from istream
-void pe_base::read_pe(std::istream& file, bool read_debug_raw_data)
+bool pe_base::read_pe(std::istream& file, bool read_debug_raw_data, pe_error& error, section_buffer_pool* section_pool)
 {
 	//Get istream size
 	std::streamoff filesize = pe_utils::get_file_size(file);
 
 	//Check if PE header is DWORD-aligned
 	if((dos_header_.e_lfanew % sizeof(uint32_t)) != 0)
-		throw pe_exception("PE header is not DWORD-aligned", pe_exception::bad_dos_header);
+		return error.set("PE header is not DWORD-aligned", pe_exception::bad_dos_header);
 
 	//Seek to NT headers
 	file.seekg(dos_header_.e_lfanew);
 	if(file.bad() || file.fail())
-		throw pe_exception("Cannot reach IMAGE_NT_HEADERS", pe_exception::image_nt_headers_not_found);
+		return error.set("Cannot reach IMAGE_NT_HEADERS", pe_exception::image_nt_headers_not_found);
 
 	//Read NT headers
 	file.read(get_nt_headers_ptr(), get_sizeof_nt_header() - sizeof(image_data_directory) * image_numberof_directory_entries);
 	if(file.bad() || file.eof())
-		throw pe_exception("Error reading IMAGE_NT_HEADERS", pe_exception::error_reading_image_nt_headers);
+		return error.set("Error reading IMAGE_NT_HEADERS", pe_exception::error_reading_image_nt_headers);
 
 	//Check PE signature
 	if(get_pe_signature() != 0x4550) //"PE"
-		throw pe_exception("Incorrect PE signature", pe_exception::pe_signature_incorrect);
+		return error.set("Incorrect PE signature", pe_exception::pe_signature_incorrect);
 
 	//Check number of directories
 	if(get_number_of_rvas_and_sizes() > image_numberof_directory_entries)
@@ -809,32 +884,32 @@ void pe_base::read_pe(std::istream& file, bool read_debug_raw_data)
 		//Read data directory headers, if any
 		file.read(get_nt_headers_ptr() + (get_sizeof_nt_header() - sizeof(image_data_directory) * image_numberof_directory_entries), sizeof(image_data_directory) * get_number_of_rvas_and_sizes());
 		if(file.bad() || file.eof())
-			throw pe_exception("Error reading DATA_DIRECTORY headers", pe_exception::error_reading_data_directories);
+			return error.set("Error reading DATA_DIRECTORY headers", pe_exception::error_reading_data_directories);
 	}
 
 	//Check section number
 	//Images with zero section number accepted
 	if(get_number_of_sections() > maximum_number_of_sections)
-		throw pe_exception("Incorrect number of sections", pe_exception::section_number_incorrect);
+		return error.set("Incorrect number of sections", pe_exception::section_number_incorrect);
 
 	//Check PE magic
 	if(get_magic() != get_needed_magic())
-		throw pe_exception("Incorrect PE signature", pe_exception::pe_signature_incorrect);
+		return error.set("Incorrect PE signature", pe_exception::pe_signature_incorrect);
 
 	//Check section alignment
 	if(!pe_utils::is_power_of_2(get_section_alignment()))
-		throw pe_exception("Incorrect section alignment", pe_exception::incorrect_section_alignment);
+		return error.set("Incorrect section alignment", pe_exception::incorrect_section_alignment);
 
 	//Check file alignment
 	if(!pe_utils::is_power_of_2(get_file_alignment()))
-		throw pe_exception("Incorrect file alignment", pe_exception::incorrect_file_alignment);
+		return error.set("Incorrect file alignment", pe_exception::incorrect_file_alignment);
 
 	if(get_file_alignment() != get_section_alignment() && (get_file_alignment() < minimum_file_alignment || get_file_alignment() > get_section_alignment()))
-		throw pe_exception("Incorrect file alignment", pe_exception::incorrect_file_alignment);
+		return error.set("Incorrect file alignment", pe_exception::incorrect_file_alignment);
 
 	//Check size of image
 	if(pe_utils::align_up(get_size_of_image(), get_section_alignment()) == 0)
-		throw pe_exception("Incorrect size of image", pe_exception::incorrect_size_of_image);
+		return error.set("Incorrect size of image", pe_exception::incorrect_size_of_image);
 	
 	//Read rich data overlay / DOS stub (if any)
 	if(static_cast<uint32_t>(dos_header_.e_lfanew) > sizeof(image_dos_header))
@@ -843,7 +918,7 @@ void pe_base::read_pe(std::istream& file, bool read_debug_raw_data)
 		file.seekg(sizeof(image_dos_header));
 		file.read(&rich_overlay_[0], dos_header_.e_lfanew - sizeof(image_dos_header));
 		if(file.bad() || file.eof())
-			throw pe_exception("Error reading 'Rich' & 'DOS stub' overlay", pe_exception::error_reading_overlay);
+			return error.set("Error reading 'Rich' & 'DOS stub' overlay", pe_exception::error_reading_overlay);
 	}
 
 	//Calculate first section raw position
@@ -855,31 +930,32 @@ void pe_base::read_pe(std::istream& file, bool read_debug_raw_data)
 		//Go to first section
 		file.seekg(first_section);
 		if(file.bad() || file.fail())
-			throw pe_exception("Cannot reach section headers", pe_exception::image_section_headers_not_found);
+			return error.set("Cannot reach section headers", pe_exception::image_section_headers_not_found);
 	}
 
 	uint32_t last_raw_size = 0;
 
 	//Read all sections
+	sections_.reserve(get_number_of_sections());
 	for(int i = 0; i < get_number_of_sections(); i++)
 	{
-		section s;
+		section s(section_pool);
 		//Read section header
 		file.read(reinterpret_cast<char*>(&s.get_raw_header()), sizeof(image_section_header));
 		if(file.bad() || file.eof())
-			throw pe_exception("Error reading section header", pe_exception::error_reading_section_header);
+			return error.set("Error reading section header", pe_exception::error_reading_section_header);
 
 		//Save next section header position
 		std::streamoff next_sect = file.tellg();
 
 		//Check section virtual and raw sizes
 		if(!s.get_size_of_raw_data() && !s.get_virtual_size())
-			throw pe_exception("Virtual and Physical sizes of section can't be 0 at the same time", pe_exception::zero_section_sizes);
+			return error.set("Virtual and Physical sizes of section can't be 0 at the same time", pe_exception::zero_section_sizes);
 
 		//Check for adequate values of section fields
 		if(!pe_utils::is_sum_safe(s.get_virtual_address(), s.get_virtual_size()) || s.get_virtual_size() > pe_utils::two_gb
 			|| !pe_utils::is_sum_safe(s.get_pointer_to_raw_data(), s.get_size_of_raw_data()) || s.get_size_of_raw_data() > pe_utils::two_gb)
-			throw pe_exception("Incorrect section address or size", pe_exception::section_incorrect_addr_or_size);
+			return error.set("Incorrect section address or size", pe_exception::section_incorrect_addr_or_size);
 
 		if(s.get_size_of_raw_data() != 0)
 		{
@@ -894,26 +970,30 @@ void pe_base::read_pe(std::istream& file, bool read_debug_raw_data)
 			if(s.get_virtual_address() + pe_utils::align_up(s.get_virtual_size(), get_section_alignment()) > pe_utils::align_up(get_size_of_image(), get_section_alignment())
 				||
 				pe_utils::align_down(s.get_pointer_to_raw_data(), get_file_alignment()) + s.get_size_of_raw_data() > static_cast<uint32_t>(filesize))
-				throw pe_exception("Incorrect section address or size", pe_exception::section_incorrect_addr_or_size);
+				return error.set("Incorrect section address or size", pe_exception::section_incorrect_addr_or_size);
 
 			//Seek to section raw data
 			file.seekg(pe_utils::align_down(s.get_pointer_to_raw_data(), get_file_alignment()));
 			if(file.bad() || file.fail())
-				throw pe_exception("Cannot reach section data", pe_exception::image_section_data_not_found);
+				return error.set("Cannot reach section data", pe_exception::image_section_data_not_found);
 
 			//Read section raw data
-			s.get_raw_data().resize(s.get_size_of_raw_data());
-			file.read(&s.get_raw_data()[0], s.get_size_of_raw_data());
+			//Buffer is not zero-filled, it's overwritten by file data
+			section_buffer& raw_data = s.get_raw_buffer();
+			raw_data.resize_uninitialized(s.get_size_of_raw_data());
+			file.read(raw_data.data(), s.get_size_of_raw_data());
 			if(file.bad() || file.fail())
-				throw pe_exception("Error reading section data", pe_exception::image_section_data_not_found);
+				return error.set("Error reading section data", pe_exception::image_section_data_not_found);
+
+			s.set_source_offset(pe_utils::align_down(s.get_pointer_to_raw_data(), get_file_alignment()));
 		}
 
 		//Check virtual address and size of section
 		if(s.get_virtual_address() + s.get_aligned_virtual_size(get_section_alignment()) > pe_utils::align_up(get_size_of_image(), get_section_alignment()))
-			throw pe_exception("Incorrect section address or size", pe_exception::section_incorrect_addr_or_size);
+			return error.set("Incorrect section address or size", pe_exception::section_incorrect_addr_or_size);
 
 		//Save section
-		sections_.push_back(s);
+		sections_.push_back(std::move(s));
 
 		//Seek to the next section header
 		file.seekg(next_sect);
@@ -921,7 +1001,7 @@ void pe_base::read_pe(std::istream& file, bool read_debug_raw_data)
 
 	//Check size of headers: SizeOfHeaders can't be larger than first section VA
 	if(!sections_.empty() && get_size_of_headers() > sections_.front().get_virtual_address())
-		throw pe_exception("Incorrect size of headers", pe_exception::incorrect_size_of_headers);
+		return error.set("Incorrect size of headers", pe_exception::incorrect_size_of_headers);
 
 	//If image has more than two sections
 	if(sections_.size() >= 2)
@@ -930,7 +1010,7 @@ void pe_base::read_pe(std::istream& file, bool read_debug_raw_data)
 		for(section_list::const_iterator i = sections_.begin() + 1; i != sections_.end(); ++i)
 		{
 			if((*i).get_virtual_address() != (*(i - 1)).get_virtual_address() + (*(i - 1)).get_aligned_virtual_size(get_section_alignment()))
-				throw pe_exception("Section table is incorrect", pe_exception::image_section_table_incorrect);
+				return error.set("Section table is incorrect", pe_exception::image_section_table_incorrect);
 		}
 	}
 
@@ -957,61 +1037,14 @@ void pe_base::read_pe(std::istream& file, bool read_debug_raw_data)
 		full_headers_data_.resize(size_of_headers);
 		file.read(&full_headers_data_[0], size_of_headers);
 		if(file.bad() || file.eof())
-			throw pe_exception("Error reading file", pe_exception::error_reading_file);
+			return error.set("Error reading file", pe_exception::error_reading_file);
 	}
 
 	//Moreover, if there's debug directory, read its raw data for some debug info types
-	while(read_debug_raw_data && has_debug())
-	{
-		try
-		{
-			//Check the length in bytes of the section containing debug directory
-			if(section_data_length_from_rva(get_directory_rva(image_directory_entry_debug), get_directory_rva(image_directory_entry_debug), section_data_virtual, true) < sizeof(image_debug_directory))
-				break;
-
-			unsigned long current_pos = get_directory_rva(image_directory_entry_debug);
-
-			//First IMAGE_DEBUG_DIRECTORY table
-			image_debug_directory directory = section_data_from_rva<image_debug_directory>(current_pos, section_data_virtual, true);
-
-			//Iterate over all IMAGE_DEBUG_DIRECTORY directories
-			while(directory.PointerToRawData
-				&& current_pos < get_directory_rva(image_directory_entry_debug) + get_directory_size(image_directory_entry_debug))
-			{
-				//If we have something to read
-				if((directory.Type == image_debug_type_codeview
-					|| directory.Type == image_debug_type_misc
-					|| directory.Type == image_debug_type_coff)
-					&& directory.SizeOfData)
-				{
-					std::string data;
-					data.resize(directory.SizeOfData);
-					file.seekg(directory.PointerToRawData);
-					file.read(&data[0], directory.SizeOfData);
-					if(file.bad() || file.eof())
-						throw pe_exception("Error reading file", pe_exception::error_reading_file);
-
-					debug_data_.insert(std::make_pair(directory.PointerToRawData, data));
-				}
-
-				//Go to next debug entry
-				current_pos += sizeof(image_debug_directory);
-				directory = section_data_from_rva<image_debug_directory>(current_pos, section_data_virtual, true);
-			}
+	if(read_debug_raw_data)
+		load_debug_raw_data(file);
 
-			break;
-		}
-		catch(const pe_exception&)
-		{
-			//Don't throw any exception here, if debug info is corrupted or incorrect
-			break;
-		}
-		catch(const std::bad_alloc&)
-		{
-			//Don't throw any exception here, if debug info is corrupted or incorrect
-			break;
-		}
-	}
+	return true;
 }
 
 //Returns PE type of this image
@@ -1022,54 +1055,64 @@ pe_type pe_base::get_pe_type() const
 
 //Returns PE type (PE or PE+) from pe_type enumeration (minimal correctness checks)
 pe_type pe_base::get_pe_type(std::istream& file)
+{
+	pe_type type;
+	pe_error error;
+	if(!try_get_pe_type(file, type, error))
+		error.raise();
+
+	return type;
+}
+
+//Non-throwing version of get_pe_type
+bool pe_base::try_get_pe_type(std::istream& file, pe_type& type, pe_error& error)
 {
 	//Save state of the istream
 	std::ios_base::iostate state = file.exceptions();
 	std::streamoff old_offset = file.tellg();
+
+	file.exceptions(std::ios::goodbit);
+	bool result = read_pe_type(file, type, error);
+
+	//Restore stream state
+	file.exceptions(state);
+	file.seekg(old_offset);
+	file.clear();
+
+	return result;
+}
+
+//Reads PE type from istream without saving its state
+bool pe_base::read_pe_type(std::istream& file, pe_type& type, pe_error& error)
+{
 	image_nt_headers32 nt_headers;
 	image_dos_header header;
 
-	try
-	{
-		//Read dos header
-		file.exceptions(std::ios::goodbit);
-		read_dos_header(file, header);
-
-		//Seek to the NT headers start
-		file.seekg(header.e_lfanew);
-		if(file.bad() || file.fail())
-			throw pe_exception("Cannot reach IMAGE_NT_HEADERS", pe_exception::image_nt_headers_not_found);
+	//Read dos header
+	if(!try_read_dos_header(file, header, error))
+		return false;
 
-		//Read NT headers (we're using 32-bit version, because there's no significant differencies between 32 and 64 bit version structures)
-		file.read(reinterpret_cast<char*>(&nt_headers), sizeof(image_nt_headers32) - sizeof(image_data_directory) * image_numberof_directory_entries);
-		if(file.bad() || file.eof())
-			throw pe_exception("Error reading IMAGE_NT_HEADERS", pe_exception::error_reading_image_nt_headers);
+	//Seek to the NT headers start
+	file.seekg(header.e_lfanew);
+	if(file.bad() || file.fail())
+		return error.set("Cannot reach IMAGE_NT_HEADERS", pe_exception::image_nt_headers_not_found);
 
-		//Check NT headers signature
-		if(nt_headers.Signature != 0x4550) //"PE"
-			throw pe_exception("Incorrect PE signature", pe_exception::pe_signature_incorrect);
+	//Read NT headers (we're using 32-bit version, because there's no significant differencies between 32 and 64 bit version structures)
+	file.read(reinterpret_cast<char*>(&nt_headers), sizeof(image_nt_headers32) - sizeof(image_data_directory) * image_numberof_directory_entries);
+	if(file.bad() || file.eof())
+		return error.set("Error reading IMAGE_NT_HEADERS", pe_exception::error_reading_image_nt_headers);
 
-		//Check NT headers magic
-		if(nt_headers.OptionalHeader.Magic != image_nt_optional_hdr32_magic && nt_headers.OptionalHeader.Magic != image_nt_optional_hdr64_magic)
-			throw pe_exception("Incorrect PE signature", pe_exception::pe_signature_incorrect);
-	}
-	catch(const std::exception&)
-	{
-		//If something went wrong, restore istream state
-		file.exceptions(state);
-		file.seekg(old_offset);
-		file.clear();
-		//Retrhow exception
-		throw;
-	}
+	//Check NT headers signature
+	if(nt_headers.Signature != 0x4550) //"PE"
+		return error.set("Incorrect PE signature", pe_exception::pe_signature_incorrect);
 
-	//Restore stream state
-	file.exceptions(state);
-	file.seekg(old_offset);
-	file.clear();
+	//Check NT headers magic
+	if(nt_headers.OptionalHeader.Magic != image_nt_optional_hdr32_magic && nt_headers.OptionalHeader.Magic != image_nt_optional_hdr64_magic)
+		return error.set("Incorrect PE signature", pe_exception::pe_signature_incorrect);
 
-	//Determine PE type and return it
-	return nt_headers.OptionalHeader.Magic == image_nt_optional_hdr64_magic ? pe_type_64 : pe_type_32;
+	//Determine PE type
+	type = nt_headers.OptionalHeader.Magic == image_nt_optional_hdr64_magic ? pe_type_64 : pe_type_32;
+	return true;
 }
 
 //Returns true if image has overlay data at the end of file
@@ -1552,10 +1595,10 @@ void pe_base::recalculate_section_sizes(section& s, bool auto_strip)
 	if(auto_strip && !(sections_.empty() || &s == &*(sections_.end() - 1)))
 	{
 		//Strip ending raw data nullbytes to optimize size
-		std::string& raw_data = s.get_raw_data();
+		section_buffer& raw_data = s.get_raw_buffer();
 		if(!raw_data.empty())
 		{
-			std::string::size_type i = raw_data.length();
+			std::size_t i = raw_data.length();
 			for(; i != 1; --i)
 			{
 				if(raw_data[i - 1] != 0)
@@ -1585,6 +1628,73 @@ const pe_base::debug_data_list& pe_base::get_raw_debug_data_list() const
 	return debug_data_;
 }
 
+//Returns true if raw debug data was not read with image and was not loaded later
+bool pe_base::is_debug_raw_data_deferred() const
+{
+	return debug_raw_data_deferred_;
+}
+
+//Reads raw debug data which was not read yet
+void pe_base::load_debug_raw_data(std::istream& file)
+{
+	//Data which can't be read now is treated as missing, as when reading image
+	debug_raw_data_deferred_ = false;
+
+	if(!has_debug())
+		return;
+
+	//Incorrect debug directory is not an error here, reading just stops
+	pe_error error;
+
+	//Check the length in bytes of the section containing debug directory
+	uint32_t length;
+	if(!try_section_data_length_from_rva(get_directory_rva(image_directory_entry_debug), get_directory_rva(image_directory_entry_debug), length, error, section_data_virtual, true)
+		|| length < sizeof(image_debug_directory))
+		return;
+
+	unsigned long current_pos = get_directory_rva(image_directory_entry_debug);
+
+	//First IMAGE_DEBUG_DIRECTORY table
+	image_debug_directory directory = image_debug_directory();
+	if(!try_section_data_from_rva(current_pos, directory, error, section_data_virtual, true))
+		return;
+
+	try
+	{
+		//Iterate over all IMAGE_DEBUG_DIRECTORY directories
+		while(directory.PointerToRawData
+			&& current_pos < get_directory_rva(image_directory_entry_debug) + get_directory_size(image_directory_entry_debug))
+		{
+			//If we have something to read and it was not read yet
+			if((directory.Type == image_debug_type_codeview
+				|| directory.Type == image_debug_type_misc
+				|| directory.Type == image_debug_type_coff)
+				&& directory.SizeOfData
+				&& debug_data_.find(directory.PointerToRawData) == debug_data_.end())
+			{
+				std::string data;
+				data.resize(directory.SizeOfData);
+				file.clear();
+				file.seekg(directory.PointerToRawData);
+				file.read(&data[0], directory.SizeOfData);
+				if(file.bad() || file.eof())
+					return;
+
+				debug_data_.insert(std::make_pair(directory.PointerToRawData, data));
+			}
+
+			//Go to next debug entry
+			current_pos += sizeof(image_debug_directory);
+			if(!try_section_data_from_rva(current_pos, directory, error, section_data_virtual, true))
+				return;
+		}
+	}
+	catch(const std::bad_alloc&)
+	{
+		//Don't throw any exception here, if debug info is corrupted or incorrect
+	}
+}
+
 //Sets number of sections
 void pe_base::set_number_of_sections(uint16_t number)
 {
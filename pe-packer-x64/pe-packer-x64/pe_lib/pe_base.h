@@ -9,7 +9,9 @@
 #include "utils.h"
 #include "pe_section.h"
 #include "pe_properties.h"
+#ifdef PE_BLISS_WINDOWS
 #include <Windows.h>
+#endif
 
 //Please don't remove this information from header
 //PEBliss 1.0.0
@@ -34,7 +36,12 @@ class pe_base
 {
 public: //CONSTRUCTORS
 	//Constructor from stream
-	pe_base(std::istream& file, const pe_properties& props, bool read_debug_raw_data = true);
+	//If read_debug_raw_data, raw debug data is read here, otherwise it can be read later by load_debug_raw_data()
+	//Section data is allocated from section_pool (default section_buffer_pool if it's null)
+	pe_base(std::istream& file, const pe_properties& props, bool read_debug_raw_data = false, section_buffer_pool* section_pool = 0);
+	//Non-throwing constructor from stream, sets error instead of throwing if image is incorrect
+	//The image must not be used if error is set
+	pe_base(std::istream& file, const pe_properties& props, bool read_debug_raw_data, pe_error& error, section_buffer_pool* section_pool = 0);
 
 	//Constructor of empty PE-file
 	explicit pe_base(const pe_properties& props, uint32_t section_alignment = 0x1000, bool dll = false, uint16_t subsystem = pe_win::image_subsystem_windows_gui);
@@ -247,10 +254,17 @@ public: //PE HEADER
 	
 	typedef std::multimap<uint32_t, std::string> debug_data_list;
 	//Returns raw list of debug data
+	//It's empty if image was read without raw debug data and load_debug_raw_data() was not called
 	const debug_data_list& get_raw_debug_data_list() const;
+	//Reads raw debug data (COFF, CodeView and misc types) which was not read yet from stream the image was read from
+	//Incorrect debug directory or data are ignored here, as when reading image
+	void load_debug_raw_data(std::istream& file);
+	//Returns true if image was read without raw debug data and load_debug_raw_data() was not called
+	bool is_debug_raw_data_deferred() const;
 	
 	//Reads and checks DOS header
 	static void read_dos_header(std::istream& file, pe_win::image_dos_header& header);
+	static bool try_read_dos_header(std::istream& file, pe_win::image_dos_header& header, pe_error& error);
 	
 	//Returns sizeof() nt headers
 	uint32_t get_sizeof_nt_header() const;
@@ -313,6 +327,9 @@ public: //IMAGE SECTIONS
 	//Returns section from RVA inside it
 	section& section_from_rva(uint32_t rva);
 	const section& section_from_rva(uint32_t rva) const;
+	//Returns section from RVA inside it, null if there is no such section
+	section* find_section_from_rva(uint32_t rva);
+	const section* find_section_from_rva(uint32_t rva) const;
 	//Returns section from directory ID
 	section& section_from_directory(uint32_t directory_id);
 	const section& section_from_directory(uint32_t directory_id) const;
@@ -342,6 +359,8 @@ public: //IMAGE SECTIONS
 	//Returns section remaining RAW/VIRTUAL data length from RVA "rva_inside" to the end of section containing RVA "rva"
 	//If include_headers = true, data from the beginning of PE file to SizeOfHeaders will be searched, too
 	uint32_t section_data_length_from_rva(uint32_t rva, uint32_t rva_inside, section_data_type datatype = section_data_raw, bool include_headers = false) const;
+	//Non-throwing version, returns false and sets error if RVA is incorrect
+	bool try_section_data_length_from_rva(uint32_t rva, uint32_t rva_inside, uint32_t& length, pe_error& error, section_data_type datatype = section_data_raw, bool include_headers = false) const;
 	//Returns section remaining RAW/VIRTUAL data length from VA "va_inside" to the end of section containing VA "va" for PE32 and PE64 respectively
 	//If include_headers = true, data from the beginning of PE file to SizeOfHeaders will be searched, too
 	uint32_t section_data_length_from_va(uint32_t va, uint32_t va_inside, section_data_type datatype = section_data_raw, bool include_headers = false) const;
@@ -351,6 +370,8 @@ public: //IMAGE SECTIONS
 	//Returns corresponding section data pointer from RVA inside section
 	char* section_data_from_rva(uint32_t rva, bool include_headers = false);
 	const char* section_data_from_rva(uint32_t rva, section_data_type datatype = section_data_raw, bool include_headers = false) const;
+	//Non-throwing version, returns null and sets error if RVA is incorrect
+	const char* try_section_data_from_rva(uint32_t rva, pe_error& error, section_data_type datatype = section_data_raw, bool include_headers = false) const;
 	//Returns corresponding section data pointer from VA inside section for PE32 and PE64 respectively
 	char* section_data_from_va(uint32_t va, bool include_headers = false);
 	const char* section_data_from_va(uint32_t va, section_data_type datatype = section_data_raw, bool include_headers = false) const;
@@ -372,7 +393,7 @@ public: //IMAGE SECTIONS
 	{
 		if(rva >= s.get_virtual_address() && rva < s.get_virtual_address() + s.get_aligned_virtual_size(get_section_alignment()) && pe_utils::is_sum_safe(rva, sizeof(T)))
 		{
-			const std::string& data = datatype == section_data_raw ? s.get_raw_data() : s.get_virtual_data(get_section_alignment());
+			std::string_view data = datatype == section_data_raw ? s.get_raw_view() : s.get_virtual_view(get_section_alignment());
 			//Don't check for underflow here, comparsion is unsigned
 			if(data.size() < rva - s.get_virtual_address() + sizeof(T))
 				throw pe_exception("RVA and requested data size does not exist inside section", pe_exception::rva_not_exists);
@@ -387,18 +408,37 @@ public: //IMAGE SECTIONS
 	//If include_headers = true, data from the beginning of PE file to SizeOfHeaders will be searched, too
 	template<typename T>
 	T section_data_from_rva(uint32_t rva, section_data_type datatype = section_data_raw, bool include_headers = false) const
+	{
+		T value = T();
+		pe_error error;
+		if(!try_section_data_from_rva(rva, value, error, datatype, include_headers))
+			error.raise();
+
+		return value;
+	}
+
+	//Non-throwing version, returns false and sets error if RVA or data size is incorrect
+	template<typename T>
+	bool try_section_data_from_rva(uint32_t rva, T& value, pe_error& error, section_data_type datatype = section_data_raw, bool include_headers = false) const
 	{
 		//if RVA is inside of headers and we're searching them too...
 		if(include_headers && pe_utils::is_sum_safe(rva, sizeof(T)) && (rva + sizeof(T) < full_headers_data_.length()))
-			return *reinterpret_cast<const T*>(&full_headers_data_[rva]);
+		{
+			value = *reinterpret_cast<const T*>(&full_headers_data_[rva]);
+			return true;
+		}
+
+		const section* s = find_section_from_rva(rva);
+		if(!s)
+			return error.set("No section found by presented address", pe_exception::no_section_found);
 
-		const section& s = section_from_rva(rva);
-		const std::string& data = datatype == section_data_raw ? s.get_raw_data() : s.get_virtual_data(get_section_alignment());
+		std::string_view data = datatype == section_data_raw ? s->get_raw_view() : s->get_virtual_view(get_section_alignment());
 		//Don't check for underflow here, comparsion is unsigned
-		if(data.size() < rva - s.get_virtual_address() + sizeof(T))
-			throw pe_exception("RVA and requested data size does not exist inside section", pe_exception::rva_not_exists);
+		if(data.size() < rva - s->get_virtual_address() + sizeof(T))
+			return error.set("RVA and requested data size does not exist inside section", pe_exception::rva_not_exists);
 
-		return *reinterpret_cast<const T*>(data.data() + rva - s.get_virtual_address());
+		value = *reinterpret_cast<const T*>(data.data() + rva - s->get_virtual_address());
+		return true;
 	}
 
 	//Returns corresponding section data pointer from VA inside section "s" (checks bounds, checks sizes, the most safe function)
@@ -453,6 +493,10 @@ public: //IMAGE SECTIONS
 	//Adds section to image
 	//Returns last section
 	section& add_section(section s);
+	//Returns virtual address, which section added by add_section will get
+	//It doesn't depend on added section, so code can be generated for this address before section is built
+	//If image has no sections, virtual address of added section is used, when it's set
+	uint32_t get_next_section_rva(uint32_t section_rva = 0) const;
 	//Prepares section to later add it to image (checks and recalculates virtual and raw section size)
 	//Section must be prepared by this function before calling add_section
 	void prepare_section(section& s);
@@ -464,6 +508,8 @@ public: //IMAGE SECTIONS
 public: //IMAGE
 	//Returns PE type (PE or PE+) from pe_type enumeration (minimal correctness checks)
 	static pe_type get_pe_type(std::istream& file);
+	//Non-throwing version, returns false and sets error if stream doesn't contain PE image
+	static bool try_get_pe_type(std::istream& file, pe_type& type, pe_error& error);
 	//Returns PE type of this image
 	pe_type get_pe_type() const;
 
@@ -479,6 +525,9 @@ public: //IMAGE
 
 	// ========== END OF PUBLIC MEMBERS AND STRUCTURES ========== //
 private:
+	//Restores parsed image state without reading and checking image again
+	friend class pe_image_cache;
+
 	//Image DOS header
 	pe_win::image_dos_header dos_header_;
 	//Rich (stub) overlay data (for MSVS)
@@ -492,14 +541,19 @@ private:
 	//Raw debug data for all directories
 	//PointerToRawData; Data
 	debug_data_list debug_data_;
+	//True if raw debug data was not read with image and was not loaded later
+	bool debug_raw_data_deferred_;
 	//PE or PE+ related properties
 	pe_properties* props_;
 
-	//Reads and checks DOS header
-	void read_dos_header(std::istream& file);
+	//Reads DOS header, PE headers and section data, restores istream state
+	bool load(std::istream& file, bool read_debug_raw_data, pe_error& error, section_buffer_pool* section_pool);
 
 	//Reads and checks PE headers and section headers, data
-	void read_pe(std::istream& file, bool read_debug_raw_data);
+	bool read_pe(std::istream& file, bool read_debug_raw_data, pe_error& error, section_buffer_pool* section_pool);
+
+	//Reads PE type, istream state is not restored
+	static bool read_pe_type(std::istream& file, pe_type& type, pe_error& error);
 
 	//Sets number of sections
 	void set_number_of_sections(uint16_t number);
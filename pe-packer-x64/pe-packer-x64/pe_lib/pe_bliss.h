@@ -2,6 +2,7 @@
 #include "pe_base.h"
 #include "pe_rebuilder.h"
 #include "pe_factory.h"
+#include "pe_image_cache.h"
 #include "pe_bound_import.h"
 #include "pe_debug.h"
 #include "pe_dotnet.h"
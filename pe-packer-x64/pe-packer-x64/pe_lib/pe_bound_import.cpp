@@ -232,7 +232,7 @@ const image_directory rebuild_bound_imports(pe_base& pe, const bound_import_modu
 		(imports_section.empty() || pe_utils::align_up(imports_section.get_size_of_raw_data(), pe.get_file_alignment()) < needed_size + directory_pos))
 		throw pe_exception("Insufficient space for bound import directory", pe_exception::insufficient_space);
 
-	std::string& raw_data = imports_section.get_raw_data();
+	section_buffer& raw_data = imports_section.get_raw_buffer();
 
 	//This will be done only if imports_section is the last section of image or for section with unaligned raw length of data
 	if(raw_data.length() < needed_size + directory_pos)
@@ -598,8 +598,126 @@ void coff_debug_info::coff_symbol::set_type(uint16_t type)
 	type_ = type;
 }
 
-//Returns debug information list
-const debug_info_list get_debug_information(const pe_base& pe)
+//Walks symbols of raw COFF debug data
+bool walk_coff_symbols(const std::string& debug_data, const coff_symbol_callback& callback)
+{
+	//Check data length
+	if(debug_data.length() < sizeof(image_coff_symbols_header))
+		throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
+
+	//Get coff header structure pointer
+	const image_coff_symbols_header* coff = reinterpret_cast<const image_coff_symbols_header*>(debug_data.data());
+
+	//Check possible overflows
+	if(coff->NumberOfSymbols >= pe_utils::max_dword / sizeof(image_symbol)
+		|| !pe_utils::is_sum_safe(coff->NumberOfSymbols * sizeof(image_symbol), coff->LvaToFirstSymbol))
+		throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
+
+	//Check data length again
+	if(debug_data.length() < coff->NumberOfSymbols * sizeof(image_symbol) + coff->LvaToFirstSymbol)
+		throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
+
+	//Enumerate debug symbols data
+	for(uint32_t i = 0; i < coff->NumberOfSymbols; ++i)
+	{
+		//Safe sum (checked above)
+		const image_symbol* sym = reinterpret_cast<const image_symbol*>(debug_data.data() + i * sizeof(image_symbol) + coff->LvaToFirstSymbol);
+
+		coff_symbol_ref symbol;
+		symbol.index = i; //Save symbol index
+		symbol.storage_class = sym->StorageClass; //Save storage class
+		symbol.type = sym->Type; //Save type
+		symbol.section_number = 0;
+		symbol.rva = 0;
+		symbol.is_file = false;
+
+		//Check data length again
+		if(!pe_utils::is_sum_safe(i, sym->NumberOfAuxSymbols)
+			|| (i + sym->NumberOfAuxSymbols) > coff->NumberOfSymbols
+			|| debug_data.length() < (i + 1) * sizeof(image_symbol) + coff->LvaToFirstSymbol + sym->NumberOfAuxSymbols * sizeof(image_symbol))
+			throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
+
+		//If symbol is filename
+		if(sym->StorageClass == image_sym_class_file)
+		{
+			//File name is situated just after this IMAGE_SYMBOL structure, strip null bytes in the end of it
+			const char* file_name = reinterpret_cast<const char*>(sym + 1);
+			size_t length = sym->NumberOfAuxSymbols * sizeof(image_symbol);
+			while(length && !file_name[length - 1])
+				--length;
+
+			symbol.is_file = true;
+			symbol.name = std::string_view(file_name, length);
+
+			//Save symbol info
+			if(!callback(symbol))
+				return false;
+
+			//Move to next symbol
+			i += sym->NumberOfAuxSymbols;
+			continue;
+		}
+
+		//Dump some other symbols
+		if(((sym->StorageClass == image_sym_class_static)
+			&& (sym->NumberOfAuxSymbols == 0)
+			&& (sym->SectionNumber == 1))
+			||
+			((sym->StorageClass == image_sym_class_external)
+			&& ISFCN(sym->Type)
+			&& (sym->SectionNumber > 0))
+			)
+		{
+			//Save RVA and section number
+			symbol.section_number = sym->SectionNumber;
+			symbol.rva = sym->Value;
+
+			//If symbol has short name
+			if(sym->N.Name.Short)
+			{
+				//Name is null-terminated if it is shorter than 8 bytes
+				symbol.name = std::string_view(reinterpret_cast<const char*>(sym->N.ShortName), 8);
+				symbol.name = symbol.name.substr(0, symbol.name.find('\0'));
+			}
+			else
+			{
+				//Symbol has long name
+
+				//Check possible overflows
+				if(!pe_utils::is_sum_safe(coff->LvaToFirstSymbol + coff->NumberOfSymbols * sizeof(image_symbol), sym->N.Name.Long))
+					throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
+
+				//Here we have an offset to the string table
+				uint32_t symbol_offset = coff->LvaToFirstSymbol + coff->NumberOfSymbols * sizeof(image_symbol) + sym->N.Name.Long;
+
+				//Check data length
+				if(debug_data.length() < symbol_offset)
+					throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
+
+				//Check symbol name for null-termination
+				if(!pe_utils::is_null_terminated(debug_data.data() + symbol_offset, debug_data.length() - symbol_offset))
+					throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
+
+				symbol.name = std::string_view(debug_data.data() + symbol_offset);
+			}
+
+			//Save symbol info
+			if(!callback(symbol))
+				return false;
+
+			//Move to next symbol
+			i += sym->NumberOfAuxSymbols;
+			continue;
+		}
+	}
+
+	return true;
+}
+
+namespace
+{
+//Returns debug information list, raw debug data which was not read with image is read from file if it's not null
+const debug_info_list parse_debug_information(const pe_base& pe, std::istream* file)
 {
 	debug_info_list ret;
 
@@ -620,6 +738,9 @@ const debug_info_list get_debug_information(const pe_base& pe)
 	if(!pe_utils::is_sum_safe(pe.get_directory_rva(image_directory_entry_debug), pe.get_directory_size(image_directory_entry_debug)))
 		throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
 
+	//Raw debug data read from file for current entry
+	std::string file_data;
+
 	//Iterate over all IMAGE_DEBUG_DIRECTORY directories
 	while(directory.PointerToRawData
 		&& current_pos < pe.get_directory_rva(image_directory_entry_debug) + pe.get_directory_size(image_directory_entry_debug))
@@ -628,11 +749,44 @@ const debug_info_list get_debug_information(const pe_base& pe)
 		debug_info info(directory);
 
 		//Find raw debug data
+		const std::string* raw_data = 0;
 		const pe_base::debug_data_list& debug_datas = pe.get_raw_debug_data_list();
 		pe_base::debug_data_list::const_iterator it = debug_datas.find(directory.PointerToRawData);
-		if(it != debug_datas.end()) //If it exists, we'll do some detailed debug info research
+		if(it != debug_datas.end())
+		{
+			raw_data = &(*it).second;
+		}
+		else if((directory.Type == image_debug_type_codeview
+			|| directory.Type == image_debug_type_misc
+			|| directory.Type == image_debug_type_coff)
+			&& directory.SizeOfData)
+		{
+			if(file)
+			{
+				//Read data, as pe_base does it, errors are ignored then
+				try
+				{
+					file_data.resize(directory.SizeOfData);
+					file->clear();
+					file->seekg(directory.PointerToRawData);
+					file->read(&file_data[0], directory.SizeOfData);
+					if(!file->bad() && !file->eof())
+						raw_data = &file_data;
+				}
+				catch(const std::bad_alloc&)
+				{
+				}
+			}
+			else if(pe.is_debug_raw_data_deferred())
+			{
+				//Data was not read with image, don't return entry without its advanced information
+				throw pe_exception("Raw debug data was not loaded, use load_debug_raw_data() or pass the image stream", pe_exception::debug_raw_data_not_loaded);
+			}
+		}
+
+		if(raw_data) //If it exists, we'll do some detailed debug info research
 		{
-			const std::string& debug_data = (*it).second;
+			const std::string& debug_data = *raw_data;
 			switch(directory.Type)
 			{
 			case image_debug_type_coff:
@@ -641,108 +795,31 @@ const debug_info_list get_debug_information(const pe_base& pe)
 					if(debug_data.length() < sizeof(image_coff_symbols_header))
 						throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
 
-					//Get coff header structure pointer
-					const image_coff_symbols_header* coff = reinterpret_cast<const image_coff_symbols_header*>(debug_data.data());
-
-					//Check possible overflows
-					if(coff->NumberOfSymbols >= pe_utils::max_dword / sizeof(image_symbol)
-						|| !pe_utils::is_sum_safe(coff->NumberOfSymbols * sizeof(image_symbol), coff->LvaToFirstSymbol))
-						throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
-
-					//Check data length again
-					if(debug_data.length() < coff->NumberOfSymbols * sizeof(image_symbol) + coff->LvaToFirstSymbol)
-						throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
-
 					//Create COFF debug info structure
-					coff_debug_info coff_info(coff);
+					coff_debug_info coff_info(reinterpret_cast<const image_coff_symbols_header*>(debug_data.data()));
 
 					//Enumerate debug symbols data
-					for(uint32_t i = 0; i < coff->NumberOfSymbols; ++i)
+					walk_coff_symbols(debug_data, [&coff_info](const coff_symbol_ref& ref)
 					{
-						//Safe sum (checked above)
-						const image_symbol* sym = reinterpret_cast<const image_symbol*>(debug_data.data() + i * sizeof(image_symbol) + coff->LvaToFirstSymbol);
-
 						coff_debug_info::coff_symbol symbol;
-						symbol.set_index(i); //Save symbol index
-						symbol.set_storage_class(sym->StorageClass); //Save storage class
-						symbol.set_type(sym->Type); //Save storage class
-
-						//Check data length again
-						if(!pe_utils::is_sum_safe(i, sym->NumberOfAuxSymbols)
-							|| (i + sym->NumberOfAuxSymbols) > coff->NumberOfSymbols
-							|| debug_data.length() < (i + 1) * sizeof(image_symbol) + coff->LvaToFirstSymbol + sym->NumberOfAuxSymbols * sizeof(image_symbol))
-							throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
+						symbol.set_index(ref.index);
+						symbol.set_storage_class(ref.storage_class);
+						symbol.set_type(ref.type);
 
-						//If symbol is filename
-						if(sym->StorageClass == image_sym_class_file)
+						if(ref.is_file)
 						{
-							//Save file name, it is situated just after this IMAGE_SYMBOL structure
-							std::string file_name(reinterpret_cast<const char*>(debug_data.data() + (i + 1) * sizeof(image_symbol)), sym->NumberOfAuxSymbols * sizeof(image_symbol));
-							pe_utils::strip_nullbytes(file_name);
-							symbol.set_file_name(file_name);
-
-							//Save symbol info
-							coff_info.add_symbol(symbol);
-
-							//Move to next symbol
-							i += sym->NumberOfAuxSymbols;
-							continue;
+							symbol.set_file_name(std::string(ref.name));
 						}
-
-						//Dump some other symbols
-						if(((sym->StorageClass == image_sym_class_static)
-							&& (sym->NumberOfAuxSymbols == 0)
-							&& (sym->SectionNumber == 1))
-							||
-							((sym->StorageClass == image_sym_class_external)
-							&& ISFCN(sym->Type)
-							&& (sym->SectionNumber > 0))
-							)
+						else
 						{
-							//Save RVA and section number
-							symbol.set_section_number(sym->SectionNumber);
-							symbol.set_rva(sym->Value);
-
-							//If symbol has short name
-							if(sym->N.Name.Short)
-							{
-								//Copy and save symbol name
-								char name_buff[9];
-								memcpy(name_buff, sym->N.ShortName, 8);
-								name_buff[8] = '\0';
-								symbol.set_symbol_name(name_buff);
-							}
-							else
-							{
-								//Symbol has long name
-
-								//Check possible overflows
-								if(!pe_utils::is_sum_safe(coff->LvaToFirstSymbol + coff->NumberOfSymbols * sizeof(image_symbol), sym->N.Name.Long))
-									throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
-
-								//Here we have an offset to the string table
-								uint32_t symbol_offset = coff->LvaToFirstSymbol + coff->NumberOfSymbols * sizeof(image_symbol) + sym->N.Name.Long;
-
-								//Check data length
-								if(debug_data.length() < symbol_offset)
-									throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
-
-								//Check symbol name for null-termination
-								if(!pe_utils::is_null_terminated(debug_data.data() + symbol_offset, debug_data.length() - symbol_offset))
-									throw pe_exception("Incorrect debug directory", pe_exception::incorrect_debug_directory);
-
-								//Save symbol name
-								symbol.set_symbol_name(debug_data.data() + symbol_offset);
-							}
-
-							//Save symbol info
-							coff_info.add_symbol(symbol);
-
-							//Move to next symbol
-							i += sym->NumberOfAuxSymbols;
-							continue;
+							symbol.set_section_number(ref.section_number);
+							symbol.set_rva(ref.rva);
+							symbol.set_symbol_name(std::string(ref.name));
 						}
-					}
+
+						coff_info.add_symbol(symbol);
+						return true;
+					});
 
 					info.set_advanced_debug_info(coff_info);
 				}
@@ -842,3 +919,16 @@ const debug_info_list get_debug_information(const pe_base& pe)
 	return ret;
 }
 }
+
+//Returns debug information list
+const debug_info_list get_debug_information(const pe_base& pe)
+{
+	return parse_debug_information(pe, 0);
+}
+
+//Returns debug information list, raw debug data which was not read with image is read from file
+const debug_info_list get_debug_information(const pe_base& pe, std::istream& file)
+{
+	return parse_debug_information(pe, &file);
+}
+}
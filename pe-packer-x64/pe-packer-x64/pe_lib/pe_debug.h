@@ -1,5 +1,8 @@
 #pragma once
 #include <vector>
+#include <istream>
+#include <functional>
+#include <string_view>
 #include "pe_structures.h"
 #include "pe_base.h"
 
@@ -299,5 +302,31 @@ private:
 typedef std::vector<debug_info> debug_info_list;
 
 //Returns debug information list
+//Advanced information is available only if raw debug data was read (see pe_base::load_debug_raw_data())
+//Throws pe_exception (debug_raw_data_not_loaded) if image has COFF, CodeView or misc debug data which was not read yet
 const debug_info_list get_debug_information(const pe_base& pe);
+//Returns debug information list, raw debug data which was not read with image is read from file (stream image was read from)
+//Data is read only for the time of parsing, it is not saved to image
+const debug_info_list get_debug_information(const pe_base& pe, std::istream& file);
+
+//COFF symbol passed to walk_coff_symbols() callback
+//Name points to raw debug data and is valid only during the callback call
+struct coff_symbol_ref
+{
+	uint32_t index;
+	uint32_t storage_class;
+	uint16_t type;
+	uint32_t section_number; //Zero for file names
+	uint32_t rva; //Zero for file names
+	bool is_file;
+	std::string_view name; //Symbol or file name
+};
+
+//Callback of walk_coff_symbols(), returns false to stop walking
+typedef std::function<bool(const coff_symbol_ref& symbol)> coff_symbol_callback;
+
+//Walks symbols of raw COFF (IMAGE_DEBUG_TYPE_COFF) debug data, calling callback for symbols coff_debug_info lists
+//Symbols are not saved and names are not copied
+//Returns false if walking was stopped by callback
+bool walk_coff_symbols(const std::string& debug_data, const coff_symbol_callback& callback);
 }
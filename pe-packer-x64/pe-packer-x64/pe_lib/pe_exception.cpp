@@ -16,4 +16,41 @@ pe_exception::exception_id pe_exception::get_id() const
 {
 	return id_;
 }
+
+//No error
+pe_error::pe_error()
+	:text_(0), id_(pe_exception::unknown_error)
+{}
+
+//Returns true if error is set
+bool pe_error::failed() const
+{
+	return text_ != 0;
+}
+
+//Returns exception ID
+pe_exception::exception_id pe_error::get_id() const
+{
+	return id_;
+}
+
+//Returns error text
+const char* pe_error::get_text() const
+{
+	return text_ ? text_ : "";
+}
+
+//Sets error
+bool pe_error::set(const char* text, pe_exception::exception_id id)
+{
+	text_ = text;
+	id_ = id;
+	return false;
+}
+
+//Throws pe_exception with this error
+void pe_error::raise() const
+{
+	throw pe_exception(get_text(), id_);
+}
 }
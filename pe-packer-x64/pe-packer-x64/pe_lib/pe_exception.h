@@ -62,6 +62,7 @@ public:
 		resource_incorrect_version_info,
 
 		advanced_debug_information_request_error,
+		debug_raw_data_not_loaded,
 		image_does_not_have_managed_code,
 
 		section_is_empty,
@@ -106,4 +107,30 @@ public:
 private:
 	exception_id id_;
 };
+
+//Error of non-throwing (try_*) functions, they report the same IDs and texts as pe_exception
+//and return false instead of throwing, so malformed images don't unwind the stack
+class pe_error
+{
+public:
+	//No error
+	pe_error();
+
+	//Returns true if error is set
+	bool failed() const;
+	//Returns exception ID from pe_exception::exception_id enumeration
+	pe_exception::exception_id get_id() const;
+	//Returns error text, empty if there is no error
+	const char* get_text() const;
+
+	//Sets error, text must be a string literal, always returns false
+	bool set(const char* text, pe_exception::exception_id id);
+
+	//Throws pe_exception with this error, used by throwing wrappers of try_* functions
+	void raise() const;
+
+private:
+	const char* text_;
+	pe_exception::exception_id id_;
+};
 }
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include "pe_exception_directory.h"
+#include "rva_data_cache.h"
 
 namespace pe_bliss
 {
@@ -109,47 +111,139 @@ uint8_t exception_entry::get_scaled_rsp_offset() const
 	return frame_offset_;
 }
 
-//Returns exception directory data (exists on PE+ only)
-//Unwind opcodes are not listed, because their format and list are subject to change
-const exception_entry_list get_exception_directory_data(const pe_base& pe)
-{
-	exception_entry_list ret;
+//Default constructor (empty view)
+exception_directory_view::exception_directory_view()
+	:pe_(0), entries_(0), count_(0), sorted_(true)
+{}
 
-	//If image doesn't have exception directory, return empty list
+//Constructor from image
+exception_directory_view::exception_directory_view(const pe_base& pe)
+	:pe_(&pe), entries_(0), count_(0), sorted_(true)
+{
+	//If image doesn't have exception directory, view is empty
 	if(!pe.has_exception_directory())
-		return ret;
+		return;
 
-	//Check the length in bytes of the section containing exception directory
-	if(pe.section_data_length_from_rva(pe.get_directory_rva(image_directory_entry_exception), pe.get_directory_rva(image_directory_entry_exception), section_data_virtual, true)
-		< sizeof(image_runtime_function_entry))
-		throw pe_exception("Incorrect exception directory", pe_exception::incorrect_exception_directory);
-
-	unsigned long current_pos = pe.get_directory_rva(image_directory_entry_exception);
+	uint32_t current_pos = pe.get_directory_rva(image_directory_entry_exception);
 
 	//Check if structures are DWORD-aligned
 	if(current_pos % sizeof(uint32_t))
 		throw pe_exception("Incorrect exception directory", pe_exception::incorrect_exception_directory);
 
-	//First IMAGE_RUNTIME_FUNCTION_ENTRY table
-	image_runtime_function_entry exception_table = pe.section_data_from_rva<image_runtime_function_entry>(current_pos, section_data_virtual, true);
+	//Check the length in bytes of the section containing exception directory
+	rva_data_cache cache(pe);
+	uint32_t available;
+	const char* data = cache.get(current_pos, available);
+	if(available < sizeof(image_runtime_function_entry))
+		throw pe_exception("Incorrect exception directory", pe_exception::incorrect_exception_directory);
+
+	entries_ = reinterpret_cast<const image_runtime_function_entry*>(data);
 
+	//Entries list is terminated by null entry, which must be inside section
 	//todo: virtual addresses BeginAddress and EndAddress are not checked to be inside image
-	while(exception_table.BeginAddress)
+	size_t max_count = available / sizeof(image_runtime_function_entry);
+	for(; count_ != max_count && entries_[count_].BeginAddress; ++count_)
 	{
 		//Check addresses
-		if(exception_table.BeginAddress > exception_table.EndAddress)
+		if(entries_[count_].BeginAddress > entries_[count_].EndAddress)
 			throw pe_exception("Incorrect exception directory", pe_exception::incorrect_exception_directory);
 
-		//Get unwind information
-		unwind_info info = pe.section_data_from_rva<unwind_info>(exception_table.UnwindInfoAddress, section_data_virtual, true);
+		if(count_ && entries_[count_].BeginAddress < entries_[count_ - 1].BeginAddress)
+			sorted_ = false;
+	}
+
+	if(count_ == max_count)
+		throw pe_exception("RVA and requested data size does not exist inside section", pe_exception::rva_not_exists);
+}
+
+//Returns number of entries
+size_t exception_directory_view::size() const
+{
+	return count_;
+}
+
+//Returns true if there are no entries
+bool exception_directory_view::empty() const
+{
+	return count_ == 0;
+}
+
+//Returns true if entries are sorted by BeginAddress
+bool exception_directory_view::is_sorted() const
+{
+	return sorted_;
+}
+
+//Returns raw entry by index
+const image_runtime_function_entry& exception_directory_view::operator[](size_t index) const
+{
+	return entries_[index];
+}
 
-		//Create exception entry and save it
-		ret.push_back(exception_entry(exception_table, info));
+//Returns raw entries array
+const image_runtime_function_entry* exception_directory_view::data() const
+{
+	return entries_;
+}
 
-		//Go to next exception entry
-		current_pos += sizeof(image_runtime_function_entry);
-		exception_table = pe.section_data_from_rva<image_runtime_function_entry>(current_pos, section_data_virtual, true);
+//Returns index of entry of function containing RVA or npos
+size_t exception_directory_view::find_function_index(uint32_t rva) const
+{
+	if(sorted_)
+	{
+		//Find first function starting after RVA, previous one may contain it
+		size_t first = 0, last = count_;
+		while(first != last)
+		{
+			size_t middle = first + (last - first) / 2;
+			if(entries_[middle].BeginAddress <= rva)
+				first = middle + 1;
+			else
+				last = middle;
+		}
+
+		if(first != 0 && rva < entries_[first - 1].EndAddress)
+			return first - 1;
 	}
+	else
+	{
+		for(size_t i = 0; i != count_; ++i)
+		{
+			if(entries_[i].BeginAddress <= rva && rva < entries_[i].EndAddress)
+				return i;
+		}
+	}
+
+	return npos;
+}
+
+//Returns entry of function containing RVA or null
+const image_runtime_function_entry* exception_directory_view::find_function(uint32_t rva) const
+{
+	size_t index = find_function_index(rva);
+	return index == npos ? 0 : entries_ + index;
+}
+
+//Reads unwind information of entry
+const exception_entry exception_directory_view::get_exception_entry(size_t index) const
+{
+	const image_runtime_function_entry& entry = entries_[index];
+	return exception_entry(entry, pe_->section_data_from_rva<unwind_info>(entry.UnwindInfoAddress, section_data_virtual, true));
+}
+
+//Returns exception directory data (exists on PE+ only)
+//Unwind opcodes are not listed, because their format and list are subject to change
+const exception_entry_list get_exception_directory_data(const pe_base& pe)
+{
+	exception_entry_list ret;
+
+	exception_directory_view view(pe);
+	ret.reserve(view.size());
+
+	//Unwind information is usually placed in one section, so it's read through cache
+	rva_data_cache cache(pe);
+	for(size_t i = 0; i != view.size(); ++i)
+		ret.push_back(exception_entry(view[i], cache.read<unwind_info>(view[i].UnwindInfoAddress, pe_exception::rva_not_exists)));
 
 	return ret;
 }
@@ -61,6 +61,49 @@ private:
 
 typedef std::vector<exception_entry> exception_entry_list;
 
+//View of exception directory (exists on PE+ only) without copying its entries
+//Entries are checked once on construction, unwind information is read only when requested
+//View points to image section data and is valid while image sections are not changed
+class exception_directory_view
+{
+public:
+	//Returned by find_function_index() if there's no function containing RVA
+	static const size_t npos = static_cast<size_t>(-1);
+
+public:
+	//Default constructor (empty view)
+	exception_directory_view();
+	//Constructor from image, empty view is created if image doesn't have exception directory
+	explicit exception_directory_view(const pe_base& pe);
+
+	//Returns number of entries
+	size_t size() const;
+	//Returns true if there are no entries
+	bool empty() const;
+	//Returns true if entries are sorted by BeginAddress (as they must be), find functions use binary search then
+	bool is_sorted() const;
+
+	//Returns raw entry by index
+	const pe_win::image_runtime_function_entry& operator[](size_t index) const;
+	//Returns raw entries array (size() entries)
+	const pe_win::image_runtime_function_entry* data() const;
+
+	//Returns index of entry of function containing RVA or npos
+	size_t find_function_index(uint32_t rva) const;
+	//Returns entry of function containing RVA or null
+	const pe_win::image_runtime_function_entry* find_function(uint32_t rva) const;
+
+	//Reads unwind information of entry
+	//Throws an exception if unwind information is out of image
+	const exception_entry get_exception_entry(size_t index) const;
+
+private:
+	const pe_base* pe_;
+	const pe_win::image_runtime_function_entry* entries_;
+	size_t count_;
+	bool sorted_;
+};
+
 //Returns exception directory data (exists on PE+ only)
 //Unwind opcodes are not listed, because their format and list are subject to change
 const exception_entry_list get_exception_directory_data(const pe_base& pe);
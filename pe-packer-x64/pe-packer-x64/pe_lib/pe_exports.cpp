@@ -1,4 +1,5 @@
 #include <set>
+#include <vector>
 #include <algorithm>
 #include <string.h>
 #include "pe_exports.h"
@@ -14,6 +15,29 @@ exported_function::exported_function()
 	:ordinal_(0), rva_(0), has_name_(false), name_ordinal_(0), forward_(false)
 {}
 
+//Constructor with memory resource of names
+exported_function::exported_function(const allocator_type& alloc)
+	:ordinal_(0), rva_(0), name_(alloc), has_name_(false), name_ordinal_(0), forward_(false), forward_name_(alloc)
+{}
+
+//Copy constructor to other memory resource
+exported_function::exported_function(const exported_function& other, const allocator_type& alloc)
+	:ordinal_(other.ordinal_), rva_(other.rva_), name_(other.name_, alloc), has_name_(other.has_name_),
+	name_ordinal_(other.name_ordinal_), forward_(other.forward_), forward_name_(other.forward_name_, alloc)
+{}
+
+//Move constructor to other memory resource, copies names if resources differ
+exported_function::exported_function(exported_function&& other, const allocator_type& alloc)
+	:ordinal_(other.ordinal_), rva_(other.rva_), name_(std::move(other.name_), alloc), has_name_(other.has_name_),
+	name_ordinal_(other.name_ordinal_), forward_(other.forward_), forward_name_(std::move(other.forward_name_), alloc)
+{}
+
+//Returns memory resource names are allocated from
+exported_function::allocator_type exported_function::get_allocator() const
+{
+	return name_.get_allocator();
+}
+
 //Returns ordinal of function (actually, ordinal = hint + ordinal base)
 uint16_t exported_function::get_ordinal() const
 {
@@ -27,7 +51,7 @@ uint32_t exported_function::get_rva() const
 }
 
 //Returns name of function
-const std::string& exported_function::get_name() const
+const std::pmr::string& exported_function::get_name() const
 {
 	return name_;
 }
@@ -51,7 +75,7 @@ bool exported_function::is_forwarded() const
 }
 
 //Returns the name of forwarded function
-const std::string& exported_function::get_forwarded_name() const
+const std::pmr::string& exported_function::get_forwarded_name() const
 {
 	return forward_name_;
 }
@@ -69,9 +93,9 @@ void exported_function::set_rva(uint32_t rva)
 }
 
 //Sets name of function (or clears it, if empty name is passed)
-void exported_function::set_name(const std::string& name)
+void exported_function::set_name(std::string_view name)
 {
-	name_ = name;
+	name_.assign(name.data(), name.size());
 	has_name_ = !name.empty();
 }
 
@@ -82,9 +106,9 @@ void exported_function::set_name_ordinal(uint16_t name_ordinal)
 }
 
 //Sets forwarded function name (or clears it, if empty name is passed)
-void exported_function::set_forwarded_name(const std::string& name)
+void exported_function::set_forwarded_name(std::string_view name)
 {
-	forward_name_ = name;
+	forward_name_.assign(name.data(), name.size());
 	forward_ = !name.empty();
 }
 
@@ -234,18 +258,26 @@ void export_info::set_rva_of_name_ordinals(uint32_t rva_of_name_ordinals)
 	address_of_name_ordinals_ = rva_of_name_ordinals;
 }
 
-const exported_functions_list get_exported_functions(const pe_base& pe, export_info* info);
-
 //Returns array of exported functions
-const exported_functions_list get_exported_functions(const pe_base& pe)
+const exported_functions_list get_exported_functions(const pe_base& pe, std::pmr::memory_resource* resource)
 {
-	return get_exported_functions(pe, 0);
+	exported_functions_list ret(resource);
+	pe_error error;
+	if(!try_get_exported_functions(pe, ret, error))
+		error.raise();
+
+	return ret;
 }
 
 //Returns array of exported functions and information about export
-const exported_functions_list get_exported_functions(const pe_base& pe, export_info& info)
+const exported_functions_list get_exported_functions(const pe_base& pe, export_info& info, std::pmr::memory_resource* resource)
 {
-	return get_exported_functions(pe, &info);
+	exported_functions_list ret(resource);
+	pe_error error;
+	if(!try_get_exported_functions(pe, ret, error, &info))
+		error.raise();
+
+	return ret;
 }
 
 //Helper: sorts exported function list by ordinals
@@ -255,162 +287,203 @@ public:
 		bool operator()(const exported_function& func1, const exported_function& func2) const;
 };
 
-//Returns array of exported functions and information about export (if info != 0)
-const exported_functions_list get_exported_functions(const pe_base& pe, export_info* info)
+//Non-throwing version of get_exported_functions
+bool try_get_exported_functions(const pe_base& pe, exported_functions_list& ret, pe_error& error, export_info* info)
 {
-	//Returned exported functions info array
-	std::vector<exported_function> ret;
+	ret.clear();
 
-	if(pe.has_exports())
-	{
-		//Check the length in bytes of the section containing export directory
-		if(pe.section_data_length_from_rva(pe.get_directory_rva(image_directory_entry_export),
-			pe.get_directory_rva(image_directory_entry_export), section_data_virtual, true)
-			< sizeof(image_export_directory))
-			throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
+	if(!pe.has_exports())
+		return true;
 
-		image_export_directory exports = pe.section_data_from_rva<image_export_directory>(pe.get_directory_rva(image_directory_entry_export), section_data_virtual, true);
+	//Check the length in bytes of the section containing export directory
+	uint32_t length;
+	if(!pe.try_section_data_length_from_rva(pe.get_directory_rva(image_directory_entry_export),
+		pe.get_directory_rva(image_directory_entry_export), length, error, section_data_virtual, true))
+		return false;
 
-		unsigned long max_name_length;
+	if(length < sizeof(image_export_directory))
+		return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
 
-		if(info)
-		{
-			//Save some export info data
-			info->set_characteristics(exports.Characteristics);
-			info->set_major_version(exports.MajorVersion);
-			info->set_minor_version(exports.MinorVersion);
+	image_export_directory exports = image_export_directory();
+	if(!pe.try_section_data_from_rva(pe.get_directory_rva(image_directory_entry_export), exports, error, section_data_virtual, true))
+		return false;
 
-			//Get byte count that we have for dll name
-			if((max_name_length = pe.section_data_length_from_rva(exports.Name, exports.Name, section_data_virtual, true)) < 2)
-				throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
+	uint32_t max_name_length;
 
-			//Get dll name pointer
-			const char* dll_name = pe.section_data_from_rva(exports.Name, section_data_virtual, true);
+	if(info)
+	{
+		//Save some export info data
+		info->set_characteristics(exports.Characteristics);
+		info->set_major_version(exports.MajorVersion);
+		info->set_minor_version(exports.MinorVersion);
+
+		//Get byte count that we have for dll name
+		if(!pe.try_section_data_length_from_rva(exports.Name, exports.Name, max_name_length, error, section_data_virtual, true))
+			return false;
+
+		if(max_name_length < 2)
+			return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
+
+		//Get dll name pointer
+		const char* dll_name = pe.try_section_data_from_rva(exports.Name, error, section_data_virtual, true);
+		if(!dll_name)
+			return false;
+
+		//Check for null-termination
+		if(!pe_utils::is_null_terminated(dll_name, max_name_length))
+			return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
+
+		//Save the rest of export information data
+		info->set_name(dll_name);
+		info->set_number_of_functions(exports.NumberOfFunctions);
+		info->set_number_of_names(exports.NumberOfNames);
+		info->set_ordinal_base(exports.Base);
+		info->set_rva_of_functions(exports.AddressOfFunctions);
+		info->set_rva_of_names(exports.AddressOfNames);
+		info->set_rva_of_name_ordinals(exports.AddressOfNameOrdinals);
+		info->set_timestamp(exports.TimeDateStamp);
+	}
 
-			//Check for null-termination
-			if(!pe_utils::is_null_terminated(dll_name, max_name_length))
-				throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
-
-			//Save the rest of export information data
-			info->set_name(dll_name);
-			info->set_number_of_functions(exports.NumberOfFunctions);
-			info->set_number_of_names(exports.NumberOfNames);
-			info->set_ordinal_base(exports.Base);
-			info->set_rva_of_functions(exports.AddressOfFunctions);
-			info->set_rva_of_names(exports.AddressOfNames);
-			info->set_rva_of_name_ordinals(exports.AddressOfNameOrdinals);
-			info->set_timestamp(exports.TimeDateStamp);
-		}
+	if(!exports.NumberOfFunctions)
+		return true;
+
+	//Check IMAGE_EXPORT_DIRECTORY fields
+	if(exports.NumberOfNames > exports.NumberOfFunctions)
+		return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
+
+	//Check some export directory fields
+	if((!exports.AddressOfNameOrdinals && exports.AddressOfNames) ||
+		(exports.AddressOfNameOrdinals && !exports.AddressOfNames) ||
+		!exports.AddressOfFunctions
+		|| exports.NumberOfFunctions >= pe_utils::max_dword / sizeof(uint32_t)
+		|| exports.NumberOfNames > pe_utils::max_dword / sizeof(uint32_t)
+		|| !pe_utils::is_sum_safe(exports.AddressOfFunctions, exports.NumberOfFunctions * sizeof(uint32_t))
+		|| !pe_utils::is_sum_safe(exports.AddressOfNames, exports.NumberOfNames * sizeof(uint32_t))
+		|| !pe_utils::is_sum_safe(exports.AddressOfNameOrdinals, exports.NumberOfFunctions * sizeof(uint32_t))
+		|| !pe_utils::is_sum_safe(pe.get_directory_rva(image_directory_entry_export), pe.get_directory_size(image_directory_entry_export)))
+		return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
+
+	//Check if it is enough bytes to hold AddressOfFunctions table
+	if(!pe.try_section_data_length_from_rva(exports.AddressOfFunctions, exports.AddressOfFunctions, length, error, section_data_virtual, true))
+		return false;
+
+	if(length < exports.NumberOfFunctions * sizeof(uint32_t))
+		return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
+
+	if(exports.AddressOfNames)
+	{
+		//Check if it is enough bytes to hold name and ordinal tables
+		if(!pe.try_section_data_length_from_rva(exports.AddressOfNameOrdinals, exports.AddressOfNameOrdinals, length, error, section_data_virtual, true))
+			return false;
+
+		if(length < exports.NumberOfNames * sizeof(uint16_t))
+			return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
 
-		if(!exports.NumberOfFunctions)
-			return ret;
-
-		//Check IMAGE_EXPORT_DIRECTORY fields
-		if(exports.NumberOfNames > exports.NumberOfFunctions)
-			throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
-
-		//Check some export directory fields
-		if((!exports.AddressOfNameOrdinals && exports.AddressOfNames) ||
-			(exports.AddressOfNameOrdinals && !exports.AddressOfNames) ||
-			!exports.AddressOfFunctions
-			|| exports.NumberOfFunctions >= pe_utils::max_dword / sizeof(uint32_t)
-			|| exports.NumberOfNames > pe_utils::max_dword / sizeof(uint32_t)
-			|| !pe_utils::is_sum_safe(exports.AddressOfFunctions, exports.NumberOfFunctions * sizeof(uint32_t))
-			|| !pe_utils::is_sum_safe(exports.AddressOfNames, exports.NumberOfNames * sizeof(uint32_t))
-			|| !pe_utils::is_sum_safe(exports.AddressOfNameOrdinals, exports.NumberOfFunctions * sizeof(uint32_t))
-			|| !pe_utils::is_sum_safe(pe.get_directory_rva(image_directory_entry_export), pe.get_directory_size(image_directory_entry_export)))
-			throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
-
-		//Check if it is enough bytes to hold AddressOfFunctions table
-		if(pe.section_data_length_from_rva(exports.AddressOfFunctions, exports.AddressOfFunctions, section_data_virtual, true)
-			< exports.NumberOfFunctions * sizeof(uint32_t))
-			throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
-
-		if(exports.AddressOfNames)
+		if(!pe.try_section_data_length_from_rva(exports.AddressOfNames, exports.AddressOfNames, length, error, section_data_virtual, true))
+			return false;
+
+		if(length < exports.NumberOfNames * sizeof(uint32_t))
+			return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
+	}
+
+	//Index of the first name of every function (NumberOfNames if function has no name)
+	//One pass over name ordinals instead of scanning all of them for every function
+	std::vector<uint32_t> name_indexes(exports.NumberOfFunctions, exports.NumberOfNames);
+	if(exports.NumberOfFunctions && exports.NumberOfNames)
+	{
+		//Length of the table is checked above
+		const char* name_ordinals = pe.try_section_data_from_rva(exports.AddressOfNameOrdinals, error, section_data_virtual, true);
+		if(!name_ordinals)
+			return false;
+
+		for(uint32_t i = 0; i < exports.NumberOfNames; i++)
 		{
-			//Check if it is enough bytes to hold name and ordinal tables
-			if(pe.section_data_length_from_rva(exports.AddressOfNameOrdinals, exports.AddressOfNameOrdinals, section_data_virtual, true)
-				< exports.NumberOfNames * sizeof(uint16_t))
-				throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
-
-			if(pe.section_data_length_from_rva(exports.AddressOfNames, exports.AddressOfNames, section_data_virtual, true)
-				< exports.NumberOfNames * sizeof(uint32_t))
-				throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
+			uint16_t name_ordinal;
+			memcpy(&name_ordinal, name_ordinals + i * sizeof(uint16_t), sizeof(name_ordinal));
+			if(name_ordinal < exports.NumberOfFunctions && name_indexes[name_ordinal] == exports.NumberOfNames)
+				name_indexes[name_ordinal] = i;
 		}
-		
-		for(uint32_t ordinal = 0; ordinal < exports.NumberOfFunctions; ordinal++)
+	}
+	
+	for(uint32_t ordinal = 0; ordinal < exports.NumberOfFunctions; ordinal++)
+	{
+		//Get function address
+		//Sum and multiplication are safe (checked above)
+		uint32_t rva = 0;
+		if(!pe.try_section_data_from_rva(exports.AddressOfFunctions + ordinal * sizeof(uint32_t), rva, error, section_data_virtual, true))
+			return false;
+
+		//If we have a skip
+		if(!rva)
+			continue;
+
+		exported_function func(ret.get_allocator());
+		func.set_rva(rva);
+
+		if(!pe_utils::is_sum_safe(exports.Base, ordinal) || exports.Base + ordinal > pe_utils::max_word)
+			return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
+
+		func.set_ordinal(static_cast<uint16_t>(ordinal + exports.Base));
+
+		//If function has name (and name ordinal)
+		uint32_t i = name_indexes[ordinal];
+		if(i != exports.NumberOfNames)
 		{
-			//Get function address
+			//Get function name
 			//Sum and multiplication are safe (checked above)
-			uint32_t rva = pe.section_data_from_rva<uint32_t>(exports.AddressOfFunctions + ordinal * sizeof(uint32_t), section_data_virtual, true);
+			uint32_t function_name_rva = 0;
+			if(!pe.try_section_data_from_rva(exports.AddressOfNames + i * sizeof(uint32_t), function_name_rva, error, section_data_virtual, true))
+				return false;
+
+			//Get byte count that we have for function name
+			if(!pe.try_section_data_length_from_rva(function_name_rva, function_name_rva, max_name_length, error, section_data_virtual, true))
+				return false;
 
-			//If we have a skip
-			if(!rva)
-				continue;
+			if(max_name_length < 2)
+				return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
 
-			exported_function func;
-			func.set_rva(rva);
+			//Get function name pointer
+			const char* func_name = pe.try_section_data_from_rva(function_name_rva, error, section_data_virtual, true);
+			if(!func_name)
+				return false;
 
-			if(!pe_utils::is_sum_safe(exports.Base, ordinal) || exports.Base + ordinal > pe_utils::max_word)
-				throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
+			//Check for null-termination
+			if(!pe_utils::is_null_terminated(func_name, max_name_length))
+				return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
 
-			func.set_ordinal(static_cast<uint16_t>(ordinal + exports.Base));
+			//Save function info
+			func.set_name(func_name);
+			func.set_name_ordinal(static_cast<uint16_t>(ordinal));
 
-			//Scan for function name ordinal
-			for(uint32_t i = 0; i < exports.NumberOfNames; i++)
+			//If the function is just a redirect, save its name
+			if(rva >= pe.get_directory_rva(image_directory_entry_export) + sizeof(image_directory_entry_export) &&
+				rva < pe.get_directory_rva(image_directory_entry_export) + pe.get_directory_size(image_directory_entry_export))
 			{
-				uint16_t ordinal2 = pe.section_data_from_rva<uint16_t>(exports.AddressOfNameOrdinals + i * sizeof(uint16_t), section_data_virtual, true);
-
-				//If function has name (and name ordinal)
-				if(ordinal == ordinal2)
-				{
-					//Get function name
-					//Sum and multiplication are safe (checked above)
-					uint32_t function_name_rva = pe.section_data_from_rva<uint32_t>(exports.AddressOfNames + i * sizeof(uint32_t), section_data_virtual, true);
-
-					//Get byte count that we have for function name
-					if((max_name_length = pe.section_data_length_from_rva(function_name_rva, function_name_rva, section_data_virtual, true)) < 2)
-						throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
-
-					//Get function name pointer
-					const char* func_name = pe.section_data_from_rva(function_name_rva, section_data_virtual, true);
-
-					//Check for null-termination
-					if(!pe_utils::is_null_terminated(func_name, max_name_length))
-						throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
-
-					//Save function info
-					func.set_name(func_name);
-					func.set_name_ordinal(ordinal2);
-
-					//If the function is just a redirect, save its name
-					if(rva >= pe.get_directory_rva(image_directory_entry_export) + sizeof(image_directory_entry_export) &&
-						rva < pe.get_directory_rva(image_directory_entry_export) + pe.get_directory_size(image_directory_entry_export))
-					{
-						if((max_name_length = pe.section_data_length_from_rva(rva, rva, section_data_virtual, true)) < 2)
-							throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
-
-						//Get forwarded function name pointer
-						const char* forwarded_func_name = pe.section_data_from_rva(rva, section_data_virtual, true);
-
-						//Check for null-termination
-						if(!pe_utils::is_null_terminated(forwarded_func_name, max_name_length))
-							throw pe_exception("Incorrect export directory", pe_exception::incorrect_export_directory);
-
-						//Set the name of forwarded function
-						func.set_forwarded_name(forwarded_func_name);
-					}
-
-					break;
-				}
-			}
+				if(!pe.try_section_data_length_from_rva(rva, rva, max_name_length, error, section_data_virtual, true))
+					return false;
+
+				if(max_name_length < 2)
+					return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
 
-			//Add function info to output array
-			ret.push_back(func);
+				//Get forwarded function name pointer
+				const char* forwarded_func_name = pe.try_section_data_from_rva(rva, error, section_data_virtual, true);
+				if(!forwarded_func_name)
+					return false;
+
+				//Check for null-termination
+				if(!pe_utils::is_null_terminated(forwarded_func_name, max_name_length))
+					return error.set("Incorrect export directory", pe_exception::incorrect_export_directory);
+
+				//Set the name of forwarded function
+				func.set_forwarded_name(forwarded_func_name);
+			}
 		}
+
+		//Add function info to output array
+		ret.push_back(std::move(func));
 	}
 
-	return ret;
+	return true;
 }
 
 //Helper export functions
@@ -435,11 +508,11 @@ const std::pair<uint16_t, uint16_t> get_export_ordinal_limits(const exported_fun
 }
 
 //Checks if exported function name already exists
-bool exported_name_exists(const std::string& function_name, const exported_functions_list& exports)
+bool exported_name_exists(std::string_view function_name, const exported_functions_list& exports)
 {
 	for(exported_functions_list::const_iterator it = exports.begin(); it != exports.end(); ++it)
 	{
-		if((*it).has_name() && (*it).get_name() == function_name)
+		if((*it).has_name() && std::string_view((*it).get_name()) == function_name)
 			return true;
 	}
 
@@ -498,7 +571,7 @@ const image_directory rebuild_exports(pe_base& pe, const export_info& info, expo
 	//Calculate needed size for function list
 	{
 		//Also check that there're no duplicate names and ordinals
-		std::set<std::string> used_function_names;
+		std::set<std::string_view> used_function_names;
 		std::set<uint16_t> used_function_ordinals;
 
 		for(exported_functions_list::const_iterator it = exports.begin(); it != exports.end(); ++it)
@@ -556,7 +629,7 @@ const image_directory rebuild_exports(pe_base& pe, const export_info& info, expo
 		(exports_section.empty() || pe_utils::align_up(exports_section.get_size_of_raw_data(), pe.get_file_alignment()) < needed_size + directory_pos))
 		throw pe_exception("Insufficient space for export directory", pe_exception::insufficient_space);
 
-	std::string& raw_data = exports_section.get_raw_data();
+	section_buffer& raw_data = exports_section.get_raw_buffer();
 
 	//This will be done only if exports_section is the last section of image or for section with unaligned raw length of data
 	if(raw_data.length() < needed_size + directory_pos)
@@ -596,7 +669,7 @@ const image_directory rebuild_exports(pe_base& pe, const export_info& info, expo
 	memcpy(&raw_data[directory_pos + sizeof(image_export_directory)], info.get_name().c_str(), info.get_name().length() + 1);
 
 	//A map to sort function names alphabetically
-	typedef std::map<std::string, uint16_t> funclist; //function name; function name ordinal
+	typedef std::map<std::string_view, uint16_t> funclist; //function name; function name ordinal
 	funclist funcs;
 
 	uint32_t last_ordinal = ordinal_base;
@@ -622,7 +695,7 @@ const image_directory rebuild_exports(pe_base& pe, const export_info& info, expo
 		
 		//If function is named, save its name ordinal and name in sorted alphabetically order
 		if(func.has_name())
-			funcs.insert(std::make_pair(func.get_name(), static_cast<uint16_t>(func.get_ordinal() - ordinal_base))); //Calculate name ordinal
+			funcs.insert(funclist::value_type(func.get_name(), static_cast<uint16_t>(func.get_ordinal() - ordinal_base))); //Calculate name ordinal
 
 		//If function is forwarded to another DLL
 		if(func.is_forwarded())
@@ -653,7 +726,8 @@ const image_directory rebuild_exports(pe_base& pe, const export_info& info, expo
 		current_pos_of_function_names_rvas += sizeof(function_name_rva);
 
 		//Save function name
-		memcpy(&raw_data[current_pos_of_function_names], (*it).first.c_str(), (*it).first.length() + 1);
+		memcpy(&raw_data[current_pos_of_function_names], (*it).first.data(), (*it).first.length());
+		raw_data[current_pos_of_function_names + (*it).first.length()] = 0;
 		current_pos_of_function_names += static_cast<uint32_t>((*it).first.length() + 1);
 
 		//Save function name ordinal
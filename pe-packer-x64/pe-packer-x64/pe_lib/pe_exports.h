@@ -1,6 +1,8 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory_resource>
 #include "pe_structures.h"
 #include "pe_base.h"
 #include "pe_directory.h"
@@ -8,12 +10,30 @@
 namespace pe_bliss
 {
 //Class representing exported function
+//Names are allocated from memory resource of the function, so whole exported_functions_list
+//may be placed to one arena (for example, std::pmr::monotonic_buffer_resource)
 class exported_function
 {
+public:
+	typedef std::pmr::string::allocator_type allocator_type;
+
 public:
 	//Default constructor
 	exported_function();
 
+	//Allocator-extended constructors, used by exported_functions_list to pass its memory resource
+	explicit exported_function(const allocator_type& alloc);
+	exported_function(const exported_function& other, const allocator_type& alloc);
+	exported_function(exported_function&& other, const allocator_type& alloc);
+
+	exported_function(const exported_function& other) = default;
+	exported_function(exported_function&& other) = default;
+	exported_function& operator=(const exported_function& other) = default;
+	exported_function& operator=(exported_function&& other) = default;
+
+	//Returns memory resource names are allocated from
+	allocator_type get_allocator() const;
+
 	//Returns ordinal of function (actually, ordinal = hint + ordinal base)
 	uint16_t get_ordinal() const;
 
@@ -23,14 +43,14 @@ public:
 	//Returns true if function has name and name ordinal
 	bool has_name() const;
 	//Returns name of function
-	const std::string& get_name() const;
+	const std::pmr::string& get_name() const;
 	//Returns name ordinal of function
 	uint16_t get_name_ordinal() const;
 
 	//Returns true if function is forwarded to other library
 	bool is_forwarded() const;
 	//Returns the name of forwarded function
-	const std::string& get_forwarded_name() const;
+	const std::pmr::string& get_forwarded_name() const;
 
 public: //Setters do not change everything inside image, they are used by PE class
 	//You can also use them to rebuild export directory
@@ -42,21 +62,21 @@ public: //Setters do not change everything inside image, they are used by PE cla
 	void set_rva(uint32_t rva);
 
 	//Sets name of function (or clears it, if empty name is passed)
-	void set_name(const std::string& name);
+	void set_name(std::string_view name);
 	//Sets name ordinal
 	void set_name_ordinal(uint16_t name_ordinal);
 
 	//Sets forwarded function name (or clears it, if empty name is passed)
-	void set_forwarded_name(const std::string& name);
+	void set_forwarded_name(std::string_view name);
 
 private:
 	uint16_t ordinal_; //Function ordinal
 	uint32_t rva_; //Function RVA
-	std::string name_; //Function name
+	std::pmr::string name_; //Function name
 	bool has_name_; //true == function has name
 	uint16_t name_ordinal_; //Function name ordinal
 	bool forward_; //true == function is forwarded
-	std::string forward_name_; //Name of forwarded function
+	std::pmr::string forward_name_; //Name of forwarded function
 };
 
 //Class representing export information
@@ -130,19 +150,22 @@ private:
 };
 
 //Exported functions list typedef
-typedef std::vector<exported_function> exported_functions_list;
+typedef std::pmr::vector<exported_function> exported_functions_list;
 
-//Returns array of exported functions
-const exported_functions_list get_exported_functions(const pe_base& pe);
+//Returns array of exported functions, allocated from resource
+const exported_functions_list get_exported_functions(const pe_base& pe, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 //Returns array of exported functions and information about export
-const exported_functions_list get_exported_functions(const pe_base& pe, export_info& info);
+const exported_functions_list get_exported_functions(const pe_base& pe, export_info& info, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+//Non-throwing version, returns false and sets error if export directory is incorrect
+//Information about export is saved to info if info != 0, functions are allocated from memory resource of exports
+bool try_get_exported_functions(const pe_base& pe, exported_functions_list& exports, pe_error& error, export_info* info = 0);
 	
 //Helper export functions
 //Returns pair: <ordinal base for supplied functions; maximum ordinal value for supplied functions>
 const std::pair<uint16_t, uint16_t> get_export_ordinal_limits(const exported_functions_list& exports);
 
 //Checks if exported function name already exists
-bool exported_name_exists(const std::string& function_name, const exported_functions_list& exports);
+bool exported_name_exists(std::string_view function_name, const exported_functions_list& exports);
 
 //Checks if exported function ordinal already exists
 bool exported_ordinal_exists(uint16_t ordinal, const exported_functions_list& exports);
@@ -3,10 +3,26 @@
 
 namespace pe_bliss
 {
-pe_base pe_factory::create_pe(std::istream& file, bool read_debug_raw_data)
+pe_base pe_factory::create_pe(std::istream& file, bool read_debug_raw_data, section_buffer_pool* section_pool)
 {
 	return pe_base::get_pe_type(file) == pe_type_32
-		? pe_base(file, pe_properties_32(), read_debug_raw_data)
-		: pe_base(file, pe_properties_64(), read_debug_raw_data);
+		? pe_base(file, pe_properties_32(), read_debug_raw_data, section_pool)
+		: pe_base(file, pe_properties_64(), read_debug_raw_data, section_pool);
+}
+
+std::unique_ptr<pe_base> pe_factory::try_create_pe(std::istream& file, pe_error& error, bool read_debug_raw_data, section_buffer_pool* section_pool)
+{
+	pe_type type;
+	if(!pe_base::try_get_pe_type(file, type, error))
+		return std::unique_ptr<pe_base>();
+
+	std::unique_ptr<pe_base> pe(type == pe_type_32
+		? new pe_base(file, pe_properties_32(), read_debug_raw_data, error, section_pool)
+		: new pe_base(file, pe_properties_64(), read_debug_raw_data, error, section_pool));
+
+	if(error.failed())
+		pe.reset();
+
+	return pe;
 }
 }
@@ -11,6 +11,11 @@ public:
 	//Creates pe_base class instance from PE or PE+ istream
 	//If read_bound_import_raw_data, raw bound import data will be read (used to get bound import info)
 	//If read_debug_raw_data, raw debug data will be read (used to get image debug info)
-	static pe_base create_pe(std::istream& file, bool read_debug_raw_data = true);
+	//By default it's not read, use pe_base::load_debug_raw_data() or get_debug_information(pe, file) to read it when needed,
+	//get_debug_information(pe) throws until it's loaded
+	//Section data is allocated from section_pool, pass the same pool for images of a batch to reuse their memory
+	static pe_base create_pe(std::istream& file, bool read_debug_raw_data = false, section_buffer_pool* section_pool = 0);
+	//Non-throwing version for triage of many files, returns null and sets error if image is incorrect
+	static std::unique_ptr<pe_base> try_create_pe(std::istream& file, pe_error& error, bool read_debug_raw_data = false, section_buffer_pool* section_pool = 0);
 };
 }
@@ -0,0 +1,450 @@
+#include <string.h>
+#include <stdio.h>
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include "pe_image_cache.h"
+#include "pe_factory.h"
+#include "pe_properties_generic.h"
+#ifndef PE_BLISS_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace pe_bliss
+{
+using namespace pe_win;
+
+namespace
+{
+//Read-only memory mapping of file
+//If file does not exist or can not be mapped, data() returns null
+class mapped_file
+{
+public:
+	explicit mapped_file(const std::string& path)
+		:data_(0), length_(0)
+#ifdef PE_BLISS_WINDOWS
+		, file_(INVALID_HANDLE_VALUE), mapping_(0)
+#endif
+	{
+#ifdef PE_BLISS_WINDOWS
+		file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if(file_ == INVALID_HANDLE_VALUE)
+			return;
+
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(file_, &size) || size.QuadPart == 0 || size.QuadPart > pe_utils::two_gb)
+			return;
+
+		mapping_ = CreateFileMappingA(file_, 0, PAGE_READONLY, 0, 0, 0);
+		if(!mapping_)
+			return;
+
+		data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+		if(data_)
+			length_ = static_cast<size_t>(size.QuadPart);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if(fd == -1)
+			return;
+
+		struct stat st;
+		if(fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= pe_utils::two_gb)
+		{
+			void* data = mmap(0, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if(data != MAP_FAILED)
+			{
+				data_ = static_cast<const char*>(data);
+				length_ = static_cast<size_t>(st.st_size);
+			}
+		}
+
+		close(fd);
+#endif
+	}
+
+	~mapped_file()
+	{
+#ifdef PE_BLISS_WINDOWS
+		if(data_)
+			UnmapViewOfFile(data_);
+		if(mapping_)
+			CloseHandle(mapping_);
+		if(file_ != INVALID_HANDLE_VALUE)
+			CloseHandle(file_);
+#else
+		if(data_)
+			munmap(const_cast<char*>(data_), length_);
+#endif
+	}
+
+	const char* data() const
+	{
+		return data_;
+	}
+
+	size_t length() const
+	{
+		return length_;
+	}
+
+private:
+	mapped_file(const mapped_file&);
+	mapped_file& operator=(const mapped_file&);
+
+	const char* data_;
+	size_t length_;
+#ifdef PE_BLISS_WINDOWS
+	HANDLE file_;
+	HANDLE mapping_;
+#endif
+};
+
+const char cache_magic[8] = {'P', 'E', 'C', 'A', 'C', 'H', 'E', 0};
+
+//Returns true if [offset, offset + size) range is inside data of specified length
+bool is_range_inside(uint64_t offset, uint64_t size, uint64_t length)
+{
+	return offset <= length && size <= length - offset;
+}
+
+//XXH64 primes
+const uint64_t prime64_1 = 0x9E3779B185EBCA87ull;
+const uint64_t prime64_2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t prime64_3 = 0x165667B19E3779F9ull;
+const uint64_t prime64_4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t prime64_5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t rotl64(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t read64(const char* data)
+{
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+inline uint32_t read32(const char* data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+	acc += input * prime64_2;
+	acc = rotl64(acc, 31);
+	return acc * prime64_1;
+}
+
+inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t value)
+{
+	acc ^= xxh64_round(0, value);
+	return acc * prime64_1 + prime64_4;
+}
+
+//Returns name of temporary file for "file_name", unique for each process, thread and call,
+//so concurrent writers of the same entry never write to the same temporary file
+std::string get_temp_file_name(const std::string& file_name)
+{
+	static std::atomic<uint32_t> counter(0);
+	static const uint32_t process_random = std::random_device()();
+
+#ifdef PE_BLISS_WINDOWS
+	uint32_t process_id = GetCurrentProcessId();
+#else
+	uint32_t process_id = static_cast<uint32_t>(getpid());
+#endif
+
+	std::ostringstream name;
+	name << file_name << '.' << std::hex << process_id
+		<< '.' << std::hash<std::thread::id>()(std::this_thread::get_id())
+		<< '.' << process_random << '.' << counter++ << ".tmp";
+	return name.str();
+}
+
+//Replaces "file_name" with "temp_name" in one step, readers see either old or new file
+bool replace_file(const std::string& temp_name, const std::string& file_name)
+{
+#ifdef PE_BLISS_WINDOWS
+	return MoveFileExA(temp_name.c_str(), file_name.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(temp_name.c_str(), file_name.c_str()) == 0;
+#endif
+}
+}
+
+//Constructor, directory must exist
+pe_image_cache::pe_image_cache(const std::string& directory)
+	:directory_(directory)
+{
+	if(!directory_.empty() && directory_[directory_.length() - 1] != '/' && directory_[directory_.length() - 1] != '\\')
+		directory_ += '/';
+}
+
+//Returns path to cache file for image with specified hash
+const std::string pe_image_cache::get_cache_file_name(uint64_t image_hash) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.pec", static_cast<unsigned long long>(image_hash));
+	return directory_ + name;
+}
+
+//Calculates 64-bit hash of data (XXH64)
+uint64_t pe_image_cache::hash(const char* data, size_t length, uint64_t seed)
+{
+	const char* p = data;
+	const char* end = data + length;
+	uint64_t ret;
+
+	if(length >= 32)
+	{
+		//Four independent lanes over 32-byte stripes
+		uint64_t v1 = seed + prime64_1 + prime64_2;
+		uint64_t v2 = seed + prime64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - prime64_1;
+
+		const char* limit = end - 32;
+		do
+		{
+			v1 = xxh64_round(v1, read64(p));
+			v2 = xxh64_round(v2, read64(p + 8));
+			v3 = xxh64_round(v3, read64(p + 16));
+			v4 = xxh64_round(v4, read64(p + 24));
+			p += 32;
+		}
+		while(p <= limit);
+
+		ret = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		ret = xxh64_merge_round(ret, v1);
+		ret = xxh64_merge_round(ret, v2);
+		ret = xxh64_merge_round(ret, v3);
+		ret = xxh64_merge_round(ret, v4);
+	}
+	else
+	{
+		ret = seed + prime64_5;
+	}
+
+	ret += static_cast<uint64_t>(length);
+
+	//Tail
+	for(; p + 8 <= end; p += 8)
+	{
+		ret ^= xxh64_round(0, read64(p));
+		ret = rotl64(ret, 27) * prime64_1 + prime64_4;
+	}
+
+	if(p + 4 <= end)
+	{
+		ret ^= static_cast<uint64_t>(read32(p)) * prime64_1;
+		ret = rotl64(ret, 23) * prime64_2 + prime64_3;
+		p += 4;
+	}
+
+	for(; p != end; ++p)
+	{
+		ret ^= static_cast<uint8_t>(*p) * prime64_5;
+		ret = rotl64(ret, 11) * prime64_1;
+	}
+
+	//Avalanche
+	ret ^= ret >> 33;
+	ret *= prime64_2;
+	ret ^= ret >> 29;
+	ret *= prime64_3;
+	ret ^= ret >> 32;
+
+	return ret;
+}
+
+//Returns image parsed from "image" data
+const pe_base pe_image_cache::load(const std::string& image, bool* from_cache, section_buffer_pool* section_pool) const
+{
+	uint64_t image_hash = hash(image.data(), image.length());
+
+	if(from_cache)
+		*from_cache = false;
+
+	{
+		mapped_file cache_file(get_cache_file_name(image_hash));
+		if(cache_file.data() && cache_file.length() >= sizeof(cache_header))
+		{
+			cache_header header;
+			memcpy(&header, cache_file.data(), sizeof(header));
+
+			if(header.pe_type == pe_type_32 || header.pe_type == pe_type_64)
+			{
+				pe_base pe(header.pe_type == pe_type_32
+					? pe_base(pe_properties_32())
+					: pe_base(pe_properties_64()));
+
+				if(restore(cache_file.data(), cache_file.length(), image, image_hash, pe, section_pool))
+				{
+					if(from_cache)
+						*from_cache = true;
+
+					return pe;
+				}
+			}
+		}
+	}
+
+	//No cache entry (or it is incorrect), parse image
+	std::istringstream stream(image);
+	pe_base pe(pe_factory::create_pe(stream, false, section_pool));
+
+	//Cache is optional, image is returned even if entry can't be written
+	save(pe, image, image_hash);
+	return pe;
+}
+
+//Restores image from cache file data, returns false if cache file data is incorrect
+bool pe_image_cache::restore(const char* data, size_t length, const std::string& image, uint64_t image_hash, pe_base& pe, section_buffer_pool* section_pool)
+{
+	cache_header header;
+	memcpy(&header, data, sizeof(header));
+
+	//Check that cache entry belongs to this image
+	if(memcmp(header.magic, cache_magic, sizeof(cache_magic))
+		|| header.version != cache_version
+		|| header.pe_type != static_cast<uint32_t>(pe.get_pe_type())
+		|| header.image_hash != image_hash
+		|| header.image_size != image.length()
+		|| header.nt_headers_size != pe.get_sizeof_nt_header())
+		return false;
+
+	uint64_t needed_length = sizeof(cache_header)
+		+ static_cast<uint64_t>(header.nt_headers_size)
+		+ static_cast<uint64_t>(header.number_of_sections) * sizeof(cache_section)
+		+ static_cast<uint64_t>(header.number_of_debug_entries) * sizeof(cache_debug_entry);
+	if(needed_length != length
+		|| header.full_headers_size < sizeof(image_dos_header)
+		|| !is_range_inside(0, header.full_headers_size, image.length()))
+		return false;
+
+	const char* p = data + sizeof(cache_header);
+
+	//DOS header and stub overlay are taken from image
+	memcpy(&pe.dos_header_, image.data(), sizeof(image_dos_header));
+	if(pe.dos_header_.e_lfanew < 0 || !is_range_inside(0, static_cast<uint32_t>(pe.dos_header_.e_lfanew), image.length()))
+		return false;
+
+	if(static_cast<uint32_t>(pe.dos_header_.e_lfanew) > sizeof(image_dos_header))
+		pe.rich_overlay_.assign(image.data() + sizeof(image_dos_header), pe.dos_header_.e_lfanew - sizeof(image_dos_header));
+
+	//NT headers are saved in cache, because some fields are fixed while parsing
+	memcpy(pe.get_nt_headers_ptr(), p, header.nt_headers_size);
+	p += header.nt_headers_size;
+
+	pe.sections_.clear();
+	pe.sections_.reserve(header.number_of_sections);
+	for(uint32_t i = 0; i != header.number_of_sections; ++i, p += sizeof(cache_section))
+	{
+		cache_section entry;
+		memcpy(&entry, p, sizeof(entry));
+		if(!is_range_inside(entry.raw_offset, entry.raw_size, image.length()))
+			return false;
+
+		section s(section_pool);
+		s.get_raw_header() = entry.header;
+		if(entry.raw_size)
+		{
+			s.get_raw_buffer().assign(std::string_view(image.data() + entry.raw_offset, entry.raw_size));
+			s.set_source_offset(entry.raw_offset);
+		}
+
+		pe.sections_.push_back(std::move(s));
+	}
+
+	pe.debug_data_.clear();
+	for(uint32_t i = 0; i != header.number_of_debug_entries; ++i, p += sizeof(cache_debug_entry))
+	{
+		cache_debug_entry entry;
+		memcpy(&entry, p, sizeof(entry));
+		if(!is_range_inside(entry.raw_offset, entry.raw_size, image.length()))
+			return false;
+
+		pe.debug_data_.insert(std::make_pair(entry.raw_offset, std::string(image.data() + entry.raw_offset, entry.raw_size)));
+	}
+
+	pe.full_headers_data_.assign(image.data(), header.full_headers_size);
+	pe.has_overlay_ = header.has_overlay != 0;
+
+	return true;
+}
+
+//Saves parsed image state to cache file, returns false if cache file can't be written
+bool pe_image_cache::save(const pe_base& pe, const std::string& image, uint64_t image_hash) const
+{
+	cache_header header;
+	memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.pe_type = pe.get_pe_type();
+	header.image_hash = image_hash;
+	header.image_size = image.length();
+	header.nt_headers_size = pe.get_sizeof_nt_header();
+	header.full_headers_size = static_cast<uint32_t>(pe.full_headers_data_.length());
+	header.number_of_sections = static_cast<uint32_t>(pe.sections_.size());
+	header.number_of_debug_entries = static_cast<uint32_t>(pe.debug_data_.size());
+	header.has_overlay = pe.has_overlay_ ? 1 : 0;
+	header.reserved = 0;
+
+	std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+	data.append(pe.get_nt_headers_ptr(), header.nt_headers_size);
+
+	for(section_list::const_iterator it = pe.sections_.begin(); it != pe.sections_.end(); ++it)
+	{
+		cache_section entry;
+		entry.header = (*it).get_raw_header();
+		entry.raw_size = static_cast<uint32_t>((*it).get_raw_view().length());
+		entry.raw_offset = entry.raw_size ? pe_utils::align_down((*it).get_pointer_to_raw_data(), pe.get_file_alignment()) : 0;
+		data.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+	}
+
+	for(pe_base::debug_data_list::const_iterator it = pe.debug_data_.begin(); it != pe.debug_data_.end(); ++it)
+	{
+		cache_debug_entry entry;
+		entry.raw_offset = (*it).first;
+		entry.raw_size = static_cast<uint32_t>((*it).second.length());
+		data.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+	}
+
+	//Write to temporary file of this call first, then replace entry with it,
+	//so concurrent runs never see partially written entry and an existing entry never disappears
+	std::string file_name = get_cache_file_name(image_hash);
+	std::string temp_name = get_temp_file_name(file_name);
+
+	{
+		std::ofstream file(temp_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!file)
+			return false;
+
+		file.write(data.data(), data.length());
+		if(!file)
+		{
+			file.close();
+			remove(temp_name.c_str());
+			return false;
+		}
+	}
+
+	if(!replace_file(temp_name, file_name))
+	{
+		remove(temp_name.c_str());
+		return false;
+	}
+
+	return true;
+}
+}
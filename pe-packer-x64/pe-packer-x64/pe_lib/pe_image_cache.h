@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include "pe_base.h"
+
+namespace pe_bliss
+{
+//On-disk cache of parsed images, keyed by image contents hash
+//Cache file holds parsed headers, section table and locations of section and debug data inside image,
+//so image, which was parsed once, is restored without parsing and checking it again
+//Cache file is mapped to memory when loading
+class pe_image_cache
+{
+public:
+	//Constructor, directory must exist
+	explicit pe_image_cache(const std::string& directory);
+
+	//Returns image parsed from "image" data
+	//If cache has entry for the image, it is restored from cache, otherwise image is parsed and saved to cache
+	//If from_cache is not null, it is set to true when image was restored from cache
+	//Section data is allocated from section_pool (default section_buffer_pool if it's null)
+	const pe_base load(const std::string& image, bool* from_cache = 0, section_buffer_pool* section_pool = 0) const;
+
+	//Returns path to cache file for image with specified hash
+	const std::string get_cache_file_name(uint64_t image_hash) const;
+
+	//Calculates 64-bit hash of data (XXH64)
+	static uint64_t hash(const char* data, size_t length, uint64_t seed = 0);
+
+private:
+	static const uint32_t cache_version = 1;
+
+#pragma pack(push, 1)
+	struct cache_header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t pe_type;
+		uint64_t image_hash;
+		uint64_t image_size;
+		uint32_t nt_headers_size;
+		uint32_t full_headers_size;
+		uint32_t number_of_sections;
+		uint32_t number_of_debug_entries;
+		uint32_t has_overlay;
+		uint32_t reserved;
+	};
+
+	struct cache_section
+	{
+		pe_win::image_section_header header;
+		uint32_t raw_offset; //Offset of section raw data in image
+		uint32_t raw_size;
+	};
+
+	struct cache_debug_entry
+	{
+		uint32_t raw_offset; //PointerToRawData of debug directory
+		uint32_t raw_size;
+	};
+#pragma pack(pop)
+
+	//Restores image from cache file data, returns false if cache file data is incorrect
+	static bool restore(const char* data, size_t length, const std::string& image, uint64_t image_hash, pe_base& pe, section_buffer_pool* section_pool);
+	//Saves parsed image state to cache file, returns false if cache file can't be written
+	bool save(const pe_base& pe, const std::string& image, uint64_t image_hash) const;
+
+	std::string directory_;
+};
+}
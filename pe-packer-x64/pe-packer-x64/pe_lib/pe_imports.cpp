@@ -1,6 +1,7 @@
 #include <string.h>
 #include "pe_imports.h"
 #include "pe_properties_generic.h"
+#include "rva_data_cache.h"
 
 namespace pe_bliss
 {
@@ -129,8 +130,23 @@ imported_function::imported_function()
 	:hint_(0), ordinal_(0), iat_va_(0)
 {}
 
+//Constructor with memory resource of name
+imported_function::imported_function(const allocator_type& alloc)
+	:name_(alloc), hint_(0), ordinal_(0), iat_va_(0)
+{}
+
+//Copy constructor to other memory resource
+imported_function::imported_function(const imported_function& other, const allocator_type& alloc)
+	:name_(other.name_, alloc), hint_(other.hint_), ordinal_(other.ordinal_), iat_va_(other.iat_va_)
+{}
+
+//Move constructor to other memory resource, copies name if resources differ
+imported_function::imported_function(imported_function&& other, const allocator_type& alloc)
+	:name_(std::move(other.name_), alloc), hint_(other.hint_), ordinal_(other.ordinal_), iat_va_(other.iat_va_)
+{}
+
 //Returns name of function
-const std::string& imported_function::get_name() const
+const std::pmr::string& imported_function::get_name() const
 {
 	return name_;
 }
@@ -160,9 +176,9 @@ uint64_t imported_function::get_iat_va() const
 }
 
 //Sets name of function
-void imported_function::set_name(const std::string& name)
+void imported_function::set_name(std::string_view name)
 {
-	name_ = name;
+	name_.assign(name.data(), name.size());
 }
 
 //Sets hint
@@ -188,8 +204,31 @@ import_library::import_library()
 	:rva_to_iat_(0), rva_to_original_iat_(0), timestamp_(0)
 {}
 
+//Constructor with memory resource of name and imported functions
+import_library::import_library(const allocator_type& alloc)
+	:name_(alloc), rva_to_iat_(0), rva_to_original_iat_(0), timestamp_(0), imports_(alloc)
+{}
+
+//Copy constructor to other memory resource
+import_library::import_library(const import_library& other, const allocator_type& alloc)
+	:name_(other.name_, alloc), rva_to_iat_(other.rva_to_iat_), rva_to_original_iat_(other.rva_to_original_iat_),
+	timestamp_(other.timestamp_), imports_(other.imports_, alloc)
+{}
+
+//Move constructor to other memory resource, copies name and imported functions if resources differ
+import_library::import_library(import_library&& other, const allocator_type& alloc)
+	:name_(std::move(other.name_), alloc), rva_to_iat_(other.rva_to_iat_), rva_to_original_iat_(other.rva_to_original_iat_),
+	timestamp_(other.timestamp_), imports_(std::move(other.imports_), alloc)
+{}
+
+//Returns memory resource name and imported functions are allocated from
+import_library::allocator_type import_library::get_allocator() const
+{
+	return imports_.get_allocator();
+}
+
 //Returns name of library
-const std::string& import_library::get_name() const
+const std::pmr::string& import_library::get_name() const
 {
 	return name_;
 }
@@ -213,9 +252,9 @@ uint32_t import_library::get_timestamp() const
 }
 
 //Sets name of library
-void import_library::set_name(const std::string& name)
+void import_library::set_name(std::string_view name)
 {
-	name_ = name;
+	name_.assign(name.data(), name.size());
 }
 
 //Sets RVA to Import Address Table (IAT)
@@ -248,17 +287,29 @@ void import_library::add_import(const imported_function& func)
 	imports_.push_back(func);
 }
 
+//Adds imported function
+void import_library::add_import(imported_function&& func)
+{
+	imports_.push_back(std::move(func));
+}
+
+//Reserves space for count imported functions
+void import_library::reserve_imports(std::size_t count)
+{
+	imports_.reserve(count);
+}
+
 //Clears imported functions list
 void import_library::clear_imports()
 {
 	imports_.clear();
 }
 
-const imported_functions_list get_imported_functions(const pe_base& pe)
+const imported_functions_list get_imported_functions(const pe_base& pe, std::pmr::memory_resource* resource)
 {
 	return (pe.get_pe_type() == pe_type_32 ?
-		get_imported_functions_base<pe_types_class_32>(pe)
-		: get_imported_functions_base<pe_types_class_64>(pe));
+		get_imported_functions_base<pe_types_class_32>(pe, resource)
+		: get_imported_functions_base<pe_types_class_64>(pe, resource));
 }
 
 const image_directory rebuild_imports(pe_base& pe, const imported_functions_list& imports, section& import_section, const import_rebuilder_settings& import_settings)
@@ -268,136 +319,294 @@ const image_directory rebuild_imports(pe_base& pe, const imported_functions_list
 		: rebuild_imports_base<pe_types_class_64>(pe, imports, import_section, import_settings));
 }
 
+//Default constructor
+import_table::import_table()
+{}
+
+//Returns libraries list
+const import_table::library_list& import_table::get_libraries() const
+{
+	return libraries_;
+}
+
+//Returns functions of all libraries
+const import_table::function_list& import_table::get_functions() const
+{
+	return functions_;
+}
+
+//Returns pointer to first function of library (number_of_functions functions follow it)
+const import_table::function* import_table::get_functions(const library& lib) const
+{
+	return functions_.empty() ? 0 : &functions_[0] + lib.first_function;
+}
+
+//Returns name of library
+std::string_view import_table::get_name(const library& lib) const
+{
+	return strings_.get(lib.name);
+}
+
+//Returns name of function (empty, if function is imported by ordinal)
+std::string_view import_table::get_name(const function& func) const
+{
+	return func.name == no_name ? std::string_view() : strings_.get(func.name);
+}
+
+//Returns string pool containing library and function names
+const string_pool& import_table::get_strings() const
+{
+	return strings_;
+}
+
+//Converts table to imported_functions_list allocated from resource
+const imported_functions_list import_table::to_imported_functions_list(std::pmr::memory_resource* resource) const
+{
+	imported_functions_list ret(resource);
+	ret.reserve(libraries_.size());
+
+	for(library_list::const_iterator it = libraries_.begin(); it != libraries_.end(); ++it)
+	{
+		import_library lib(ret.get_allocator());
+		lib.set_name(get_name(*it));
+		lib.set_timestamp((*it).timestamp);
+		lib.set_rva_to_iat((*it).rva_to_iat);
+		lib.set_rva_to_original_iat((*it).rva_to_original_iat);
+		lib.reserve_imports((*it).number_of_functions);
+
+		const function* funcs = get_functions(*it);
+		for(uint32_t i = 0; i != (*it).number_of_functions; ++i)
+		{
+			imported_function func(ret.get_allocator());
+			if(funcs[i].name == no_name)
+			{
+				func.set_ordinal(funcs[i].ordinal);
+			}
+			else
+			{
+				func.set_name(get_name(funcs[i]));
+				func.set_hint(funcs[i].hint);
+			}
+
+			func.set_iat_va(funcs[i].iat_va);
+			lib.add_import(std::move(func));
+		}
+
+		ret.push_back(std::move(lib));
+	}
+
+	return ret;
+}
+
+//Adds library, its functions must be added right after this call
+void import_table::add_library(std::string_view name, uint32_t rva_to_iat, uint32_t rva_to_original_iat, uint32_t timestamp)
+{
+	library lib;
+	lib.name = strings_.intern(name);
+	lib.rva_to_iat = rva_to_iat;
+	lib.rva_to_original_iat = rva_to_original_iat;
+	lib.timestamp = timestamp;
+	lib.first_function = static_cast<uint32_t>(functions_.size());
+	lib.number_of_functions = 0;
+	libraries_.push_back(lib);
+}
+
+//Adds function to the last added library
+void import_table::add_function(uint32_t name, uint16_t hint, uint16_t ordinal, uint64_t iat_va)
+{
+	function func;
+	func.name = name;
+	func.hint = hint;
+	func.ordinal = ordinal;
+	func.iat_va = iat_va;
+	functions_.push_back(func);
+	++libraries_.back().number_of_functions;
+}
+
+//Interns string in table string pool
+uint32_t import_table::intern(std::string_view str)
+{
+	return strings_.intern(str);
+}
+
+import_table get_import_table(const pe_base& pe)
+{
+	return (pe.get_pe_type() == pe_type_32 ?
+		get_import_table_base<pe_types_class_32>(pe)
+		: get_import_table_base<pe_types_class_64>(pe));
+}
+
+bool try_get_import_table(const pe_base& pe, import_table& imports, pe_error& error)
+{
+	return (pe.get_pe_type() == pe_type_32 ?
+		try_get_import_table_base<pe_types_class_32>(pe, imports, error)
+		: try_get_import_table_base<pe_types_class_64>(pe, imports, error));
+}
+
+bool try_get_imported_functions(const pe_base& pe, imported_functions_list& imports, pe_error& error)
+{
+	import_table table;
+	if(!try_get_import_table(pe, table, error))
+		return false;
+
+	imports = table.to_imported_functions_list(imports.get_allocator().resource());
+	return true;
+}
+
 //Returns imported functions list with related libraries info
 template<typename PEClassType>
-const imported_functions_list get_imported_functions_base(const pe_base& pe)
+const imported_functions_list get_imported_functions_base(const pe_base& pe, std::pmr::memory_resource* resource)
+{
+	return get_import_table_base<PEClassType>(pe).to_imported_functions_list(resource);
+}
+
+//Returns compact imports table
+//Thunk arrays are validated once per library and then walked by pointer
+template<typename PEClassType>
+import_table get_import_table_base(const pe_base& pe)
+{
+	import_table ret;
+	pe_error error;
+	if(!try_get_import_table_base<PEClassType>(pe, ret, error))
+		error.raise();
+
+	return ret;
+}
+
+//Non-throwing version of get_import_table_base, ret must be empty
+template<typename PEClassType>
+bool try_get_import_table_base(const pe_base& pe, import_table& ret, pe_error& error)
 {
-	imported_functions_list ret;
+	typedef typename PEClassType::BaseSize thunk_type;
 
-	//If image has no imports, return empty array
+	//If image has no imports, return empty table
 	if(!pe.has_imports())
-		return ret;
+		return true;
+
+	rva_data_cache cache(pe);
 
-	unsigned long current_descriptor_pos = pe.get_directory_rva(image_directory_entry_import);
+	uint32_t current_descriptor_pos = pe.get_directory_rva(image_directory_entry_import);
 	//Get first IMAGE_IMPORT_DESCRIPTOR
-	image_import_descriptor import_descriptor = pe.section_data_from_rva<image_import_descriptor>(current_descriptor_pos, section_data_virtual, true);
+	image_import_descriptor import_descriptor = image_import_descriptor();
+	if(!cache.try_read(current_descriptor_pos, import_descriptor, pe_exception::rva_not_exists, error))
+		return false;
 
 	//Iterate them until we reach zero-element
-	//We don't need to check correctness of this, because exception will be thrown
-	//inside of loop if we go outsize of section
 	while(import_descriptor.Name)
 	{
-		//Get imported library information
-		import_library lib;
-
-		unsigned long max_name_length;
-		//Get byte count that we have for library name
-		if((max_name_length = pe.section_data_length_from_rva(import_descriptor.Name, import_descriptor.Name, section_data_virtual, true)) < 2)
-			throw pe_exception("Incorrect import directory", pe_exception::incorrect_import_directory);
-
-		//Get DLL name pointer
-		const char* dll_name = pe.section_data_from_rva(import_descriptor.Name, section_data_virtual, true);
-
-		//Check for null-termination
-		if(!pe_utils::is_null_terminated(dll_name, max_name_length))
-			throw pe_exception("Incorrect import directory", pe_exception::incorrect_import_directory);
-
-		//Set library name
-		lib.set_name(dll_name);
-		//Set library timestamp
-		lib.set_timestamp(import_descriptor.TimeDateStamp);
-		//Set library RVA to IAT and original IAT
-		lib.set_rva_to_iat(import_descriptor.FirstThunk);
-		lib.set_rva_to_original_iat(import_descriptor.OriginalFirstThunk);
-
-		//Get RVA to IAT (it must be filled by loader when loading PE)
-		uint32_t current_thunk_rva = import_descriptor.FirstThunk;
-		typename PEClassType::BaseSize import_address_table = pe.section_data_from_rva<typename PEClassType::BaseSize>(current_thunk_rva, section_data_virtual, true);
-
-		//Get RVA to original IAT (lookup table), which must handle imported functions names
+		//Get DLL name and check for null-termination
+		uint32_t max_name_length;
+		const char* dll_name = cache.try_get(import_descriptor.Name, max_name_length, error);
+		if(!dll_name)
+			return false;
+
+		if(max_name_length < 2)
+			return error.set("Incorrect import directory", pe_exception::incorrect_import_directory);
+
+		const void* dll_name_end = memchr(dll_name, 0, max_name_length);
+		if(!dll_name_end)
+			return error.set("Incorrect import directory", pe_exception::incorrect_import_directory);
+
+		ret.add_library(std::string_view(dll_name, static_cast<const char*>(dll_name_end) - dll_name),
+			import_descriptor.FirstThunk, import_descriptor.OriginalFirstThunk, import_descriptor.TimeDateStamp);
+
+		//Get IAT (it must be filled by loader when loading PE)
+		uint32_t iat_available;
+		const char* iat = cache.try_get(import_descriptor.FirstThunk, iat_available, error);
+		if(!iat)
+			return false;
+
+		if(iat_available < sizeof(thunk_type))
+			return error.set("Incorrect import directory", pe_exception::incorrect_import_directory);
+
+		//Get original IAT (lookup table), which must handle imported functions names
 		//Some linkers leave this pointer zero-filled
 		//Such image is valid, but it is not possible to restore imported functions names
 		//afted image was loaded, because IAT becomes the only one table
 		//containing both function names and function RVAs after loading
-		uint32_t current_original_thunk_rva = import_descriptor.OriginalFirstThunk;
-		typename PEClassType::BaseSize import_lookup_table = current_original_thunk_rva == 0 ? import_address_table : pe.section_data_from_rva<typename PEClassType::BaseSize>(current_original_thunk_rva, section_data_virtual, true);
-		if(current_original_thunk_rva == 0)
-			current_original_thunk_rva = current_thunk_rva;
+		uint32_t lookup_available = iat_available;
+		const char* lookup = iat;
+		if(import_descriptor.OriginalFirstThunk)
+		{
+			lookup = cache.try_get(import_descriptor.OriginalFirstThunk, lookup_available, error);
+			if(!lookup)
+				return false;
+
+			if(lookup_available < sizeof(thunk_type))
+				return error.set("Incorrect import directory", pe_exception::incorrect_import_directory);
+		}
+
+		thunk_type address, lookup_value;
+		memcpy(&address, iat, sizeof(thunk_type));
+		memcpy(&lookup_value, lookup, sizeof(thunk_type));
 
 		//List all imported functions for current DLL
-		if(import_lookup_table != 0 && import_address_table != 0)
+		if(address != 0 && lookup_value != 0)
 		{
-			while(true)
+			//Find terminating null thunk of IAT, it must be inside section
+			uint32_t count = 0;
+			uint32_t max_count = iat_available / sizeof(thunk_type);
+			for(; count != max_count; ++count)
 			{
-				//Imported function description
-				imported_function func;
-
-				//Get VA from IAT
-				typename PEClassType::BaseSize address = pe.section_data_from_rva<typename PEClassType::BaseSize>(current_thunk_rva, section_data_virtual, true);
-				//Move pointer
-				current_thunk_rva += sizeof(typename PEClassType::BaseSize);
-
-				//Jump to next DLL if we finished with this one
+				memcpy(&address, iat + count * sizeof(thunk_type), sizeof(thunk_type));
 				if(!address)
 					break;
+			}
 
-				func.set_iat_va(address);
+			//Lookup table must have as many thunks as IAT
+			if(count == max_count || lookup_available / sizeof(thunk_type) < count)
+				return error.set("Incorrect import directory", pe_exception::incorrect_import_directory);
 
-				//Get VA from original IAT
-				typename PEClassType::BaseSize lookup = pe.section_data_from_rva<typename PEClassType::BaseSize>(current_original_thunk_rva, section_data_virtual, true);
-				//Move pointer
-				current_original_thunk_rva += sizeof(typename PEClassType::BaseSize);
+			for(uint32_t i = 0; i != count; ++i)
+			{
+				memcpy(&address, iat + i * sizeof(thunk_type), sizeof(thunk_type));
+				memcpy(&lookup_value, lookup + i * sizeof(thunk_type), sizeof(thunk_type));
 
 				//Check if function is imported by ordinal
-				if((lookup & PEClassType::ImportSnapFlag) != 0)
+				if((lookup_value & PEClassType::ImportSnapFlag) != 0)
 				{
-					//Set function ordinal
-					func.set_ordinal(static_cast<uint16_t>(lookup & 0xffff));
+					ret.add_function(import_table::no_name, 0, static_cast<uint16_t>(lookup_value & 0xffff), address);
 				}
 				else
 				{
-					//Get byte count that we have for function name
-					if(lookup > static_cast<uint32_t>(-1) - sizeof(uint16_t))
-						throw pe_exception("Incorrect import directory", pe_exception::incorrect_import_directory);
+					if(lookup_value > static_cast<uint32_t>(-1) - sizeof(uint16_t))
+						return error.set("Incorrect import directory", pe_exception::incorrect_import_directory);
 
-					//Get maximum available length of function name
-					if((max_name_length = pe.section_data_length_from_rva(static_cast<uint32_t>(lookup + sizeof(uint16_t)), static_cast<uint32_t>(lookup + sizeof(uint16_t)), section_data_virtual, true)) < 2)
-						throw pe_exception("Incorrect import directory", pe_exception::incorrect_import_directory);
+					//HINT in import table is ORDINAL in export table
+					uint32_t hint_name_rva = static_cast<uint32_t>(lookup_value);
+					uint32_t hint_name_available;
+					const char* hint_name = cache.try_get(hint_name_rva, hint_name_available, error);
+					if(!hint_name)
+						return false;
 
-					//Get imported function name
-					const char* func_name = pe.section_data_from_rva(static_cast<uint32_t>(lookup + sizeof(uint16_t)), section_data_virtual, true);
+					//Hint and at least one name byte with null-termination
+					if(hint_name_available < sizeof(uint16_t) + 2)
+						return error.set("Incorrect import directory", pe_exception::incorrect_import_directory);
 
-					//Check for null-termination
-					if(!pe_utils::is_null_terminated(func_name, max_name_length))
-						throw pe_exception("Incorrect import directory", pe_exception::incorrect_import_directory);
+					const char* func_name = hint_name + sizeof(uint16_t);
+					const void* name_end = memchr(func_name, 0, hint_name_available - sizeof(uint16_t));
+					if(!name_end)
+						return error.set("Incorrect import directory", pe_exception::incorrect_import_directory);
 
-					//HINT in import table is ORDINAL in export table
-					uint16_t hint = pe.section_data_from_rva<uint16_t>(static_cast<uint32_t>(lookup), section_data_virtual, true);
+					uint16_t hint;
+					memcpy(&hint, hint_name, sizeof(hint));
 
-					//Save hint and name
-					func.set_name(func_name);
-					func.set_hint(hint);
+					ret.add_function(ret.intern(std::string_view(func_name, static_cast<const char*>(name_end) - func_name)), hint, 0, address);
 				}
-
-				//Add function to list
-				lib.add_import(func);
 			}
 		}
 
 		//Check possible overflow
 		if(!pe_utils::is_sum_safe(current_descriptor_pos, sizeof(image_import_descriptor)))
-			throw pe_exception("Incorrect import directory", pe_exception::incorrect_import_directory);
+			return error.set("Incorrect import directory", pe_exception::incorrect_import_directory);
 
 		//Go to next library
 		current_descriptor_pos += sizeof(image_import_descriptor);
-		import_descriptor = pe.section_data_from_rva<image_import_descriptor>(current_descriptor_pos, section_data_virtual, true);
-
-		//Save import information
-		ret.push_back(lib);
+		if(!cache.try_read(current_descriptor_pos, import_descriptor, pe_exception::rva_not_exists, error))
+			return false;
 	}
 
-	//Return resulting list
-	return ret;
+	return true;
 }
 
 
@@ -455,7 +664,7 @@ const image_directory rebuild_imports_base(pe_base& pe, const imported_functions
 		(import_section.empty() || pe_utils::align_up(import_section.get_size_of_raw_data(), pe.get_file_alignment()) < needed_size + import_settings.get_offset_from_section_start()))
 		throw pe_exception("Insufficient space for import directory", pe_exception::insufficient_space);
 
-	std::string& raw_data = import_section.get_raw_data();
+	section_buffer& raw_data = import_section.get_raw_buffer();
 
 	//This will be done only if image_section is the last section of image or for section with unaligned raw length of data
 	if(raw_data.length() < needed_size + import_settings.get_offset_from_section_start())
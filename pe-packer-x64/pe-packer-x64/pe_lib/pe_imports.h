@@ -1,23 +1,40 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory_resource>
 #include "pe_structures.h"
 #include "pe_directory.h"
 #include "pe_base.h"
+#include "string_pool.h"
 
 namespace pe_bliss
 {
 //Class representing imported function
+//Name is allocated from memory resource of the function
 class imported_function
 {
+public:
+	typedef std::pmr::string::allocator_type allocator_type;
+
 public:
 	//Default constructor
 	imported_function();
 
+	//Allocator-extended constructors, used by import_library to pass its memory resource
+	explicit imported_function(const allocator_type& alloc);
+	imported_function(const imported_function& other, const allocator_type& alloc);
+	imported_function(imported_function&& other, const allocator_type& alloc);
+
+	imported_function(const imported_function& other) = default;
+	imported_function(imported_function&& other) = default;
+	imported_function& operator=(const imported_function& other) = default;
+	imported_function& operator=(imported_function&& other) = default;
+
 	//Returns true if imported function has name (and hint)
 	bool has_name() const;
 	//Returns name of function
-	const std::string& get_name() const;
+	const std::pmr::string& get_name() const;
 	//Returns hint
 	uint16_t get_hint() const;
 	//Returns ordinal of function
@@ -29,7 +46,7 @@ public:
 public: //Setters do not change everything inside image, they are used by PE class
 	//You also can use them to rebuild image imports
 	//Sets name of function
-	void set_name(const std::string& name);
+	void set_name(std::string_view name);
 	//Sets hint
 	void set_hint(uint16_t hint);
 	//Sets ordinal
@@ -39,24 +56,40 @@ public: //Setters do not change everything inside image, they are used by PE cla
 	void set_iat_va(uint64_t rva);
 
 private:
-	std::string name_; //Function name
+	std::pmr::string name_; //Function name
 	uint16_t hint_; //Hint
 	uint16_t ordinal_; //Ordinal
 	uint64_t iat_va_;
 };
 
 //Class representing imported library information
+//Name and imported functions are allocated from memory resource of the library, so whole imported_functions_list
+//may be placed to one arena (for example, std::pmr::monotonic_buffer_resource)
 class import_library
 {
 public:
-	typedef std::vector<imported_function> imported_list;
+	typedef std::pmr::vector<imported_function> imported_list;
+	typedef imported_list::allocator_type allocator_type;
 
 public:
 	//Default constructor
 	import_library();
 
+	//Allocator-extended constructors, used by imported_functions_list to pass its memory resource
+	explicit import_library(const allocator_type& alloc);
+	import_library(const import_library& other, const allocator_type& alloc);
+	import_library(import_library&& other, const allocator_type& alloc);
+
+	import_library(const import_library& other) = default;
+	import_library(import_library&& other) = default;
+	import_library& operator=(const import_library& other) = default;
+	import_library& operator=(import_library&& other) = default;
+
+	//Returns memory resource name and imported functions are allocated from
+	allocator_type get_allocator() const;
+
 	//Returns name of library
-	const std::string& get_name() const;
+	const std::pmr::string& get_name() const;
 	//Returns RVA to Import Address Table (IAT)
 	uint32_t get_rva_to_iat() const;
 	//Returns RVA to Original Import Address Table (Original IAT)
@@ -70,7 +103,7 @@ public:
 public: //Setters do not change everything inside image, they are used by PE class
 	//You also can use them to rebuild image imports
 	//Sets name of library
-	void set_name(const std::string& name);
+	void set_name(std::string_view name);
 	//Sets RVA to Import Address Table (IAT)
 	void set_rva_to_iat(uint32_t rva_to_iat);
 	//Sets RVA to Original Import Address Table (Original IAT)
@@ -80,11 +113,14 @@ public: //Setters do not change everything inside image, they are used by PE cla
 
 	//Adds imported function
 	void add_import(const imported_function& func);
+	void add_import(imported_function&& func);
+	//Reserves space for count imported functions
+	void reserve_imports(std::size_t count);
 	//Clears imported functions list
 	void clear_imports();
 
 private:
-	std::string name_; //Library name
+	std::pmr::string name_; //Library name
 	uint32_t rva_to_iat_; //RVA to IAT
 	uint32_t rva_to_original_iat_; //RVA to original IAT
 	uint32_t timestamp_; //DLL TimeStamp
@@ -163,14 +199,102 @@ private:
 	bool auto_strip_last_section_;
 };
 
-typedef std::vector<import_library> imported_functions_list;
+typedef std::pmr::vector<import_library> imported_functions_list;
+
+//Compact read-only view of image imports
+//Functions of all libraries are stored in one array, names are interned in a string pool,
+//so parsing doesn't allocate per function
+class import_table
+{
+public:
+	//Name index of function imported by ordinal
+	static const uint32_t no_name = static_cast<uint32_t>(-1);
+
+	struct function
+	{
+		uint32_t name; //Index of name in string pool or no_name
+		uint16_t hint;
+		uint16_t ordinal;
+		uint64_t iat_va;
+	};
+
+	struct library
+	{
+		uint32_t name; //Index of name in string pool
+		uint32_t rva_to_iat;
+		uint32_t rva_to_original_iat;
+		uint32_t timestamp;
+		uint32_t first_function; //Index of first function of library in functions array
+		uint32_t number_of_functions;
+	};
+
+	typedef std::vector<library> library_list;
+	typedef std::vector<function> function_list;
+
+public:
+	//Default constructor
+	import_table();
+
+	import_table(import_table&& other) = default;
+	import_table& operator=(import_table&& other) = default;
+
+	//Returns libraries list
+	const library_list& get_libraries() const;
+	//Returns functions of all libraries
+	const function_list& get_functions() const;
+	//Returns pointer to first function of library (number_of_functions functions follow it)
+	const function* get_functions(const library& lib) const;
+
+	//Returns name of library
+	std::string_view get_name(const library& lib) const;
+	//Returns name of function (empty, if function is imported by ordinal)
+	std::string_view get_name(const function& func) const;
+
+	//Returns string pool containing library and function names
+	const string_pool& get_strings() const;
+
+	//Converts table to imported_functions_list
+	const imported_functions_list to_imported_functions_list(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+public: //Used by import parser
+	//Adds library, its functions must be added right after this call
+	void add_library(std::string_view name, uint32_t rva_to_iat, uint32_t rva_to_original_iat, uint32_t timestamp);
+	//Adds function to the last added library
+	void add_function(uint32_t name, uint16_t hint, uint16_t ordinal, uint64_t iat_va);
+	//Interns string in table string pool
+	uint32_t intern(std::string_view str);
+
+private:
+	import_table(const import_table&);
+	import_table& operator=(const import_table&);
+
+	library_list libraries_;
+	function_list functions_;
+	string_pool strings_;
+};
+
+
+//Returns imported functions list with related libraries info, allocated from resource
+const imported_functions_list get_imported_functions(const pe_base& pe, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+template<typename PEClassType>
+const imported_functions_list get_imported_functions_base(const pe_base& pe, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+//Non-throwing version, returns false and sets error if import directory is incorrect
+//Libraries are allocated from memory resource of imports
+bool try_get_imported_functions(const pe_base& pe, imported_functions_list& imports, pe_error& error);
 
+//Returns compact imports table, faster than get_imported_functions() for images with many imports
+import_table get_import_table(const pe_base& pe);
+
+template<typename PEClassType>
+import_table get_import_table_base(const pe_base& pe);
 
-//Returns imported functions list with related libraries info
-const imported_functions_list get_imported_functions(const pe_base& pe);
+//Non-throwing version, imports must be empty
+bool try_get_import_table(const pe_base& pe, import_table& imports, pe_error& error);
 
 template<typename PEClassType>
-const imported_functions_list get_imported_functions_base(const pe_base& pe);
+bool try_get_import_table_base(const pe_base& pe, import_table& imports, pe_error& error);
 
 
 //You can get all image imports with get_imported_functions() function
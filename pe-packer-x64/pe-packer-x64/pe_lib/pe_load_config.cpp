@@ -417,7 +417,7 @@ const image_directory rebuild_image_config_base(pe_base& pe, const image_config_
 		(image_config_section.empty() || pe_utils::align_up(image_config_section.get_size_of_raw_data(), pe.get_file_alignment()) < needed_size + image_config_data_pos))
 		throw pe_exception("Insufficient space for TLS directory", pe_exception::insufficient_space);
 
-	std::string& raw_data = image_config_section.get_raw_data();
+	section_buffer& raw_data = image_config_section.get_raw_buffer();
 
 	//This will be done only if image_config_section is the last section of image or for section with unaligned raw length of data
 	if(raw_data.length() < needed_size + image_config_data_pos)
@@ -1,8 +1,11 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 #include "pe_rebuilder.h"
 #include "pe_base.h"
 #include "pe_structures.h"
 #include "pe_exception.h"
-#include "../handler/handler.hpp"
 
 namespace pe_bliss
 {
@@ -78,18 +81,18 @@ void rebuild_pe(pe_base& pe, image_dos_header& dos_header, bool strip_dos_header
 	}
 }
 
-//Rebuild PE image and write it to "out" ostream
-//If strip_dos_header is true, DOS headers partially will be used for PE headers
-//If change_size_of_headers == true, SizeOfHeaders will be recalculated automatically
-//If save_bound_import == true, existing bound import directory will be saved correctly (because some compilers and bind.exe put it to PE headers)
-void rebuild_pe(pe_base& pe, std::ostream& out, bool strip_dos_header, bool change_size_of_headers, bool save_bound_import)
+//Rebuilds PE image headers and writes them (with bound import data) to "out" ostream
+//Section data is not written
+void rebuild_pe_headers(pe_base& pe, std::ostream& out, bool strip_dos_header, bool change_size_of_headers, bool save_bound_import)
 {
-	error_handling(out.bad(), "[ pebliss ] error", "stream is bad");
+	if(out.bad())
+		throw pe_exception("Stream is bad", pe_exception::stream_is_bad);
 
 	if(save_bound_import && pe.has_bound_import())
 	{
-		error_handling(pe.section_data_length_from_rva(pe.get_directory_rva(image_directory_entry_bound_import), pe.get_directory_rva(image_directory_entry_bound_import), section_data_raw, true)
-			< pe.get_directory_size(image_directory_entry_bound_import), "[ pebliss ] error", "incorrect bound import directory");
+		if(pe.section_data_length_from_rva(pe.get_directory_rva(image_directory_entry_bound_import), pe.get_directory_rva(image_directory_entry_bound_import), section_data_raw, true)
+			< pe.get_directory_size(image_directory_entry_bound_import))
+			throw pe_exception("Incorrect bound import directory", pe_exception::incorrect_bound_import_directory);
 	}
 
 	//Change ostream state
@@ -142,7 +145,7 @@ void rebuild_pe(pe_base& pe, std::ostream& out, bool strip_dos_header, bool chan
 		if(it == sections.end() - 1) //If last section encountered
 		{
 			image_section_header header((*it).get_raw_header());
-			header.SizeOfRawData = static_cast<uint32_t>((*it).get_raw_data().length()); //Set non-aligned actual data length for it
+			header.SizeOfRawData = static_cast<uint32_t>((*it).get_raw_view().length()); //Set non-aligned actual data length for it
 			out.write(reinterpret_cast<const char*>(&header), sizeof(image_section_header));
 		}
 		else
@@ -157,20 +160,123 @@ void rebuild_pe(pe_base& pe, std::ostream& out, bool strip_dos_header, bool chan
 		out.write(pe.section_data_from_rva(original_bound_import_rva, section_data_raw, true),
 			pe.get_directory_size(image_directory_entry_bound_import));
 	}
+}
+
+//Rebuild PE image and write it to "out" ostream
+//If strip_dos_header is true, DOS headers partially will be used for PE headers
+//If change_size_of_headers == true, SizeOfHeaders will be recalculated automatically
+//If save_bound_import == true, existing bound import directory will be saved correctly (because some compilers and bind.exe put it to PE headers)
+void rebuild_pe(pe_base& pe, std::ostream& out, bool strip_dos_header, bool change_size_of_headers, bool save_bound_import)
+{
+	rebuild_pe_headers(pe, out, strip_dos_header, change_size_of_headers, save_bound_import);
+
+	static const char zeros[0x200] = {0};
 
 	//Write section data finally
+	const section_list& sections = pe.get_image_sections();
 	for(section_list::const_iterator it = sections.begin(); it != sections.end(); ++it)
 	{
 		const section& s = *it;
 
 		std::streamoff wpos = out.tellp();
 
-		//Fill unused overlay data between sections with null bytes
-		for(unsigned int i = 0; i < s.get_pointer_to_raw_data() - wpos; i++)
-			out.put(0);
+		//Fill unused overlay data between sections with null bytes, by blocks instead of byte by byte
+		if(wpos >= 0 && s.get_pointer_to_raw_data() > static_cast<uint64_t>(wpos))
+		{
+			for(uint64_t left = s.get_pointer_to_raw_data() - wpos; left; )
+			{
+				uint64_t size = std::min<uint64_t>(left, sizeof(zeros));
+				out.write(zeros, size);
+				left -= size;
+			}
+		}
 
 		//Write raw section data
-		out.write(s.get_raw_data().data(), s.get_raw_data().length());
+		std::string_view data = s.get_raw_view();
+		out.write(data.data(), data.length());
+	}
+}
+
+//Rebuild PE image and write it to file, copying unchanged section data from source file
+void rebuild_pe_incremental(pe_base& pe, const std::string& source_file_name, const std::string& out_file_name,
+	bool strip_dos_header, bool change_size_of_headers, bool save_bound_import)
+{
+	//Headers are small, they're always rebuilt
+	std::ostringstream headers;
+	rebuild_pe_headers(pe, headers, strip_dos_header, change_size_of_headers, save_bound_import);
+
+	const section_list& sections = pe.get_image_sections();
+
+	//Check if there's any section data which stays in place
+	bool has_data_in_place = false;
+	for(section_list::const_iterator it = sections.begin(); it != sections.end(); ++it)
+	{
+		if((*it).get_source_offset() == (*it).get_pointer_to_raw_data() && !(*it).get_raw_view().empty())
+			has_data_in_place = true;
+	}
+
+	//Copy source file, its data at unchanged places will not be written then
+	std::error_code ec;
+	bool copied = false;
+	if(has_data_in_place)
+	{
+		if(std::filesystem::equivalent(source_file_name, out_file_name, ec))
+			copied = true;
+		else
+			copied = std::filesystem::copy_file(source_file_name, out_file_name, std::filesystem::copy_options::overwrite_existing, ec) && !ec;
+	}
+
+	std::fstream out(out_file_name.c_str(), copied
+		? std::ios::in | std::ios::out | std::ios::binary
+		: std::ios::out | std::ios::trunc | std::ios::binary);
+	if(!out)
+		throw pe_exception("Stream is bad", pe_exception::stream_is_bad);
+
+	const std::string& headers_data = headers.str();
+	out.write(headers_data.data(), headers_data.length());
+
+	static const char zeros[0x200] = {0};
+
+	uint64_t pos = headers_data.length();
+	for(section_list::const_iterator it = sections.begin(); it != sections.end(); ++it)
+	{
+		const section& s = *it;
+
+		//Fill unused overlay data between sections with null bytes
+		if(s.get_pointer_to_raw_data() > pos)
+		{
+			out.seekp(pos);
+			for(uint64_t left = s.get_pointer_to_raw_data() - pos; left; )
+			{
+				uint64_t size = std::min<uint64_t>(left, sizeof(zeros));
+				out.write(zeros, size);
+				left -= size;
+			}
+
+			pos = s.get_pointer_to_raw_data();
+		}
+
+		//Write raw section data, if it is not in place already
+		std::string_view data = s.get_raw_view();
+		if(!copied || s.get_source_offset() != s.get_pointer_to_raw_data())
+		{
+			out.seekp(pos);
+			out.write(data.data(), data.length());
+		}
+
+		pos += data.length();
+	}
+
+	out.close();
+	if(out.fail())
+		throw pe_exception("Stream is bad", pe_exception::stream_is_bad);
+
+	//Source file may have been longer (overlay, old sections data)
+	if(copied)
+	{
+		std::filesystem::resize_file(out_file_name, pos, ec);
+		if(ec)
+			throw pe_exception("Stream is bad", pe_exception::stream_is_bad);
 	}
 }
 }
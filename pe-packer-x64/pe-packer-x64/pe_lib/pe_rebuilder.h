@@ -1,5 +1,6 @@
 #pragma once
 #include <ostream>
+#include <string>
 
 namespace pe_bliss
 {
@@ -8,4 +9,12 @@ class pe_base;
 //If change_size_of_headers == true, SizeOfHeaders will be recalculated automatically
 //If save_bound_import == true, existing bound import directory will be saved correctly (because some compilers and bind.exe put it to PE headers)
 void rebuild_pe(pe_base& pe, std::ostream& out, bool strip_dos_header = false, bool change_size_of_headers = true, bool save_bound_import = true);
+
+//Rebuilds PE image the same way and writes resulting image to file "out_file_name"
+//"source_file_name" is the file image was read from. Source file is copied by file system first
+//(std::filesystem::copy_file, which uses copy_file_range, block cloning or CopyFile where available),
+//then only headers and sections changed since reading (see section::get_source_offset()) are written
+//If out_file_name is source_file_name, file is patched in place
+void rebuild_pe_incremental(pe_base& pe, const std::string& source_file_name, const std::string& out_file_name,
+	bool strip_dos_header = false, bool change_size_of_headers = true, bool save_bound_import = true);
 }
@@ -1,4 +1,5 @@
 #include <string.h>
+#include <algorithm>
 #include "pe_relocations.h"
 #include "pe_properties_generic.h"
 
@@ -81,6 +82,32 @@ relocation_table::relocation_table(uint32_t rva)
 	:rva_(rva)
 {}
 
+//Constructor with memory resource of relocation list
+relocation_table::relocation_table(const allocator_type& alloc)
+	:rva_(0), relocations_(alloc)
+{}
+
+//Constructor from RVA of relocation table and memory resource of relocation list
+relocation_table::relocation_table(uint32_t rva, const allocator_type& alloc)
+	:rva_(rva), relocations_(alloc)
+{}
+
+//Copy constructor to other memory resource
+relocation_table::relocation_table(const relocation_table& other, const allocator_type& alloc)
+	:rva_(other.rva_), relocations_(other.relocations_, alloc)
+{}
+
+//Move constructor to other memory resource, copies relocation list if resources differ
+relocation_table::relocation_table(relocation_table&& other, const allocator_type& alloc)
+	:rva_(other.rva_), relocations_(std::move(other.relocations_), alloc)
+{}
+
+//Returns memory resource relocation list is allocated from
+relocation_table::allocator_type relocation_table::get_allocator() const
+{
+	return relocations_.get_allocator();
+}
+
 //Returns RVA of block
 uint32_t relocation_table::get_rva() const
 {
@@ -101,26 +128,42 @@ relocation_table::relocation_list& relocation_table::get_relocations()
 
 //Get relocation list of pe file, supports one-word sized relocations only
 //If list_absolute_entries = true, IMAGE_REL_BASED_ABSOLUTE will be listed
-const relocation_table_list get_relocations(const pe_base& pe, bool list_absolute_entries)
+const relocation_table_list get_relocations(const pe_base& pe, bool list_absolute_entries, std::pmr::memory_resource* resource)
+{
+	relocation_table_list ret(resource);
+	pe_error error;
+	if(!try_get_relocations(pe, ret, error, list_absolute_entries))
+		error.raise();
+
+	return ret;
+}
+
+//Non-throwing version of get_relocations
+bool try_get_relocations(const pe_base& pe, relocation_table_list& relocs, pe_error& error, bool list_absolute_entries)
 {
-	relocation_table_list ret;
+	relocs.clear();
 
 	//If image does not have relocations
 	if(!pe.has_reloc())
-		return ret;
+		return true;
 
 	//Check the length in bytes of the section containing relocation directory
-	if(pe.section_data_length_from_rva(pe.get_directory_rva(image_directory_entry_basereloc),
-		pe.get_directory_rva(image_directory_entry_basereloc), section_data_virtual, true)
-		< sizeof(image_base_relocation))
-		throw pe_exception("Incorrect relocation directory", pe_exception::incorrect_relocation_directory);
+	uint32_t length;
+	if(!pe.try_section_data_length_from_rva(pe.get_directory_rva(image_directory_entry_basereloc),
+		pe.get_directory_rva(image_directory_entry_basereloc), length, error, section_data_virtual, true))
+		return false;
+
+	if(length < sizeof(image_base_relocation))
+		return error.set("Incorrect relocation directory", pe_exception::incorrect_relocation_directory);
 
 	unsigned long current_pos = pe.get_directory_rva(image_directory_entry_basereloc);
 	//First IMAGE_BASE_RELOCATION table
-	image_base_relocation reloc_table = pe.section_data_from_rva<image_base_relocation>(current_pos, section_data_virtual, true);
+	image_base_relocation reloc_table = image_base_relocation();
+	if(!pe.try_section_data_from_rva(current_pos, reloc_table, error, section_data_virtual, true))
+		return false;
 
 	if(reloc_table.SizeOfBlock % 2)
-		throw pe_exception("Incorrect relocation directory", pe_exception::incorrect_relocation_directory);
+		return error.set("Incorrect relocation directory", pe_exception::incorrect_relocation_directory);
 
 	unsigned long reloc_size = pe.get_directory_size(image_directory_entry_basereloc);
 	unsigned long read_size = 0;
@@ -128,35 +171,45 @@ const relocation_table_list get_relocations(const pe_base& pe, bool list_absolut
 	//reloc_table.VirtualAddress is not checked (not so important)
 	while(reloc_table.SizeOfBlock && read_size < reloc_size)
 	{
-		//Create relocation table
-		relocation_table table;
-		//Save RVA
-		table.set_rva(reloc_table.VirtualAddress);
+		//Create relocation table in memory resource of list
+		relocation_table table(reloc_table.VirtualAddress, relocs.get_allocator());
 
 		if(!pe_utils::is_sum_safe(current_pos, reloc_table.SizeOfBlock))
-			throw pe_exception("Incorrect relocation directory", pe_exception::incorrect_relocation_directory);
+			return error.set("Incorrect relocation directory", pe_exception::incorrect_relocation_directory);
+
+		//Reserve relocation list, but not more than section data after block header holds
+		uint32_t block_length;
+		pe_error length_error;
+		if(reloc_table.SizeOfBlock > sizeof(image_base_relocation)
+			&& pe.try_section_data_length_from_rva(current_pos, current_pos, block_length, length_error, section_data_virtual, true))
+			table.get_relocations().reserve(((std::min)(reloc_table.SizeOfBlock, block_length) - sizeof(image_base_relocation)) / sizeof(uint16_t));
 
 		//List all relocations
 		for(unsigned long i = sizeof(image_base_relocation); i < reloc_table.SizeOfBlock; i += sizeof(uint16_t))
 		{
-			relocation_entry entry(pe.section_data_from_rva<uint16_t>(current_pos + i, section_data_virtual, true));
+			uint16_t item = 0;
+			if(!pe.try_section_data_from_rva(current_pos + i, item, error, section_data_virtual, true))
+				return false;
+
+			relocation_entry entry(item);
 			if(list_absolute_entries || entry.get_type() != image_rel_based_absolute)
 				table.add_relocation(entry);
 		}
 
 		//Save table
-		ret.push_back(table);
+		relocs.push_back(std::move(table));
 		
 		//Go to next relocation block
 		if(!pe_utils::is_sum_safe(current_pos, reloc_table.SizeOfBlock))
-			throw pe_exception("Incorrect relocation directory", pe_exception::incorrect_relocation_directory);
+			return error.set("Incorrect relocation directory", pe_exception::incorrect_relocation_directory);
 
 		current_pos += reloc_table.SizeOfBlock;
 		read_size += reloc_table.SizeOfBlock;
-		reloc_table = pe.section_data_from_rva<image_base_relocation>(current_pos, section_data_virtual, true);
+		if(!pe.try_section_data_from_rva(current_pos, reloc_table, error, section_data_virtual, true))
+			return false;
 	}
 
-	return ret;
+	return true;
 }
 
 //Simple relocations rebuilder
@@ -192,7 +245,7 @@ const image_directory rebuild_relocations(pe_base& pe, const relocation_table_li
 		(reloc_section.empty() || pe_utils::align_up(reloc_section.get_size_of_raw_data(), pe.get_file_alignment()) < needed_size + current_reloc_data_pos))
 		throw pe_exception("Insufficient space for relocations directory", pe_exception::insufficient_space);
 
-	std::string& raw_data = reloc_section.get_raw_data();
+	section_buffer& raw_data = reloc_section.get_raw_buffer();
 
 	//This will be done only if reloc_section is the last section of image or for section with unaligned raw length of data
 	if(raw_data.length() < needed_size + current_reloc_data_pos)
@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
+#include <memory_resource>
 #include "pe_structures.h"
 #include "pe_base.h"
 #include "pe_directory.h"
@@ -44,10 +45,13 @@ private:
 };
 
 //Class representing relocation table
+//Relocation list is allocated from memory resource of the table, so whole relocation_table_list
+//may be placed to one arena (for example, std::pmr::monotonic_buffer_resource)
 class relocation_table
 {
 public:
-	typedef std::vector<relocation_entry> relocation_list;
+	typedef std::pmr::vector<relocation_entry> relocation_list;
+	typedef relocation_list::allocator_type allocator_type;
 
 public:
 	//Default constructor
@@ -55,6 +59,20 @@ public:
 	//Constructor from RVA of relocation table
 	explicit relocation_table(uint32_t rva);
 
+	//Allocator-extended constructors, used by relocation_table_list to pass its memory resource
+	explicit relocation_table(const allocator_type& alloc);
+	relocation_table(uint32_t rva, const allocator_type& alloc);
+	relocation_table(const relocation_table& other, const allocator_type& alloc);
+	relocation_table(relocation_table&& other, const allocator_type& alloc);
+
+	relocation_table(const relocation_table& other) = default;
+	relocation_table(relocation_table&& other) = default;
+	relocation_table& operator=(const relocation_table& other) = default;
+	relocation_table& operator=(relocation_table&& other) = default;
+
+	//Returns memory resource relocation list is allocated from
+	allocator_type get_allocator() const;
+
 	//Returns relocation list
 	const relocation_list& get_relocations() const;
 	//Returns RVA of block
@@ -75,11 +93,15 @@ private:
 	relocation_list relocations_;
 };
 
-typedef std::vector<relocation_table> relocation_table_list;
+typedef std::pmr::vector<relocation_table> relocation_table_list;
 
 //Get relocation list of pe file, supports one-word sized relocations only
 //If list_absolute_entries = true, IMAGE_REL_BASED_ABSOLUTE will be listed
-const relocation_table_list get_relocations(const pe_base& pe, bool list_absolute_entries = false);
+//Returned list and relocation tables are allocated from resource
+const relocation_table_list get_relocations(const pe_base& pe, bool list_absolute_entries = false, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+//Non-throwing version, returns false and sets error if relocation directory is incorrect
+//Tables are allocated from memory resource of relocs
+bool try_get_relocations(const pe_base& pe, relocation_table_list& relocs, pe_error& error, bool list_absolute_entries = false);
 
 //Simple relocations rebuilder
 //To keep PE file working, don't remove any of existing relocations in
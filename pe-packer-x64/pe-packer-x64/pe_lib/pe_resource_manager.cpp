@@ -17,6 +17,8 @@ pe_resource_manager::pe_resource_manager(resource_directory& root_directory)
 
 resource_directory& pe_resource_manager::get_root_directory()
 {
+	//Directory may be changed by caller
+	invalidate_indexes();
 	return root_dir_edit_;
 }
 
@@ -26,6 +28,8 @@ resource_directory& pe_resource_manager::get_root_directory()
 //Returns true if resource was deleted
 bool pe_resource_manager::remove_resource_type(resource_type type)
 {
+	invalidate_indexes();
+
 	//Search for resource type
 	resource_directory::entry_list& entries = root_dir_edit_.get_entry_list();
 	resource_directory::entry_list::iterator it = std::find_if(entries.begin(), entries.end(), resource_directory::id_entry_finder(type));
@@ -41,6 +45,8 @@ bool pe_resource_manager::remove_resource_type(resource_type type)
 
 bool pe_resource_manager::remove_resource(const std::wstring& root_name)
 {
+	invalidate_indexes();
+
 	//Search for resource type
 	resource_directory::entry_list& entries = root_dir_edit_.get_entry_list();
 	resource_directory::entry_list::iterator it = std::find_if(entries.begin(), entries.end(), resource_directory::name_entry_finder(root_name));
@@ -57,6 +63,8 @@ bool pe_resource_manager::remove_resource(const std::wstring& root_name)
 //Helper to remove resource
 bool pe_resource_manager::remove_resource(const resource_directory::entry_finder& root_finder, const resource_directory::entry_finder& finder)
 {
+	invalidate_indexes();
+
 	//Search for resource type
 	resource_directory::entry_list& entries_type = root_dir_edit_.get_entry_list();
 	resource_directory::entry_list::iterator it_type = std::find_if(entries_type.begin(), entries_type.end(), root_finder);
@@ -108,6 +116,8 @@ bool pe_resource_manager::remove_resource(const std::wstring& root_name, uint32_
 //Helper to remove resource
 bool pe_resource_manager::remove_resource(const resource_directory::entry_finder& root_finder, const resource_directory::entry_finder& finder, uint32_t language)
 {
+	invalidate_indexes();
+
 	//Search for resource type
 	resource_directory::entry_list& entries_type = root_dir_edit_.get_entry_list();
 	resource_directory::entry_list::iterator it_type = std::find_if(entries_type.begin(), entries_type.end(), root_finder);
@@ -187,6 +197,8 @@ void pe_resource_manager::add_resource(const std::string& data, const std::wstri
 //Helper to add/replace resource
 void pe_resource_manager::add_resource(const std::string& data, resource_directory_entry& new_root_entry, const resource_directory::entry_finder& root_finder, resource_directory_entry& new_entry, const resource_directory::entry_finder& finder, uint32_t language, uint32_t codepage, uint32_t timestamp)
 {
+	invalidate_indexes();
+
 	//Search for resource type
 	resource_directory::entry_list* entries = &root_dir_edit_.get_entry_list();
 	resource_directory::entry_list::iterator it = std::find_if(entries->begin(), entries->end(), root_finder);
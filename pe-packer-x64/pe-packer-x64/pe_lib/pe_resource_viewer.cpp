@@ -9,7 +9,16 @@ using namespace pe_win;
 
 //Constructor from root resource_directory
 pe_resource_viewer::pe_resource_viewer(const resource_directory& root_directory)
-	:root_dir_(root_directory)
+	:root_dir_(root_directory), indexes_(new index_state)
+{}
+
+//Copy constructor, indexes are built again on demand
+pe_resource_viewer::pe_resource_viewer(const pe_resource_viewer& other)
+	:root_dir_(other.root_dir_), indexes_(new index_state)
+{}
+
+pe_resource_viewer::index_state::index_state()
+	:string_index_built(false)
 {}
 
 const resource_directory& pe_resource_viewer::get_root_directory() const
@@ -358,4 +367,112 @@ const resource_data_info pe_resource_viewer::get_resource_data_by_id(const std::
 
 	return resource_data_info(entries.at(index).get_data_entry()); //Data directory
 }
+
+//Returns resource data entry by type, ID and language or null if there's no such resource
+const resource_data_entry* pe_resource_viewer::find_resource_data_by_id(uint32_t language, resource_type type, uint32_t id) const
+{
+	std::unique_lock<std::mutex> lock(indexes_->mutex);
+	index_map::iterator it = indexes_->id_indexes.find(type);
+	if(it == indexes_->id_indexes.end())
+	{
+		//Build index of all ID-resources of this type
+		index_list index;
+
+		const resource_directory::entry_list& types = root_dir_.get_entry_list();
+		resource_directory::entry_list::const_iterator type_entry = std::find_if(types.begin(), types.end(), resource_directory::id_entry_finder(type));
+		if(type_entry != types.end() && !(*type_entry).includes_data())
+		{
+			const resource_directory::entry_list& ids = (*type_entry).get_resource_directory().get_entry_list();
+			for(resource_directory::entry_list::const_iterator id_it = ids.begin(); id_it != ids.end(); ++id_it)
+			{
+				if((*id_it).is_named() || (*id_it).includes_data())
+					continue;
+
+				const resource_directory::entry_list& languages = (*id_it).get_resource_directory().get_entry_list();
+				for(resource_directory::entry_list::const_iterator lang_it = languages.begin(); lang_it != languages.end(); ++lang_it)
+				{
+					if((*lang_it).is_named() || !(*lang_it).includes_data())
+						continue;
+
+					index_entry entry;
+					entry.key = make_index_key((*id_it).get_id(), (*lang_it).get_id());
+					entry.data = &(*lang_it).get_data_entry();
+					entry.position = 0;
+					index.push_back(entry);
+				}
+			}
+		}
+
+		//Stable sort keeps first of duplicate entries first, as entry_by_id() does
+		std::stable_sort(index.begin(), index.end());
+		it = indexes_->id_indexes.insert(std::make_pair(static_cast<uint32_t>(type), index)).first;
+	}
+
+	const index_list& type_index = (*it).second;
+	lock.unlock();
+
+	const index_entry* entry = find_index_entry(type_index, make_index_key(id, language));
+	return entry ? entry->data : 0;
+}
+
+//Returns resource data entry by type, name and language or null if there's no such resource
+const resource_data_entry* pe_resource_viewer::find_resource_data_by_name(uint32_t language, resource_type type, const std::wstring& name) const
+{
+	//Type directory
+	const resource_directory_entry* entry = root_dir_.find_entry_by_id(type);
+	if(!entry || entry->includes_data())
+		return 0;
+
+	//Name/ID directory
+	entry = entry->get_resource_directory().find_entry_by_name(name);
+	if(!entry || entry->includes_data())
+		return 0;
+
+	//Language directory
+	entry = entry->get_resource_directory().find_entry_by_id(language);
+	if(!entry || !entry->includes_data())
+		return 0;
+
+	return &entry->get_data_entry();
+}
+
+//Drops lazily built indexes
+void pe_resource_viewer::invalidate_indexes() const
+{
+	std::lock_guard<std::mutex> lock(indexes_->mutex);
+	indexes_->id_indexes.clear();
+	indexes_->group_indexes.clear();
+	indexes_->string_index.clear();
+	indexes_->string_index_built = false;
+}
+
+bool pe_resource_viewer::index_entry::operator<(const index_entry& other) const
+{
+	return key < other.key;
+}
+
+//Returns index key for ID and language
+uint64_t pe_resource_viewer::make_index_key(uint32_t id, uint32_t language)
+{
+	return (static_cast<uint64_t>(id) << 32) | language;
+}
+
+//Returns first entry with key from sorted index or null
+const pe_resource_viewer::index_entry* pe_resource_viewer::find_index_entry(const index_list& index, uint64_t key)
+{
+	index_entry needle;
+	needle.key = key;
+	index_list::const_iterator it = std::lower_bound(index.begin(), index.end(), needle);
+	return it != index.end() && (*it).key == key ? &*it : 0;
+}
+
+//Returns all entries with key from sorted index as [first, last) range
+void pe_resource_viewer::find_index_entries(const index_list& index, uint64_t key, const index_entry*& first, const index_entry*& last)
+{
+	index_entry needle;
+	needle.key = key;
+	std::pair<index_list::const_iterator, index_list::const_iterator> range = std::equal_range(index.begin(), index.end(), needle);
+	first = range.first == range.second ? 0 : &*range.first;
+	last = first ? first + (range.second - range.first) : 0;
+}
 }
@@ -1,6 +1,9 @@
 #pragma once
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "pe_structures.h"
 #include "pe_resources.h"
 #include "message_table.h"
@@ -48,6 +51,8 @@ public:
 public:
 	//Constructor from root resource_directory from PE file
 	explicit pe_resource_viewer(const resource_directory& root_directory);
+	//Copy constructor, copy starts with empty indexes
+	pe_resource_viewer(const pe_resource_viewer& other);
 
 	const resource_directory& get_root_directory() const;
 
@@ -105,10 +110,68 @@ public:
 	//Returns raw resource data by root name, ID and index in language directory (instead of language)
 	const resource_data_info get_resource_data_by_id(const std::wstring& root_name, uint32_t id, uint32_t index = 0) const;
 
+public: //Indexed lookups
+	//Returns resource data entry by type, ID and language or null if there's no such resource
+	//Uses index of resources of this type, which is built on the first call
+	const resource_data_entry* find_resource_data_by_id(uint32_t language, resource_type type, uint32_t id) const;
+	//Returns resource data entry by type, name and language or null if there's no such resource
+	const resource_data_entry* find_resource_data_by_name(uint32_t language, resource_type type, const std::wstring& name) const;
+
+	//Drops lazily built indexes
+	//pe_resource_manager does it automatically, call it if resource directory was changed in other way
+	//Lookups from other threads must not run at the same time, as with changes of resource directory
+	void invalidate_indexes() const;
+
 protected:
 	//Root resource directory. We're not copying it, because it might be heavy
 	const resource_directory& root_dir_;
 
+	//Index entry: resource or group item, found by ID and language
+	struct index_entry
+	{
+		uint64_t key; //ID << 32 | language
+		const resource_data_entry* data;
+		uint32_t position; //Position of item inside group (for group indexes)
+
+		bool operator<(const index_entry& other) const;
+	};
+
+	typedef std::vector<index_entry> index_list;
+	typedef std::map<uint32_t, index_list> index_map;
+
+	//Returns index key for ID and language
+	static uint64_t make_index_key(uint32_t id, uint32_t language);
+	//Returns first entry with key from sorted index or null
+	static const index_entry* find_index_entry(const index_list& index, uint64_t key);
+	//Returns all entries with key from sorted index as [first, last) range, empty if there are no such entries
+	static void find_index_entries(const index_list& index, uint64_t key, const index_entry*& first, const index_entry*& last);
+
+	//Lazily built indexes
+	//They are owned separately, so viewer stays copyable (the mutex is not)
+	struct index_state
+	{
+		index_state();
+
+		//Guards lazy building of indexes, so const viewer can be used by several threads at once
+		//Index lists are not changed once built, so they're searched without holding it
+		std::mutex mutex;
+
+		//Indexes of ID-resources by type (ID and language -> data entry)
+		index_map id_indexes;
+		//Reverse indexes of icon and cursor groups by group type (icon/cursor ID and language -> group)
+		//They are built by resource_cursor_icon_reader
+		index_map group_indexes;
+		//Index of non-empty strings of all string tables (language and string ID -> string table, offset of string length)
+		//It is built by resource_string_table_reader
+		index_list string_index;
+		bool string_index_built;
+	};
+
+	//Never null
+	std::unique_ptr<index_state> indexes_;
+	friend class resource_cursor_icon_reader;
+	friend class resource_string_table_reader;
+
 	//Helper function to get ID list from entry list
 	static const resource_id_list get_id_list(const resource_directory::entry_list& entries);
 	//Helper function to get name list from entry list
@@ -483,7 +483,7 @@ void rebuild_resource_directory(pe_base& pe, section& resource_section, resource
 			++dir.NumberOfIdEntries;
 	}
 	
-	std::string& raw_data = resource_section.get_raw_data();
+	section_buffer& raw_data = resource_section.get_raw_buffer();
 
 	//Save resource directory
 	memcpy(&raw_data[current_structures_pos], &dir, sizeof(dir));
@@ -600,7 +600,7 @@ const image_directory rebuild_resources(pe_base& pe, resource_directory& info, s
 		< needed_size + aligned_offset_from_section_start))
 		throw pe_exception("Insufficient space for resource directory", pe_exception::insufficient_space);
 
-	std::string& raw_data = resources_section.get_raw_data();
+	section_buffer& raw_data = resources_section.get_raw_buffer();
 
 	//This will be done only if resources_section is the last section of image or for section with unaligned raw length of data
 	if(raw_data.length() < needed_size + aligned_offset_from_section_start)
@@ -686,20 +686,34 @@ bool resource_directory::entry_finder::operator()(const resource_directory_entry
 //Returns resource_directory_entry by ID. If not found - throws an exception
 const resource_directory_entry& resource_directory::entry_by_id(uint32_t id) const
 {
-	entry_list::const_iterator i = std::find_if(entries_.begin(), entries_.end(), id_entry_finder(id));
-	if(i == entries_.end())
+	const resource_directory_entry* entry = find_entry_by_id(id);
+	if(!entry)
 		throw pe_exception("Resource directory entry not found", pe_exception::resource_directory_entry_not_found);
 
-	return *i;
+	return *entry;
 }
 
 //Returns resource_directory_entry by name. If not found - throws an exception
 const resource_directory_entry& resource_directory::entry_by_name(const std::wstring& name) const
 {
-	entry_list::const_iterator i = std::find_if(entries_.begin(), entries_.end(), name_entry_finder(name));
-	if(i == entries_.end())
+	const resource_directory_entry* entry = find_entry_by_name(name);
+	if(!entry)
 		throw pe_exception("Resource directory entry not found", pe_exception::resource_directory_entry_not_found);
 
-	return *i;
+	return *entry;
+}
+
+//Returns resource_directory_entry by ID or null if not found
+const resource_directory_entry* resource_directory::find_entry_by_id(uint32_t id) const
+{
+	entry_list::const_iterator i = std::find_if(entries_.begin(), entries_.end(), id_entry_finder(id));
+	return i == entries_.end() ? 0 : &*i;
+}
+
+//Returns resource_directory_entry by name or null if not found
+const resource_directory_entry* resource_directory::find_entry_by_name(const std::wstring& name) const
+{
+	entry_list::const_iterator i = std::find_if(entries_.begin(), entries_.end(), name_entry_finder(name));
+	return i == entries_.end() ? 0 : &*i;
 }
 }
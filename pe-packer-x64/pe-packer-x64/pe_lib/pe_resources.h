@@ -139,6 +139,10 @@ public:
 	const resource_directory_entry& entry_by_id(uint32_t id) const;
 	//Returns resource_directory_entry by name. If not found - throws an exception
 	const resource_directory_entry& entry_by_name(const std::wstring& name) const;
+	//Returns resource_directory_entry by ID or null if not found
+	const resource_directory_entry* find_entry_by_id(uint32_t id) const;
+	//Returns resource_directory_entry by name or null if not found
+	const resource_directory_entry* find_entry_by_name(const std::wstring& name) const;
 
 public: //These functions do not change everything inside image, they are used by PE class
 	//You can also use them to rebuild resource directory
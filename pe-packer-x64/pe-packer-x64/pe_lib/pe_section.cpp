@@ -8,7 +8,14 @@ using namespace pe_win;
 
 //Section structure default constructor
 section::section()
-	:old_size_(static_cast<size_t>(-1))
+	:old_size_(static_cast<size_t>(-1)), source_offset_(no_source_offset)
+{
+	memset(&header_, 0, sizeof(image_section_header));
+}
+
+//Constructor, section data is allocated from "pool"
+section::section(section_buffer_pool* pool)
+	:old_size_(static_cast<size_t>(-1)), raw_data_(pool), source_offset_(no_source_offset)
 {
 	memset(&header_, 0, sizeof(image_section_header));
 }
@@ -107,47 +114,99 @@ bool section::empty() const
 }
 
 //Returns raw section data from file image
-std::string& section::get_raw_data()
+section_buffer& section::get_raw_buffer()
 {
 	unmap_virtual();
+	source_offset_ = no_source_offset;
 	return raw_data_;
 }
 
-//Sets raw section data from file image
-void section::set_raw_data(const std::string& data)
-{
-	old_size_ = static_cast<size_t>(-1);
-	raw_data_ = data;
-}
-
 //Returns raw section data from file image
-const std::string& section::get_raw_data() const
+const section_buffer& section::get_raw_buffer() const
 {
 	unmap_virtual();
 	return raw_data_;
 }
 
 //Returns mapped virtual section data
-const std::string& section::get_virtual_data(uint32_t section_alignment) const
+section_buffer& section::get_virtual_buffer(uint32_t section_alignment)
 {
 	map_virtual(section_alignment);
+	source_offset_ = no_source_offset;
 	return raw_data_;
 }
 
 //Returns mapped virtual section data
-std::string& section::get_virtual_data(uint32_t section_alignment)
+const section_buffer& section::get_virtual_buffer(uint32_t section_alignment) const
 {
 	map_virtual(section_alignment);
 	return raw_data_;
 }
 
+//Returns view of raw section data
+std::string_view section::get_raw_view() const
+{
+	unmap_virtual();
+	return raw_data_.view();
+}
+
+//Returns view of mapped virtual section data
+std::string_view section::get_virtual_view(uint32_t section_alignment) const
+{
+	map_virtual(section_alignment);
+	return raw_data_.view();
+}
+
+//Returns pointer to raw section data to change it in place
+char* section::get_raw_data_ptr()
+{
+	unmap_virtual();
+	source_offset_ = no_source_offset;
+	if(raw_data_.empty())
+		return 0;
+
+	return raw_data_.data();
+}
+
+//Returns raw section data from file image
+section_buffer& section::get_raw_data()
+{
+	return get_raw_buffer();
+}
+
+//Returns raw section data from file image
+const section_buffer& section::get_raw_data() const
+{
+	return get_raw_buffer();
+}
+
+//Returns mapped virtual section data
+const section_buffer& section::get_virtual_data(uint32_t section_alignment) const
+{
+	return get_virtual_buffer(section_alignment);
+}
+
+//Returns mapped virtual section data
+section_buffer& section::get_virtual_data(uint32_t section_alignment)
+{
+	return get_virtual_buffer(section_alignment);
+}
+
+//Sets raw section data from file image
+void section::set_raw_data(std::string_view data)
+{
+	old_size_ = static_cast<size_t>(-1);
+	source_offset_ = no_source_offset;
+	raw_data_.assign(data);
+}
+
 //Maps virtual section data
 void section::map_virtual(uint32_t section_alignment) const
 {
 	uint32_t aligned_virtual_size = get_aligned_virtual_size(section_alignment);
-	if(old_size_ == static_cast<size_t>(-1) && aligned_virtual_size && aligned_virtual_size > raw_data_.length())
+	if(old_size_ == static_cast<size_t>(-1) && aligned_virtual_size && aligned_virtual_size > raw_data_.size())
 	{
-		old_size_ = raw_data_.length();
+		old_size_ = raw_data_.size();
 		raw_data_.resize(aligned_virtual_size, 0);
 	}
 }
@@ -259,6 +318,18 @@ void section::set_virtual_address(uint32_t virtual_address)
 	header_.VirtualAddress = virtual_address;
 }
 
+//Returns offset of section raw data in file image was read from
+uint32_t section::get_source_offset() const
+{
+	return source_offset_;
+}
+
+//Sets offset of section raw data in source file
+void section::set_source_offset(uint32_t offset)
+{
+	source_offset_ = offset;
+}
+
 //Section by file offset finder helper (4gb max)
 section_by_raw_offset::section_by_raw_offset(uint32_t offset)
 	:offset_(offset)
@@ -1,7 +1,9 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include "pe_structures.h"
+#include "section_buffer.h"
 
 namespace pe_bliss
 {
@@ -16,8 +18,10 @@ enum section_data_type
 class section
 {
 public:
-	//Default constructor
+	//Default constructor, section data is allocated from default section_buffer_pool
 	section();
+	//Constructor, section data is allocated from "pool"
+	explicit section(section_buffer_pool* pool);
 
 	//Sets the name of section (stripped to 8 characters)
 	void set_name(const std::string& name);
@@ -43,13 +47,35 @@ public:
 	bool empty() const;
 
 	//Returns raw section data from file image
-	std::string& get_raw_data();
+	section_buffer& get_raw_buffer();
 	//Returns raw section data from file image
-	const std::string& get_raw_data() const;
+	const section_buffer& get_raw_buffer() const;
 	//Returns mapped virtual section data
-	const std::string& get_virtual_data(uint32_t section_alignment) const;
+	section_buffer& get_virtual_buffer(uint32_t section_alignment);
 	//Returns mapped virtual section data
-	std::string& get_virtual_data(uint32_t section_alignment);
+	const section_buffer& get_virtual_buffer(uint32_t section_alignment) const;
+
+	//Return views of raw and mapped virtual section data
+	std::string_view get_raw_view() const;
+	std::string_view get_virtual_view(uint32_t section_alignment) const;
+	//Returns pointer to raw section data to change it in place (null if there's no raw data)
+	char* get_raw_data_ptr();
+
+public: //Compatibility accessors
+	//Return the same section_buffer as get_*_buffer(), it has the std::string members used with section data
+	//(assign, append, resize, size, data, operator[], substr, assignment from string), but it isn't std::string:
+	//code binding the result to std::string& has to use section_buffer& (or auto&) instead
+	//get_raw_data() drops mapped virtual data, so views from get_virtual_view() may point past the end of data,
+	//get_virtual_data() may grow the buffer, which invalidates all views, pointers and slices of section data,
+	//as do changes of size made through returned references
+	//Returns raw section data from file image
+	[[deprecated("use get_raw_buffer() or get_raw_view()")]] section_buffer& get_raw_data();
+	//Returns raw section data from file image
+	[[deprecated("use get_raw_buffer() or get_raw_view()")]] const section_buffer& get_raw_data() const;
+	//Returns mapped virtual section data
+	[[deprecated("use get_virtual_buffer() or get_virtual_view()")]] const section_buffer& get_virtual_data(uint32_t section_alignment) const;
+	//Returns mapped virtual section data
+	[[deprecated("use get_virtual_buffer() or get_virtual_view()")]] section_buffer& get_virtual_data(uint32_t section_alignment);
 
 public: //Header getters
 	//Returns section virtual size
@@ -80,7 +106,7 @@ public: //Setters
 	//Sets section characteristics
 	void set_characteristics(uint32_t characteristics);
 	//Sets raw section data from file image
-	void set_raw_data(const std::string& data);
+	void set_raw_data(std::string_view data);
 
 public: //Setters, be careful
 	//Sets section virtual size (doesn't set internal aligned virtual size, changes only header value)
@@ -91,6 +117,16 @@ public: //Setters, be careful
 	//Returns raw image section header
 	pe_win::image_section_header& get_raw_header();
 
+public: //Source file tracking
+	//Returned by get_source_offset() if section raw data was not read from file or could have been changed
+	static const uint32_t no_source_offset = 0xFFFFFFFF;
+
+	//Returns offset of section raw data in file image was read from
+	//Any non-const access to raw or virtual data resets it, so rebuilder can copy unchanged data from source file
+	uint32_t get_source_offset() const;
+	//Sets offset of section raw data in source file (used by PE class)
+	void set_source_offset(uint32_t offset);
+
 private:
 	//Section header
 	pe_win::image_section_header header_;
@@ -108,7 +144,10 @@ private:
 	mutable std::size_t old_size_;
 
 	//Section raw/virtual data
-	mutable std::string raw_data_;
+	mutable section_buffer raw_data_;
+
+	//Offset of unchanged raw data in source file or no_source_offset
+	uint32_t source_offset_;
 };
 
 //Section by file offset finder helper (4gb max)
@@ -244,7 +244,7 @@ const image_directory rebuild_tls_base(pe_base& pe, const tls_info& info, sectio
 	if(info.get_raw_data_end_rva() < info.get_raw_data_start_rva() || info.get_index_rva() == 0)
 		throw pe_exception("Incorrect TLS directory", pe_exception::incorrect_tls_directory);
 
-	std::string& raw_data = tls_section.get_raw_data();
+	section_buffer& raw_data = tls_section.get_raw_buffer();
 
 	//This will be done only if tls_section is the last section of image or for section with unaligned raw length of data
 	if(raw_data.length() < needed_size + tls_data_pos)
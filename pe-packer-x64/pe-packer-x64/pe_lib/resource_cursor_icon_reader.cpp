@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <stddef.h>
+#include <string.h>
 #include "resource_cursor_icon_reader.h"
 #include "pe_structures.h"
 #include "pe_resource_viewer.h"
@@ -63,7 +65,7 @@ const std::string resource_cursor_icon_reader::get_single_icon_by_id_lang(uint32
 	//Get icon headers
 	std::string icon_data(lookup_icon_group_data_by_icon(id, language));
 	//Append icon data
-	icon_data.append(res_.get_resource_data_by_id(language, pe_resource_viewer::resource_icon, id).get_data());
+	icon_data.append(get_item_data(language, pe_resource_viewer::resource_icon, id));
 	return icon_data;
 }
 
@@ -117,7 +119,7 @@ const std::string resource_cursor_icon_reader::get_icon_by_name(uint32_t languag
 	for(uint16_t i = 0; i != icon_count; ++i)
 	{
 		const icon_group* group = reinterpret_cast<const icon_group*>(data.data() + sizeof(ico_header) + i * sizeof(icon_group));
-		ret += res_.get_resource_data_by_id(language, pe_resource_viewer::resource_icon, group->Number).get_data();
+		ret += get_item_data(language, pe_resource_viewer::resource_icon, group->Number);
 	}
 
 	return ret;
@@ -138,7 +140,7 @@ const std::string resource_cursor_icon_reader::get_icon_by_id_lang(uint32_t lang
 	for(uint16_t i = 0; i != icon_count; ++i)
 	{
 		const icon_group* group = reinterpret_cast<const icon_group*>(data.data() + sizeof(ico_header) + i * sizeof(icon_group));
-		ret += res_.get_resource_data_by_id(language, pe_resource_viewer::resource_icon, group->Number).get_data();
+		ret += get_item_data(language, pe_resource_viewer::resource_icon, group->Number);
 	}
 
 	return ret;
@@ -215,29 +217,12 @@ const std::string resource_cursor_icon_reader::lookup_icon_group_data_by_icon(ui
 {
 	std::string icon_header_data;
 
+	//Groups listing the icon are checked in turn, the first one which contains it is used
+	const resource_data_entry* group;
+	for(size_t number = 0; (group = find_owning_group(pe_resource_viewer::resource_icon_group, icon_id, language, number)) != 0; ++number)
 	{
-		//List all ID-resources
-		pe_resource_viewer::resource_id_list ids(res_.list_resource_ids(pe_resource_viewer::resource_icon_group));
-
-		for(pe_resource_viewer::resource_id_list::const_iterator it = ids.begin(); it != ids.end(); ++it)
-		{
-			pe_resource_viewer::resource_language_list group_languages(res_.list_resource_languages(pe_resource_viewer::resource_icon_group, *it));
-			if(std::find(group_languages.begin(), group_languages.end(), language) != group_languages.end()
-				&& check_icon_presence(res_.get_resource_data_by_id(language, pe_resource_viewer::resource_icon_group, *it).get_data(), icon_id, icon_header_data))
-				return icon_header_data;
-		}
-	}
-
-	{
-		//List all named resources
-		pe_resource_viewer::resource_name_list names(res_.list_resource_names(pe_resource_viewer::resource_icon_group));
-		for(pe_resource_viewer::resource_name_list::const_iterator it = names.begin(); it != names.end(); ++it)
-		{
-			pe_resource_viewer::resource_language_list group_languages(res_.list_resource_languages(pe_resource_viewer::resource_icon_group, *it));
-			if(std::find(group_languages.begin(), group_languages.end(), language) != group_languages.end()
-				&& check_icon_presence(res_.get_resource_data_by_name(language, pe_resource_viewer::resource_icon_group, *it).get_data(), icon_id, icon_header_data))
-				return icon_header_data;
-		}
+		if(check_icon_presence(group->get_data(), icon_id, icon_header_data))
+			return icon_header_data;
 	}
 
 	throw pe_exception("No icon group find for requested icon", pe_exception::no_icon_group_found);
@@ -246,11 +231,11 @@ const std::string resource_cursor_icon_reader::lookup_icon_group_data_by_icon(ui
 //Returns single cursor data by ID and language (minimum checks of format correctness)
 const std::string resource_cursor_icon_reader::get_single_cursor_by_id_lang(uint32_t language, uint32_t id) const
 {
-	std::string raw_cursor_data(res_.get_resource_data_by_id(language, pe_resource_viewer::resource_cursor, id).get_data());
+	const std::string& raw_cursor_data = get_item_data(language, pe_resource_viewer::resource_cursor, id);
 	//Get cursor headers
 	std::string cursor_data(lookup_cursor_group_data_by_cursor(id, language, raw_cursor_data));
 	//Append cursor data
-	cursor_data.append(raw_cursor_data.substr(sizeof(uint16_t) * 2 /* hotspot position */));
+	cursor_data.append(raw_cursor_data, sizeof(uint16_t) * 2 /* hotspot position */, std::string::npos);
 	return cursor_data;
 }
 
@@ -303,7 +288,7 @@ uint16_t resource_cursor_icon_reader::format_cursor_headers(std::string& cur_dat
 
 		//Now read hotspot data from cursor data directory
 		const std::string cursor = index == 0xFFFFFFFF
-			? res_.get_resource_data_by_id(language, pe_resource_viewer::resource_cursor, group->Number).get_data()
+			? get_item_data(language, pe_resource_viewer::resource_cursor, group->Number)
 			: res_.get_resource_data_by_id(pe_resource_viewer::resource_cursor, group->Number, index).get_data();
 		if(cursor.length() < 2 * sizeof(uint16_t))
 			throw pe_exception("Incorrect resource cursor", pe_exception::resource_incorrect_cursor);
@@ -341,7 +326,7 @@ const std::string resource_cursor_icon_reader::get_cursor_by_name(uint32_t langu
 	for(uint16_t i = 0; i != cursor_count; ++i)
 	{
 		const cursor_group* group = reinterpret_cast<const cursor_group*>(resource_data.data() + sizeof(cursor_header) + i * sizeof(cursor_group));
-		ret += res_.get_resource_data_by_id(language, pe_resource_viewer::resource_cursor, group->Number).get_data().substr(2 * sizeof(uint16_t));
+		ret.append(get_item_data(language, pe_resource_viewer::resource_cursor, group->Number), 2 * sizeof(uint16_t), std::string::npos);
 	}
 
 	return ret;
@@ -383,7 +368,7 @@ const std::string resource_cursor_icon_reader::get_cursor_by_id_lang(uint32_t la
 	for(uint16_t i = 0; i != cursor_count; ++i)
 	{
 		const cursor_group* group = reinterpret_cast<const cursor_group*>(resource_data.data() + sizeof(cursor_header) + i * sizeof(cursor_group));
-		ret += res_.get_resource_data_by_id(language, pe_resource_viewer::resource_cursor, group->Number).get_data().substr(2 * sizeof(uint16_t));
+		ret.append(get_item_data(language, pe_resource_viewer::resource_cursor, group->Number), 2 * sizeof(uint16_t), std::string::npos);
 	}
 
 	return ret;
@@ -470,31 +455,167 @@ const std::string resource_cursor_icon_reader::lookup_cursor_group_data_by_curso
 {
 	std::string cursor_header_data;
 
+	//Groups listing the cursor are checked in turn, the first one which contains it is used
+	const resource_data_entry* group;
+	for(size_t number = 0; (group = find_owning_group(pe_resource_viewer::resource_cursor_group, cursor_id, language, number)) != 0; ++number)
+	{
+		if(check_cursor_presence(group->get_data(), cursor_id, cursor_header_data, raw_cursor_data))
+			return cursor_header_data;
+	}
+
+	throw pe_exception("No cursor group find for requested icon", pe_exception::no_cursor_group_found);
+}
+
+//Returns data of single icon or cursor by type, ID and language, throws if it does not exist
+const std::string& resource_cursor_icon_reader::get_item_data(uint32_t language, uint32_t type, uint32_t id) const
+{
+	const resource_data_entry* data = res_.find_resource_data_by_id(language, static_cast<pe_resource_viewer::resource_type>(type), id);
+	if(!data)
+		throw pe_exception("Resource directory entry not found", pe_exception::resource_directory_entry_not_found);
+
+	return data->get_data();
+}
+
+//Returns "number"-th icon or cursor group listing item with specified ID and language or null
+const resource_data_entry* resource_cursor_icon_reader::find_owning_group(uint32_t group_type, uint32_t id, uint32_t language, size_t number) const
+{
+	std::unique_lock<std::mutex> lock(res_.indexes_->mutex);
+	pe_resource_viewer::index_map::iterator it = res_.indexes_->group_indexes.find(group_type);
+	if(it == res_.indexes_->group_indexes.end())
 	{
-		//List all ID-resources
-		pe_resource_viewer::resource_id_list ids(res_.list_resource_ids(pe_resource_viewer::resource_cursor_group));
+		//Icon and cursor group headers have the same layout, entries differ
+		size_t header_size = group_type == pe_resource_viewer::resource_icon_group ? sizeof(ico_header) : sizeof(cursor_header);
+		size_t entry_size = group_type == pe_resource_viewer::resource_icon_group ? sizeof(icon_group) : sizeof(cursor_group);
+		size_t number_offset = group_type == pe_resource_viewer::resource_icon_group ? offsetof(icon_group, Number) : offsetof(cursor_group, Number);
 
-		for(pe_resource_viewer::resource_id_list::const_iterator it = ids.begin(); it != ids.end(); ++it)
+		pe_resource_viewer::index_list index;
+
+		const resource_directory::entry_list& types = res_.get_root_directory().get_entry_list();
+		resource_directory::entry_list::const_iterator type_entry = std::find_if(types.begin(), types.end(), resource_directory::id_entry_finder(group_type));
+		if(type_entry != types.end() && !(*type_entry).includes_data())
 		{
-			pe_resource_viewer::resource_language_list group_languages(res_.list_resource_languages(pe_resource_viewer::resource_cursor_group, *it));
-			if(std::find(group_languages.begin(), group_languages.end(), language) != group_languages.end()
-				&& check_cursor_presence(res_.get_resource_data_by_id(language, pe_resource_viewer::resource_cursor_group, *it).get_data(), cursor_id, cursor_header_data, raw_cursor_data))
-				return cursor_header_data;
+			const resource_directory::entry_list& groups = (*type_entry).get_resource_directory().get_entry_list();
+
+			//ID-groups are searched first, then named ones
+			for(int named = 0; named != 2; ++named)
+			{
+				for(resource_directory::entry_list::const_iterator group_it = groups.begin(); group_it != groups.end(); ++group_it)
+				{
+					if((*group_it).is_named() != (named != 0) || (*group_it).includes_data())
+						continue;
+
+					const resource_directory::entry_list& languages = (*group_it).get_resource_directory().get_entry_list();
+					for(resource_directory::entry_list::const_iterator lang_it = languages.begin(); lang_it != languages.end(); ++lang_it)
+					{
+						if((*lang_it).is_named() || !(*lang_it).includes_data())
+							continue;
+
+						//Skip groups with incorrect data
+						const std::string& data = (*lang_it).get_data_entry().get_data();
+						if(data.length() < header_size)
+							continue;
+
+						uint16_t count;
+						memcpy(&count, data.data() + offsetof(ico_header, Count), sizeof(count));
+						if(data.length() < header_size + count * entry_size)
+							continue;
+
+						for(uint16_t i = 0; i != count; ++i)
+						{
+							uint16_t number;
+							memcpy(&number, data.data() + header_size + i * entry_size + number_offset, sizeof(number));
+
+							pe_resource_viewer::index_entry entry;
+							entry.key = pe_resource_viewer::make_index_key(number, (*lang_it).get_id());
+							entry.data = &(*lang_it).get_data_entry();
+							entry.position = i;
+							index.push_back(entry);
+						}
+					}
+				}
+			}
 		}
+
+		//Stable sort keeps groups listing the item in the order they are searched
+		std::stable_sort(index.begin(), index.end());
+		it = res_.indexes_->group_indexes.insert(std::make_pair(group_type, index)).first;
 	}
 
+	const pe_resource_viewer::index_list& group_index = (*it).second;
+	lock.unlock();
+
+	const pe_resource_viewer::index_entry* first;
+	const pe_resource_viewer::index_entry* last;
+	pe_resource_viewer::find_index_entries(group_index, pe_resource_viewer::make_index_key(id, language), first, last);
+	return number < static_cast<size_t>(last - first) ? first[number].data : 0;
+}
+
+//Returns all icon groups of all languages as .ico files (minimum checks of format correctness)
+const resource_cursor_icon_reader::icon_file_list resource_cursor_icon_reader::get_all_icons() const
+{
+	icon_file_list ret;
+
+	const resource_directory::entry_list& types = res_.get_root_directory().get_entry_list();
+	resource_directory::entry_list::const_iterator type_entry = std::find_if(types.begin(), types.end(), resource_directory::id_entry_finder(pe_resource_viewer::resource_icon_group));
+	if(type_entry == types.end() || (*type_entry).includes_data())
+		return ret;
+
+	//Icons of current group
+	std::vector<const std::string*> icons;
+
+	const resource_directory::entry_list& groups = (*type_entry).get_resource_directory().get_entry_list();
+	for(resource_directory::entry_list::const_iterator group_it = groups.begin(); group_it != groups.end(); ++group_it)
 	{
-		//List all named resources
-		pe_resource_viewer::resource_name_list names(res_.list_resource_names(pe_resource_viewer::resource_cursor_group));
-		for(pe_resource_viewer::resource_name_list::const_iterator it = names.begin(); it != names.end(); ++it)
+		if((*group_it).includes_data())
+			continue;
+
+		const resource_directory::entry_list& languages = (*group_it).get_resource_directory().get_entry_list();
+		for(resource_directory::entry_list::const_iterator lang_it = languages.begin(); lang_it != languages.end(); ++lang_it)
 		{
-			pe_resource_viewer::resource_language_list group_languages(res_.list_resource_languages(pe_resource_viewer::resource_cursor_group, *it));
-			if(std::find(group_languages.begin(), group_languages.end(), language) != group_languages.end()
-				&& check_cursor_presence(res_.get_resource_data_by_name(language, pe_resource_viewer::resource_cursor_group, *it).get_data(), cursor_id, cursor_header_data, raw_cursor_data))
-				return cursor_header_data;
+			if((*lang_it).is_named() || !(*lang_it).includes_data())
+				continue;
+
+			const std::string& data = (*lang_it).get_data_entry().get_data();
+			if(data.length() < sizeof(ico_header))
+				continue;
+
+			const ico_header* info = reinterpret_cast<const ico_header*>(data.data());
+			if(data.length() < sizeof(ico_header) + info->Count * sizeof(icon_group))
+				continue;
+
+			//Find all icons of group to calculate resulting size
+			size_t total_size = sizeof(ico_header) + info->Count * sizeof(icondirentry);
+			icons.clear();
+			for(uint16_t i = 0; i != info->Count; ++i)
+			{
+				const icon_group* group = reinterpret_cast<const icon_group*>(data.data() + sizeof(ico_header) + i * sizeof(icon_group));
+				const resource_data_entry* icon = res_.find_resource_data_by_id((*lang_it).get_id(), pe_resource_viewer::resource_icon, group->Number);
+				if(!icon)
+					break;
+
+				icons.push_back(&icon->get_data());
+				total_size += icon->get_data().length();
+			}
+
+			if(icons.size() != info->Count)
+				continue;
+
+			ret.push_back(icon_file());
+			icon_file& file = ret.back();
+			file.named = (*group_it).is_named();
+			file.id = file.named ? 0 : (*group_it).get_id();
+			if(file.named)
+				file.name = (*group_it).get_name();
+			file.language = (*lang_it).get_id();
+
+			//Build .ico file in place
+			file.data.reserve(total_size);
+			format_icon_headers(file.data, data);
+			for(std::vector<const std::string*>::const_iterator it = icons.begin(); it != icons.end(); ++it)
+				file.data.append(**it);
 		}
 	}
 
-	throw pe_exception("No cursor group find for requested icon", pe_exception::no_cursor_group_found);
+	return ret;
 }
 }
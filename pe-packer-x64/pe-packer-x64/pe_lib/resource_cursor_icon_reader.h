@@ -1,10 +1,12 @@
 #pragma once
 #include <string>
+#include <vector>
 #include "stdint_defs.h"
 
 namespace pe_bliss
 {
 class pe_resource_viewer;
+class resource_data_entry;
 
 class resource_cursor_icon_reader
 {
@@ -39,6 +41,23 @@ public:
 	//Returns cursor data by ID and index in language directory (instead of language) (minimum checks of format correctness)
 	const std::string get_cursor_by_id(uint32_t cursor_group_id, uint32_t index = 0) const;
 
+	//Icon group of some language assembled as .ico file
+	struct icon_file
+	{
+		bool named; //true if group has name instead of ID
+		uint32_t id;
+		std::wstring name;
+		uint32_t language;
+		std::string data; //.ico file contents
+	};
+
+	typedef std::vector<icon_file> icon_file_list;
+
+	//Returns all icon groups of all languages as .ico files (minimum checks of format correctness)
+	//Every group is parsed once, icons are found by index, so it's much faster than calling get_icon_by_* for each group
+	//Groups with incorrect data or referencing missing icons are skipped
+	const icon_file_list get_all_icons() const;
+
 private:
 	const pe_resource_viewer& res_;
 
@@ -50,6 +69,14 @@ private:
 	//Returns cursor count
 	uint16_t format_cursor_headers(std::string& cur_data, const std::string& resource_data, uint32_t language, uint32_t index = 0xFFFFFFFF) const;
 
+	//Returns data of single icon or cursor by type, ID and language, throws if it does not exist
+	const std::string& get_item_data(uint32_t language, uint32_t type, uint32_t id) const;
+
+	//Returns "number"-th icon or cursor group listing item with specified ID and language or null if there are less such groups
+	//Groups are numbered in the order they are searched (ID-groups first, then named ones)
+	//Uses reverse index of groups, which is built once per pe_resource_viewer
+	const resource_data_entry* find_owning_group(uint32_t group_type, uint32_t id, uint32_t language, size_t number = 0) const;
+
 	//Looks up icon group by icon id and returns full icon headers if found
 	const std::string lookup_icon_group_data_by_icon(uint32_t icon_id, uint32_t language) const;
 	//Checks for icon presence inside icon group, fills icon headers if found
@@ -108,61 +108,64 @@ const std::vector<uint16_t> resource_cursor_icon_writer::get_icon_or_cursor_free
 	//Search for available icon/cursor IDs
 	std::vector<uint16_t> icon_cursor_id_list;
 
-	try
+	//If there are no icons (cursors), place them from ID 1
+	//(Const viewer accessor is used, as pe_resource_manager one drops indexes)
+	const pe_resource_viewer& viewer = res_;
+	const resource_directory_entry* type_entry = viewer.get_root_directory().find_entry_by_id(type);
+	if(!type_entry || type_entry->includes_data())
 	{
-		//If any icon exists
-		//List icon IDs
-		std::vector<uint32_t> id_list(res_.list_resource_ids(type));
-		std::sort(id_list.begin(), id_list.end());
-
-		//If we are placing icon on free spaces
-		//I.e., icon IDs 1, 3, 4, 7, 8 already exist
-		//We'll place five icons on IDs 2, 5, 6, 9, 10
-		if(mode != icon_place_after_max_icon_id)
+		for(uint16_t i = 1; i != count + 1; ++i)
+			icon_cursor_id_list.push_back(i);
+
+		return icon_cursor_id_list;
+	}
+
+	//List icon IDs
+	std::vector<uint32_t> id_list(res_.list_resource_ids(type));
+	std::sort(id_list.begin(), id_list.end());
+
+	//If we are placing icon on free spaces
+	//I.e., icon IDs 1, 3, 4, 7, 8 already exist
+	//We'll place five icons on IDs 2, 5, 6, 9, 10
+	if(mode != icon_place_after_max_icon_id)
+	{
+		if(!id_list.empty())
 		{
-			if(!id_list.empty())
+			//Determine and list free icon IDs
+			for(std::vector<uint32_t>::const_iterator it = id_list.begin(); it != id_list.end(); ++it)
 			{
-				//Determine and list free icon IDs
-				for(std::vector<uint32_t>::const_iterator it = id_list.begin(); it != id_list.end(); ++it)
+				if(it == id_list.begin())
 				{
-					if(it == id_list.begin())
-					{
-						if(*it > 1)
-						{
-							for(uint16_t i = 1; i != *it; ++i)
-							{
-								icon_cursor_id_list.push_back(i);
-								if(icon_cursor_id_list.size() == count)
-									break;
-							}
-						}
-					}
-					else if(*(it - 1) - *it > 1)
+					if(*it > 1)
 					{
-						for(uint16_t i = static_cast<uint16_t>(*(it - 1) + 1); i != static_cast<uint16_t>(*it); ++i)
+						for(uint16_t i = 1; i != *it; ++i)
 						{
 							icon_cursor_id_list.push_back(i);
 							if(icon_cursor_id_list.size() == count)
 								break;
 						}
 					}
-
-					if(icon_cursor_id_list.size() == count)
-						break;
 				}
+				else if(*(it - 1) - *it > 1)
+				{
+					for(uint16_t i = static_cast<uint16_t>(*(it - 1) + 1); i != static_cast<uint16_t>(*it); ++i)
+					{
+						icon_cursor_id_list.push_back(i);
+						if(icon_cursor_id_list.size() == count)
+							break;
+					}
+				}
+
+				if(icon_cursor_id_list.size() == count)
+					break;
 			}
 		}
-
-		uint32_t max_id = id_list.empty() ? 0 : *std::max_element(id_list.begin(), id_list.end());
-		for(uint32_t i = static_cast<uint32_t>(icon_cursor_id_list.size()); i != count; ++i)
-			icon_cursor_id_list.push_back(static_cast<uint16_t>(++max_id));
-	}
-	catch(const pe_exception&) //Entry not found
-	{
-		for(uint16_t i = 1; i != count + 1; ++i)
-			icon_cursor_id_list.push_back(i);
 	}
 
+	uint32_t max_id = id_list.empty() ? 0 : *std::max_element(id_list.begin(), id_list.end());
+	for(uint32_t i = static_cast<uint32_t>(icon_cursor_id_list.size()); i != count; ++i)
+		icon_cursor_id_list.push_back(static_cast<uint16_t>(++max_id));
+
 	return icon_cursor_id_list;
 }
 
@@ -273,13 +276,9 @@ void resource_cursor_icon_writer::add_icon(const std::string& icon_file, const s
 	new_icon_group_entry.set_name(icon_group_name);
 	std::unique_ptr<resource_data_info> data_info;
 
-	try
-	{
-		data_info.reset(new resource_data_info(res_.get_resource_data_by_name(language, pe_resource_viewer::resource_icon_group, icon_group_name)));
-	}
-	catch(const pe_exception&) //Entry not found
-	{
-	}
+	const resource_data_entry* data = res_.find_resource_data_by_name(language, pe_resource_viewer::resource_icon_group, icon_group_name);
+	if(data)
+		data_info.reset(new resource_data_info(*data));
 
 	add_icon(icon_file, data_info.get(), new_icon_group_entry, resource_directory::entry_finder(icon_group_name), language, mode, codepage, timestamp);
 }
@@ -290,13 +289,9 @@ void resource_cursor_icon_writer::add_icon(const std::string& icon_file, uint32_
 	new_icon_group_entry.set_id(icon_group_id);
 	std::unique_ptr<resource_data_info> data_info;
 
-	try
-	{
-		data_info.reset(new resource_data_info(res_.get_resource_data_by_id(language, pe_resource_viewer::resource_icon_group, icon_group_id)));
-	}
-	catch(const pe_exception&) //Entry not found
-	{
-	}
+	const resource_data_entry* data = res_.find_resource_data_by_id(language, pe_resource_viewer::resource_icon_group, icon_group_id);
+	if(data)
+		data_info.reset(new resource_data_info(*data));
 
 	add_icon(icon_file, data_info.get(), new_icon_group_entry, resource_directory::entry_finder(icon_group_id), language, mode, codepage, timestamp);
 }
@@ -312,13 +307,9 @@ void resource_cursor_icon_writer::add_cursor(const std::string& cursor_file, con
 	new_cursor_group_entry.set_name(cursor_group_name);
 	std::unique_ptr<resource_data_info> data_info;
 
-	try
-	{
-		data_info.reset(new resource_data_info(res_.get_resource_data_by_name(language, pe_resource_viewer::resource_cursor_group, cursor_group_name)));
-	}
-	catch(const pe_exception&) //Entry not found
-	{
-	}
+	const resource_data_entry* data = res_.find_resource_data_by_name(language, pe_resource_viewer::resource_cursor_group, cursor_group_name);
+	if(data)
+		data_info.reset(new resource_data_info(*data));
 
 	add_cursor(cursor_file, data_info.get(), new_cursor_group_entry, resource_directory::entry_finder(cursor_group_name), language, mode, codepage, timestamp);
 }
@@ -329,13 +320,9 @@ void resource_cursor_icon_writer::add_cursor(const std::string& cursor_file, uin
 	new_cursor_group_entry.set_id(cursor_group_id);
 	std::unique_ptr<resource_data_info> data_info;
 
-	try
-	{
-		data_info.reset(new resource_data_info(res_.get_resource_data_by_id(language, pe_resource_viewer::resource_cursor_group, cursor_group_id)));
-	}
-	catch(const pe_exception&) //Entry not found
-	{
-	}
+	const resource_data_entry* data = res_.find_resource_data_by_id(language, pe_resource_viewer::resource_cursor_group, cursor_group_id);
+	if(data)
+		data_info.reset(new resource_data_info(*data));
 
 	add_cursor(cursor_file, data_info.get(), new_cursor_group_entry, resource_directory::entry_finder(cursor_group_id), language, mode, codepage, timestamp);
 }
@@ -1,3 +1,5 @@
+#include <string.h>
+#include <algorithm>
 #include "resource_string_table_reader.h"
 #include "pe_resource_viewer.h"
 
@@ -38,7 +40,7 @@ const resource_string_list resource_string_table_reader::parse_string_list(uint3
 		passed_bytes += sizeof(uint16_t); //WORD containing string length
 
 		//Check resource data length again
-		if(resource_data.length() < string_length + passed_bytes)
+		if(resource_data.length() < string_length * 2 + passed_bytes)
 			throw pe_exception("Incorrect resource string table", pe_exception::resource_incorrect_string_table);
 
 		if(string_length)
@@ -65,13 +67,12 @@ const resource_string_list resource_string_table_reader::parse_string_list(uint3
 //Returns string from string table by ID and language
 const std::wstring resource_string_table_reader::get_string_by_id_lang(uint32_t language, uint16_t id) const
 {
-	//List strings by string table id and language
-	const resource_string_list strings(get_string_table_by_id_lang(language, (id >> 4) + 1));
-	resource_string_list::const_iterator it = strings.find(id); //Find string by id
-	if(it == strings.end())
-		throw pe_exception("Resource string not found", pe_exception::resource_string_not_found);
-
-	return (*it).second;
+	const u16string_view value(get_string_view_by_id_lang(language, id));
+#ifdef PE_BLISS_WINDOWS
+	return std::wstring(value.data(), value.length());
+#else
+	return pe_utils::from_ucs2(u16string(value.data(), value.length()));
+#endif
 }
 
 //Returns string from string table by ID and index in language directory (instead of language)
@@ -85,4 +86,164 @@ const std::wstring resource_string_table_reader::get_string_by_id(uint16_t id, u
 
 	return (*it).second;
 }
+
+//Returns string from string table by ID and language
+const u16string_view resource_string_table_reader::get_string_view_by_id_lang(uint32_t language, uint16_t id) const
+{
+	build_string_index();
+
+	const pe_resource_viewer::index_entry* entry = pe_resource_viewer::find_index_entry(res_.indexes_->string_index, pe_resource_viewer::make_index_key(language, id));
+	if(!entry)
+	{
+		//String table exists, but string is empty
+		if(res_.find_resource_data_by_id(language, pe_resource_viewer::resource_string, (id >> 4) + 1))
+			throw pe_exception("Resource string not found", pe_exception::resource_string_not_found);
+
+		throw pe_exception("Resource directory entry not found", pe_exception::resource_directory_entry_not_found);
+	}
+
+	if(!entry->data)
+		throw pe_exception("Incorrect resource string table", pe_exception::resource_incorrect_string_table);
+
+	const std::string& resource_data = entry->data->get_data();
+	return u16string_view(reinterpret_cast<const unicode16_t*>(resource_data.data() + entry->position + sizeof(uint16_t)),
+		read_string_length(resource_data, entry->position));
+}
+
+//Returns all non-empty strings of language sorted by ID
+const resource_string_ref_list resource_string_table_reader::get_strings_by_lang(uint32_t language) const
+{
+	resource_string_ref_list ret;
+	list_strings(ret, pe_resource_viewer::make_index_key(language, 0), pe_resource_viewer::make_index_key(language, 0xFFFF));
+	return ret;
+}
+
+//Returns all non-empty strings of all string tables sorted by language and ID
+const resource_string_ref_list resource_string_table_reader::get_all_strings() const
+{
+	resource_string_ref_list ret;
+	list_strings(ret, 0, ~static_cast<uint64_t>(0));
+	return ret;
+}
+
+//Appends strings of index with keys in range [first_key; last_key] to list
+void resource_string_table_reader::list_strings(resource_string_ref_list& strings, uint64_t first_key, uint64_t last_key) const
+{
+	build_string_index();
+
+	pe_resource_viewer::index_entry needle;
+	needle.key = first_key;
+	pe_resource_viewer::index_list::const_iterator begin = std::lower_bound(res_.indexes_->string_index.begin(), res_.indexes_->string_index.end(), needle);
+	pe_resource_viewer::index_list::const_iterator end = begin;
+	while(end != res_.indexes_->string_index.end() && (*end).key <= last_key)
+		++end;
+
+	strings.reserve(strings.size() + (end - begin));
+	for(pe_resource_viewer::index_list::const_iterator it = begin; it != end; ++it)
+	{
+		//Skip incorrect string tables
+		if(!(*it).data || (it != begin && (*it).key == (*(it - 1)).key))
+			continue;
+
+		const std::string& resource_data = (*it).data->get_data();
+
+		resource_string_ref ref;
+		ref.language = static_cast<uint32_t>((*it).key >> 32);
+		ref.id = static_cast<uint16_t>((*it).key);
+		ref.value = u16string_view(reinterpret_cast<const unicode16_t*>(resource_data.data() + (*it).position + sizeof(uint16_t)),
+			read_string_length(resource_data, (*it).position));
+		strings.push_back(ref);
+	}
+}
+
+//Returns length of string at "position" of string table data
+uint16_t resource_string_table_reader::read_string_length(const std::string& resource_data, size_t position)
+{
+	uint16_t length;
+	memcpy(&length, resource_data.data() + position, sizeof(length));
+	return length;
+}
+
+//Builds index of strings of all string tables if it was not built yet
+void resource_string_table_reader::build_string_index() const
+{
+	std::lock_guard<std::mutex> lock(res_.indexes_->mutex);
+	if(res_.indexes_->string_index_built)
+		return;
+
+	//Index keys are (language << 32 | string ID), so strings of single language are adjacent
+	pe_resource_viewer::index_list index;
+
+	const resource_directory::entry_list& types = res_.get_root_directory().get_entry_list();
+	resource_directory::entry_list::const_iterator type_entry = std::find_if(types.begin(), types.end(), resource_directory::id_entry_finder(pe_resource_viewer::resource_string));
+	if(type_entry != types.end() && !(*type_entry).includes_data())
+	{
+		//16 is maximum count of strings in a string table
+		static const unsigned long max_string_list_entries = 16;
+
+		const resource_directory::entry_list& tables = (*type_entry).get_resource_directory().get_entry_list();
+		for(resource_directory::entry_list::const_iterator table_it = tables.begin(); table_it != tables.end(); ++table_it)
+		{
+			//String table IDs are 1..4096, other tables can't be found by string ID
+			if((*table_it).is_named() || (*table_it).includes_data() || (*table_it).get_id() == 0 || (*table_it).get_id() > 0x1000)
+				continue;
+
+			uint16_t first_id = static_cast<uint16_t>(((*table_it).get_id() - 1) << 4);
+
+			const resource_directory::entry_list& languages = (*table_it).get_resource_directory().get_entry_list();
+			for(resource_directory::entry_list::const_iterator lang_it = languages.begin(); lang_it != languages.end(); ++lang_it)
+			{
+				if((*lang_it).is_named() || !(*lang_it).includes_data())
+					continue;
+
+				const resource_data_entry& data = (*lang_it).get_data_entry();
+				const std::string& resource_data = data.get_data();
+				size_t table_start = index.size();
+
+				pe_resource_viewer::index_entry entry;
+				entry.data = &data;
+
+				unsigned long passed_bytes = 0;
+				unsigned long i = 0;
+				for(; i != max_string_list_entries; ++i)
+				{
+					//Check resource data length
+					if(resource_data.length() < sizeof(uint16_t) + passed_bytes)
+						break;
+
+					uint16_t string_length = read_string_length(resource_data, passed_bytes);
+					if(resource_data.length() < sizeof(uint16_t) + string_length * 2 + passed_bytes)
+						break;
+
+					if(string_length)
+					{
+						entry.key = pe_resource_viewer::make_index_key((*lang_it).get_id(), first_id + i);
+						entry.position = passed_bytes;
+						index.push_back(entry);
+					}
+
+					passed_bytes += sizeof(uint16_t) + string_length * 2;
+				}
+
+				//Incorrect string table: all its strings are marked, so lookups can report it
+				if(i != max_string_list_entries)
+				{
+					index.resize(table_start);
+					entry.data = 0;
+					entry.position = 0;
+					for(i = 0; i != max_string_list_entries; ++i)
+					{
+						entry.key = pe_resource_viewer::make_index_key((*lang_it).get_id(), first_id + i);
+						index.push_back(entry);
+					}
+				}
+			}
+		}
+	}
+
+	//Stable sort keeps strings of first of duplicate tables first
+	std::stable_sort(index.begin(), index.end());
+	res_.indexes_->string_index.swap(index);
+	res_.indexes_->string_index_built = true;
+}
 }
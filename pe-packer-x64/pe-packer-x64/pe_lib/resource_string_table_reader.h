@@ -1,7 +1,10 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <vector>
 #include <map>
 #include "stdint_defs.h"
+#include "pe_structures.h"
 
 namespace pe_bliss
 {
@@ -10,6 +13,19 @@ class pe_resource_viewer;
 //ID; string
 typedef std::map<uint16_t, std::wstring> resource_string_list;
 
+//UNICODE string inside string table resource data
+typedef std::basic_string_view<unicode16_t> u16string_view;
+
+//String from string table referenced without copying
+struct resource_string_ref
+{
+	uint32_t language;
+	uint16_t id;
+	u16string_view value;
+};
+
+typedef std::vector<resource_string_ref> resource_string_ref_list;
+
 class resource_string_table_reader
 {
 public:
@@ -25,6 +41,19 @@ public:
 	//Returns string from string table by ID and index in language directory (instead of language)
 	const std::wstring get_string_by_id(uint16_t id, uint32_t index = 0) const;
 
+public: //Indexed access
+	//Functions below use index of all string tables, which is built on the first call and kept by pe_resource_viewer
+	//Returned views point to resource data and are valid while resource directory is alive and not changed
+
+	//Returns string from string table by ID and language
+	const u16string_view get_string_view_by_id_lang(uint32_t language, uint16_t id) const;
+	//Returns all non-empty strings of language sorted by ID
+	//Incorrect string tables are skipped
+	const resource_string_ref_list get_strings_by_lang(uint32_t language) const;
+	//Returns all non-empty strings of all string tables sorted by language and ID
+	//Incorrect string tables are skipped
+	const resource_string_ref_list get_all_strings() const;
+
 private:
 	const pe_resource_viewer& res_;
 
@@ -32,5 +61,14 @@ private:
 	//Id of resource is needed to calculate string IDs correctly
 	//resource_data is raw string table resource data
 	static const resource_string_list parse_string_list(uint32_t id, const std::string& resource_data);
+
+	//Returns length of string at "position" of string table data, which may be unaligned
+	static uint16_t read_string_length(const std::string& resource_data, size_t position);
+
+	//Builds index of strings of all string tables if it was not built yet
+	//Index is built under indexes mutex of pe_resource_viewer and is not changed afterwards, so it's read without it
+	void build_string_index() const;
+	//Appends strings of index with keys in range [first_key; last_key] to list
+	void list_strings(resource_string_ref_list& strings, uint64_t first_key, uint64_t last_key) const;
 };
 }
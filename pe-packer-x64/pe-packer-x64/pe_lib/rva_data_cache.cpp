@@ -0,0 +1,88 @@
+#include <string.h>
+#include <algorithm>
+#include "rva_data_cache.h"
+
+namespace pe_bliss
+{
+//Constructor
+rva_data_cache::rva_data_cache(const pe_base& pe, bool include_headers)
+	:pe_(pe), include_headers_(include_headers), start_(0), end_(0), data_(0)
+{}
+
+//Returns pointer to data at RVA and number of bytes available from it to the end of section (or headers)
+const char* rva_data_cache::get(uint32_t rva, uint32_t& available)
+{
+	pe_error error;
+	const char* data = try_get(rva, available, error);
+	if(!data)
+		error.raise();
+
+	return data;
+}
+
+//Non-throwing version of get
+const char* rva_data_cache::try_get(uint32_t rva, uint32_t& available, pe_error& error)
+{
+	if(rva < start_ || rva >= end_)
+	{
+		const std::string& headers = pe_.get_full_headers_data();
+		if(include_headers_ && rva < headers.length())
+		{
+			start_ = 0;
+			end_ = static_cast<uint32_t>(headers.length());
+			data_ = headers.data();
+		}
+		else
+		{
+			const section* s = pe_.find_section_from_rva(rva);
+			if(!s)
+			{
+				error.set("No section found by presented address", pe_exception::no_section_found);
+				return 0;
+			}
+
+			std::string_view data = s->get_virtual_view(pe_.get_section_alignment());
+			start_ = s->get_virtual_address();
+			end_ = start_ + std::min<uint32_t>(static_cast<uint32_t>(data.length()), s->get_aligned_virtual_size(pe_.get_section_alignment()));
+			data_ = data.data();
+
+			if(rva >= end_)
+			{
+				error.set("RVA not found inside section", pe_exception::rva_not_exists);
+				return 0;
+			}
+		}
+	}
+
+	available = end_ - rva;
+	return data_ + (rva - start_);
+}
+
+//Returns pointer to data at RVA, checks that at least "size" bytes are available
+const char* rva_data_cache::get(uint32_t rva, uint32_t size, pe_exception::exception_id id)
+{
+	pe_error error;
+	const char* data = try_get(rva, size, id, error);
+	if(!data)
+		error.raise();
+
+	return data;
+}
+
+//Non-throwing version of get
+const char* rva_data_cache::try_get(uint32_t rva, uint32_t size, pe_exception::exception_id id, pe_error& error)
+{
+	uint32_t available;
+	const char* data = try_get(rva, available, error);
+	if(!data)
+		return 0;
+
+	if(available < size)
+	{
+		error.set("RVA and requested data size does not exist inside section", id);
+		return 0;
+	}
+
+	return data;
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <string.h>
+#include "pe_base.h"
+
+namespace pe_bliss
+{
+//Resolves RVAs to mapped (virtual) data of image, remembering the last section used
+//Directory parsers use it to avoid searching section list for every small read
+//Pointers are valid while image sections are not changed
+class rva_data_cache
+{
+public:
+	//Constructor, if include_headers = true, data from the beginning of PE file to SizeOfHeaders will be searched, too
+	explicit rva_data_cache(const pe_base& pe, bool include_headers = true);
+
+	//Returns pointer to data at RVA and number of bytes available from it to the end of section (or headers)
+	//Throws an exception if RVA does not belong to any section
+	const char* get(uint32_t rva, uint32_t& available);
+	//Non-throwing version, returns 0 and sets error if RVA does not belong to any section
+	const char* try_get(uint32_t rva, uint32_t& available, pe_error& error);
+
+	//Returns pointer to data at RVA, checks that at least "size" bytes are available
+	const char* get(uint32_t rva, uint32_t size, pe_exception::exception_id id);
+	//Non-throwing version, returns 0 and sets error if less than "size" bytes are available
+	const char* try_get(uint32_t rva, uint32_t size, pe_exception::exception_id id, pe_error& error);
+
+	//Reads value of type T at RVA, checks bounds
+	template<typename T>
+	T read(uint32_t rva, pe_exception::exception_id id)
+	{
+		T value;
+		memcpy(&value, get(rva, sizeof(T), id), sizeof(T));
+		return value;
+	}
+
+	//Non-throwing version of read
+	template<typename T>
+	bool try_read(uint32_t rva, T& value, pe_exception::exception_id id, pe_error& error)
+	{
+		const char* data = try_get(rva, sizeof(T), id, error);
+		if(!data)
+			return false;
+
+		memcpy(&value, data, sizeof(T));
+		return true;
+	}
+
+private:
+	rva_data_cache(const rva_data_cache&);
+	rva_data_cache& operator=(const rva_data_cache&);
+
+	const pe_base& pe_;
+	bool include_headers_;
+	uint32_t start_, end_;
+	const char* data_;
+};
+}
@@ -0,0 +1,308 @@
+#include <string.h>
+#include <algorithm>
+#include "section_buffer.h"
+
+namespace pe_bliss
+{
+//Constructor
+section_buffer_pool::section_buffer_pool(size_t max_cached_bytes)
+	:max_cached_bytes_(max_cached_bytes), cached_bytes_(0), allocations_(0), reused_(0)
+{}
+
+//Destructor, frees cached blocks
+section_buffer_pool::~section_buffer_pool()
+{
+	trim();
+}
+
+//Returns size class index and rounds size up to class size
+size_t section_buffer_pool::get_class(size_t& size)
+{
+	if(size <= min_block_size)
+	{
+		size = min_block_size;
+		return 0;
+	}
+
+	//Find power of two "bit": bit < size <= bit * 2
+	size_t bit = min_block_size;
+	size_t power = 0;
+	while(bit < (size - 1) / 2 + 1)
+	{
+		bit <<= 1;
+		++power;
+	}
+
+	//Classes of this power of two are bit * 5/4, 6/4, 7/4 and 8/4
+	size_t step = bit / 4;
+	size_t quarters = (size + step - 1) / step;
+	size_t index = power * 4 + (quarters - 4);
+	if(index >= number_of_classes)
+		return number_of_classes;
+
+	size = quarters * step;
+	return index;
+}
+
+//Returns block of at least "size" bytes
+char* section_buffer_pool::allocate(size_t size, size_t& capacity)
+{
+	capacity = size;
+	size_t index = get_class(capacity);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		++allocations_;
+		if(index != number_of_classes && !free_blocks_[index].empty())
+		{
+			char* block = free_blocks_[index].back();
+			free_blocks_[index].pop_back();
+			cached_bytes_ -= capacity;
+			++reused_;
+			return block;
+		}
+	}
+
+	return new char[capacity];
+}
+
+//Returns block to pool
+void section_buffer_pool::deallocate(char* block, size_t capacity)
+{
+	size_t class_size = capacity;
+	size_t index = get_class(class_size);
+
+	if(index != number_of_classes && class_size == capacity)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(cached_bytes_ + capacity <= max_cached_bytes_)
+		{
+			free_blocks_[index].push_back(block);
+			cached_bytes_ += capacity;
+			return;
+		}
+	}
+
+	delete[] block;
+}
+
+//Frees all cached blocks
+void section_buffer_pool::trim()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for(size_t i = 0; i != number_of_classes; ++i)
+	{
+		for(std::vector<char*>::const_iterator it = free_blocks_[i].begin(); it != free_blocks_[i].end(); ++it)
+			delete[] *it;
+
+		free_blocks_[i].clear();
+	}
+
+	cached_bytes_ = 0;
+}
+
+//Returns number of allocate() calls
+size_t section_buffer_pool::get_allocations() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return allocations_;
+}
+
+//Returns number of allocate() calls served by cached blocks
+size_t section_buffer_pool::get_reused() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return reused_;
+}
+
+//Returns total size of cached blocks
+size_t section_buffer_pool::get_cached_bytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return cached_bytes_;
+}
+
+//Returns process-wide pool used by default
+section_buffer_pool* section_buffer_pool::get_default()
+{
+	static section_buffer_pool pool;
+	return &pool;
+}
+
+//Creates empty buffer using default pool
+section_buffer::section_buffer()
+	:pool_(section_buffer_pool::get_default()), data_(0), size_(0), capacity_(0)
+{}
+
+//Creates empty buffer using "pool"
+section_buffer::section_buffer(section_buffer_pool* pool)
+	:pool_(pool ? pool : section_buffer_pool::get_default()), data_(0), size_(0), capacity_(0)
+{}
+
+//Copy constructor
+section_buffer::section_buffer(const section_buffer& other)
+	:pool_(other.pool_), data_(0), size_(0), capacity_(0)
+{
+	assign(other.view());
+}
+
+//Move constructor
+section_buffer::section_buffer(section_buffer&& other) noexcept
+	:pool_(other.pool_), data_(other.data_), size_(other.size_), capacity_(other.capacity_)
+{
+	other.data_ = 0;
+	other.size_ = 0;
+	other.capacity_ = 0;
+}
+
+//Copy assignment operator
+section_buffer& section_buffer::operator=(const section_buffer& other)
+{
+	if(this != &other)
+		assign(other.view());
+
+	return *this;
+}
+
+//Move assignment operator
+section_buffer& section_buffer::operator=(section_buffer&& other) noexcept
+{
+	if(this != &other)
+	{
+		release();
+		pool_ = other.pool_;
+		data_ = other.data_;
+		size_ = other.size_;
+		capacity_ = other.capacity_;
+		other.data_ = 0;
+		other.size_ = 0;
+		other.capacity_ = 0;
+	}
+
+	return *this;
+}
+
+//Destructor, returns block to pool
+section_buffer::~section_buffer()
+{
+	release();
+}
+
+//Moves data to block of at least "capacity" bytes
+void section_buffer::grow(size_t capacity)
+{
+	size_t new_capacity;
+	char* new_data = pool_->allocate(capacity, new_capacity);
+	if(size_)
+		memcpy(new_data, data_, size_);
+
+	if(data_)
+		pool_->deallocate(data_, capacity_);
+
+	data_ = new_data;
+	capacity_ = new_capacity;
+}
+
+//Makes capacity at least "capacity" bytes
+void section_buffer::reserve(size_t capacity)
+{
+	if(capacity > capacity_)
+		grow(capacity);
+}
+
+//Changes size of buffer, new bytes are set to "fill"
+void section_buffer::resize(size_t size, char fill)
+{
+	size_t old_size = size_;
+	resize_uninitialized(size);
+	if(size > old_size)
+		memset(data_ + old_size, fill, size - old_size);
+}
+
+//Changes size of buffer, new bytes are left uninitialized
+void section_buffer::resize_uninitialized(size_t size)
+{
+	//Grow geometrically, so appending data doesn't copy buffer every time
+	if(size > capacity_)
+		grow(std::max(size, capacity_ + capacity_ / 2));
+
+	size_ = size;
+}
+
+//Replaces buffer contents with "data"
+void section_buffer::assign(std::string_view data)
+{
+	//Don't copy old contents when growing
+	if(data.length() > capacity_)
+		release();
+
+	resize_uninitialized(data.length());
+	if(!data.empty())
+		memmove(data_, data.data(), data.length());
+}
+
+//Replaces buffer contents with "data"
+section_buffer& section_buffer::operator=(std::string_view data)
+{
+	assign(data);
+	return *this;
+}
+
+//Returns copy of "length" bytes from "offset"
+std::string section_buffer::substr(size_t offset, size_t length) const
+{
+	return std::string(slice(offset, length));
+}
+
+//Replaces buffer contents with "count" bytes "value"
+void section_buffer::assign(size_t count, char value)
+{
+	clear();
+	resize(count, value);
+}
+
+//Appends "data" to buffer
+void section_buffer::append(std::string_view data)
+{
+	size_t old_size = size_;
+	resize_uninitialized(size_ + data.length());
+	if(!data.empty())
+		memcpy(data_ + old_size, data.data(), data.length());
+}
+
+//Sets size to zero, keeps block
+void section_buffer::clear()
+{
+	size_ = 0;
+}
+
+//Sets size to zero and returns block to pool
+void section_buffer::release()
+{
+	if(data_)
+		pool_->deallocate(data_, capacity_);
+
+	data_ = 0;
+	size_ = 0;
+	capacity_ = 0;
+}
+
+//Returns view of whole buffer
+std::string_view section_buffer::view() const
+{
+	return std::string_view(data_, size_);
+}
+
+//Returns view of "length" bytes from "offset", both are clamped to size of buffer
+std::string_view section_buffer::slice(size_t offset, size_t length) const
+{
+	offset = std::min(offset, size_);
+	return std::string_view(data_ + offset, std::min(length, size_ - offset));
+}
+
+//Returns pool of buffer
+section_buffer_pool* section_buffer::get_pool() const
+{
+	return pool_;
+}
+}
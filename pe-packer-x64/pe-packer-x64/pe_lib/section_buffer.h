@@ -0,0 +1,139 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "stdint_defs.h"
+
+namespace pe_bliss
+{
+//Pool of blocks for section data, shared by images
+//Block sizes are rounded up to size classes (four classes for each power of two from 4 kb),
+//freed blocks are kept for the next buffers of the same class, so images of a batch reuse memory of previous ones
+//Pool is thread-safe and must outlive buffers using it
+class section_buffer_pool
+{
+public:
+	//Constructor, max_cached_bytes limits total size of freed blocks kept in pool
+	explicit section_buffer_pool(size_t max_cached_bytes = default_max_cached_bytes);
+	~section_buffer_pool();
+
+	//Returns block of at least "size" bytes, "capacity" is set to the real size of block
+	char* allocate(size_t size, size_t& capacity);
+	//Returns block to pool, block is freed if pool is full
+	void deallocate(char* block, size_t capacity);
+
+	//Frees all cached blocks
+	void trim();
+
+	//Returns number of allocate() calls
+	size_t get_allocations() const;
+	//Returns number of allocate() calls served by cached blocks
+	size_t get_reused() const;
+	//Returns total size of cached blocks
+	size_t get_cached_bytes() const;
+
+	//Returns process-wide pool used by default
+	static section_buffer_pool* get_default();
+
+	static const size_t default_max_cached_bytes = 0x4000000;
+
+private:
+	section_buffer_pool(const section_buffer_pool&);
+	section_buffer_pool& operator=(const section_buffer_pool&);
+
+	static const size_t min_block_size = 0x1000;
+	static const size_t number_of_classes = 80; //Up to 4 gb
+
+	//Returns size class index and rounds size up to class size, returns number_of_classes for too large blocks
+	static size_t get_class(size_t& size);
+
+	mutable std::mutex mutex_;
+	std::vector<char*> free_blocks_[number_of_classes];
+	size_t max_cached_bytes_;
+	size_t cached_bytes_;
+	size_t allocations_;
+	size_t reused_;
+};
+
+//Byte buffer holding section data
+//Unlike std::string, it can grow without filling new bytes (resize_uninitialized()),
+//takes blocks from section_buffer_pool and returns them there, and gives read-only slices without copying
+class section_buffer
+{
+public:
+	//Creates empty buffer using default pool
+	section_buffer();
+	//Creates empty buffer using "pool"
+	explicit section_buffer(section_buffer_pool* pool);
+
+	//Copy uses the pool of "other"
+	section_buffer(const section_buffer& other);
+	section_buffer(section_buffer&& other) noexcept;
+	section_buffer& operator=(const section_buffer& other);
+	section_buffer& operator=(section_buffer&& other) noexcept;
+	~section_buffer();
+
+	char* data() { return data_; }
+	const char* data() const { return data_; }
+	size_t size() const { return size_; }
+	size_t length() const { return size_; }
+	size_t capacity() const { return capacity_; }
+	bool empty() const { return size_ == 0; }
+
+	char& operator[](size_t pos) { return data_[pos]; }
+	const char& operator[](size_t pos) const { return data_[pos]; }
+
+	char* begin() { return data_; }
+	char* end() { return data_ + size_; }
+	const char* begin() const { return data_; }
+	const char* end() const { return data_ + size_; }
+
+	//std::string-like access for code written against section::get_raw_data() returning std::string&
+	//Replaces buffer contents with "data"
+	section_buffer& operator=(std::string_view data);
+	//Views are valid until buffer is resized or destroyed
+	operator std::string_view() const { return view(); }
+	//Returns copy of "length" bytes from "offset", both are clamped to size of buffer
+	std::string substr(size_t offset, size_t length = npos) const;
+
+	//Makes capacity at least "capacity" bytes
+	void reserve(size_t capacity);
+	//Changes size of buffer, new bytes are set to "fill"
+	void resize(size_t size, char fill = 0);
+	//Changes size of buffer, new bytes are left uninitialized (to be overwritten by caller)
+	void resize_uninitialized(size_t size);
+
+	//Replaces buffer contents with "data"
+	void assign(std::string_view data);
+	//Replaces buffer contents with "count" bytes "value"
+	void assign(size_t count, char value);
+	//Appends "data" to buffer
+	void append(std::string_view data);
+
+	//Sets size to zero, keeps block
+	void clear();
+	//Sets size to zero and returns block to pool
+	void release();
+
+	//Returns view of whole buffer
+	std::string_view view() const;
+	//Returns view of "length" bytes from "offset", both are clamped to size of buffer
+	//View is valid until buffer is resized or destroyed
+	std::string_view slice(size_t offset, size_t length = npos) const;
+
+	//Returns pool of buffer
+	section_buffer_pool* get_pool() const;
+
+	static const size_t npos = static_cast<size_t>(-1);
+
+private:
+	//Moves data to block of at least "capacity" bytes
+	void grow(size_t capacity);
+
+	section_buffer_pool* pool_;
+	char* data_;
+	size_t size_;
+	size_t capacity_;
+};
+}
@@ -0,0 +1,147 @@
+#include <string.h>
+#include "string_pool.h"
+
+namespace pe_bliss
+{
+//Default constructor
+string_pool::string_pool()
+	:block_used_(block_size)
+{}
+
+//Move constructor
+string_pool::string_pool(string_pool&& other) noexcept
+	:blocks_(std::move(other.blocks_)),
+	large_blocks_(std::move(other.large_blocks_)),
+	block_used_(other.block_used_),
+	strings_(std::move(other.strings_)),
+	hashes_(std::move(other.hashes_)),
+	buckets_(std::move(other.buckets_))
+{
+	other.reset();
+}
+
+//Move assignment operator
+string_pool& string_pool::operator=(string_pool&& other) noexcept
+{
+	if(this != &other)
+	{
+		blocks_ = std::move(other.blocks_);
+		large_blocks_ = std::move(other.large_blocks_);
+		block_used_ = other.block_used_;
+		strings_ = std::move(other.strings_);
+		hashes_ = std::move(other.hashes_);
+		buckets_ = std::move(other.buckets_);
+		other.reset();
+	}
+
+	return *this;
+}
+
+//Leaves pool empty, the next string starts a new block
+void string_pool::reset()
+{
+	blocks_.clear();
+	large_blocks_.clear();
+	block_used_ = block_size;
+	strings_.clear();
+	hashes_.clear();
+	buckets_.clear();
+}
+
+//Returns index of string, adds string to pool if it is not there yet
+uint32_t string_pool::intern(std::string_view str)
+{
+	//Keep load factor below 1/2
+	if((strings_.size() + 1) * 2 > buckets_.size())
+		grow();
+
+	uint32_t str_hash = hash(str);
+	size_t mask = buckets_.size() - 1;
+	size_t pos = str_hash & mask;
+	while(buckets_[pos])
+	{
+		uint32_t index = buckets_[pos] - 1;
+		if(hashes_[index] == str_hash && strings_[index] == str)
+			return index;
+
+		pos = (pos + 1) & mask;
+	}
+
+	uint32_t index = static_cast<uint32_t>(strings_.size());
+	strings_.push_back(store(str));
+	hashes_.push_back(str_hash);
+	buckets_[pos] = index + 1;
+	return index;
+}
+
+//Returns string by index
+std::string_view string_pool::get(uint32_t index) const
+{
+	return strings_.at(index);
+}
+
+//Returns number of distinct strings in pool
+size_t string_pool::size() const
+{
+	return strings_.size();
+}
+
+//Copies string to blocks, returns null-terminated copy
+std::string_view string_pool::store(std::string_view str)
+{
+	size_t needed = str.length() + 1;
+	char* data;
+
+	if(needed > block_size / 4)
+	{
+		//Long strings get their own block, so the shared block is not wasted
+		large_blocks_.push_back(std::unique_ptr<char[]>(new char[needed]));
+		data = large_blocks_.back().get();
+	}
+	else
+	{
+		if(needed > block_size - block_used_)
+		{
+			blocks_.push_back(std::unique_ptr<char[]>(new char[block_size]));
+			block_used_ = 0;
+		}
+
+		data = blocks_.back().get() + block_used_;
+		block_used_ += needed;
+	}
+
+	memcpy(data, str.data(), str.length());
+	data[str.length()] = '\0';
+	return std::string_view(data, str.length());
+}
+
+//Returns hash of string (FNV-1a)
+uint32_t string_pool::hash(std::string_view str)
+{
+	uint32_t ret = 2166136261u;
+	for(size_t i = 0; i != str.length(); ++i)
+	{
+		ret ^= static_cast<uint8_t>(str[i]);
+		ret *= 16777619u;
+	}
+
+	return ret;
+}
+
+//Doubles hash table size and reinserts all strings
+void string_pool::grow()
+{
+	std::vector<uint32_t> buckets(buckets_.empty() ? 64 : buckets_.size() * 2, 0);
+	size_t mask = buckets.size() - 1;
+	for(size_t i = 0; i != hashes_.size(); ++i)
+	{
+		size_t pos = hashes_[i] & mask;
+		while(buckets[pos])
+			pos = (pos + 1) & mask;
+
+		buckets[pos] = static_cast<uint32_t>(i + 1);
+	}
+
+	buckets_.swap(buckets);
+}
+}
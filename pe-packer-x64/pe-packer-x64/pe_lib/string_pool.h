@@ -0,0 +1,52 @@
+#pragma once
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "stdint_defs.h"
+
+namespace pe_bliss
+{
+//Interning table for strings read from image
+//Each distinct string is stored once in large blocks, so no per-string allocations are made
+//Returned string views stay valid while pool exists (moving pool doesn't invalidate them)
+class string_pool
+{
+public:
+	//Default constructor
+	string_pool();
+
+	//Move constructor and assignment, moved-from pool is left empty and usable
+	string_pool(string_pool&& other) noexcept;
+	string_pool& operator=(string_pool&& other) noexcept;
+
+	//Returns index of string, adds string to pool if it is not there yet
+	uint32_t intern(std::string_view str);
+
+	//Returns string by index
+	std::string_view get(uint32_t index) const;
+
+	//Returns number of distinct strings in pool
+	size_t size() const;
+
+private:
+	string_pool(const string_pool&);
+	string_pool& operator=(const string_pool&);
+
+	//Leaves pool empty, the next string starts a new block
+	void reset();
+	//Copies string to blocks, returns null-terminated copy
+	std::string_view store(std::string_view str);
+	//Returns hash of string (FNV-1a)
+	static uint32_t hash(std::string_view str);
+	//Doubles hash table size and reinserts all strings
+	void grow();
+
+	static const size_t block_size = 0x10000;
+
+	std::vector<std::unique_ptr<char[]> > blocks_, large_blocks_;
+	size_t block_used_;
+	std::vector<std::string_view> strings_;
+	std::vector<uint32_t> hashes_; //Hash of each string
+	std::vector<uint32_t> buckets_; //Open addressing hash table, string index + 1 or zero for empty bucket
+};
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// FIFO queue with fixed capacity shared between pipeline stages
+// push() blocks while the queue is full, pop() blocks while it is empty
+template <typename T>
+class c_bounded_queue
+{
+public:
+	explicit c_bounded_queue(std::size_t capacity) : m_capacity(capacity ? capacity : 1) {}
+
+	// returns false if queue has been closed
+	bool push(T item) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_not_full.wait(lock, [this]() { return m_closed || m_items.size() < m_capacity; });
+		if (m_closed)
+			return false;
+
+		m_items.push_back(std::move(item));
+		m_not_empty.notify_one();
+		return true;
+	}
+
+	// returns false when queue is closed and all items have been taken
+	bool pop(T& item) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_not_empty.wait(lock, [this]() { return m_closed || !m_items.empty(); });
+		if (m_items.empty())
+			return false;
+
+		item = std::move(m_items.front());
+		m_items.pop_front();
+		m_not_full.notify_one();
+		return true;
+	}
+
+	// no more items will be pushed, waiting consumers drain the queue and stop
+	void close() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+		m_not_empty.notify_all();
+		m_not_full.notify_all();
+	}
+
+private:
+	std::size_t m_capacity;
+	bool m_closed = false;
+	std::deque<T> m_items;
+	std::mutex m_mutex;
+	std::condition_variable m_not_empty;
+	std::condition_variable m_not_full;
+};
+
+// Limits number of bytes held by all pipeline stages at once
+// A single request larger than the limit is still let through when nothing else is held
+class c_byte_budget
+{
+public:
+	explicit c_byte_budget(std::uint64_t limit) : m_limit(limit) {}
+
+	// blocks until bytes fit into the budget
+	void acquire(std::uint64_t bytes) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_released.wait(lock, [this, bytes]() { return m_used == 0 || m_used + bytes <= m_limit; });
+		m_used += bytes;
+	}
+
+	// accounts bytes without waiting (for buffers which already exist)
+	void add(std::uint64_t bytes) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_used += bytes;
+	}
+
+	void release(std::uint64_t bytes) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_used -= bytes < m_used ? bytes : m_used;
+		m_released.notify_all();
+	}
+
+private:
+	std::uint64_t m_limit;
+	std::uint64_t m_used = 0;
+	std::mutex m_mutex;
+	std::condition_variable m_released;
+};
@@ -1,15 +1,32 @@
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+#include <cstdint>
 #include <random>
 
+// generator state is per thread, stub chunks generated in parallel use their own streams
+inline std::mt19937& random_engine() {
+    static thread_local std::mt19937 rng(std::random_device{}());
+    return rng;
+}
+
+inline void seed_random(std::uint32_t seed) {
+    random_engine().seed(seed);
+}
+
 inline int random_value(int from, int to) {
-    std::random_device dev;
-    std::mt19937 rng(dev());
     std::uniform_int_distribution<std::mt19937::result_type> dist6(from, to);
 
-    return dist6(rng);
+    return dist6(random_engine());
+}
+
+// replacement of rand(), values are in range [0, 0x7FFFFFFF]
+inline int random_int() {
+    return static_cast<int>(random_engine()() >> 1);
 }
 
 inline void enable_virtual_terminal_processing() {
+#ifdef _WIN32
     HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
     if (hOut == INVALID_HANDLE_VALUE) return;
 
@@ -18,4 +35,5 @@ inline void enable_virtual_terminal_processing() {
 
     dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
     SetConsoleMode(hOut, dwMode);
+#endif
 }
\ No newline at end of file